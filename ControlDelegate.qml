@@ -19,7 +19,7 @@ Pane {
             }
             return "#6A6A6A"     // Black border for individual regimes
         }
-        border.width: model.cycle_status === 1 ? 2 : 1  // Thicker border for cycles
+        border.width: model.cycle_status === 1 ? 1 + model.cycle_depth : 1  // Thicker border for cycles, more so when nested
         color: {
             // Background highlighting for cycles
             if (model.cycle_status === 1) {
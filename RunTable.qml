@@ -20,6 +20,20 @@ Item {
     //     }
     // }
 
+    // Selected rows as [first, last] ranges, so the model works per block instead of per row
+    function selectedRanges() {
+        let ranges = []
+        for (let i = 0; i < repeater.count; i++) {
+            if (!repeater.itemAt(i).isSelected)
+                continue
+            if (ranges.length > 0 && ranges[ranges.length - 1][1] === i - 1)
+                ranges[ranges.length - 1][1] = i
+            else
+                ranges.push([i, i])
+        }
+        return ranges
+    }
+
     Dialog {
         id: unsavedChangesDialog
         title: "Unsaved Changes"
@@ -37,6 +51,35 @@ Item {
         }
     }
 
+    // Offered whenever a loaded file has a journal of edits that were never saved
+    Dialog {
+        id: autosaveDialog
+        title: qsTr("Несохранённые изменения")
+        standardButtons: Dialog.Yes | Dialog.No
+        modal: true
+        closePolicy: Popup.NoAutoClose
+        anchors.centerIn: parent
+
+        Label {
+            text: qsTr("Найдены изменения программы, которые не были сохранены. Восстановить их?")
+        }
+
+        onAccepted: RegimeManager.restoreAutosave()
+        onRejected: RegimeManager.discardAutosave()
+        Component.onCompleted: {
+            if (RegimeManager.autosaveAvailable)
+                open()
+        }
+
+        Connections {
+            target: RegimeManager
+            function onAutosaveAvailableChanged() {
+                if (RegimeManager.autosaveAvailable)
+                    autosaveDialog.open()
+            }
+        }
+    }
+
     FileDialog {
         id: openFileDialog
         title: "Please choose a file to open"
@@ -62,6 +105,21 @@ Item {
         }
     }
 
+    FileDialog {
+        id: reportFileDialog
+        property bool repeats: false
+        title: "Please choose a report file"
+        defaultSuffix: "csv"
+        fileMode: FileDialog.SaveFile
+        nameFilters: ["CSV files (*.csv)", "Columnar reports (*.grr)"]
+        onAccepted: {
+            if (repeats)
+                RegimeManager.exportRepeatReport(selectedFile)
+            else
+                RegimeManager.exportRowReport(selectedFile)
+        }
+    }
+
     TableView {
         id: tableView
         x: 10
@@ -75,9 +133,10 @@ Item {
         property var columnWidths: [70, 165, 80, 90]
         columnWidthProvider: function (column) { return columnWidths[column] }
         boundsBehavior: TableView.StopAtBounds
-        model: RegimeManager.model
+        // While searching only the matching rows are shown
+        model: RegimeManager.filterModel.active ? RegimeManager.filterModel : RegimeManager.model
         selectionModel: ItemSelectionModel {
-            model: RegimeManager.model
+            model: tableView.model
         }
         
         // Synchronize with controlsView scrollbar
@@ -162,6 +221,8 @@ Item {
         width: 245
         height: 225
         clip: true
+        // Row controls line up with the full program only
+        visible: !RegimeManager.filterModel.active
         // implicitHeight: 400
         // Synchronize with tableView scrollbar
         property bool syncingScroll: false
@@ -230,6 +291,27 @@ Item {
         height: 130
     }
 
+    TextField {
+        id: searchField
+        x: 420
+        y: 375
+        width: 245
+        height: 40
+        font.pointSize: 9
+        placeholderText: qsTr("Поиск режима")
+        onTextChanged: RegimeManager.filterModel.searchText = text
+        rightPadding: matchLabel.width + 8
+
+        Label {
+            id: matchLabel
+            anchors.right: parent.right
+            anchors.rightMargin: 6
+            anchors.verticalCenter: parent.verticalCenter
+            visible: RegimeManager.filterModel.active
+            text: RegimeManager.filterModel.matchCount
+        }
+    }
+
     MenuBar {
         id: menuBar
         x: 150
@@ -253,6 +335,33 @@ Item {
                 text: qsTr("Экспорт")
                 onTriggered: saveAsFileDialog.open()
             }
+            MenuItem {
+                text: qsTr("Отчёт по режимам")
+                onTriggered: {
+                    reportFileDialog.repeats = false
+                    reportFileDialog.open()
+                }
+            }
+            MenuItem {
+                text: qsTr("Отчёт по повторам")
+                onTriggered: {
+                    reportFileDialog.repeats = true
+                    reportFileDialog.open()
+                }
+            }
+        }
+        Menu {
+            title: "Правка"
+            MenuItem {
+                text: RegimeManager.model.canUndo ? qsTr("Отменить: ") + RegimeManager.model.undoText : qsTr("Отменить")
+                enabled: RegimeManager.model.canUndo
+                onTriggered: RegimeManager.model.undo()
+            }
+            MenuItem {
+                text: RegimeManager.model.canRedo ? qsTr("Повторить: ") + RegimeManager.model.redoText : qsTr("Повторить")
+                enabled: RegimeManager.model.canRedo
+                onTriggered: RegimeManager.model.redo()
+            }
         }
         Menu {
             title: "Добавить"
@@ -275,14 +384,7 @@ Item {
                 text: "Удалить выбранные"
                 // enabled: controlsGridLayout.selectedRows.length > 0
                 onTriggered: {
-                    let tSelectedRows = []
-                    for(let i = 0; i < repeater.count; i++){
-                        if(repeater.itemAt(i).isSelected)
-                        {
-                            tSelectedRows.push(i)
-                        }
-                    }
-                    RegimeManager.model.deleteRows(tSelectedRows)
+                    RegimeManager.model.deleteRows(selectedRanges())
                     for(let i = 0; i < repeater.count; i++)
                         repeater.itemAt(i).isSelected = false
                 }
@@ -294,20 +396,8 @@ Item {
                 text: "Сгруппировать"
                 // enabled: controlsGridLayout.isSelectionGroupable
                 onTriggered: {
-                    let tSelectedRows = []
-                    for(let i = 0; i < repeater.count; i++){
-                        if(repeater.itemAt(i).isSelected)
-                        {
-                            if (repeater.itemAt(i).model.cycle_status === 1) {
-                                for (let j = 0; j < repeater.itemAt(i).model.cycle_row_count; j++) {
-                                    tSelectedRows.push(i + j)
-                                }
-                            } else {
-                                tSelectedRows.push(i)
-                            }
-                        }
-                    }
-                    RegimeManager.model.groupRows(tSelectedRows)
+                    // Cycles are taken whole by the model, one selected row of them is enough
+                    RegimeManager.model.groupRows(selectedRanges())
                     for(let i = 0; i < repeater.count; i++)
                         repeater.itemAt(i).isSelected = false
                 }
@@ -316,20 +406,8 @@ Item {
                 text: "Разгруппировать"
                 // enabled: controlsGridLayout.isSelectionUngroupable
                 onTriggered: {
-                    let tSelectedRows = []
-                    for(let i = 0; i < repeater.count; i++){
-                        if(repeater.itemAt(i).isSelected)
-                        {
-                            if (repeater.itemAt(i).model.cycle_status === 1) {
-                                for (let j = 0; j < repeater.itemAt(i).model.cycle_row_count; j++) {
-                                    tSelectedRows.push(i + j)
-                                }
-                            } else {
-                                tSelectedRows.push(i)
-                            }
-                        }
-                    }
-                    RegimeManager.model.ungroupRows(tSelectedRows)
+                    // Cycles are taken whole by the model, one selected row of them is enough
+                    RegimeManager.model.ungroupRows(selectedRanges())
                     for(let i = 0; i < repeater.count; i++)
                         repeater.itemAt(i).isSelected = false
                 }
@@ -345,6 +423,15 @@ Item {
         }
     }
 
+    Shortcut {
+        sequence: StandardKey.Undo
+        onActivated: RegimeManager.model.undo()
+    }
+    Shortcut {
+        sequence: StandardKey.Redo
+        onActivated: RegimeManager.model.redo()
+    }
+
     function formatTime(seconds) {
         var hours = Math.floor(seconds / 3600)
         var minutes = Math.floor((seconds % 3600) / 60)
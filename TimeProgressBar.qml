@@ -12,6 +12,23 @@ Rectangle {
     property int visibleStartTime: 0
     property int visibleEndTime: RegimeManager.getTotalEstimatedTime()
     property real timelineScale: 1.0  // Scale factor for timeline width
+    property int totalTime: RegimeManager.getTotalEstimatedTime()
+    // Bumped once per rendered frame while a row runs; progress bindings read it to follow the phase clock
+    property int frame: 0
+    // Bumped whenever sensor traces change; trace overlays repaint on it
+    property int traceRevision: 0
+
+    FrameAnimation {
+        running: RegimeManager.phaseClock.active
+        onTriggered: root.frame++
+    }
+
+    Connections {
+        target: RegimeManager.sensorTraces
+        function onTracesChanged() {
+            root.traceRevision++
+        }
+    }
     
     Component.onCompleted: {
         updateTimeRange()
@@ -57,7 +74,7 @@ Rectangle {
             startTimeField.text = formatTime(root.visibleStartTime)
             
             // Update time label
-            timeLabel.text = formatTime(RegimeManager.getTotalElapsedTime()) + " / " + formatTime(totalTime)
+            root.totalTime = totalTime
             
             // Update visible regimes
             RegimeManager.updateVisibleRegimes(root.visibleStartTime, root.visibleEndTime)
@@ -71,6 +88,16 @@ Rectangle {
         return Qt.formatTime(new Date(0, 0, 0, hours, minutes, secs), "hh:mm:ss")
     }
     
+    // Seconds into a phase of a timeline entry; the repeat in progress follows the phase clock
+    function elapsedInPhase(entry, execution) {
+        if (root.frame < 0 || entry.repeatIndex !== entry.currentRepeat)
+            return (execution ? entry.regimeTimePassed : entry.conditionTimePassed) || 0
+        // The clock is keyed by program row, which regimeIndex is in any window
+        var row = entry.regimeIndex
+        return execution ? RegimeManager.phaseClock.regimeElapsed(row)
+                         : RegimeManager.phaseClock.conditionElapsed(row)
+    }
+
     function timeToSeconds(timeString) {
         var parts = timeString.split(':')
         if (parts.length !== 3) {
@@ -149,7 +176,7 @@ Rectangle {
                         id: conditionProgress
                         width: {
                             if (model.conditionTime > 0 && model.state === 2) { // Running
-                                var conditionTimePassed = model.conditionTimePassed || 0
+                                var conditionTimePassed = root.elapsedInPhase(model, false)
                                 var conditionProgressRatio = conditionTimePassed / model.conditionTime
                                 var conditionWidthRatio = model.conditionTime / model.maxTime
                                 return Math.min(conditionProgressRatio, 1.0) * conditionWidthRatio * parent.width
@@ -174,7 +201,7 @@ Rectangle {
                         }
                         width: {
                             if (model.maxTime > 0 && model.state === 2) { // Running
-                                var regimeTimePassed = model.regimeTimePassed || 0
+                                var regimeTimePassed = root.elapsedInPhase(model, true)
                                 var regimeExecutionTime = model.regimeExecutionTime
                                 
                                 if (regimeExecutionTime > 0) {
@@ -207,6 +234,41 @@ Rectangle {
                         visible: model.conditionTime > 0
                     }
 
+                    // Measured temperature of this repeat, downsampled to the block width;
+                    // traces are kept by program row, which regimeIndex is in any window
+                    Loader {
+                        anchors.fill: parent
+                        active: root.traceRevision >= 0 && RegimeManager.sensorTraces.hasTrace(model.regimeIndex, model.repeatIndex)
+                        sourceComponent: Canvas {
+                            id: traceCanvas
+                            property int revision: root.traceRevision
+                            onRevisionChanged: requestPaint()
+                            onWidthChanged: requestPaint()
+                            onPaint: {
+                                var ctx = getContext("2d")
+                                ctx.reset()
+                                var trace = RegimeManager.sensorTraces.trace(model.regimeIndex, model.repeatIndex, Math.ceil(width))
+                                if (!trace.times || model.maxTime <= 0)
+                                    return
+                                var times = new Float64Array(trace.times)
+                                var values = new Float32Array(trace.values)
+                                var range = Math.max(trace.max - trace.min, 0.001)
+                                ctx.strokeStyle = "#c0392b"
+                                ctx.lineWidth = 1
+                                ctx.beginPath()
+                                for (var i = 0; i < times.length; ++i) {
+                                    var x = times[i] / model.maxTime * width
+                                    var y = height - 2 - (values[i] - trace.min) / range * (height - 4)
+                                    if (i === 0)
+                                        ctx.moveTo(x, y)
+                                    else
+                                        ctx.lineTo(x, y)
+                                }
+                                ctx.stroke()
+                            }
+                        }
+                    }
+
                     // Regime name text with repeat info
                     Text {
                         text: {
@@ -260,7 +322,8 @@ Rectangle {
                                 }
                                 
                                 // Add condition information if available
-                                var regime = RegimeManager.model.getRegime(index)
+                                // regimeIndex is the program row, also in partial windows
+                                var regime = RegimeManager.model.getRegime(model.regimeIndex)
                                 if (regime && regime.condition) {
                                     if (regime.condition.type === "time") {
                                         tooltip += `\nУсловие: Ожидание ${regime.condition.time} мин`
@@ -303,11 +366,37 @@ Rectangle {
         y: 55
         width: parent.width
         // color: "white"
-        text: formatTime(RegimeManager.getTotalElapsedTime()) + " / " + formatTime(RegimeManager.getTotalEstimatedTime())
+        text: formatTime(Math.floor(root.frame >= 0 ? RegimeManager.phaseClock.totalElapsed() : 0)) + " / " + formatTime(root.totalTime)
         horizontalAlignment: Text.AlignHCenter
         verticalAlignment: Text.AlignVCenter
     }
 
+    // Projected finish, corrected by the phase durations observed in this run
+    Label {
+        id: etaLabel
+        y: 55
+        anchors.left: parent.left
+        anchors.leftMargin: 10
+        visible: RegimeManager.eta.secondsLeft > 0
+        font.pixelSize: 11
+        text: "Осталось " + formatTime(RegimeManager.eta.secondsLeft)
+              + " · окончание " + Qt.formatDateTime(RegimeManager.eta.finishTime, "dd.MM hh:mm")
+    }
+
+    // Monte Carlo forecast of the remaining time (P50 / P90 / P99)
+    Label {
+        id: forecastLabel
+        y: 55
+        anchors.right: parent.right
+        anchors.rightMargin: 10
+        visible: RegimeManager.forecaster.p99 > 0
+        opacity: RegimeManager.forecaster.busy ? 0.6 : 1.0
+        font.pixelSize: 11
+        text: "P50 " + formatTime(RegimeManager.forecaster.p50)
+              + " · P90 " + formatTime(RegimeManager.forecaster.p90)
+              + " · P99 " + formatTime(RegimeManager.forecaster.p99)
+    }
+
     // Time range controls
     RowLayout {
         id: timeControls
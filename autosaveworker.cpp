@@ -0,0 +1,146 @@
+#include "autosaveworker.h"
+#include "prototablemodel.h"
+
+AutosaveWorker::AutosaveWorker(ProtoTableModel *model, QObject *parent)
+    : QObject{parent}
+    , m_model(model)
+    , m_state(std::make_shared<WriterState>())
+{
+    // One writer thread keeps journal updates strictly ordered
+    m_writer.setMaxThreadCount(1);
+    m_writer.setObjectName("AutosaveWriter");
+
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(10000);
+    connect(&m_timer, &QTimer::timeout, this, &AutosaveWorker::saveNow);
+    connect(m_model, &ProtoTableModel::definitionChanged, this, &AutosaveWorker::markPending);
+}
+
+AutosaveWorker::~AutosaveWorker()
+{
+    // Flush what is pending so a clean shutdown loses nothing
+    if (m_pending)
+        saveNow();
+    m_writer.waitForDone();
+}
+
+bool AutosaveWorker::isEnabled() const
+{
+    return m_enabled;
+}
+
+void AutosaveWorker::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    m_enabled = enabled;
+    if (!m_enabled)
+        m_timer.stop();
+    else if (m_pending)
+        m_timer.start();
+    emit enabledChanged();
+}
+
+int AutosaveWorker::interval() const
+{
+    return m_timer.interval();
+}
+
+void AutosaveWorker::setInterval(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (m_timer.interval() != milliseconds) {
+        m_timer.setInterval(milliseconds);
+        emit intervalChanged();
+    }
+}
+
+QString AutosaveWorker::journalPath() const
+{
+    return m_journalPath;
+}
+
+void AutosaveWorker::setJournalPath(const QString &path)
+{
+    if (m_journalPath == path)
+        return;
+    m_journalPath = path;
+
+    std::shared_ptr<WriterState> state = m_state;
+    m_writer.start([state, path]() { state->journal.setFilePath(path); });
+    emit journalPathChanged();
+    markPending();
+}
+
+bool AutosaveWorker::isPending() const
+{
+    return m_pending;
+}
+
+void AutosaveWorker::saveNow()
+{
+    m_timer.stop();
+    if (m_journalPath.isEmpty() || !m_enabled)
+        return;
+
+    const ProgramSnapshotPtr snapshot = m_model->snapshot();
+    std::shared_ptr<WriterState> state = m_state;
+    state->newestQueued.store(snapshot->version, std::memory_order_relaxed);
+    setPending(false);
+
+    m_writer.start([this, state, snapshot]() {
+        // A newer snapshot is already queued behind this one
+        if (snapshot->version < state->newestQueued.load(std::memory_order_relaxed))
+            return;
+
+        const bool ok = state->journal.update(snapshot->regimes.toList());
+        const qint64 written = state->journal.lastWriteSize();
+        const QString path = state->journal.filePath();
+        // The destructor waits for the writer, so `this` is alive here
+        QMetaObject::invokeMethod(this, [this, ok, written, path, version = snapshot->version]() {
+            if (ok)
+                emit saved(version, written);
+            else
+                emit failed(path);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void AutosaveWorker::discardJournal()
+{
+    m_timer.stop();
+    setPending(false);
+    std::shared_ptr<WriterState> state = m_state;
+    m_writer.start([state]() { state->journal.remove(); });
+}
+
+void AutosaveWorker::markSaved()
+{
+    m_timer.stop();
+    setPending(false);
+}
+
+void AutosaveWorker::waitForIdle()
+{
+    m_writer.waitForDone();
+}
+
+bool AutosaveWorker::recover(const QString &journalPath, QList<Regime> &regimes)
+{
+    return ProgramJournal::read(journalPath, regimes);
+}
+
+void AutosaveWorker::markPending()
+{
+    setPending(true);
+    if (m_enabled && !m_timer.isActive())
+        m_timer.start();
+}
+
+void AutosaveWorker::setPending(bool pending)
+{
+    if (m_pending != pending) {
+        m_pending = pending;
+        emit pendingChanged();
+    }
+}
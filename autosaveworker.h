@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include "programfile.h"
+
+class ProtoTableModel;
+
+/**
+ * @brief Periodically persists program definition changes to a journal off the GUI thread
+ *
+ * Only ProtoTableModel::definitionChanged() schedules a save; execution progress never
+ * does. When the interval elapses the worker captures the model's immutable snapshot (a
+ * reference count increment) and hands it to a dedicated writer thread, which diffs it
+ * against what was persisted last and appends only the changed records to a
+ * ProgramJournal. Saves queued while the writer is busy collapse into the newest one.
+ */
+class AutosaveWorker : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY enabledChanged)
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_PROPERTY(QString journalPath READ journalPath WRITE setJournalPath NOTIFY journalPathChanged)
+    Q_PROPERTY(bool pending READ isPending NOTIFY pendingChanged)
+
+public:
+    explicit AutosaveWorker(ProtoTableModel *model, QObject *parent = nullptr);
+    ~AutosaveWorker() override;
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    /// Delay in milliseconds between the first unsaved change and the autosave
+    int interval() const;
+    void setInterval(int milliseconds);
+
+    QString journalPath() const;
+    void setJournalPath(const QString &path);
+
+    /// True while there are definition changes that have not been handed to the writer
+    bool isPending() const;
+
+    /// Queues a save of the current program right away
+    Q_INVOKABLE void saveNow();
+    /// Deletes the journal, e.g. after the program was saved explicitly
+    Q_INVOKABLE void discardJournal();
+    /// Forgets pending changes because the program matches its file (just loaded)
+    void markSaved();
+    /// Blocks until all queued writes are done
+    void waitForIdle();
+
+    /// Reads back a journal left behind by a previous session
+    static bool recover(const QString &journalPath, QList<Regime> &regimes);
+
+signals:
+    void enabledChanged();
+    void intervalChanged();
+    void journalPathChanged();
+    void pendingChanged();
+    /// Snapshot version persisted and the number of bytes written for it
+    void saved(quint64 version, qint64 bytesWritten);
+    void failed(const QString &journalPath);
+
+private:
+    // Touched only by writer jobs, which the single-thread pool runs one at a time
+    struct WriterState {
+        ProgramJournal journal;
+        std::atomic<quint64> newestQueued{0};
+    };
+
+    void markPending();
+    void setPending(bool pending);
+
+    ProtoTableModel *m_model = nullptr;
+    QThreadPool m_writer;
+    QTimer m_timer;
+    std::shared_ptr<WriterState> m_state;
+    QString m_journalPath;
+    bool m_enabled = true;
+    bool m_pending = false;
+};
@@ -0,0 +1,402 @@
+#include "completionforecaster.h"
+#include "parallelchunks.h"
+#include "prototablemodel.h"
+#include <QDebug>
+#include <QThreadPool>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr int kChunkSize = 1024;
+// Sums of more identical condition phases than this are drawn from their normal approximation
+constexpr qint64 kNormalApproxThreshold = 32;
+constexpr quint64 kSeed = 0x5EED2024ULL;
+
+// `count` condition phases, each uniform in [low, high] seconds
+struct StochasticGroup {
+    double low = 0.0;
+    double high = 0.0;
+    qint64 count = 0;
+};
+
+// Condition phase of a running repeat that has already waited `passed` seconds
+struct PartialCondition {
+    double low = 0.0;
+    double high = 0.0;
+    double passed = 0.0;
+};
+
+struct RemainingWork {
+    double fixedSeconds = 0.0;
+    std::vector<StochasticGroup> groups;
+    std::vector<PartialCondition> partials;
+
+    bool isDeterministic() const { return groups.empty() && partials.empty(); }
+};
+
+// Remaining work of one row; the program's is the sum over its rows
+struct RowWork {
+    qint64 fixedMs = 0;     // Execution time and conditions of fixed length
+    double low = 0.0;       // Range of each condition phase
+    double high = 0.0;
+    qint64 phases = 0;      // Condition phases of random length not started yet
+    double passed = -1.0;   // Condition time waited by the repeat in progress, -1 if it has none
+};
+
+// Sum of the work of every row; rows are added and taken out one at a time
+struct ProgramWork {
+    // Whole milliseconds, so taking a row out restores the sum exactly
+    qint64 fixedMs = 0;
+    std::map<std::pair<double, double>, qint64> groups;
+    std::map<int, PartialCondition> partials;
+
+    void add(int row, const RowWork &work, int sign)
+    {
+        fixedMs += sign * work.fixedMs;
+        if (work.phases > 0) {
+            const auto it = groups.try_emplace(std::make_pair(work.low, work.high), 0).first;
+            it->second += sign * work.phases;
+            if (it->second == 0)
+                groups.erase(it);
+        }
+        if (work.passed >= 0.0) {
+            if (sign > 0)
+                partials[row] = {work.low, work.high, work.passed};
+            else
+                partials.erase(row);
+        }
+    }
+
+    RemainingWork remaining() const
+    {
+        RemainingWork work;
+        work.fixedSeconds = fixedMs / 1000.0;
+        for (const auto &[range, count] : groups)
+            work.groups.push_back({range.first, range.second, count});
+        for (const auto &[row, partial] : partials)
+            work.partials.push_back(partial);
+        return work;
+    }
+};
+
+bool isFinished(RegimeEnums::State state)
+{
+    return state == RegimeEnums::State::Done
+        || state == RegimeEnums::State::Skipped
+        || state == RegimeEnums::State::Error;
+}
+
+RowWork rowWork(const Regime &regime, const QHash<QString, CompletionForecaster::Distribution> &distributions)
+{
+    RowWork work;
+    if (isFinished(regime.m_state))
+        return work;
+
+    const qint64 units = qint64(regime.m_repeatCount) * regime.cyclePasses();
+    const int processed = regime.m_repeatsDone + regime.m_repeatsSkipped + regime.m_repeatsError;
+    qint64 remaining = units - processed;
+    if (remaining <= 0)
+        return work;
+
+    const CompletionForecaster::Distribution distribution = distributions.value(regime.m_condition.type);
+    const double planned = regime.conditionTimeInSeconds();
+    work.low = planned * distribution.minFraction;
+    work.high = planned * distribution.maxFraction;
+
+    // The repeat in progress only has its unfinished part left
+    double fixedSeconds = 0.0;
+    if (regime.m_state == RegimeEnums::State::Running || regime.m_state == RegimeEnums::State::Paused) {
+        --remaining;
+        if (!regime.m_conditionCompleted) {
+            work.passed = regime.m_conditionTimePassed;
+            fixedSeconds += regime.m_maxTime;
+        } else {
+            fixedSeconds += qMax(0, regime.m_maxTime - regime.m_regimeTimePassed);
+        }
+    }
+
+    fixedSeconds += double(remaining) * regime.m_maxTime;
+    if (work.high > work.low)
+        work.phases = remaining;
+    else
+        fixedSeconds += double(remaining) * work.low;
+    work.fixedMs = qRound64(fixedSeconds * 1000.0);
+    return work;
+}
+
+double sampleOnce(const RemainingWork &work, std::mt19937_64 &rng)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    double total = work.fixedSeconds;
+    for (const StochasticGroup &group : work.groups) {
+        const double width = group.high - group.low;
+        if (group.count > kNormalApproxThreshold) {
+            const double mean = group.count * (group.low + group.high) / 2.0;
+            const double sigma = width * std::sqrt(group.count / 12.0);
+            total += qBound(group.count * group.low, mean + sigma * normal(rng), group.count * group.high);
+        } else {
+            for (qint64 i = 0; i < group.count; ++i)
+                total += group.low + width * unit(rng);
+        }
+    }
+
+    for (const PartialCondition &partial : work.partials) {
+        if (partial.passed >= partial.high)
+            continue; // Overdue, the condition can complete at any moment
+        const double low = qMax(partial.low, partial.passed);
+        total += low + (partial.high - low) * unit(rng) - partial.passed;
+    }
+    return total;
+}
+
+// Nearest-rank percentile; partially reorders `values`
+int percentile(std::vector<double> &values, double p)
+{
+    const size_t rank = qMax<size_t>(1, size_t(qCeil(p * values.size())));
+    auto nth = values.begin() + (rank - 1);
+    std::nth_element(values.begin(), nth, values.end());
+    return qCeil(*nth);
+}
+
+CompletionForecaster::Forecast sample(const RemainingWork &work, int samples, quint64 seed, QThreadPool *pool)
+{
+    CompletionForecaster::Forecast forecast;
+    if (samples <= 0)
+        return forecast;
+    forecast.samples = samples;
+
+    if (work.isDeterministic()) {
+        forecast.p50 = forecast.p90 = forecast.p99 = qCeil(work.fixedSeconds);
+        return forecast;
+    }
+
+    std::vector<double> results(samples);
+    const int chunkCount = (samples + kChunkSize - 1) / kChunkSize;
+    runParallelChunks(chunkCount, [&work, &results, samples, seed](int chunk) {
+        // Seeding per chunk keeps the result independent of thread scheduling
+        std::mt19937_64 rng(seed + 0x9E3779B97F4A7C15ULL * quint64(chunk + 1));
+        const int begin = chunk * kChunkSize;
+        const int end = qMin(samples, begin + kChunkSize);
+        for (int i = begin; i < end; ++i) {
+            results[i] = sampleOnce(work, rng);
+        }
+    }, pool);
+
+    forecast.p50 = percentile(results, 0.50);
+    forecast.p90 = percentile(results, 0.90);
+    forecast.p99 = percentile(results, 0.99);
+    return forecast;
+}
+
+} // namespace
+
+struct CompletionForecaster::Work {
+    QList<RowWork> rows;
+    ProgramWork total;
+};
+
+CompletionForecaster::CompletionForecaster(ProtoTableModel *model, QObject *parent)
+    : QObject{parent}
+    , m_model(model)
+    , m_pool(QThreadPool::globalInstance())
+    , m_channel(std::make_shared<Channel>())
+    , m_work(std::make_unique<Work>())
+{
+    m_channel->receiver = this;
+
+    // `time` conditions always take their full time; `temp` ones end once the target is reached
+    m_distributions.insert("none", {0.0, 0.0});
+    m_distributions.insert("time", {1.0, 1.0});
+    m_distributions.insert("temp", {0.25, 1.0});
+
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(250);
+    connect(&m_debounce, &QTimer::timeout, this, &CompletionForecaster::startJob);
+
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                    updateRows(topLeft.row(), bottomRight.row());
+                });
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, &CompletionForecaster::invalidateWork);
+        connect(m_model, &QAbstractItemModel::rowsRemoved, this, &CompletionForecaster::invalidateWork);
+        connect(m_model, &QAbstractItemModel::rowsMoved, this, &CompletionForecaster::invalidateWork);
+        connect(m_model, &QAbstractItemModel::modelReset, this, &CompletionForecaster::invalidateWork);
+        connect(m_model, &QAbstractItemModel::layoutChanged, this, &CompletionForecaster::invalidateWork);
+    }
+}
+
+CompletionForecaster::~CompletionForecaster()
+{
+    QMutexLocker locker(&m_channel->mutex);
+    m_channel->receiver = nullptr;
+}
+
+int CompletionForecaster::p50() const
+{
+    return m_forecast.p50;
+}
+
+int CompletionForecaster::p90() const
+{
+    return m_forecast.p90;
+}
+
+int CompletionForecaster::p99() const
+{
+    return m_forecast.p99;
+}
+
+bool CompletionForecaster::busy() const
+{
+    return m_busy;
+}
+
+int CompletionForecaster::sampleCount() const
+{
+    return m_sampleCount;
+}
+
+void CompletionForecaster::setSampleCount(int count)
+{
+    count = qBound(100, count, 1000000);
+    if (m_sampleCount == count)
+        return;
+    m_sampleCount = count;
+    emit sampleCountChanged();
+    requestUpdate();
+}
+
+void CompletionForecaster::setThreadPool(QThreadPool *pool)
+{
+    m_pool = pool ? pool : QThreadPool::globalInstance();
+}
+
+void CompletionForecaster::setConditionDistribution(const QString &conditionType, double minFraction, double maxFraction)
+{
+    if (minFraction < 0.0 || maxFraction < minFraction) {
+        qWarning() << "setConditionDistribution: Invalid range" << minFraction << maxFraction << "for" << conditionType;
+        return;
+    }
+    m_distributions.insert(conditionType, {minFraction, maxFraction});
+    invalidateWork();
+}
+
+void CompletionForecaster::requestUpdate()
+{
+    m_debounce.start();
+}
+
+void CompletionForecaster::invalidateWork()
+{
+    m_workDirty = true;
+    requestUpdate();
+}
+
+void CompletionForecaster::updateRows(int first, int last)
+{
+    if (!m_workDirty) {
+        if (first < 0 || last >= m_work->rows.count()) {
+            m_workDirty = true;
+        } else {
+            for (int row = first; row <= last; ++row) {
+                RowWork &work = m_work->rows[row];
+                m_work->total.add(row, work, -1);
+                work = rowWork(m_model->regimeAt(row), m_distributions);
+                m_work->total.add(row, work, 1);
+            }
+        }
+    }
+    requestUpdate();
+}
+
+void CompletionForecaster::rebuildWork()
+{
+    const int rows = m_model->rowCount();
+    m_work->rows.resize(rows);
+    m_work->total = ProgramWork();
+    for (int row = 0; row < rows; ++row) {
+        m_work->rows[row] = rowWork(m_model->regimeAt(row), m_distributions);
+        m_work->total.add(row, m_work->rows.at(row), 1);
+    }
+    m_workDirty = false;
+}
+
+CompletionForecaster::Forecast CompletionForecaster::simulate(const QList<Regime> &regimes,
+                                                              const QHash<QString, Distribution> &distributions,
+                                                              int samples,
+                                                              quint64 seed,
+                                                              QThreadPool *pool)
+{
+    ProgramWork work;
+    for (int row = 0; row < regimes.count(); ++row)
+        work.add(row, rowWork(regimes.at(row), distributions), 1);
+    return sample(work.remaining(), samples, seed, pool);
+}
+
+void CompletionForecaster::startJob()
+{
+    if (!m_model)
+        return;
+
+    // A job is already running; its completion picks up the latest state
+    if (m_busy) {
+        m_pending = true;
+        return;
+    }
+
+    m_pending = false;
+    setBusy(true);
+
+    if (m_workDirty)
+        rebuildWork();
+
+    // The job gets its own copy of the summed work, a few entries however long the program is
+    const RemainingWork work = m_work->total.remaining();
+    const int samples = m_sampleCount;
+    QThreadPool *pool = m_pool;
+    std::shared_ptr<Channel> channel = m_channel;
+    const quint64 generation = ++m_generation;
+
+    pool->start([work, samples, pool, channel, generation]() {
+        const Forecast forecast = sample(work, samples, kSeed, pool);
+
+        QMutexLocker locker(&channel->mutex);
+        if (CompletionForecaster *receiver = channel->receiver) {
+            QMetaObject::invokeMethod(receiver, [receiver, generation, forecast]() {
+                receiver->applyForecast(generation, forecast);
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void CompletionForecaster::applyForecast(quint64 generation, const Forecast &forecast)
+{
+    if (generation == m_generation) {
+        const bool changed = forecast.p50 != m_forecast.p50
+                          || forecast.p90 != m_forecast.p90
+                          || forecast.p99 != m_forecast.p99;
+        m_forecast = forecast;
+        if (changed)
+            emit forecastChanged();
+    }
+
+    setBusy(false);
+    if (m_pending)
+        startJob();
+}
+
+void CompletionForecaster::setBusy(bool busy)
+{
+    if (m_busy != busy) {
+        m_busy = busy;
+        emit busyChanged();
+    }
+}
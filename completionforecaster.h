@@ -0,0 +1,114 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+#include <memory>
+#include "regime.h"
+
+class ProtoTableModel;
+class QThreadPool;
+
+/**
+ * @brief Monte Carlo forecast of the time left until the program finishes
+ *
+ * Condition phases do not have a fixed length: a `temp` condition can finish anywhere
+ * between a fraction of `Condition::time` and the full time. The forecaster samples the
+ * remaining program (repeats, cycle repeats and the progress of the running repeat)
+ * many times on a thread pool and publishes the P50/P90/P99 percentiles of the
+ * remaining time. Updates are debounced and run in the background, so progress ticks
+ * never block the GUI thread.
+ *
+ * The remaining work of each row is cached and summed into a few groups of equal condition
+ * phases. A change re-reads only the rows it covers, so a job costs O(samples * groups)
+ * however long the program is. Inserts, removals, moves and distribution changes re-read
+ * every row once before the next job.
+ */
+class CompletionForecaster : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int p50 READ p50 NOTIFY forecastChanged)
+    Q_PROPERTY(int p90 READ p90 NOTIFY forecastChanged)
+    Q_PROPERTY(int p99 READ p99 NOTIFY forecastChanged)
+    Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
+    Q_PROPERTY(int sampleCount READ sampleCount WRITE setSampleCount NOTIFY sampleCountChanged)
+
+public:
+    /// Condition duration as a uniform fraction of the planned condition time
+    struct Distribution {
+        double minFraction = 1.0;
+        double maxFraction = 1.0;
+    };
+
+    /// Remaining time percentiles in seconds
+    struct Forecast {
+        int p50 = 0;
+        int p90 = 0;
+        int p99 = 0;
+        int samples = 0;
+    };
+
+    explicit CompletionForecaster(ProtoTableModel *model, QObject *parent = nullptr);
+    ~CompletionForecaster() override;
+
+    int p50() const;
+    int p90() const;
+    int p99() const;
+    bool busy() const;
+
+    int sampleCount() const;
+    void setSampleCount(int count);
+
+    /// Pool used for simulation jobs; defaults to QThreadPool::globalInstance()
+    void setThreadPool(QThreadPool *pool);
+
+    /// Sets the duration distribution for a condition type ("none", "time" or "temp")
+    Q_INVOKABLE void setConditionDistribution(const QString &conditionType, double minFraction, double maxFraction);
+
+    /// Schedules a background recomputation; bursts of calls are coalesced
+    Q_INVOKABLE void requestUpdate();
+
+    /// Simulates the remaining program synchronously, spreading samples over the pool
+    static Forecast simulate(const QList<Regime> &regimes,
+                             const QHash<QString, Distribution> &distributions,
+                             int samples,
+                             quint64 seed,
+                             QThreadPool *pool);
+
+signals:
+    void forecastChanged();
+    void busyChanged();
+    void sampleCountChanged();
+
+private:
+    // Lets a finishing job reach the forecaster only while it is still alive
+    struct Channel {
+        QMutex mutex;
+        CompletionForecaster *receiver = nullptr;
+    };
+
+    struct Work;
+
+    void invalidateWork();
+    void updateRows(int first, int last);
+    void rebuildWork();
+    void startJob();
+    void applyForecast(quint64 generation, const Forecast &forecast);
+    void setBusy(bool busy);
+
+    ProtoTableModel *m_model = nullptr;
+    QThreadPool *m_pool = nullptr;
+    QTimer m_debounce;
+    QHash<QString, Distribution> m_distributions;
+    std::shared_ptr<Channel> m_channel;
+    /// Remaining work per row and its sum; read only on the GUI thread
+    std::unique_ptr<Work> m_work;
+    bool m_workDirty = true;
+    Forecast m_forecast;
+    quint64 m_generation = 0;
+    int m_sampleCount = 10000;
+    bool m_busy = false;
+    bool m_pending = false;
+};
@@ -0,0 +1,349 @@
+#include "conditionevaluator.h"
+#include "regimemanager.h"
+#include <QDebug>
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr qsizetype kLanes = 16;
+
+/**
+ * Index of the first value from `from` on that matches, count if none does. Whole lanes
+ * are tested without an early exit, which lets the compiler turn the inner loop into
+ * vector compares; only the lane containing the crossing is scanned one by one.
+ */
+template <typename Predicate>
+qsizetype firstMatch(const float *values, qsizetype from, qsizetype count, Predicate matches)
+{
+    qsizetype i = from;
+    for (; i + kLanes <= count; i += kLanes) {
+        bool any = false;
+        for (qsizetype lane = 0; lane < kLanes; ++lane)
+            any |= matches(values[i + lane]);
+        if (any)
+            break;
+    }
+    for (; i < count; ++i) {
+        if (matches(values[i]))
+            return i;
+    }
+    return count;
+}
+
+} // namespace
+
+ConditionEvaluator::ConditionEvaluator(RegimeManager *manager, int capacity, QObject *parent)
+    : QObject{parent}
+    , m_manager(manager)
+    , m_queue(size_t(qMax(2, capacity)))
+{
+    m_drainTimer.setSingleShot(true);
+    m_drainTimer.setTimerType(Qt::PreciseTimer);
+    m_drainTimer.setInterval(16);
+    connect(&m_drainTimer, &QTimer::timeout, this, &ConditionEvaluator::drain);
+
+    m_deadlineTimer.setSingleShot(true);
+    m_deadlineTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_deadlineTimer, &QTimer::timeout, this, &ConditionEvaluator::drain);
+
+    ProtoTableModel *model = m_manager->model();
+    connect(model, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                updateRows(topLeft.row(), bottomRight.row());
+            });
+    connect(model, &QAbstractItemModel::rowsInserted, this, &ConditionEvaluator::rebuild);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &ConditionEvaluator::rebuild);
+    connect(model, &QAbstractItemModel::rowsMoved, this, &ConditionEvaluator::rebuild);
+    connect(model, &QAbstractItemModel::layoutChanged, this, &ConditionEvaluator::rebuild);
+    connect(model, &QAbstractItemModel::modelReset, this, &ConditionEvaluator::rebuild);
+    rebuild();
+}
+
+bool ConditionEvaluator::postSamples(int channel, const float *values, qsizetype count, qint64 timestampUs, int intervalUs)
+{
+    if (!values || count < 0 || intervalUs <= 0) {
+        qWarning() << "postSamples: Invalid sample block, count" << count << "interval" << intervalUs;
+        return false;
+    }
+
+    bool complete = true;
+    SampleBlock block;
+    block.channel = channel;
+    block.intervalUs = intervalUs;
+    for (qsizetype offset = 0; offset < count; offset += SamplesPerBlock) {
+        block.count = qint32(qMin<qsizetype>(SamplesPerBlock, count - offset));
+        block.timestampUs = timestampUs + offset * intervalUs;
+        std::copy_n(values + offset, block.count, block.values);
+        if (!m_queue.tryPush(block)) {
+            m_dropped.fetch_add(quint64(block.count), std::memory_order_relaxed);
+            complete = false;
+        }
+    }
+
+    // Only the first block after a drain wakes the GUI thread
+    if (count > 0 && !m_wakePending.exchange(true, std::memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, &ConditionEvaluator::scheduleDrain, Qt::QueuedConnection);
+    return complete;
+}
+
+int ConditionEvaluator::drain()
+{
+    // Cleared before popping: anything pushed from now on schedules another drain
+    m_wakePending.exchange(false, std::memory_order_acq_rel);
+
+    const size_t limit = m_queue.capacity();
+    size_t popped = 0;
+    SampleBlock block;
+    while (popped < limit && m_queue.tryPop(block)) {
+        ++popped;
+        m_processed += quint64(block.count);
+        if (block.channel != m_temperatureChannel)
+            continue;
+        // Recorded for the timeline even when conditions are confirmed by the driver
+        m_manager->sensorTraces()->appendRunning(block.values, block.count, block.timestampUs, block.intervalUs);
+        if (!m_enabled)
+            continue;
+        for (Watch &watch : m_watches) {
+            if (watch.temperature && !watch.met)
+                evaluate(watch, block);
+        }
+    }
+
+    // Hit the per-drain limit; pick up the rest on the next frame
+    if (popped == limit)
+        scheduleDrain();
+
+    const int confirmed = confirmMet();
+    scheduleDeadline();
+    return confirmed;
+}
+
+bool ConditionEvaluator::isEnabled() const
+{
+    return m_enabled;
+}
+
+void ConditionEvaluator::setEnabled(bool enabled)
+{
+    if (m_enabled == enabled)
+        return;
+    m_enabled = enabled;
+    scheduleDeadline();
+    emit settingsChanged();
+}
+
+int ConditionEvaluator::temperatureChannel() const
+{
+    return m_temperatureChannel;
+}
+
+void ConditionEvaluator::setTemperatureChannel(int channel)
+{
+    if (m_temperatureChannel == channel)
+        return;
+    m_temperatureChannel = channel;
+    // Samples of the old channel say nothing about the new one
+    for (Watch &watch : m_watches) {
+        watch.directionKnown = false;
+        watch.inside = false;
+    }
+    emit settingsChanged();
+}
+
+double ConditionEvaluator::hysteresis() const
+{
+    return m_hysteresis;
+}
+
+void ConditionEvaluator::setHysteresis(double degrees)
+{
+    degrees = qMax(0.0, degrees);
+    if (qFuzzyCompare(m_hysteresis, degrees))
+        return;
+    m_hysteresis = degrees;
+    emit settingsChanged();
+}
+
+int ConditionEvaluator::holdTime() const
+{
+    return m_holdTime;
+}
+
+void ConditionEvaluator::setHoldTime(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (m_holdTime == milliseconds)
+        return;
+    m_holdTime = milliseconds;
+    emit settingsChanged();
+}
+
+quint64 ConditionEvaluator::processedCount() const
+{
+    return m_processed;
+}
+
+quint64 ConditionEvaluator::droppedCount() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void ConditionEvaluator::scheduleDrain()
+{
+    if (!m_drainTimer.isActive())
+        m_drainTimer.start();
+}
+
+void ConditionEvaluator::rebuild()
+{
+    // Watches follow their rows, so a moved running row keeps its hold progress
+    m_watches.removeIf([](const Watch &watch) { return !watch.index.isValid(); });
+    const ProtoTableModel *model = m_manager->model();
+    for (int row = 0; row < model->rowCount(); ++row)
+        updateWatch(row, model->regimeAt(row));
+    scheduleDeadline();
+}
+
+void ConditionEvaluator::updateRows(int first, int last)
+{
+    const ProtoTableModel *model = m_manager->model();
+    if (first < 0 || last >= model->rowCount()) {
+        rebuild();
+        return;
+    }
+    for (int row = first; row <= last; ++row)
+        updateWatch(row, model->regimeAt(row));
+    scheduleDeadline();
+}
+
+void ConditionEvaluator::updateWatch(int row, const Regime &regime)
+{
+    const bool waiting = regime.m_state == RegimeEnums::State::Running && !regime.m_conditionCompleted;
+    const bool temperature = regime.m_condition.type == "temp";
+    const bool timed = regime.m_condition.type == "time" && regime.conditionTimeInSeconds() > 0;
+    const auto it = findWatch(row);
+    if (!waiting || (!temperature && !timed)) {
+        if (it != m_watches.end())
+            m_watches.erase(it);
+        return;
+    }
+
+    const float target = float(regime.m_condition.temp);
+    if (it != m_watches.end() && it->repeat == regime.m_currentRepeat
+        && it->temperature == temperature && it->target == target) {
+        it->limitSeconds = regime.conditionTimeInSeconds();
+        return;
+    }
+
+    // A new repeat, or a changed condition, starts over
+    Watch watch;
+    watch.index = QPersistentModelIndex(m_manager->model()->index(row, 0));
+    watch.repeat = regime.m_currentRepeat;
+    watch.temperature = temperature;
+    watch.target = target;
+    watch.limitSeconds = regime.conditionTimeInSeconds();
+    if (it != m_watches.end())
+        *it = watch;
+    else
+        m_watches.append(watch);
+}
+
+QList<ConditionEvaluator::Watch>::iterator ConditionEvaluator::findWatch(int row)
+{
+    return std::find_if(m_watches.begin(), m_watches.end(),
+                        [row](const Watch &watch) { return watch.index.row() == row; });
+}
+
+void ConditionEvaluator::evaluate(Watch &watch, const SampleBlock &block) const
+{
+    const float *values = block.values;
+    const qsizetype count = block.count;
+    if (count <= 0)
+        return;
+
+    if (!watch.directionKnown) {
+        watch.rising = values[0] < watch.target;
+        watch.directionKnown = true;
+    }
+
+    const float enter = watch.target;
+    const float leave = watch.rising ? watch.target - float(m_hysteresis) : watch.target + float(m_hysteresis);
+    const bool rising = watch.rising;
+    const qint64 holdUs = qint64(m_holdTime) * 1000;
+
+    qsizetype position = 0;
+    while (position < count) {
+        if (!watch.inside) {
+            position = rising ? firstMatch(values, position, count, [enter](float v) { return v >= enter; })
+                              : firstMatch(values, position, count, [enter](float v) { return v <= enter; });
+            if (position == count)
+                return;
+            watch.inside = true;
+            watch.insideSinceUs = block.timestampUs + position * block.intervalUs;
+        }
+
+        const qsizetype leftAt = rising ? firstMatch(values, position, count, [leave](float v) { return v < leave; })
+                                        : firstMatch(values, position, count, [leave](float v) { return v > leave; });
+
+        // First sample at or after the end of the hold time
+        const qint64 heldUntilUs = watch.insideSinceUs + holdUs;
+        const qsizetype heldAt = heldUntilUs <= block.timestampUs
+            ? 0 : qsizetype((heldUntilUs - block.timestampUs + block.intervalUs - 1) / block.intervalUs);
+        if (heldAt < leftAt) {
+            watch.met = true;
+            return;
+        }
+        if (leftAt == count)
+            return;
+
+        watch.inside = false;
+        position = leftAt;
+    }
+}
+
+void ConditionEvaluator::scheduleDeadline()
+{
+    qint64 nextMs = std::numeric_limits<qint64>::max();
+    if (m_enabled) {
+        const PhaseClock *clock = m_manager->phaseClock();
+        for (const Watch &watch : std::as_const(m_watches)) {
+            if (watch.temperature)
+                continue;
+            const double left = watch.limitSeconds - clock->conditionElapsed(watch.index.row());
+            nextMs = qMin(nextMs, qMax<qint64>(0, qCeil(left * 1000.0)));
+        }
+    }
+
+    if (nextMs == std::numeric_limits<qint64>::max())
+        m_deadlineTimer.stop();
+    else
+        m_deadlineTimer.start(int(qMin<qint64>(nextMs, std::numeric_limits<int>::max())));
+}
+
+int ConditionEvaluator::confirmMet()
+{
+    if (!m_enabled)
+        return 0;
+
+    const PhaseClock *clock = m_manager->phaseClock();
+    QList<std::pair<int, int>> met;
+    for (const Watch &watch : std::as_const(m_watches)) {
+        const int row = watch.index.row();
+        if (watch.temperature ? watch.met : clock->conditionElapsed(row) >= watch.limitSeconds)
+            met.append({row, watch.repeat});
+    }
+
+    // Confirming changes the model, which updates m_watches
+    int confirmed = 0;
+    for (const auto &[row, repeat] : std::as_const(met)) {
+        if (m_manager->confirmConditionCompletion(row, repeat)) {
+            ++confirmed;
+            emit conditionConfirmed(row, repeat);
+        } else if (const auto it = findWatch(row); it != m_watches.end()) {
+            m_watches.erase(it);
+        }
+    }
+    return confirmed;
+}
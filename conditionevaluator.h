@@ -0,0 +1,117 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QPersistentModelIndex>
+#include <QTimer>
+#include <atomic>
+#include "mpscringbuffer.h"
+
+class RegimeManager;
+class Regime;
+
+/**
+ * @brief Completes "temp" and "time" conditions without the driver calling confirmConditionCompletion()
+ *
+ * Acquisition threads post sensor samples in fixed-size blocks into a lock-free ring
+ * buffer; the GUI thread drains it once per frame. Every running row waiting for a "temp"
+ * condition watches the temperature channel: the condition holds once the temperature
+ * reaches the target from the side it started on, stops holding only when it falls back
+ * by more than the hysteresis, and is confirmed after holding for the hold time measured
+ * in sample time. Each block is searched for the next crossing with branch-free
+ * fixed-width scans the compiler vectorizes, so a drain costs a few passes over the new
+ * samples per watching row. "time" conditions are confirmed once the phase clock reaches
+ * the planned condition time. Temperature samples are also handed to the sensor trace store.
+ *
+ * Disabled by default: a driver that confirms conditions itself would otherwise find
+ * "time" conditions already completed. Drivers that post samples opt in with setEnabled().
+ */
+class ConditionEvaluator : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY settingsChanged)
+    Q_PROPERTY(int temperatureChannel READ temperatureChannel WRITE setTemperatureChannel NOTIFY settingsChanged)
+    Q_PROPERTY(double hysteresis READ hysteresis WRITE setHysteresis NOTIFY settingsChanged)
+    Q_PROPERTY(int holdTime READ holdTime WRITE setHoldTime NOTIFY settingsChanged)
+
+public:
+    static constexpr int SamplesPerBlock = 256;
+
+    struct SampleBlock {
+        qint32 channel = 0;
+        qint32 count = 0;
+        qint64 timestampUs = 0;     // Monotonic time of values[0]
+        qint32 intervalUs = 0;      // Sample period
+        float values[SamplesPerBlock] = {};
+    };
+
+    explicit ConditionEvaluator(RegimeManager *manager, int capacity = 1024, QObject *parent = nullptr);
+
+    /**
+     * @brief Queues count evenly spaced samples of one channel; may be called from any thread
+     *
+     * Never blocks. Returns false if the queue was full and some of the samples were dropped.
+     */
+    bool postSamples(int channel, const float *values, qsizetype count, qint64 timestampUs, int intervalUs);
+
+    /// Evaluates everything queued so far; GUI thread only. Returns the number of conditions confirmed
+    int drain();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+    /// Channel carrying the temperature "temp" conditions compare against
+    int temperatureChannel() const;
+    void setTemperatureChannel(int channel);
+    /// Degrees the temperature may fall back past the target without restarting the hold time
+    double hysteresis() const;
+    void setHysteresis(double degrees);
+    /// Milliseconds the temperature must stay at the target before the condition is confirmed
+    int holdTime() const;
+    void setHoldTime(int milliseconds);
+
+    /// Samples evaluated so far
+    quint64 processedCount() const;
+    /// Samples dropped because the queue was full
+    quint64 droppedCount() const;
+
+signals:
+    void settingsChanged();
+    void conditionConfirmed(int row, int repeat);
+
+private:
+    // One running row waiting for its condition, followed through inserts, removals and moves
+    struct Watch {
+        QPersistentModelIndex index;
+        int repeat = 0;
+        bool temperature = false;   // "temp"; otherwise "time"
+        float target = 0;
+        int limitSeconds = 0;       // Planned condition time
+        bool directionKnown = false;
+        bool rising = true;         // Temperature started below the target
+        bool inside = false;        // At the target, hysteresis included
+        qint64 insideSinceUs = 0;
+        bool met = false;
+    };
+
+    void scheduleDrain();
+    void rebuild();
+    void updateRows(int first, int last);
+    void updateWatch(int row, const Regime &regime);
+    QList<Watch>::iterator findWatch(int row);
+    void evaluate(Watch &watch, const SampleBlock &block) const;
+    void scheduleDeadline();
+    int confirmMet();
+
+    RegimeManager *m_manager = nullptr;
+    MpscRingBuffer<SampleBlock> m_queue;
+    QTimer m_drainTimer;
+    QTimer m_deadlineTimer;
+    std::atomic<bool> m_wakePending{false};
+    std::atomic<quint64> m_dropped{0};
+    quint64 m_processed = 0;
+    QList<Watch> m_watches;
+    bool m_enabled = false;
+    int m_temperatureChannel = 0;
+    double m_hysteresis = 0.5;
+    int m_holdTime = 1000;
+};
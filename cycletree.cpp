@@ -0,0 +1,195 @@
+#include "cycletree.h"
+
+void CycleTree::rebuild(const QList<Regime> &regimes)
+{
+    m_nodes.clear();
+    m_nodeById.clear();
+    m_rows.clear();
+    m_rootItems.clear();
+    m_rows.reserve(regimes.count());
+
+    for (int row = 0; row < regimes.count(); ++row) {
+        const Regime &regime = regimes.at(row);
+        RowInfo info;
+        info.repeatCount = regime.m_repeatCount;
+        info.repeatTime = qint64(regime.conditionTimeInSeconds()) + regime.m_maxTime;
+        info.path = pathOf(regime);
+
+        // Descend along the path, creating cycles where they first appear
+        int parent = -1;
+        for (const CycleLevel &level : info.path) {
+            auto it = m_nodeById.constFind(level.id);
+            int node;
+            if (it == m_nodeById.cend()) {
+                node = int(m_nodes.count());
+                Node created;
+                created.id = level.id;
+                created.parent = parent;
+                created.repeat = level.repeat;
+                m_nodes.append(created);
+                m_nodeById.insert(level.id, node);
+                (parent == -1 ? m_rootItems : m_nodes[parent].items).append(~node);
+            } else {
+                node = it.value();
+            }
+            parent = node;
+        }
+        info.node = parent;
+        info.elapsed = regime.m_timePassedInSeconds;
+        info.left = timeLeftOf(regime);
+        addProgress(parent, info.elapsed, info.left);
+        (parent == -1 ? m_rootItems : m_nodes[parent].items).append(row);
+        m_rows.append(info);
+    }
+    m_startsDirty = true;
+
+    m_total = 0;
+    for (Item item : m_rootItems) {
+        if (item < 0)
+            computePass(~item);
+        m_total += itemDuration(item);
+    }
+}
+
+bool CycleTree::updateRow(int row, const Regime &regime)
+{
+    if (row < 0 || row >= m_rows.count())
+        return false;
+    RowInfo &info = m_rows[row];
+    if (info.path != pathOf(regime))
+        return false;
+    updateProgress(row, regime);
+
+    const qint64 before = info.repeatTime * info.repeatCount;
+    info.repeatCount = regime.m_repeatCount;
+    info.repeatTime = qint64(regime.conditionTimeInSeconds()) + regime.m_maxTime;
+
+    // Each enclosing pass repeats the change, so it scales by the repeats on the way up
+    qint64 delta = info.repeatTime * info.repeatCount - before;
+    for (int node = info.node; node != -1; node = m_nodes.at(node).parent) {
+        m_nodes[node].pass += delta;
+        delta *= m_nodes.at(node).repeat;
+    }
+    m_total += delta;
+    if (delta != 0)
+        m_startsDirty = true;
+    return true;
+}
+
+void CycleTree::updateProgress(int row, const Regime &regime)
+{
+    if (row < 0 || row >= m_rows.count())
+        return;
+    RowInfo &info = m_rows[row];
+    const qint64 elapsed = regime.m_timePassedInSeconds;
+    const qint64 left = timeLeftOf(regime);
+    addProgress(info.node, elapsed - info.elapsed, left - info.left);
+    info.elapsed = elapsed;
+    info.left = left;
+}
+
+qint64 CycleTree::totalDuration() const
+{
+    return m_total;
+}
+
+qint64 CycleTree::cycleDuration(int cycleId) const
+{
+    const auto it = m_nodeById.constFind(cycleId);
+    if (it == m_nodeById.cend())
+        return 0;
+    const Node &node = m_nodes.at(it.value());
+    return node.pass * node.repeat;
+}
+
+qint64 CycleTree::rowDuration(int row) const
+{
+    if (row < 0 || row >= m_rows.count())
+        return 0;
+    const RowInfo &info = m_rows.at(row);
+    qint64 duration = info.repeatTime * info.repeatCount;
+    for (const CycleLevel &level : info.path)
+        duration *= level.repeat;
+    return duration;
+}
+
+qint64 CycleTree::cycleElapsed(int cycleId) const
+{
+    const auto it = m_nodeById.constFind(cycleId);
+    return it != m_nodeById.cend() ? m_nodes.at(it.value()).elapsed : 0;
+}
+
+qint64 CycleTree::cycleTimeLeft(int cycleId) const
+{
+    const auto it = m_nodeById.constFind(cycleId);
+    return it != m_nodeById.cend() ? m_nodes.at(it.value()).left : 0;
+}
+
+const QList<qint64> &CycleTree::firstStartOffsets() const
+{
+    if (m_startsDirty) {
+        m_starts.fill(0, m_rows.count());
+        assignStarts(m_rootItems, 0, m_starts);
+        m_startsDirty = false;
+    }
+    return m_starts;
+}
+
+int CycleTree::rowCount() const
+{
+    return int(m_rows.count());
+}
+
+QList<CycleLevel> CycleTree::pathOf(const Regime &regime)
+{
+    if (regime.m_cycleId == -1)
+        return {};
+    QList<CycleLevel> path = regime.m_outerCycles;
+    path.append({regime.m_cycleId, regime.m_cycleRepeat});
+    return path;
+}
+
+qint64 CycleTree::timeLeftOf(const Regime &regime)
+{
+    return qint64(regime.m_maxTime - regime.m_timePassedInSeconds) * (regime.m_repeatCount - regime.m_repeatsDone);
+}
+
+void CycleTree::addProgress(int node, qint64 elapsed, qint64 left)
+{
+    for (; node != -1; node = m_nodes.at(node).parent) {
+        m_nodes[node].elapsed += elapsed;
+        m_nodes[node].left += left;
+    }
+}
+
+qint64 CycleTree::itemDuration(Item item) const
+{
+    if (item >= 0)
+        return m_rows.at(item).repeatTime * m_rows.at(item).repeatCount;
+    const Node &node = m_nodes.at(~item);
+    return node.pass * node.repeat;
+}
+
+qint64 CycleTree::computePass(int node)
+{
+    qint64 pass = 0;
+    for (Item item : m_nodes.at(node).items) {
+        if (item < 0)
+            computePass(~item);
+        pass += itemDuration(item);
+    }
+    m_nodes[node].pass = pass;
+    return pass;
+}
+
+void CycleTree::assignStarts(const QList<Item> &items, qint64 start, QList<qint64> &starts) const
+{
+    // Only the first pass of a cycle is walked; later passes repeat the same rows
+    for (Item item : items) {
+        if (item >= 0)
+            starts[item] = start;
+        else
+            assignStarts(m_nodes.at(~item).items, start, starts);
+        start += itemDuration(item);
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include "regime.h"
+
+/**
+ * @brief Hierarchy of (nested) cycles over the program rows, with cached durations
+ *
+ * Built from the cycle path of every row (Regime::m_outerCycles plus m_cycleId). Rows of a
+ * cycle are gathered where the cycle first appears, the same way VisibleRegimeModel
+ * expands cycles. Every node caches the duration of one pass over its children, so the
+ * total and per-cycle durations are O(1) reads, and a change of one row's own duration
+ * (condition, max time, repeats) is applied along its ancestors in O(depth). Changes to the
+ * cycle structure or to a cycle's repeat count need rebuild().
+ *
+ * Nodes also keep the elapsed and remaining seconds summed over every row below them, so
+ * the progress of a cycle is a lookup as well; updateProgress() applies a row's execution
+ * progress in O(depth). Start offsets are computed on first use after a duration change.
+ */
+class CycleTree
+{
+public:
+    void rebuild(const QList<Regime> &regimes);
+
+    /**
+     * @brief Applies a change of the row's own duration in O(depth)
+     * @return false if the row's cycle path or a cycle repeat changed; rebuild() is needed then
+     */
+    bool updateRow(int row, const Regime &regime);
+    /// Applies a change of the row's execution progress to the sums of its cycles in O(depth)
+    void updateProgress(int row, const Regime &regime);
+
+    /// Planned duration of the whole program in seconds
+    qint64 totalDuration() const;
+    /// All passes of a cycle within one pass of its enclosing cycle; 0 for unknown ids
+    qint64 cycleDuration(int cycleId) const;
+    /// Planned seconds spent in a row over all its repeats and enclosing cycle passes
+    qint64 rowDuration(int row) const;
+    /// Seconds passed in every row of a cycle, nested cycles included; 0 for unknown ids
+    qint64 cycleElapsed(int cycleId) const;
+    /// Execution seconds left in every row of a cycle: (max time - passed) * repeats not done
+    qint64 cycleTimeLeft(int cycleId) const;
+    /// Where each row first starts in the planned timeline
+    const QList<qint64> &firstStartOffsets() const;
+
+    int rowCount() const;
+
+    /**
+     * @brief Visits every planned repeat in timeline order
+     *
+     * visit(row, repeatIndex, cyclePass) is called once per repeat; cyclePass is the pass
+     * of the row's innermost cycle (0 outside cycles).
+     */
+    template <typename Visitor>
+    void forEachRepeat(Visitor &&visit) const
+    {
+        walk(m_rootItems, 0, visit);
+    }
+
+private:
+    // A child of the root or of a cycle: a row (>= 0) or a cycle node (~nodeIndex)
+    using Item = int;
+
+    struct Node {
+        int id = -1;
+        int parent = -1;
+        int repeat = 1;
+        qint64 pass = 0;    // One pass over the items
+        qint64 elapsed = 0; // Sums over every row below, not scaled by passes
+        qint64 left = 0;
+        QList<Item> items;
+    };
+
+    struct RowInfo {
+        int node = -1;
+        int repeatCount = 1;
+        qint64 repeatTime = 0;
+        qint64 elapsed = 0;
+        qint64 left = 0;
+        QList<CycleLevel> path;     // Outermost first, innermost last
+    };
+
+    static QList<CycleLevel> pathOf(const Regime &regime);
+    static qint64 timeLeftOf(const Regime &regime);
+    void addProgress(int node, qint64 elapsed, qint64 left);
+    qint64 itemDuration(Item item) const;
+    qint64 computePass(int node);
+    void assignStarts(const QList<Item> &items, qint64 start, QList<qint64> &starts) const;
+
+    template <typename Visitor>
+    void walk(const QList<Item> &items, int pass, Visitor &visit) const
+    {
+        for (Item item : items) {
+            if (item >= 0) {
+                for (int repeat = 0; repeat < m_rows.at(item).repeatCount; ++repeat)
+                    visit(item, repeat, pass);
+                continue;
+            }
+            const Node &node = m_nodes.at(~item);
+            for (int nodePass = 0; nodePass < node.repeat; ++nodePass)
+                walk(node.items, nodePass, visit);
+        }
+    }
+
+    QList<Node> m_nodes;
+    QHash<int, int> m_nodeById;
+    QList<RowInfo> m_rows;
+    QList<Item> m_rootItems;
+    qint64 m_total = 0;
+    mutable QList<qint64> m_starts;
+    mutable bool m_startsDirty = true;
+};
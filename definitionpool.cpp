@@ -0,0 +1,73 @@
+#include "definitionpool.h"
+
+void DefinitionPool::intern(Regime &regime)
+{
+    regime.m_name = intern(regime.m_name);
+    regime.m_condition.type = intern(regime.m_condition.type);
+}
+
+QString DefinitionPool::intern(const QString &text)
+{
+    if (text.isEmpty())
+        return QString();
+
+    const auto it = m_strings.constFind(text);
+    if (it != m_strings.cend())
+        return *it;
+    if (m_strings.count() >= m_pruneAt)
+        prune();
+    m_strings.insert(text);
+    return text;
+}
+
+void DefinitionPool::intern(QList<Regime> &regimes)
+{
+    for (Regime &regime : regimes)
+        intern(regime);
+}
+
+void DefinitionPool::clear()
+{
+    m_strings.clear();
+    m_pruneAt = MinPruneSize;
+}
+
+void DefinitionPool::prune()
+{
+    for (auto it = m_strings.begin(); it != m_strings.end();) {
+        if (it->isDetached())
+            it = m_strings.erase(it);
+        else
+            ++it;
+    }
+    m_pruneAt = qMax(qsizetype(MinPruneSize), 2 * m_strings.count());
+}
+
+int DefinitionPool::size() const
+{
+    return int(m_strings.count());
+}
+
+qint64 DefinitionPool::bytesUsed(const QList<Regime> &regimes)
+{
+    QSet<const void *> counted;
+    auto buffer = [&counted](const void *data, qsizetype payloadBytes) -> qint64 {
+        if (!data || payloadBytes <= 0 || counted.contains(data))
+            return 0;
+        counted.insert(data);
+        return qint64(sizeof(QArrayData)) + payloadBytes;
+    };
+
+    // Strings also keep room for their terminating null; null strings own no buffer
+    auto stringBytes = [](const QString &text) -> qsizetype {
+        return text.capacity() > 0 ? (text.capacity() + 1) * qsizetype(sizeof(QChar)) : 0;
+    };
+
+    qint64 bytes = qint64(regimes.capacity()) * qint64(sizeof(Regime));
+    for (const Regime &regime : regimes) {
+        bytes += buffer(regime.m_name.constData(), stringBytes(regime.m_name));
+        bytes += buffer(regime.m_condition.type.constData(), stringBytes(regime.m_condition.type));
+        bytes += buffer(regime.m_outerCycles.constData(), regime.m_outerCycles.capacity() * qsizetype(sizeof(CycleLevel)));
+    }
+    return bytes;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QList>
+#include <QSet>
+#include <QString>
+#include "regime.h"
+
+/**
+ * @brief Shares the text of regime definitions between rows
+ *
+ * Programs repeat a handful of definitions thousands of times, but rows loaded from a file
+ * or the journal each get their own copy of the name and condition type. Interning points
+ * every equal string at one implicitly shared buffer; editing a row detaches only that row
+ * (QString copy-on-write), so rows stay plain values for the rest of the code.
+ *
+ * Strings no row refers to any more are dropped when the pool has doubled since it was
+ * last pruned, so edits and deletes cannot grow it without bound. Pruning scans the pool
+ * once per doubling, which keeps interning amortized O(1).
+ *
+ * Not thread-safe; the model interns on its own thread.
+ */
+class DefinitionPool
+{
+public:
+    /// The pool is not pruned below this many strings
+    static constexpr int MinPruneSize = 64;
+
+    /// Makes the name and condition type of regime share storage with equal strings seen before
+    void intern(Regime &regime);
+    QString intern(const QString &text);
+    void intern(QList<Regime> &regimes);
+    void clear();
+    /// Drops the strings that only the pool still holds
+    void prune();
+    /// Distinct strings held by the pool
+    int size() const;
+
+    /**
+     * @brief Memory held by regimes: the row structs plus every distinct heap buffer they reference
+     *
+     * Buffers shared between rows (interned strings, implicitly shared lists) are counted once.
+     */
+    static qint64 bytesUsed(const QList<Regime> &regimes);
+
+private:
+    QSet<QString> m_strings;
+    qsizetype m_pruneAt = MinPruneSize;
+};
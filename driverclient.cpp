@@ -0,0 +1,185 @@
+#include "driverclient.h"
+#include <QCborValue>
+#include <QDebug>
+#include <limits>
+
+using namespace DriverProtocol;
+
+DriverClient::DriverClient(QObject *parent)
+    : QObject{parent}
+{
+    connect(&m_socket, &QLocalSocket::connected, this, &DriverClient::connected);
+    connect(&m_socket, &QLocalSocket::disconnected, this, &DriverClient::disconnected);
+    connect(&m_socket, &QLocalSocket::readyRead, this, &DriverClient::readReplies);
+}
+
+void DriverClient::connectToServer(const QString &serverName)
+{
+    m_buffer.clear();
+    m_socket.connectToServer(serverName);
+}
+
+void DriverClient::disconnectFromServer()
+{
+    m_socket.disconnectFromServer();
+}
+
+bool DriverClient::waitForConnected(int msecs)
+{
+    return m_socket.waitForConnected(msecs);
+}
+
+bool DriverClient::isConnected() const
+{
+    return m_socket.state() == QLocalSocket::ConnectedState;
+}
+
+quint32 DriverClient::startExecution(int regimeId)
+{
+    return sendInts(Opcode::StartExecution, {regimeId});
+}
+
+quint32 DriverClient::conditionProgress(int regimeId, int conditionTimeElapsed, int currentRepeat, bool wantReply)
+{
+    return sendInts(Opcode::ConditionProgress, {regimeId, conditionTimeElapsed, currentRepeat}, wantReply);
+}
+
+quint32 DriverClient::regimeProgress(int regimeId, int regimeTimeElapsed, int currentRepeat, bool wantReply)
+{
+    return sendInts(Opcode::RegimeProgress, {regimeId, regimeTimeElapsed, currentRepeat}, wantReply);
+}
+
+quint32 DriverClient::confirmCondition(int regimeId, int currentRepeat)
+{
+    return sendInts(Opcode::ConfirmCondition, {regimeId, currentRepeat});
+}
+
+quint32 DriverClient::completeRepeat(int regimeId, int currentRepeat)
+{
+    return sendInts(Opcode::CompleteRepeat, {regimeId, currentRepeat});
+}
+
+quint32 DriverClient::skipRepeat(int regimeId, int currentRepeat)
+{
+    return sendInts(Opcode::SkipRepeat, {regimeId, currentRepeat});
+}
+
+quint32 DriverClient::markRepeatAsError(int regimeId, int currentRepeat)
+{
+    return sendInts(Opcode::ErrorRepeat, {regimeId, currentRepeat});
+}
+
+quint32 DriverClient::completeRegime(int regimeId)
+{
+    return sendInts(Opcode::CompleteRegime, {regimeId});
+}
+
+quint32 DriverClient::requestExecutionInfo(int regimeId)
+{
+    return sendInts(Opcode::ExecutionInfo, {regimeId});
+}
+
+void DriverClient::queueConditionProgress(int regimeId, int conditionTimeElapsed, int currentRepeat)
+{
+    queueRecord(BatchKind::Condition, regimeId, conditionTimeElapsed, currentRepeat);
+}
+
+void DriverClient::queueRegimeProgress(int regimeId, int regimeTimeElapsed, int currentRepeat)
+{
+    queueRecord(BatchKind::Regime, regimeId, regimeTimeElapsed, currentRepeat);
+}
+
+quint32 DriverClient::flushProgress(bool wantReply)
+{
+    if (m_pendingCount == 0)
+        return 0;
+
+    QByteArray payload;
+    payload.reserve(qsizetype(sizeof(quint16)) + m_pendingBatch.size());
+    appendLittleEndian<quint16>(payload, m_pendingCount);
+    payload.append(m_pendingBatch);
+    m_pendingBatch.clear();
+    m_pendingCount = 0;
+    return send(Opcode::ProgressBatch, payload, wantReply);
+}
+
+bool DriverClient::waitForBytesWritten(int msecs)
+{
+    return m_socket.bytesToWrite() == 0 || m_socket.waitForBytesWritten(msecs);
+}
+
+quint32 DriverClient::send(Opcode opcode, const QByteArray &payload, bool wantReply)
+{
+    quint32 requestId = 0;
+    if (wantReply) {
+        requestId = m_nextRequestId++;
+        if (m_nextRequestId == 0)
+            m_nextRequestId = 1; // 0 is reserved for "no reply"
+    }
+
+    QByteArray frame;
+    appendFrame(frame, quint8(opcode), requestId, payload);
+    if (m_socket.write(frame) != frame.size()) {
+        qWarning() << "DriverClient: Couldn't write frame" << m_socket.errorString();
+        return 0;
+    }
+    return requestId;
+}
+
+quint32 DriverClient::sendInts(Opcode opcode, std::initializer_list<qint32> values, bool wantReply)
+{
+    QByteArray payload;
+    payload.reserve(qsizetype(values.size() * sizeof(qint32)));
+    for (qint32 value : values)
+        appendLittleEndian<qint32>(payload, value);
+    return send(opcode, payload, wantReply);
+}
+
+void DriverClient::queueRecord(BatchKind kind, int regimeId, int elapsed, int currentRepeat)
+{
+    if (m_pendingCount == std::numeric_limits<quint16>::max())
+        flushProgress();
+
+    appendLittleEndian<quint8>(m_pendingBatch, quint8(kind));
+    appendLittleEndian<qint32>(m_pendingBatch, regimeId);
+    appendLittleEndian<qint32>(m_pendingBatch, elapsed);
+    appendLittleEndian<qint32>(m_pendingBatch, currentRepeat);
+    ++m_pendingCount;
+}
+
+void DriverClient::readReplies()
+{
+    m_buffer.append(m_socket.readAll());
+
+    qsizetype offset = 0;
+    while (m_buffer.size() - offset >= HeaderSize) {
+        const char *header = m_buffer.constData() + offset;
+        const quint32 payloadSize = readLittleEndian<quint32>(header);
+        if (payloadSize > MaxPayloadSize) {
+            qWarning() << "DriverClient: Oversized reply, disconnecting";
+            m_socket.abort();
+            return;
+        }
+        if (m_buffer.size() - offset < HeaderSize + qsizetype(payloadSize))
+            break;
+
+        const quint8 opcode = readLittleEndian<quint8>(header + 4) & ~quint8(Opcode::Reply);
+        const quint32 requestId = readLittleEndian<quint32>(header + 5);
+        const char *payload = header + HeaderSize;
+
+        quint8 status = quint8(Status::Malformed);
+        QVariantMap info;
+        if (payloadSize >= 1) {
+            status = readLittleEndian<quint8>(payload);
+            if (opcode == quint8(Opcode::ExecutionInfo) && payloadSize > 1) {
+                info = QCborValue::fromCbor(QByteArray::fromRawData(payload + 1, payloadSize - 1)).toVariant().toMap();
+            } else if (opcode == quint8(Opcode::ProgressBatch) && payloadSize >= 5) {
+                info.insert("applied", readLittleEndian<quint16>(payload + 1));
+                info.insert("rejected", readLittleEndian<quint16>(payload + 3));
+            }
+        }
+        emit replyReceived(requestId, opcode, status, info);
+        offset += HeaderSize + payloadSize;
+    }
+    m_buffer.remove(0, offset);
+}
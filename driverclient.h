@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QLocalSocket>
+#include <QObject>
+#include <QVariantMap>
+#include "driverprotocol.h"
+
+/**
+ * @brief Reference client for DriverServer, for use by instrument driver processes
+ *
+ * Every call is written immediately and returns the requestId of the frame; replies arrive
+ * asynchronously through replyReceived(), so callers can pipeline as many requests as they
+ * like. Progress can instead be queued locally and sent as a single ProgressBatch frame by
+ * flushProgress(), which is the cheap path for high-rate updates.
+ */
+class DriverClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DriverClient(QObject *parent = nullptr);
+
+    void connectToServer(const QString &serverName);
+    void disconnectFromServer();
+    bool waitForConnected(int msecs = 3000);
+    bool isConnected() const;
+
+    quint32 startExecution(int regimeId);
+    quint32 conditionProgress(int regimeId, int conditionTimeElapsed, int currentRepeat, bool wantReply = false);
+    quint32 regimeProgress(int regimeId, int regimeTimeElapsed, int currentRepeat, bool wantReply = false);
+    quint32 confirmCondition(int regimeId, int currentRepeat);
+    quint32 completeRepeat(int regimeId, int currentRepeat);
+    quint32 skipRepeat(int regimeId, int currentRepeat);
+    quint32 markRepeatAsError(int regimeId, int currentRepeat);
+    quint32 completeRegime(int regimeId);
+    quint32 requestExecutionInfo(int regimeId);
+
+    void queueConditionProgress(int regimeId, int conditionTimeElapsed, int currentRepeat);
+    void queueRegimeProgress(int regimeId, int regimeTimeElapsed, int currentRepeat);
+    /// Sends queued progress as one frame; returns its requestId (0 when nothing was queued or no reply wanted)
+    quint32 flushProgress(bool wantReply = false);
+
+    /// Blocks until the socket has written everything; useful for short-lived command-line drivers
+    bool waitForBytesWritten(int msecs = 3000);
+
+signals:
+    void connected();
+    void disconnected();
+    /// info holds the execution info map for ExecutionInfo replies and {applied, rejected} for batches
+    void replyReceived(quint32 requestId, quint8 opcode, quint8 status, const QVariantMap &info);
+
+private:
+    quint32 send(DriverProtocol::Opcode opcode, const QByteArray &payload, bool wantReply);
+    quint32 sendInts(DriverProtocol::Opcode opcode, std::initializer_list<qint32> values, bool wantReply = true);
+    void queueRecord(DriverProtocol::BatchKind kind, int regimeId, int elapsed, int currentRepeat);
+    void readReplies();
+
+    QLocalSocket m_socket;
+    QByteArray m_buffer;
+    QByteArray m_pendingBatch;
+    quint16 m_pendingCount = 0;
+    quint32 m_nextRequestId = 1;
+};
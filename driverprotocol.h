@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QByteArray>
+#include <QtEndian>
+
+/**
+ * Binary protocol spoken between out-of-process instrument drivers and DriverServer.
+ *
+ * Every frame is a 9-byte header followed by the payload, all integers little-endian:
+ *
+ *     u32 payloadSize | u8 opcode | u32 requestId | payload
+ *
+ * Requests may be pipelined: the server handles frames strictly in arrival order and
+ * answers each one with a reply frame (opcode | Reply) carrying the same requestId and a
+ * status byte. A requestId of 0 asks for no reply, which is how high-rate progress is
+ * usually sent.
+ */
+namespace DriverProtocol {
+
+constexpr int HeaderSize = 9;
+constexpr quint32 MaxPayloadSize = 1u << 20;
+// u8 kind, i32 regimeId, i32 elapsed, i32 repeat
+constexpr int BatchRecordSize = 13;
+
+enum class Opcode : quint8 {
+    StartExecution = 0x01,      // i32 regimeId
+    ConditionProgress = 0x02,   // i32 regimeId, i32 elapsed, i32 repeat
+    ConfirmCondition = 0x03,    // i32 regimeId, i32 repeat
+    RegimeProgress = 0x04,      // i32 regimeId, i32 elapsed, i32 repeat
+    CompleteRepeat = 0x05,      // i32 regimeId, i32 repeat
+    SkipRepeat = 0x06,          // i32 regimeId, i32 repeat
+    ErrorRepeat = 0x07,         // i32 regimeId, i32 repeat
+    CompleteRegime = 0x08,      // i32 regimeId
+    ExecutionInfo = 0x09,       // i32 regimeId; reply carries a CBOR map
+    ProgressBatch = 0x0A,       // u16 count, count * BatchRecordSize bytes; reply: u16 applied, u16 rejected
+    Reply = 0x80                // Or-ed into the opcode of every reply frame
+};
+
+enum class Status : quint8 {
+    Ok = 0,
+    Rejected = 1,       // The RegimeManager API refused the call (wrong repeat, not running, ...)
+    Malformed = 2,      // Payload size does not match the opcode
+    UnknownOpcode = 3
+};
+
+// Record kinds inside a ProgressBatch payload
+enum class BatchKind : quint8 {
+    Condition = 1,
+    Regime = 2
+};
+
+template <typename T>
+inline void appendLittleEndian(QByteArray &buffer, T value)
+{
+    const qsizetype offset = buffer.size();
+    buffer.resize(offset + qsizetype(sizeof(T)));
+    qToLittleEndian<T>(value, buffer.data() + offset);
+}
+
+template <typename T>
+inline T readLittleEndian(const char *data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+inline void appendFrame(QByteArray &out, quint8 opcode, quint32 requestId, const QByteArray &payload)
+{
+    out.reserve(out.size() + HeaderSize + payload.size());
+    appendLittleEndian<quint32>(out, quint32(payload.size()));
+    appendLittleEndian<quint8>(out, opcode);
+    appendLittleEndian<quint32>(out, requestId);
+    out.append(payload);
+}
+
+} // namespace DriverProtocol
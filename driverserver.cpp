@@ -0,0 +1,243 @@
+#include "driverserver.h"
+#include "localserver.h"
+#include "regimemanager.h"
+#include <QCborValue>
+#include <QDebug>
+#include <QLocalSocket>
+#include <algorithm>
+
+using namespace DriverProtocol;
+
+namespace {
+
+bool readInts(const char *payload, quint32 size, std::initializer_list<qint32 *> values)
+{
+    if (size != quint32(values.size() * sizeof(qint32)))
+        return false;
+    for (qint32 *value : values) {
+        *value = readLittleEndian<qint32>(payload);
+        payload += sizeof(qint32);
+    }
+    return true;
+}
+
+Status toStatus(bool ok)
+{
+    return ok ? Status::Ok : Status::Rejected;
+}
+
+} // namespace
+
+DriverServer::DriverServer(RegimeManager *manager, QObject *parent)
+    : QObject{parent}
+    , m_manager(manager)
+{
+    connect(&m_server, &QLocalServer::newConnection, this, &DriverServer::acceptConnections);
+}
+
+DriverServer::~DriverServer()
+{
+    close();
+}
+
+bool DriverServer::listen(const QString &serverName)
+{
+    close();
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!LocalServer::listen(m_server, serverName)) {
+        qWarning() << "DriverServer: Couldn't listen on" << serverName << m_server.errorString();
+        return false;
+    }
+    emit listeningChanged();
+    return true;
+}
+
+void DriverServer::close()
+{
+    const bool wasListening = m_server.isListening();
+    m_server.close();
+
+    const QList<QLocalSocket*> sockets = m_buffers.keys();
+    m_buffers.clear();
+    for (QLocalSocket *socket : sockets) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+
+    if (!sockets.isEmpty())
+        emit clientCountChanged();
+    if (wasListening)
+        emit listeningChanged();
+}
+
+bool DriverServer::isListening() const
+{
+    return m_server.isListening();
+}
+
+QString DriverServer::serverName() const
+{
+    return m_server.serverName();
+}
+
+int DriverServer::clientCount() const
+{
+    return m_buffers.count();
+}
+
+void DriverServer::acceptConnections()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readFrames(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+            emit clientCountChanged();
+        });
+        emit clientCountChanged();
+    }
+}
+
+void DriverServer::readFrames(QLocalSocket *socket)
+{
+    auto it = m_buffers.find(socket);
+    if (it == m_buffers.end())
+        return;
+
+    QByteArray &buffer = it.value();
+    buffer.append(socket->readAll());
+
+    QByteArray replies;
+    qsizetype offset = 0;
+    while (buffer.size() - offset >= HeaderSize) {
+        const char *header = buffer.constData() + offset;
+        const quint32 payloadSize = readLittleEndian<quint32>(header);
+        if (payloadSize > MaxPayloadSize) {
+            qWarning() << "DriverServer: Oversized frame, dropping client";
+            socket->abort();
+            return;
+        }
+        if (buffer.size() - offset < HeaderSize + qsizetype(payloadSize))
+            break; // Wait for the rest of the frame
+
+        const quint8 opcode = readLittleEndian<quint8>(header + 4);
+        const quint32 requestId = readLittleEndian<quint32>(header + 5);
+
+        QByteArray replyPayload;
+        const Status status = handleFrame(opcode, header + HeaderSize, payloadSize, replyPayload);
+        if (requestId != 0) {
+            replyPayload.prepend(char(status));
+            appendFrame(replies, opcode | quint8(Opcode::Reply), requestId, replyPayload);
+        }
+        offset += HeaderSize + payloadSize;
+    }
+    buffer.remove(0, offset);
+
+    if (!replies.isEmpty()) {
+        socket->write(replies);
+        socket->flush();
+    }
+}
+
+Status DriverServer::handleFrame(quint8 opcode, const char *payload, quint32 size, QByteArray &replyPayload)
+{
+    qint32 regimeId = 0;
+    qint32 elapsed = 0;
+    qint32 repeat = 0;
+
+    switch (Opcode(opcode)) {
+    case Opcode::StartExecution:
+        if (!readInts(payload, size, {&regimeId}))
+            return Status::Malformed;
+        return toStatus(m_manager->startRegimeExecution(regimeId));
+    case Opcode::ConditionProgress:
+        if (!readInts(payload, size, {&regimeId, &elapsed, &repeat}))
+            return Status::Malformed;
+        return toStatus(m_manager->updateConditionProgress(regimeId, elapsed, repeat));
+    case Opcode::ConfirmCondition:
+        if (!readInts(payload, size, {&regimeId, &repeat}))
+            return Status::Malformed;
+        return toStatus(m_manager->confirmConditionCompletion(regimeId, repeat));
+    case Opcode::RegimeProgress:
+        if (!readInts(payload, size, {&regimeId, &elapsed, &repeat}))
+            return Status::Malformed;
+        return toStatus(m_manager->updateRegimeProgress(regimeId, elapsed, repeat));
+    case Opcode::CompleteRepeat:
+        if (!readInts(payload, size, {&regimeId, &repeat}))
+            return Status::Malformed;
+        return toStatus(m_manager->completeCurrentRepeat(regimeId, repeat));
+    case Opcode::SkipRepeat:
+        if (!readInts(payload, size, {&regimeId, &repeat}))
+            return Status::Malformed;
+        return toStatus(m_manager->skipCurrentRepeat(regimeId, repeat));
+    case Opcode::ErrorRepeat:
+        if (!readInts(payload, size, {&regimeId, &repeat}))
+            return Status::Malformed;
+        return toStatus(m_manager->markRepeatAsError(regimeId, repeat));
+    case Opcode::CompleteRegime:
+        if (!readInts(payload, size, {&regimeId}))
+            return Status::Malformed;
+        return toStatus(m_manager->completeRegimeExecution(regimeId));
+    case Opcode::ExecutionInfo: {
+        if (!readInts(payload, size, {&regimeId}))
+            return Status::Malformed;
+        const QVariantMap info = m_manager->getRegimeExecutionInfo(regimeId);
+        if (info.isEmpty())
+            return Status::Rejected;
+        replyPayload = QCborValue::fromVariant(info).toCbor();
+        return Status::Ok;
+    }
+    case Opcode::ProgressBatch:
+        return handleBatch(payload, size, replyPayload);
+    case Opcode::Reply:
+        break;
+    }
+    return Status::UnknownOpcode;
+}
+
+Status DriverServer::handleBatch(const char *payload, quint32 size, QByteArray &replyPayload)
+{
+    if (size < sizeof(quint16))
+        return Status::Malformed;
+    const quint16 count = readLittleEndian<quint16>(payload);
+    if (size != sizeof(quint16) + quint32(count) * BatchRecordSize)
+        return Status::Malformed;
+
+    // Keep only the newest record per (kind, regime); apply survivors in arrival order
+    const char *records = payload + sizeof(quint16);
+    QHash<quint64, int> latest;
+    latest.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const char *record = records + i * BatchRecordSize;
+        const quint8 kind = readLittleEndian<quint8>(record);
+        const qint32 regimeId = readLittleEndian<qint32>(record + 1);
+        latest.insert((quint64(kind) << 32) | quint32(regimeId), i);
+    }
+
+    QList<int> order = latest.values();
+    std::sort(order.begin(), order.end());
+
+    quint16 applied = 0;
+    quint16 rejected = 0;
+    for (int i : order) {
+        const char *record = records + i * BatchRecordSize;
+        const auto kind = BatchKind(readLittleEndian<quint8>(record));
+        const qint32 regimeId = readLittleEndian<qint32>(record + 1);
+        const qint32 elapsed = readLittleEndian<qint32>(record + 5);
+        const qint32 repeat = readLittleEndian<qint32>(record + 9);
+
+        bool ok = false;
+        if (kind == BatchKind::Condition) {
+            ok = m_manager->updateConditionProgress(regimeId, elapsed, repeat);
+        } else if (kind == BatchKind::Regime) {
+            ok = m_manager->updateRegimeProgress(regimeId, elapsed, repeat);
+        }
+        ok ? ++applied : ++rejected;
+    }
+
+    appendLittleEndian<quint16>(replyPayload, applied);
+    appendLittleEndian<quint16>(replyPayload, rejected);
+    return Status::Ok;
+}
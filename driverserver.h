@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QHash>
+#include <QLocalServer>
+#include <QObject>
+#include "driverprotocol.h"
+
+class QLocalSocket;
+class RegimeManager;
+
+/**
+ * @brief Local socket endpoint that lets out-of-process drivers control a RegimeManager
+ *
+ * Exposes the external module API (start, progress, condition confirmation,
+ * complete/skip/error repeat, execution info) over the binary DriverProtocol.
+ * All complete frames received in one read are handled in order and their replies are
+ * written back in a single write, so pipelined clients see one round trip per batch.
+ * Progress inside a ProgressBatch frame is coalesced per regime and phase before it is
+ * applied.
+ */
+class DriverServer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool listening READ isListening NOTIFY listeningChanged)
+    Q_PROPERTY(int clientCount READ clientCount NOTIFY clientCountChanged)
+
+public:
+    explicit DriverServer(RegimeManager *manager, QObject *parent = nullptr);
+    ~DriverServer() override;
+
+    /// Starts listening on serverName, replacing a stale socket left by a crashed process; fails while another instance serves it
+    bool listen(const QString &serverName);
+    void close();
+
+    bool isListening() const;
+    QString serverName() const;
+    int clientCount() const;
+
+signals:
+    void listeningChanged();
+    void clientCountChanged();
+
+private:
+    void acceptConnections();
+    void readFrames(QLocalSocket *socket);
+    DriverProtocol::Status handleFrame(quint8 opcode, const char *payload, quint32 size, QByteArray &replyPayload);
+    DriverProtocol::Status handleBatch(const char *payload, quint32 size, QByteArray &replyPayload);
+
+    RegimeManager *m_manager = nullptr;
+    QLocalServer m_server;
+    QHash<QLocalSocket*, QByteArray> m_buffers;
+};
@@ -0,0 +1,273 @@
+#include "edithistory.h"
+#include <QDebug>
+#include <algorithm>
+
+Regime EditHistory::definitionOf(const Regime &regime)
+{
+    Regime definition;
+    copyDefinition(definition, regime);
+    return definition;
+}
+
+bool EditHistory::sameDefinition(const Regime &a, const Regime &b)
+{
+    return a.m_name == b.m_name
+        && a.m_condition == b.m_condition
+        && a.m_repeatCount == b.m_repeatCount
+        && a.m_maxTime == b.m_maxTime
+        && a.m_cycleId == b.m_cycleId
+        && a.m_cycleRepeat == b.m_cycleRepeat
+        && a.m_outerCycles == b.m_outerCycles;
+}
+
+void EditHistory::copyDefinition(Regime &target, const Regime &source)
+{
+    target.m_name = source.m_name;
+    target.m_condition = source.m_condition;
+    target.m_repeatCount = source.m_repeatCount;
+    target.m_maxTime = source.m_maxTime;
+    target.m_cycleId = source.m_cycleId;
+    target.m_cycleRepeat = source.m_cycleRepeat;
+    target.m_outerCycles = source.m_outerCycles;
+}
+
+void EditHistory::reset(const QList<Regime> &regimes)
+{
+    QList<Regime> definitions;
+    definitions.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        definitions.append(definitionOf(regime));
+
+    m_document = Document::fromList(definitions);
+    m_undo.clear();
+    m_redo.clear();
+    m_pending = Step();
+    m_touched.clear();
+    m_depth = 0;
+}
+
+const EditHistory::Document &EditHistory::document() const
+{
+    return m_document;
+}
+
+void EditHistory::beginStep(const QString &label)
+{
+    if (m_depth++ == 0) {
+        m_pending = Step();
+        m_pending.label = label;
+        m_touched.clear();
+    }
+}
+
+bool EditHistory::endStep(const QList<Regime> &current)
+{
+    Q_ASSERT(m_depth > 0);
+    if (--m_depth > 0)
+        return false;
+
+    if (m_document.size() != current.count()) {
+        // A structural change bypassed the history; earlier steps no longer line up
+        qWarning() << "EditHistory: Program changed outside of recorded edits, clearing history";
+        reset(current);
+        return false;
+    }
+
+    recordUpdates(current);
+    if (m_pending.ops.isEmpty())
+        return false;
+
+    m_undo.append(std::move(m_pending));
+    m_pending = Step();
+    m_redo.clear();
+    while (m_undo.count() > m_limit)
+        m_undo.removeFirst();
+    return true;
+}
+
+bool EditHistory::isRecording() const
+{
+    return m_depth > 0;
+}
+
+void EditHistory::markTouched(int row)
+{
+    if (isRecording())
+        m_touched.append(row);
+}
+
+void EditHistory::recordInsert(int row, const QList<Regime> &regimes)
+{
+    if (!isRecording() || regimes.isEmpty())
+        return;
+
+    QList<Regime> definitions;
+    definitions.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        definitions.append(definitionOf(regime));
+
+    Op op;
+    op.kind = OpKind::Insert;
+    op.row = row;
+    op.count = int(regimes.count());
+    op.after = m_document.insert(row, Document::fromList(definitions));
+    push(std::move(op));
+    for (int &touched : m_touched) {
+        if (touched >= row)
+            touched += int(regimes.count());
+    }
+}
+
+void EditHistory::recordRemove(int row, int count)
+{
+    if (!isRecording() || count <= 0)
+        return;
+
+    Op op;
+    op.kind = OpKind::Remove;
+    op.row = row;
+    op.count = count;
+    op.after = m_document.remove(row, count);
+    push(std::move(op));
+    m_touched.removeIf([row, count](int touched) { return touched >= row && touched < row + count; });
+    for (int &touched : m_touched) {
+        if (touched >= row + count)
+            touched -= count;
+    }
+}
+
+void EditHistory::recordMove(int sourceRow, int count, int destinationChild)
+{
+    if (!isRecording() || count <= 0)
+        return;
+
+    Op op;
+    op.kind = OpKind::Move;
+    op.row = sourceRow;
+    op.count = count;
+    op.destination = destinationChild;
+    op.after = m_document.move(sourceRow, count, destinationChild);
+    push(std::move(op));
+    for (int &touched : m_touched) {
+        if (touched >= sourceRow && touched < sourceRow + count)
+            touched += destinationChild > sourceRow ? destinationChild - count - sourceRow : destinationChild - sourceRow;
+        else if (destinationChild > sourceRow && touched >= sourceRow + count && touched < destinationChild)
+            touched -= count;
+        else if (destinationChild < sourceRow && touched >= destinationChild && touched < sourceRow)
+            touched += count;
+    }
+}
+
+void EditHistory::recordReorder(const QList<int> &order)
+{
+    if (!isRecording() || order.isEmpty())
+        return;
+
+    // A permutation shares no subtrees with the old version; build it in one O(n) pass
+    const QList<Regime> rows = m_document.toList();
+    QList<Regime> reordered;
+    reordered.reserve(order.count());
+    for (int row : order)
+        reordered.append(rows.at(row));
+
+    Op op;
+    op.kind = OpKind::Reorder;
+    op.count = int(order.count());
+    op.order = order;
+    op.after = Document::fromList(reordered);
+    push(std::move(op));
+    if (!m_touched.isEmpty()) {
+        QList<int> newRowOf(order.count());
+        for (int newRow = 0; newRow < order.count(); ++newRow)
+            newRowOf[order.at(newRow)] = newRow;
+        for (int &touched : m_touched)
+            touched = newRowOf.at(touched);
+    }
+}
+
+void EditHistory::recordUpdates(const QList<Regime> &current)
+{
+    // Touched rows whose definition differs from the document, as contiguous runs
+    std::sort(m_touched.begin(), m_touched.end());
+    m_touched.erase(std::unique(m_touched.begin(), m_touched.end()), m_touched.end());
+    QList<std::pair<int, int>> runs;
+    for (int row : std::as_const(m_touched)) {
+        if (row < 0 || row >= current.count() || row >= m_document.size()
+                || sameDefinition(m_document.at(row), current.at(row)))
+            continue;
+        if (!runs.isEmpty() && runs.last().second == row)
+            runs.last().second = row + 1;
+        else
+            runs.append({row, row + 1});
+    }
+    m_touched.clear();
+
+    for (const auto &[first, end] : runs) {
+        Op op;
+        op.kind = OpKind::Update;
+        op.row = first;
+        op.count = end - first;
+        Document after = m_document;
+        for (int row = first; row < end; ++row)
+            after = after.set(row, definitionOf(current.at(row)));
+        op.after = after;
+        push(std::move(op));
+    }
+}
+
+void EditHistory::push(Op op)
+{
+    op.before = m_document;
+    m_document = op.after;
+    m_pending.ops.append(std::move(op));
+}
+
+bool EditHistory::canUndo() const
+{
+    return !m_undo.isEmpty() && !isRecording();
+}
+
+bool EditHistory::canRedo() const
+{
+    return !m_redo.isEmpty() && !isRecording();
+}
+
+QString EditHistory::undoLabel() const
+{
+    return m_undo.isEmpty() ? QString() : m_undo.last().label;
+}
+
+QString EditHistory::redoLabel() const
+{
+    return m_redo.isEmpty() ? QString() : m_redo.last().label;
+}
+
+EditHistory::Step EditHistory::takeUndo()
+{
+    Q_ASSERT(canUndo());
+    Step step = m_undo.takeLast();
+    m_document = step.ops.first().before;
+    m_redo.append(step);
+    return step;
+}
+
+EditHistory::Step EditHistory::takeRedo()
+{
+    Q_ASSERT(canRedo());
+    Step step = m_redo.takeLast();
+    m_document = step.ops.last().after;
+    m_undo.append(step);
+    return step;
+}
+
+int EditHistory::limit() const
+{
+    return m_limit;
+}
+
+void EditHistory::setLimit(int steps)
+{
+    m_limit = qMax(1, steps);
+    while (m_undo.count() > m_limit)
+        m_undo.removeFirst();
+}
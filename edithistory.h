@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include "persistentvector.h"
+#include "regime.h"
+
+/**
+ * @brief Undo/redo history of program edits for ProtoTableModel
+ *
+ * The history keeps the program definition as a PersistentVector, so every recorded
+ * version shares all untouched rows with its neighbours and a step costs O(log n) memory
+ * per changed row instead of a copy of the whole program. A step is a list of primitive
+ * operations (insert, remove, move, reorder, field update) together with the versions
+ * before and after each of them; the model replays them as minimal row inserts, removes,
+ * moves, layout changes and dataChanged signals.
+ *
+ * Only definition fields (name, condition, repeats, max time, cycle membership) are
+ * tracked; execution progress is never undone. Field updates are found by comparing the
+ * rows the model marked as touched during the step with the document, so an edit costs
+ * O(touched rows * log n) however large the program is.
+ */
+class EditHistory
+{
+public:
+    using Document = PersistentVector<Regime>;
+
+    enum class OpKind {
+        Insert,     // count rows inserted at row
+        Remove,     // count rows removed at row
+        Move,       // count rows moved from row in front of destination
+        Reorder,    // all rows permuted; order[newRow] is the old row
+        Update      // definition fields of rows [row, row + count) changed
+    };
+
+    struct Op {
+        OpKind kind = OpKind::Update;
+        int row = 0;
+        int count = 0;
+        int destination = 0;
+        QList<int> order;
+        Document before;
+        Document after;
+    };
+
+    struct Step {
+        QString label;
+        QList<Op> ops;
+    };
+
+    /// Copy of regime with the execution tracking fields reset
+    static Regime definitionOf(const Regime &regime);
+    static bool sameDefinition(const Regime &a, const Regime &b);
+    static void copyDefinition(Regime &target, const Regime &source);
+
+    /// Drops all steps and starts over from regimes
+    void reset(const QList<Regime> &regimes);
+    const Document &document() const;
+
+    /// Steps nest; only the outermost begin/end pair produces a history entry
+    void beginStep(const QString &label);
+    /// Records field updates of the touched rows against current and pushes the step if anything changed
+    bool endStep(const QList<Regime> &current);
+    bool isRecording() const;
+    /// Notes that the definition of row may have changed in the current step; only these rows are compared at endStep()
+    void markTouched(int row);
+
+    void recordInsert(int row, const QList<Regime> &regimes);
+    void recordRemove(int row, int count);
+    void recordMove(int sourceRow, int count, int destinationChild);
+    /// order[newRow] is the row that was moved to newRow
+    void recordReorder(const QList<int> &order);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    QString undoLabel() const;
+    QString redoLabel() const;
+
+    /// Moves the newest step to the redo stack and returns it; the caller reverts its ops back to front
+    Step takeUndo();
+    /// Moves the newest undone step back and returns it; the caller reapplies its ops front to back
+    Step takeRedo();
+
+    int limit() const;
+    void setLimit(int steps);
+
+private:
+    void push(Op op);
+    void recordUpdates(const QList<Regime> &current);
+
+    Document m_document;
+    QList<Step> m_undo;
+    QList<Step> m_redo;
+    Step m_pending;
+    QList<int> m_touched;   // Rows of the current step, in the positions after its structural ops
+    int m_depth = 0;
+    int m_limit = 200;
+};
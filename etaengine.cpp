@@ -0,0 +1,232 @@
+#include "etaengine.h"
+#include "prototablemodel.h"
+#include <QtMath>
+
+namespace {
+
+// Planned seconds the correction starts with at factor 1, so a single early phase cannot swing the estimate
+constexpr double kPriorSeconds = 300.0;
+
+bool isFinished(RegimeEnums::State state)
+{
+    return state == RegimeEnums::State::Done
+        || state == RegimeEnums::State::Skipped
+        || state == RegimeEnums::State::Error;
+}
+
+double correction(qint64 plannedSeconds, qint64 observedMs)
+{
+    return (observedMs / 1000.0 + kPriorSeconds) / (plannedSeconds + kPriorSeconds);
+}
+
+} // namespace
+
+EtaEngine::EtaEngine(ProtoTableModel *model, QObject *parent)
+    : QObject{parent}
+    , m_model(model)
+{
+    m_elapsed.start();
+
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                    updateRows(topLeft.row(), bottomRight.row());
+                });
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, &EtaEngine::rebuild);
+        connect(m_model, &QAbstractItemModel::rowsRemoved, this, &EtaEngine::rebuild);
+        connect(m_model, &QAbstractItemModel::rowsMoved, this, &EtaEngine::rebuild);
+        connect(m_model, &QAbstractItemModel::layoutChanged, this, &EtaEngine::rebuild);
+        // A reset loads another program, whose run has nothing to do with the phases seen so far
+        connect(m_model, &QAbstractItemModel::modelReset, this, [this]() {
+            resetObservations();
+            rebuild();
+        });
+        rebuild();
+    }
+}
+
+int EtaEngine::secondsLeft() const
+{
+    return int(qRound64(m_total.condition * conditionFactor() + m_total.execution * executionFactor()));
+}
+
+int EtaEngine::plannedSecondsLeft() const
+{
+    return int(m_total.condition + m_total.execution);
+}
+
+QDateTime EtaEngine::finishTime() const
+{
+    return QDateTime::currentDateTime().addSecs(secondsLeft());
+}
+
+double EtaEngine::conditionFactor() const
+{
+    return correction(m_plannedCondition, m_observedConditionMs);
+}
+
+double EtaEngine::executionFactor() const
+{
+    return correction(m_plannedExecution, m_observedExecutionMs);
+}
+
+void EtaEngine::recordPhase(Phase phase, qint64 plannedSeconds, qint64 observedMs)
+{
+    addObservation(phase, plannedSeconds, observedMs);
+    emit etaChanged();
+}
+
+void EtaEngine::resetObservations()
+{
+    m_plannedCondition = 0;
+    m_observedConditionMs = 0;
+    m_plannedExecution = 0;
+    m_observedExecutionMs = 0;
+    emit etaChanged();
+}
+
+void EtaEngine::setClock(std::function<qint64()> clock)
+{
+    m_clock = std::move(clock);
+}
+
+EtaEngine::Remaining EtaEngine::remainingFor(const Regime &regime)
+{
+    Remaining remaining;
+    if (isFinished(regime.m_state))
+        return remaining;
+
+    const int processed = regime.m_repeatsDone + regime.m_repeatsSkipped + regime.m_repeatsError;
+    qint64 repeats = qint64(regime.m_repeatCount) * regime.cyclePasses() - processed;
+    if (repeats <= 0)
+        return remaining;
+
+    const qint64 condition = regime.conditionTimeInSeconds();
+
+    // The repeat in progress only has its unfinished part left
+    if (regime.m_state == RegimeEnums::State::Running || regime.m_state == RegimeEnums::State::Paused) {
+        --repeats;
+        if (!regime.m_conditionCompleted) {
+            remaining.condition += qMax<qint64>(0, condition - regime.m_conditionTimePassed);
+            remaining.execution += regime.m_maxTime;
+        } else {
+            remaining.execution += qMax(0, regime.m_maxTime - regime.m_regimeTimePassed);
+        }
+    }
+
+    remaining.condition += repeats * condition;
+    remaining.execution += repeats * regime.m_maxTime;
+    return remaining;
+}
+
+void EtaEngine::rebuild()
+{
+    m_rows.clear();
+    m_total = {};
+    const QList<Regime> regimes = m_model->getRegimes();
+    m_rows.reserve(regimes.count());
+    for (const Regime &regime : regimes) {
+        RowState row;
+        row.state = regime.m_state;
+        row.conditionCompleted = regime.m_conditionCompleted;
+        row.currentRepeat = regime.m_currentRepeat;
+        row.repeatsDone = regime.m_repeatsDone;
+        row.repeatsSkipped = regime.m_repeatsSkipped;
+        row.repeatsError = regime.m_repeatsError;
+        applyRemaining(row, remainingFor(regime));
+        m_rows.append(row);
+    }
+    emit etaChanged();
+}
+
+void EtaEngine::updateRows(int first, int last)
+{
+    if (first < 0 || last >= m_rows.count()) {
+        rebuild();
+        return;
+    }
+
+    const Remaining totalBefore = m_total;
+    const double conditionBefore = conditionFactor();
+    const double executionBefore = executionFactor();
+    for (int row = first; row <= last; ++row) {
+        const Regime &regime = m_model->regimeAt(row);
+        RowState &cached = m_rows[row];
+        observeTransition(row, cached, regime);
+        applyRemaining(cached, remainingFor(regime));
+    }
+
+    if (m_total != totalBefore || conditionFactor() != conditionBefore || executionFactor() != executionBefore)
+        emit etaChanged();
+}
+
+void EtaEngine::observeTransition(int row, RowState &cached, const Regime &regime)
+{
+    const qint64 time = now();
+
+    // Only phases timed from their very start count; a pause leaves the phase untimed
+    if (cached.phaseStart >= 0 && regime.m_currentRepeat == cached.currentRepeat) {
+        if (!cached.conditionCompleted && regime.m_conditionCompleted) {
+            cached.conditionMs = time - cached.phaseStart;
+            addObservation(Phase::Condition, regime.conditionTimeInSeconds(), cached.conditionMs);
+            cached.phaseStart = time;
+        } else if (regime.m_repeatsDone > cached.repeatsDone
+                   || regime.m_repeatsSkipped > cached.repeatsSkipped
+                   || regime.m_repeatsError > cached.repeatsError) {
+            qint64 executionMs = -1;
+            RegimeEnums::State outcome = RegimeEnums::State::Done;
+            if (regime.m_repeatsSkipped > cached.repeatsSkipped) {
+                outcome = RegimeEnums::State::Skipped;
+            } else if (regime.m_repeatsError > cached.repeatsError) {
+                outcome = RegimeEnums::State::Error;
+            } else if (cached.conditionCompleted) {
+                executionMs = time - cached.phaseStart;
+                addObservation(Phase::Execution, regime.m_maxTime, executionMs);
+            }
+            emit repeatObserved(row, cached.currentRepeat, outcome, cached.conditionMs, executionMs);
+        }
+    }
+    if (regime.m_currentRepeat != cached.currentRepeat || regime.m_state != RegimeEnums::State::Running)
+        cached.conditionMs = -1;
+
+    if (regime.m_state != RegimeEnums::State::Running) {
+        cached.phaseStart = -1;
+    } else if (cached.state != RegimeEnums::State::Running && cached.state != RegimeEnums::State::Paused) {
+        cached.phaseStart = time;
+    } else if (regime.m_currentRepeat != cached.currentRepeat || regime.m_repeatsDone != cached.repeatsDone) {
+        // The next repeat starts with its condition phase
+        cached.phaseStart = time;
+    }
+
+    cached.state = regime.m_state;
+    cached.conditionCompleted = regime.m_conditionCompleted;
+    cached.currentRepeat = regime.m_currentRepeat;
+    cached.repeatsDone = regime.m_repeatsDone;
+    cached.repeatsSkipped = regime.m_repeatsSkipped;
+    cached.repeatsError = regime.m_repeatsError;
+}
+
+void EtaEngine::addObservation(Phase phase, qint64 plannedSeconds, qint64 observedMs)
+{
+    if (plannedSeconds <= 0 || observedMs < 0)
+        return;
+    if (phase == Phase::Condition) {
+        m_plannedCondition += plannedSeconds;
+        m_observedConditionMs += observedMs;
+    } else {
+        m_plannedExecution += plannedSeconds;
+        m_observedExecutionMs += observedMs;
+    }
+}
+
+void EtaEngine::applyRemaining(RowState &cached, const Remaining &remaining)
+{
+    m_total.condition += remaining.condition - cached.remaining.condition;
+    m_total.execution += remaining.execution - cached.remaining.execution;
+    cached.remaining = remaining;
+}
+
+qint64 EtaEngine::now() const
+{
+    return m_clock ? m_clock() : m_elapsed.elapsed();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <functional>
+#include "regime.h"
+
+class ProtoTableModel;
+
+/**
+ * @brief Live estimate of the time left, corrected by the phase durations observed in this run
+ *
+ * The planned time left is kept split into condition and execution seconds, cached per row
+ * and summed. A progress event touches one row, so it is applied as the difference of that
+ * row's cached share in O(1); structural edits rebuild the sums. Condition and execution
+ * phases timed by the wall clock while the program runs give two correction factors
+ * (observed / planned seconds), which scale the corresponding planned remainder.
+ */
+class EtaEngine : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int secondsLeft READ secondsLeft NOTIFY etaChanged)
+    Q_PROPERTY(int plannedSecondsLeft READ plannedSecondsLeft NOTIFY etaChanged)
+    Q_PROPERTY(QDateTime finishTime READ finishTime NOTIFY etaChanged)
+    Q_PROPERTY(double conditionFactor READ conditionFactor NOTIFY etaChanged)
+    Q_PROPERTY(double executionFactor READ executionFactor NOTIFY etaChanged)
+
+public:
+    enum class Phase {
+        Condition,
+        Execution
+    };
+
+    /// Planned seconds left in one row, split by phase
+    struct Remaining {
+        qint64 condition = 0;
+        qint64 execution = 0;
+
+        bool operator==(const Remaining &) const = default;
+    };
+
+    explicit EtaEngine(ProtoTableModel *model, QObject *parent = nullptr);
+
+    /// Seconds left with the observed corrections applied
+    int secondsLeft() const;
+    /// Seconds left as planned (condition time plus max time of every unfinished repeat)
+    int plannedSecondsLeft() const;
+    /// Projected wall-clock time the program finishes at
+    QDateTime finishTime() const;
+    /// Observed / planned duration of finished condition phases, near 1 until enough are observed
+    double conditionFactor() const;
+    /// Observed / planned duration of finished execution phases, near 1 until enough are observed
+    double executionFactor() const;
+
+    /// Adds one finished phase to the correction; phases without planned time are ignored
+    void recordPhase(Phase phase, qint64 plannedSeconds, qint64 observedMs);
+    /// Forgets the observed durations, e.g. when a new run starts
+    Q_INVOKABLE void resetObservations();
+
+    /// Replaces the wall clock (milliseconds, monotonic); used by tests
+    void setClock(std::function<qint64()> clock);
+
+    /// Planned time left in one row, counting all its repeats and enclosing cycle passes
+    static Remaining remainingFor(const Regime &regime);
+
+signals:
+    void etaChanged();
+    /**
+     * @brief A repeat that was timed from its start has finished
+     * @param outcome Done, Skipped or Error
+     * @param conditionMs Observed condition phase, -1 if it did not complete
+     * @param executionMs Observed execution phase, -1 unless the repeat completed after its condition
+     */
+    void repeatObserved(int row, int repeatIndex, RegimeEnums::State outcome, qint64 conditionMs, qint64 executionMs);
+
+private:
+    // Cached share of one row plus what is needed to spot its phase transitions
+    struct RowState {
+        Remaining remaining;
+        RegimeEnums::State state = RegimeEnums::State::Waiting;
+        bool conditionCompleted = false;
+        int currentRepeat = 0;
+        int repeatsDone = 0;
+        int repeatsSkipped = 0;
+        int repeatsError = 0;
+        qint64 phaseStart = -1;     // Clock value the current phase started at, -1 when idle
+        qint64 conditionMs = -1;    // Observed condition phase of the current repeat
+    };
+
+    void rebuild();
+    void updateRows(int first, int last);
+    void observeTransition(int row, RowState &cached, const Regime &regime);
+    void addObservation(Phase phase, qint64 plannedSeconds, qint64 observedMs);
+    void applyRemaining(RowState &cached, const Remaining &remaining);
+    qint64 now() const;
+
+    ProtoTableModel *m_model = nullptr;
+    QList<RowState> m_rows;
+    Remaining m_total;
+    qint64 m_plannedCondition = 0;        // Seconds
+    qint64 m_observedConditionMs = 0;
+    qint64 m_plannedExecution = 0;        // Seconds
+    qint64 m_observedExecutionMs = 0;
+    QElapsedTimer m_elapsed;
+    std::function<qint64()> m_clock;
+};
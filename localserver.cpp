@@ -0,0 +1,21 @@
+#include "localserver.h"
+#include <QAbstractSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+bool LocalServer::listen(QLocalServer &server, const QString &serverName)
+{
+    if (server.listen(serverName))
+        return true;
+    if (server.serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+
+    QLocalSocket probe;
+    probe.connectToServer(serverName);
+    if (probe.waitForConnected(ProbeTimeout)) {
+        probe.abort();
+        return false;
+    }
+    QLocalServer::removeServer(serverName);
+    return server.listen(serverName);
+}
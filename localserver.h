@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QString>
+
+class QLocalServer;
+
+namespace LocalServer {
+
+/// Milliseconds a connect probe waits for a process that still serves the socket
+constexpr int ProbeTimeout = 500;
+
+/**
+ * @brief Listens on serverName, replacing the socket only if it was left by a crashed process
+ *
+ * A socket that still accepts connections belongs to a running instance and is left
+ * alone, so a second instance fails to listen instead of taking the name over.
+ */
+bool listen(QLocalServer &server, const QString &serverName);
+
+} // namespace LocalServer
@@ -1,10 +1,16 @@
+#include <QDir>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QQuickStyle>
+#include <QStandardPaths>
+#include "driverserver.h"
 #include "prototablemodel.h"
 #include "regime.h"
 #include "regimemanager.h"
+#include "sharedstatesegment.h"
+#include "statepublisher.h"
+#include "stationregistry.h"
 #include "visibleregimemodel.h"
 
 int main(int argc, char *argv[])
@@ -17,8 +23,26 @@ int main(int argc, char *argv[])
     QString applicationName = "GRAMs"; // curInitProfile also?
     QLocale::setDefault(QLocale::c()); 
     QQmlApplicationEngine engine;
-    RegimeManager regimeManager;
-    qmlRegisterSingletonInstance("com.grams.prototable", 1, 0, "RegimeManager", &regimeManager);
+    StationRegistry stationRegistry;
+    // The first station keeps serving the RegimeManager singleton used by RunTable
+    RegimeManager *regimeManager = stationRegistry.addStation("default");
+    regimeManager->loadDefaultRegimes();
+    // Observed repeat durations of every run, for forecasting and reports
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    regimeManager->setHistoryPath(dataDir + "/run-history.grh");
+    qmlRegisterSingletonInstance("com.grams.prototable", 1, 0, "RegimeManager", regimeManager);
+    qmlRegisterSingletonInstance("com.grams.prototable", 1, 0, "StationRegistry", &stationRegistry);
+
+    // Out-of-process instrument drivers talk to the default station over a local socket
+    DriverServer driverServer(regimeManager);
+    driverServer.listen("grams-prototable");
+    // Read-only dashboards follow the run through snapshot + delta frames
+    StatePublisher statePublisher(regimeManager);
+    statePublisher.listen("grams-prototable-state");
+    // Local tools poll the full state from shared memory
+    SharedStateSegment sharedState(regimeManager);
+    sharedState.create("grams-prototable-state");
 
     const QUrl url("qrc:/prototype_table/qml/Main.qml");
     QObject::connect(&engine, &QQmlApplicationEngine::objectCreated,
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/**
+ * @brief Bounded lock-free multi-producer / single-consumer queue of fixed-size records
+ *
+ * Every slot carries a sequence number telling producers and the consumer whose turn
+ * it is, so a push is one CAS on the enqueue position plus a copy and never blocks or
+ * allocates. The storage is allocated once in the constructor; the capacity is rounded
+ * up to a power of two. tryPush() may be called from any thread, tryPop() only from
+ * the single consumer thread.
+ */
+template <typename T>
+class MpscRingBuffer
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Records must be trivially copyable");
+
+public:
+    explicit MpscRingBuffer(size_t capacity)
+    {
+        size_t rounded = 2;
+        while (rounded < capacity)
+            rounded <<= 1;
+        m_mask = rounded - 1;
+        m_slots = std::make_unique<Slot[]>(rounded);
+        for (size_t i = 0; i < rounded; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer &) = delete;
+    MpscRingBuffer &operator=(const MpscRingBuffer &) = delete;
+
+    size_t capacity() const { return m_mask + 1; }
+
+    /// Appends a record; returns false without waiting when the queue is full
+    bool tryPush(const T &value)
+    {
+        size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        Slot *slot = nullptr;
+        for (;;) {
+            slot = &m_slots[position & m_mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const std::intptr_t difference = std::intptr_t(sequence) - std::intptr_t(position);
+            if (difference == 0) {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = value;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Takes the oldest published record; consumer thread only
+    bool tryPop(T &value)
+    {
+        Slot &slot = m_slots[m_dequeuePosition & m_mask];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (std::intptr_t(sequence) - std::intptr_t(m_dequeuePosition + 1) < 0)
+            return false; // Empty, or the next producer has not finished writing yet
+
+        value = slot.value;
+        slot.sequence.store(m_dequeuePosition + m_mask + 1, std::memory_order_release);
+        ++m_dequeuePosition;
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    // Producers and the consumer touch different cache lines
+    alignas(64) std::atomic<size_t> m_enqueuePosition{0};
+    alignas(64) size_t m_dequeuePosition = 0;
+    size_t m_mask = 0;
+    std::unique_ptr<Slot[]> m_slots;
+};
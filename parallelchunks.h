@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QSemaphore>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * @brief Runs fn(chunkIndex) for every chunk in [0, chunkCount) across a thread pool
+ *
+ * Workers pull the next unclaimed chunk from a shared counter, so threads that finish
+ * early keep taking work from slower ones. The calling thread drains chunks as well,
+ * which keeps this safe to call from inside a task running on the same pool.
+ * Returns once every chunk has been processed.
+ */
+template <typename Fn>
+void runParallelChunks(int chunkCount, Fn &&fn, QThreadPool *pool = QThreadPool::globalInstance())
+{
+    if (chunkCount <= 0)
+        return;
+
+    struct State {
+        std::atomic<int> next{0};
+        QSemaphore done;
+        std::function<void(int)> work;
+    };
+
+    auto state = std::make_shared<State>();
+    state->work = std::forward<Fn>(fn);
+
+    auto drain = [chunkCount](const std::shared_ptr<State> &s) {
+        for (int chunk = s->next.fetch_add(1); chunk < chunkCount; chunk = s->next.fetch_add(1)) {
+            s->work(chunk);
+            s->done.release();
+        }
+    };
+
+    // Helpers that start after all chunks are claimed exit without touching the work
+    const int helpers = pool ? qMin(chunkCount - 1, pool->maxThreadCount()) : 0;
+    for (int i = 0; i < helpers; ++i) {
+        pool->start([state, drain]() { drain(state); });
+    }
+
+    drain(state);
+    state->done.acquire(chunkCount);
+}
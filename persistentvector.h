@@ -0,0 +1,223 @@
+#pragma once
+
+#include <QList>
+#include <QtGlobal>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Immutable sequence with structural sharing (persistent implicit treap)
+ *
+ * Every modifying operation returns a new vector and leaves the original untouched; only
+ * the O(log n) nodes on the affected paths are copied, everything else is shared between
+ * the versions. Copying a PersistentVector is a reference count increment. Versions can be
+ * read from any thread, as nodes are never mutated after construction.
+ */
+template<typename T>
+class PersistentVector
+{
+public:
+    PersistentVector() = default;
+
+    static PersistentVector fromList(const QList<T> &values)
+    {
+        // Balanced tree whose priorities respect the heap order, as if built by random inserts
+        const int count = int(values.count());
+        std::vector<quint32> priorities(static_cast<size_t>(count));
+        for (quint32 &priority : priorities)
+            priority = randomPriority();
+        std::sort(priorities.begin(), priorities.end(), std::greater<>());
+
+        std::vector<quint32> byPosition(static_cast<size_t>(count));
+        std::vector<std::pair<int, int>> queue;
+        queue.reserve(size_t(count));
+        if (count > 0)
+            queue.emplace_back(0, count);
+        size_t next = 0;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            const auto [begin, end] = queue[head];
+            const int mid = begin + (end - begin) / 2;
+            byPosition[size_t(mid)] = priorities[next++];
+            if (begin < mid)
+                queue.emplace_back(begin, mid);
+            if (mid + 1 < end)
+                queue.emplace_back(mid + 1, end);
+        }
+
+        PersistentVector result;
+        result.m_root = build(values, byPosition, 0, count);
+        return result;
+    }
+
+    int size() const { return sizeOf(m_root); }
+    bool isEmpty() const { return !m_root; }
+
+    const T &at(int index) const
+    {
+        Q_ASSERT(index >= 0 && index < size());
+        const Node *node = m_root.get();
+        while (true) {
+            const int leftSize = sizeOf(node->left);
+            if (index < leftSize) {
+                node = node->left.get();
+            } else if (index == leftSize) {
+                return node->value;
+            } else {
+                index -= leftSize + 1;
+                node = node->right.get();
+            }
+        }
+    }
+
+    PersistentVector set(int index, const T &value) const
+    {
+        Q_ASSERT(index >= 0 && index < size());
+        return PersistentVector(setAt(m_root, index, value));
+    }
+
+    PersistentVector insert(int index, const T &value) const
+    {
+        return insert(index, PersistentVector(makeNode(value, randomPriority(), nullptr, nullptr)));
+    }
+
+    PersistentVector insert(int index, const PersistentVector &values) const
+    {
+        Q_ASSERT(index >= 0 && index <= size());
+        auto [left, right] = split(m_root, index);
+        return PersistentVector(merge(merge(left, values.m_root), right));
+    }
+
+    PersistentVector remove(int index, int count = 1) const
+    {
+        Q_ASSERT(index >= 0 && count >= 0 && index + count <= size());
+        auto [left, rest] = split(m_root, index);
+        auto [removed, right] = split(rest, count);
+        Q_UNUSED(removed);
+        return PersistentVector(merge(left, right));
+    }
+
+    PersistentVector mid(int index, int count) const
+    {
+        Q_ASSERT(index >= 0 && count >= 0 && index + count <= size());
+        auto [left, rest] = split(m_root, index);
+        Q_UNUSED(left);
+        return PersistentVector(split(rest, count).first);
+    }
+
+    /// Moves count elements starting at sourceRow in front of destinationChild (QAbstractItemModel::moveRows semantics)
+    PersistentVector move(int sourceRow, int count, int destinationChild) const
+    {
+        const PersistentVector moved = mid(sourceRow, count);
+        const int insertAt = destinationChild > sourceRow ? destinationChild - count : destinationChild;
+        return remove(sourceRow, count).insert(insertAt, moved);
+    }
+
+    /// Calls fn(index, value) for every element in order
+    template<typename Fn>
+    void forEach(Fn &&fn) const
+    {
+        int index = 0;
+        visit(m_root.get(), index, fn);
+    }
+
+    QList<T> toList() const
+    {
+        QList<T> values;
+        values.reserve(size());
+        forEach([&values](int, const T &value) { values.append(value); });
+        return values;
+    }
+
+    /// True when both versions are the same tree (cheap "unchanged" test)
+    bool isSharedWith(const PersistentVector &other) const { return m_root == other.m_root; }
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        T value;
+        quint32 priority;
+        int size;
+        NodePtr left;
+        NodePtr right;
+    };
+
+    explicit PersistentVector(NodePtr root) : m_root(std::move(root)) {}
+
+    static quint32 randomPriority()
+    {
+        thread_local std::minstd_rand generator{std::random_device{}()};
+        return quint32(generator());
+    }
+
+    static int sizeOf(const NodePtr &node) { return node ? node->size : 0; }
+
+    static NodePtr makeNode(const T &value, quint32 priority, NodePtr left, NodePtr right)
+    {
+        const int size = sizeOf(left) + sizeOf(right) + 1;
+        return std::make_shared<const Node>(Node{value, priority, size, std::move(left), std::move(right)});
+    }
+
+    static NodePtr build(const QList<T> &values, const std::vector<quint32> &priorities, int begin, int end)
+    {
+        if (begin >= end)
+            return nullptr;
+        const int mid = begin + (end - begin) / 2;
+        return makeNode(values.at(mid), priorities[size_t(mid)],
+                        build(values, priorities, begin, mid), build(values, priorities, mid + 1, end));
+    }
+
+    static NodePtr setAt(const NodePtr &node, int index, const T &value)
+    {
+        const int leftSize = sizeOf(node->left);
+        if (index < leftSize)
+            return makeNode(node->value, node->priority, setAt(node->left, index, value), node->right);
+        if (index > leftSize)
+            return makeNode(node->value, node->priority, node->left, setAt(node->right, index - leftSize - 1, value));
+        return makeNode(value, node->priority, node->left, node->right);
+    }
+
+    // Splits into the first count elements and the rest
+    static std::pair<NodePtr, NodePtr> split(const NodePtr &node, int count)
+    {
+        if (count <= 0)
+            return {nullptr, node};
+        if (count >= sizeOf(node))
+            return {node, nullptr};
+        const int leftSize = sizeOf(node->left);
+        if (count <= leftSize) {
+            auto [left, right] = split(node->left, count);
+            return {left, makeNode(node->value, node->priority, right, node->right)};
+        }
+        auto [left, right] = split(node->right, count - leftSize - 1);
+        return {makeNode(node->value, node->priority, node->left, left), right};
+    }
+
+    static NodePtr merge(const NodePtr &left, const NodePtr &right)
+    {
+        if (!left)
+            return right;
+        if (!right)
+            return left;
+        if (left->priority > right->priority)
+            return makeNode(left->value, left->priority, left->left, merge(left->right, right));
+        return makeNode(right->value, right->priority, merge(left, right->left), right->right);
+    }
+
+    template<typename Fn>
+    static void visit(const Node *node, int &index, Fn &fn)
+    {
+        if (!node)
+            return;
+        visit(node->left.get(), index, fn);
+        fn(index++, node->value);
+        visit(node->right.get(), index, fn);
+    }
+
+    NodePtr m_root;
+};
@@ -0,0 +1,168 @@
+#include "phaseclock.h"
+#include "prototablemodel.h"
+#include <algorithm>
+
+PhaseClock::PhaseClock(ProtoTableModel *model, QObject *parent)
+    : QObject{parent}
+    , m_model(model)
+{
+    m_elapsed.start();
+
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles) {
+                    updateRows(topLeft.row(), bottomRight.row(), roles);
+                });
+        // Running rows are tracked by persistent index, which already points at the new row
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, &PhaseClock::rebuild);
+        connect(m_model, &QAbstractItemModel::rowsRemoved, this, &PhaseClock::rebuild);
+        connect(m_model, &QAbstractItemModel::rowsMoved, this, &PhaseClock::rebuild);
+        connect(m_model, &QAbstractItemModel::layoutChanged, this, &PhaseClock::rebuild);
+        connect(m_model, &QAbstractItemModel::modelReset, this, [this]() {
+            m_running.clear();
+            rebuild();
+        });
+        rebuild();
+    }
+}
+
+bool PhaseClock::isActive() const
+{
+    return !m_running.isEmpty();
+}
+
+double PhaseClock::conditionElapsed(int row) const
+{
+    if (row < 0 || row >= m_timePassed.count())
+        return 0;
+    const RowState *cached = runningState(row);
+    return cached && !cached->execution ? extrapolated(*cached) : m_model->regimeAt(row).m_conditionTimePassed;
+}
+
+double PhaseClock::regimeElapsed(int row) const
+{
+    if (row < 0 || row >= m_timePassed.count())
+        return 0;
+    const RowState *cached = runningState(row);
+    return cached && cached->execution ? extrapolated(*cached) : m_model->regimeAt(row).m_regimeTimePassed;
+}
+
+double PhaseClock::totalElapsed() const
+{
+    double total = double(m_totalTimePassed);
+    for (const RunningRow &running : m_running) {
+        const RowState &cached = running.state;
+        total += extrapolated(cached) - (cached.execution ? cached.regimePassed : cached.conditionPassed);
+    }
+    return total;
+}
+
+void PhaseClock::setClock(std::function<qint64()> clock)
+{
+    m_clock = std::move(clock);
+}
+
+void PhaseClock::rebuild()
+{
+    const bool wasActive = isActive();
+    const qint64 time = now();
+
+    m_running.removeIf([](const RunningRow &running) { return !running.index.isValid(); });
+    const int rows = m_model->rowCount();
+    m_timePassed.resize(rows);
+    m_totalTimePassed = 0;
+    for (int row = 0; row < rows; ++row) {
+        const Regime &regime = m_model->regimeAt(row);
+        m_timePassed[row] = regime.m_timePassedInSeconds;
+        m_totalTimePassed += regime.m_timePassedInSeconds;
+        updateRunning(row, regime, {}, time);
+    }
+
+    if (isActive() != wasActive)
+        emit activeChanged();
+}
+
+void PhaseClock::updateRows(int first, int last, const QList<int> &roles)
+{
+    if (first < 0 || last >= m_timePassed.count()) {
+        rebuild();
+        return;
+    }
+
+    const bool wasActive = isActive();
+    const qint64 time = now();
+    for (int row = first; row <= last; ++row) {
+        const Regime &regime = m_model->regimeAt(row);
+        m_totalTimePassed += regime.m_timePassedInSeconds - m_timePassed.at(row);
+        m_timePassed[row] = regime.m_timePassedInSeconds;
+        updateRunning(row, regime, roles, time);
+    }
+
+    if (isActive() != wasActive)
+        emit activeChanged();
+}
+
+void PhaseClock::updateRunning(int row, const Regime &regime, const QList<int> &roles, qint64 time)
+{
+    const auto it = std::find_if(m_running.begin(), m_running.end(),
+                                 [row](const RunningRow &running) { return running.index.row() == row; });
+    if (regime.m_state != RegimeEnums::State::Running) {
+        if (it != m_running.end())
+            m_running.erase(it);
+        return;
+    }
+
+    if (it == m_running.end()) {
+        m_running.append({QPersistentModelIndex(m_model->index(row, 0)), {}});
+        applyRow(m_running.last().state, regime, roles, time);
+    } else {
+        applyRow(it->state, regime, roles, time);
+    }
+}
+
+void PhaseClock::applyRow(RowState &cached, const Regime &regime, const QList<int> &roles, qint64 time)
+{
+    const bool running = regime.m_state == RegimeEnums::State::Running;
+    // Rows without a condition go straight to execution
+    const bool execution = regime.m_conditionCompleted || regime.conditionTimeInSeconds() <= 0;
+    // The driver may report the same value again, e.g. while the phase is held up
+    const bool reported = roles.contains(execution ? ProtoTableModel::RegimeTimePassedRole
+                                                   : ProtoTableModel::ConditionTimePassedRole);
+
+    // A report, a new phase or a (re)start restarts the extrapolation from the reported value
+    if (running && (reported || !cached.running || execution != cached.execution
+                    || regime.m_currentRepeat != cached.currentRepeat
+                    || regime.m_conditionTimePassed != cached.conditionPassed
+                    || regime.m_regimeTimePassed != cached.regimePassed)) {
+        cached.reportedAt = time;
+    }
+
+    cached.running = running;
+    cached.execution = execution;
+    cached.currentRepeat = regime.m_currentRepeat;
+    cached.conditionPassed = regime.m_conditionTimePassed;
+    cached.regimePassed = regime.m_regimeTimePassed;
+    cached.limit = execution ? regime.m_maxTime : regime.conditionTimeInSeconds();
+}
+
+const PhaseClock::RowState *PhaseClock::runningState(int row) const
+{
+    for (const RunningRow &running : m_running) {
+        if (running.index.row() == row)
+            return &running.state;
+    }
+    return nullptr;
+}
+
+double PhaseClock::extrapolated(const RowState &cached) const
+{
+    const int reported = cached.execution ? cached.regimePassed : cached.conditionPassed;
+    const double value = reported + (now() - cached.reportedAt) / 1000.0;
+    // Only the driver moves a row past the end of its phase
+    return qMin(value, double(qMax(cached.limit, reported)));
+}
+
+qint64 PhaseClock::now() const
+{
+    return m_clock ? m_clock() : m_elapsed.elapsed();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPersistentModelIndex>
+#include <functional>
+#include "regime.h"
+
+class ProtoTableModel;
+
+/**
+ * @brief Extrapolates the progress of running rows between driver reports
+ *
+ * Every running row remembers when its current phase was last reported (the phase start,
+ * or the last condition/regime progress update) on a monotonic clock. The elapsed values
+ * handed out are the reported ones plus the time since, capped at the phase's planned
+ * length, so the timeline can be redrawn every frame while the driver only reports phase
+ * transitions. A report always wins over the extrapolation; rows that are not running
+ * show exactly what was reported.
+ */
+class PhaseClock : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
+
+public:
+    explicit PhaseClock(ProtoTableModel *model, QObject *parent = nullptr);
+
+    /// True while at least one row is running, i.e. while the values move on their own
+    bool isActive() const;
+
+    /// Seconds into the current repeat's condition phase
+    Q_INVOKABLE double conditionElapsed(int row) const;
+    /// Seconds into the current repeat's execution phase
+    Q_INVOKABLE double regimeElapsed(int row) const;
+    /// Seconds passed in the whole program, the getTotalElapsedTime() counterpart
+    Q_INVOKABLE double totalElapsed() const;
+
+    /// Replaces the monotonic clock (milliseconds); used by tests
+    void setClock(std::function<qint64()> clock);
+
+signals:
+    void activeChanged();
+
+private:
+    // What was last reported for one running row and when
+    struct RowState {
+        bool running = false;
+        bool execution = false;     // Phase the report belongs to
+        int currentRepeat = 0;
+        int conditionPassed = 0;    // Reported seconds into each phase, valid at reportedAt
+        int regimePassed = 0;
+        int limit = 0;              // Planned length of the current phase in seconds
+        qint64 reportedAt = 0;
+    };
+    // Followed through inserts, removals and moves, so edits around it keep its stamp
+    struct RunningRow {
+        QPersistentModelIndex index;
+        RowState state;
+    };
+
+    void rebuild();
+    void updateRows(int first, int last, const QList<int> &roles);
+    void updateRunning(int row, const Regime &regime, const QList<int> &roles, qint64 time);
+    void applyRow(RowState &cached, const Regime &regime, const QList<int> &roles, qint64 time);
+    const RowState *runningState(int row) const;
+    double extrapolated(const RowState &cached) const;
+    qint64 now() const;
+
+    ProtoTableModel *m_model = nullptr;
+    QList<RunningRow> m_running;
+    QList<int> m_timePassed;        // Reported seconds of every row, re-read on structural changes
+    qint64 m_totalTimePassed = 0;   // Sum of m_timePassed
+    QElapsedTimer m_elapsed;
+    std::function<qint64()> m_clock;
+};
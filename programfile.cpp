@@ -0,0 +1,284 @@
+#include "programfile.h"
+#include "edithistory.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+namespace {
+
+// Version 2 added the enclosing levels of nested cycles to every row
+constexpr char JournalMagic[4] = {'G', 'R', 'J', '2'};
+
+enum RecordType : quint8 {
+    BaseRecord = 1,     // u32 count, count rows
+    SetRecord = 2,      // u32 row, row
+    ResizeRecord = 3    // u32 count
+};
+
+void writeRow(QDataStream &stream, const Regime &regime)
+{
+    stream << regime.m_name << regime.m_condition.type << regime.m_condition.temp
+           << qint32(regime.m_condition.time) << qint32(regime.m_repeatCount) << qint32(regime.m_maxTime)
+           << qint32(regime.m_cycleId) << qint32(regime.m_cycleRepeat);
+    stream << quint32(regime.m_outerCycles.count());
+    for (const CycleLevel &level : regime.m_outerCycles)
+        stream << qint32(level.id) << qint32(level.repeat);
+}
+
+Regime readRow(QDataStream &stream)
+{
+    Regime regime;
+    qint32 time = 0, repeatCount = 0, maxTime = 0, cycleId = 0, cycleRepeat = 0;
+    stream >> regime.m_name >> regime.m_condition.type >> regime.m_condition.temp
+           >> time >> repeatCount >> maxTime >> cycleId >> cycleRepeat;
+    regime.m_condition.time = time;
+    regime.m_repeatCount = repeatCount;
+    regime.m_maxTime = maxTime;
+    regime.m_cycleId = cycleId;
+    regime.m_cycleRepeat = cycleRepeat;
+
+    quint32 levels = 0;
+    stream >> levels;
+    for (quint32 i = 0; i < levels && stream.status() == QDataStream::Ok; ++i) {
+        qint32 id = 0, repeat = 0;
+        stream >> id >> repeat;
+        regime.m_outerCycles.append({id, repeat});
+    }
+    return regime;
+}
+
+// u32 payload size | u8 type | payload | u16 checksum over type and payload
+void appendRecord(QByteArray &out, RecordType type, const QByteArray &payload)
+{
+    QByteArray body;
+    body.reserve(payload.size() + 1);
+    body.append(char(type));
+    body.append(payload);
+
+    QDataStream stream(&out, QIODevice::WriteOnly | QIODevice::Append);
+    stream << quint32(payload.size());
+    stream.writeRawData(body.constData(), int(body.size()));
+    stream << qChecksum(body);
+}
+
+QByteArray encodeRows(quint32 firstValue, const QList<Regime> &regimes, qsizetype from, qsizetype count)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << firstValue;
+    for (qsizetype i = from; i < from + count; ++i)
+        writeRow(stream, regimes.at(i));
+    return payload;
+}
+
+} // namespace
+
+bool ProgramFile::writeJson(const QList<Regime> &regimes, const QString &filePath)
+{
+    QJsonArray regimesArray;
+    for (const auto &regime : regimes) {
+        regimesArray.append(regime.toJson());
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Couldn't open file for writing:" << filePath << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(regimesArray).toJson());
+    if (!file.commit()) {
+        qWarning() << "Couldn't save file:" << filePath << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QList<Regime> ProgramFile::readJson(const QString &filePath, bool *ok, QList<ProgramDiagnostic> *diagnostics)
+{
+    if (ok)
+        *ok = false;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Couldn't open file for reading:" << filePath;
+        return {};
+    }
+
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    QList<Regime> regimes;
+    if (diagnostics) {
+        // Converts the rows as part of the validation pass
+        *diagnostics = ProgramValidator::validateJson(doc.array(), &regimes);
+    } else {
+        for (const QJsonValue &value : doc.array()) {
+            regimes.append(Regime::fromJson(value.toObject()));
+        }
+    }
+    if (ok)
+        *ok = doc.isArray();
+    return regimes;
+}
+
+ProgramJournal::ProgramJournal(const QString &filePath)
+    : m_filePath(filePath)
+{
+}
+
+QString ProgramJournal::filePath() const
+{
+    return m_filePath;
+}
+
+void ProgramJournal::setFilePath(const QString &filePath)
+{
+    if (m_filePath == filePath)
+        return;
+    m_filePath = filePath;
+    m_persisted.clear();
+    m_valid = false;
+}
+
+bool ProgramJournal::update(const QList<Regime> &regimes)
+{
+    m_lastWriteSize = 0;
+    if (m_filePath.isEmpty())
+        return false;
+    if (!m_valid || !QFile::exists(m_filePath))
+        return compact(regimes);
+
+    QByteArray records;
+    qsizetype changed = 0;
+    const qsizetype common = qMin(regimes.count(), m_persisted.count());
+    if (regimes.count() != m_persisted.count()) {
+        QByteArray payload;
+        QDataStream(&payload, QIODevice::WriteOnly) << quint32(regimes.count());
+        appendRecord(records, ResizeRecord, payload);
+    }
+    for (qsizetype row = 0; row < regimes.count(); ++row) {
+        if (row < common && EditHistory::sameDefinition(regimes.at(row), m_persisted.at(row)))
+            continue;
+        appendRecord(records, SetRecord, encodeRows(quint32(row), regimes, row, 1));
+        ++changed;
+    }
+    if (records.isEmpty())
+        return true;
+
+    // Rewriting is cheaper than replaying a journal that has outgrown its base
+    if (changed > regimes.count() / 2 || m_fileSize + records.size() > 2 * m_baseSize + 4096)
+        return compact(regimes);
+
+    if (!append(records))
+        return false;
+
+    m_persisted.resize(regimes.count());
+    for (qsizetype row = 0; row < regimes.count(); ++row)
+        m_persisted[row] = EditHistory::definitionOf(regimes.at(row));
+    return true;
+}
+
+bool ProgramJournal::compact(const QList<Regime> &regimes)
+{
+    m_lastWriteSize = 0;
+    QByteArray data(JournalMagic, sizeof(JournalMagic));
+    appendRecord(data, BaseRecord, encodeRows(quint32(regimes.count()), regimes, 0, regimes.count()));
+
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "ProgramJournal: Couldn't write" << m_filePath << file.errorString();
+        m_valid = false;
+        return false;
+    }
+
+    m_persisted.clear();
+    m_persisted.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        m_persisted.append(EditHistory::definitionOf(regime));
+    m_baseSize = data.size();
+    m_fileSize = data.size();
+    m_lastWriteSize = data.size();
+    m_valid = true;
+    return true;
+}
+
+void ProgramJournal::remove()
+{
+    if (!m_filePath.isEmpty())
+        QFile::remove(m_filePath);
+    m_persisted.clear();
+    m_valid = false;
+}
+
+qint64 ProgramJournal::lastWriteSize() const
+{
+    return m_lastWriteSize;
+}
+
+bool ProgramJournal::append(const QByteArray &records)
+{
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(records) != records.size() || !file.flush()) {
+        qWarning() << "ProgramJournal: Couldn't append to" << m_filePath << file.errorString();
+        m_valid = false;
+        return false;
+    }
+    m_fileSize += records.size();
+    m_lastWriteSize = records.size();
+    return true;
+}
+
+bool ProgramJournal::read(const QString &filePath, QList<Regime> &regimes)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray data = file.readAll();
+    if (data.size() < qsizetype(sizeof(JournalMagic)) || !data.startsWith(QByteArray(JournalMagic, sizeof(JournalMagic))))
+        return false;
+
+    QList<Regime> result;
+    bool haveBase = false;
+    qsizetype offset = sizeof(JournalMagic);
+    while (data.size() - offset >= 4 + 1 + 2) {
+        QDataStream header(data.mid(offset, 4));
+        quint32 payloadSize = 0;
+        header >> payloadSize;
+        const qsizetype recordSize = 4 + 1 + qsizetype(payloadSize) + 2;
+        if (data.size() - offset < recordSize)
+            break; // Torn append
+
+        const QByteArray body = data.mid(offset + 4, 1 + payloadSize);
+        QDataStream trailer(data.mid(offset + 4 + 1 + payloadSize, 2));
+        quint16 checksum = 0;
+        trailer >> checksum;
+        if (checksum != qChecksum(body))
+            break;
+
+        const auto type = RecordType(quint8(body.at(0)));
+        QDataStream stream(body.mid(1));
+        stream.setVersion(QDataStream::Qt_6_0);
+        quint32 value = 0;
+        stream >> value;
+        if (type == BaseRecord) {
+            result.clear();
+            result.reserve(value);
+            for (quint32 i = 0; i < value && stream.status() == QDataStream::Ok; ++i)
+                result.append(readRow(stream));
+            haveBase = stream.status() == QDataStream::Ok;
+        } else if (type == ResizeRecord && haveBase) {
+            result.resize(value);
+        } else if (type == SetRecord && haveBase && value < quint32(result.count())) {
+            result[value] = readRow(stream);
+        }
+        offset += recordSize;
+    }
+
+    if (!haveBase)
+        return false;
+    regimes = result;
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include "programvalidator.h"
+#include "regime.h"
+
+/**
+ * @brief Reading and writing program files
+ *
+ * writeJson() goes through QSaveFile: the data is written to a temporary file next to the
+ * target and renamed over it on success, so a crash mid-save never leaves a truncated
+ * program behind.
+ */
+namespace ProgramFile {
+
+bool writeJson(const QList<Regime> &regimes, const QString &filePath);
+/// diagnostics, if given, receives the ProgramValidator report of the file contents
+QList<Regime> readJson(const QString &filePath, bool *ok = nullptr, QList<ProgramDiagnostic> *diagnostics = nullptr);
+
+} // namespace ProgramFile
+
+/**
+ * @brief Append-only binary journal of the program definition, used for autosave
+ *
+ * The file starts with a base record holding every row. update() compares the program with
+ * what was last persisted and appends only set-row and resize records for the rows that
+ * changed, so the cost of an autosave follows the size of the edit, not of the program.
+ * Once the appended records outgrow the base (or most rows changed) the journal is
+ * compacted into a fresh base through QSaveFile. Every record carries a checksum; read()
+ * stops at the first incomplete or damaged record, which is what a crash during an append
+ * leaves behind.
+ *
+ * Only definition fields are stored. Not thread-safe; use from one thread at a time.
+ */
+class ProgramJournal
+{
+public:
+    explicit ProgramJournal(const QString &filePath = QString());
+
+    QString filePath() const;
+    void setFilePath(const QString &filePath);
+
+    /// Brings the journal in line with regimes; returns false on I/O errors
+    bool update(const QList<Regime> &regimes);
+    /// Rewrites the journal as a single base record
+    bool compact(const QList<Regime> &regimes);
+    /// Deletes the journal file
+    void remove();
+
+    /// Bytes written by the last update() or compact()
+    qint64 lastWriteSize() const;
+
+    /// Replays a journal; returns false if the file is missing or has no valid base record
+    static bool read(const QString &filePath, QList<Regime> &regimes);
+
+private:
+    bool append(const QByteArray &records);
+
+    QString m_filePath;
+    QList<Regime> m_persisted;
+    qint64 m_baseSize = 0;
+    qint64 m_fileSize = 0;
+    qint64 m_lastWriteSize = 0;
+    bool m_valid = false;
+};
@@ -0,0 +1,147 @@
+#include "programhash.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// Odd multiplier, so every power is invertible modulo 2^64 and no row weight becomes zero
+constexpr quint64 Base = 0x9e3779b97f4a7c15ULL;
+
+quint64 mix(quint64 value)
+{
+    // splitmix64 finalizer
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+quint64 combine(quint64 seed, quint64 value)
+{
+    return mix(seed ^ (value + Base));
+}
+
+quint64 hashString(const QString &text)
+{
+    // FNV-1a over UTF-16 code units; stable across runs, unlike the seeded qHash
+    quint64 hash = 0xcbf29ce484222325ULL;
+    for (const QChar ch : text) {
+        hash ^= ch.unicode();
+        hash *= 0x100000001b3ULL;
+    }
+    return combine(hash, quint64(text.size()));
+}
+
+} // namespace
+
+quint64 ProgramHash::rowHash(const Regime &regime)
+{
+    quint64 hash = hashString(regime.m_name);
+    hash = combine(hash, hashString(regime.m_condition.type));
+    // +0.0 so that -0.0 and 0.0, which compare equal, also hash equal
+    hash = combine(hash, std::bit_cast<quint64>(regime.m_condition.temp + 0.0));
+    hash = combine(hash, quint64(regime.m_condition.time));
+    hash = combine(hash, quint64(regime.m_repeatCount));
+    hash = combine(hash, quint64(regime.m_maxTime));
+    hash = combine(hash, quint64(regime.m_cycleId));
+    hash = combine(hash, quint64(regime.m_cycleRepeat));
+    for (const CycleLevel &level : regime.m_outerCycles) {
+        hash = combine(hash, quint64(level.id));
+        hash = combine(hash, quint64(level.repeat));
+    }
+    return hash;
+}
+
+quint64 ProgramHash::of(const QList<Regime> &regimes)
+{
+    ProgramHash hash;
+    hash.reset(regimes);
+    return hash.value();
+}
+
+void ProgramHash::reset(const QList<Regime> &regimes)
+{
+    m_rows.clear();
+    m_rows.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        m_rows.append(rowHash(regime));
+    m_value = 0;
+    reweigh(0);
+}
+
+void ProgramHash::update(int row, const Regime &regime)
+{
+    if (row < 0 || row >= m_rows.count())
+        return;
+    const quint64 hash = rowHash(regime);
+    m_value += (hash - m_rows.at(row)) * power(row);
+    m_rows[row] = hash;
+}
+
+void ProgramHash::insert(int row, const QList<Regime> &regimes)
+{
+    row = qBound(0, row, int(m_rows.count()));
+    QList<quint64> hashes;
+    hashes.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        hashes.append(rowHash(regime));
+
+    for (int i = row; i < m_rows.count(); ++i)
+        m_value -= m_rows.at(i) * power(i);
+    m_rows.insert(row, hashes.count(), 0);
+    std::copy(hashes.cbegin(), hashes.cend(), m_rows.begin() + row);
+    reweigh(row);
+}
+
+void ProgramHash::remove(int row, int count)
+{
+    if (row < 0 || count <= 0 || row + count > m_rows.count())
+        return;
+    for (int i = row; i < m_rows.count(); ++i)
+        m_value -= m_rows.at(i) * power(i);
+    m_rows.remove(row, count);
+    reweigh(row);
+}
+
+void ProgramHash::move(int sourceRow, int count, int destinationChild)
+{
+    if (sourceRow < 0 || count <= 0 || sourceRow + count > m_rows.count())
+        return;
+    const int first = qMin(sourceRow, destinationChild);
+    for (int i = first; i < m_rows.count(); ++i)
+        m_value -= m_rows.at(i) * power(i);
+
+    const QList<quint64> moved = m_rows.mid(sourceRow, count);
+    m_rows.remove(sourceRow, count);
+    const int insertPos = sourceRow < destinationChild ? destinationChild - count : destinationChild;
+    m_rows.insert(insertPos, count, 0);
+    std::copy(moved.cbegin(), moved.cend(), m_rows.begin() + insertPos);
+    reweigh(first);
+}
+
+quint64 ProgramHash::value() const
+{
+    return m_value;
+}
+
+int ProgramHash::count() const
+{
+    return int(m_rows.count());
+}
+
+quint64 ProgramHash::power(int row)
+{
+    // Powers are cached and only ever grow, so structural edits never recompute them
+    while (m_powers.count() <= row)
+        m_powers.append(m_powers.last() * Base);
+    return m_powers.at(row);
+}
+
+void ProgramHash::reweigh(int from)
+{
+    // Adds the terms of rows [from, end) back; callers have subtracted their old terms
+    for (int i = from; i < m_rows.count(); ++i)
+        m_value += m_rows.at(i) * power(i);
+}
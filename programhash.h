@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QList>
+#include "regime.h"
+
+/**
+ * @brief 64-bit content hash of a program definition
+ *
+ * Each row is hashed over its definition fields only (name, condition, repeats, max time,
+ * cycle membership), so execution progress never changes the result. The program hash is
+ * the polynomial sum of the row hashes, h0 + h1*B + h2*B^2 + ... modulo 2^64, which keeps
+ * it order-sensitive while letting a single row edit be applied in O(1) by swapping that
+ * row's term. Inserts, removes and moves re-weight only the rows after the edit point.
+ *
+ * Equal programs always hash equal; different programs collide with negligible
+ * probability, which is good enough for dirty tracking and change detection.
+ */
+class ProgramHash
+{
+public:
+    /// Hash of one row's definition fields
+    static quint64 rowHash(const Regime &regime);
+    /// Hash of a whole program, same value as a ProgramHash reset() to it
+    static quint64 of(const QList<Regime> &regimes);
+
+    void reset(const QList<Regime> &regimes);
+    void update(int row, const Regime &regime);
+    void insert(int row, const QList<Regime> &regimes);
+    void remove(int row, int count);
+    /// Same semantics as QAbstractItemModel::moveRows
+    void move(int sourceRow, int count, int destinationChild);
+
+    quint64 value() const;
+    int count() const;
+
+private:
+    quint64 power(int row);
+    void reweigh(int from);
+
+    QList<quint64> m_rows;
+    QList<quint64> m_powers{1};
+    quint64 m_value = 0;
+};
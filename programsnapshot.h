@@ -0,0 +1,123 @@
+#pragma once
+
+#include <QList>
+#include <QSet>
+#include <iterator>
+#include <memory>
+#include "regime.h"
+
+/**
+ * @brief Rows of a snapshot, held in implicitly shared chunks of ChunkRows rows
+ *
+ * A new snapshot copies only the chunks whose rows changed and shares every other chunk
+ * with the snapshot before it. The chunks never share storage with the model's live rows,
+ * so the model can keep writing its rows in place.
+ */
+class SnapshotRows
+{
+public:
+    static constexpr int ChunkRows = 256;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Regime;
+        using difference_type = qsizetype;
+        using pointer = const Regime *;
+        using reference = const Regime &;
+
+        const_iterator() = default;
+        const_iterator(const SnapshotRows *rows, qsizetype row) : m_rows(rows), m_row(row) {}
+
+        const Regime &operator*() const { return m_rows->at(m_row); }
+        const Regime *operator->() const { return &m_rows->at(m_row); }
+        const_iterator &operator++() { ++m_row; return *this; }
+        const_iterator operator++(int) { const_iterator previous = *this; ++m_row; return previous; }
+        bool operator==(const const_iterator &other) const { return m_row == other.m_row; }
+        bool operator!=(const const_iterator &other) const { return m_row != other.m_row; }
+
+    private:
+        const SnapshotRows *m_rows = nullptr;
+        qsizetype m_row = 0;
+    };
+
+    SnapshotRows() = default;
+
+    /// Copies every row of regimes
+    explicit SnapshotRows(const QList<Regime> &regimes)
+        : m_count(regimes.count())
+    {
+        m_chunks.reserve(chunkCount(m_count));
+        for (qsizetype chunk = 0; chunk < chunkCount(m_count); ++chunk)
+            m_chunks.append(copyChunk(regimes, chunk));
+    }
+
+    /**
+     * @brief These rows with the chunks in dirtyChunks copied again from regimes
+     *
+     * regimes must have as many rows as this; the other chunks are shared, not copied.
+     */
+    SnapshotRows updated(const QList<Regime> &regimes, const QSet<qsizetype> &dirtyChunks) const
+    {
+        Q_ASSERT(regimes.count() == m_count);
+        SnapshotRows rows = *this;
+        for (qsizetype chunk : dirtyChunks) {
+            if (chunk < rows.m_chunks.count())
+                rows.m_chunks[chunk] = copyChunk(regimes, chunk);
+        }
+        return rows;
+    }
+
+    qsizetype count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    const Regime &at(qsizetype row) const { return m_chunks.at(row / ChunkRows).at(row % ChunkRows); }
+
+    /// Rows row / ChunkRows * ChunkRows onwards, at most ChunkRows of them
+    const QList<Regime> &chunkOf(qsizetype row) const { return m_chunks.at(row / ChunkRows); }
+
+    /// Flat copy of the rows; shares their strings, copies the row structs
+    QList<Regime> toList() const
+    {
+        QList<Regime> regimes;
+        regimes.reserve(m_count);
+        for (const QList<Regime> &chunk : m_chunks)
+            regimes.append(chunk);
+        return regimes;
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_count); }
+
+private:
+    static qsizetype chunkCount(qsizetype rows) { return (rows + ChunkRows - 1) / ChunkRows; }
+
+    // Always a new buffer: QList::mid() would share a chunk spanning the whole list
+    static QList<Regime> copyChunk(const QList<Regime> &regimes, qsizetype chunk)
+    {
+        const qsizetype first = chunk * ChunkRows;
+        const qsizetype last = qMin(first + ChunkRows, regimes.count());
+        return QList<Regime>(regimes.cbegin() + first, regimes.cbegin() + last);
+    }
+
+    QList<QList<Regime>> m_chunks;
+    qsizetype m_count = 0;
+};
+
+/**
+ * @brief Immutable copy of the program published by ProtoTableModel
+ *
+ * Snapshots are never modified after publication, so any thread may read one without
+ * locking for as long as it holds the pointer. The GUI thread keeps editing and
+ * updating progress in the live model meanwhile; a newer snapshot is published with a
+ * higher version once those changes are committed.
+ */
+struct ProgramSnapshot {
+    // Increases with every publication; 0 only for the empty initial snapshot
+    quint64 version = 0;
+    SnapshotRows regimes;
+    // ProgramHash of the definition; equal hashes mean equal programs
+    quint64 definitionHash = 0;
+};
+
+using ProgramSnapshotPtr = std::shared_ptr<const ProgramSnapshot>;
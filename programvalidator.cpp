@@ -0,0 +1,315 @@
+#include "programvalidator.h"
+#include <QHash>
+#include <QJsonObject>
+#include <QtNumeric>
+#include <algorithm>
+#include <cmath>
+#include "parallelchunks.h"
+
+namespace {
+
+using Severity = ProgramDiagnostic::Severity;
+using Code = ProgramDiagnostic::Code;
+
+constexpr int ChunkSize = 16384;
+
+/// What one chunk has seen of a cycle, merged across chunks in row order
+struct CycleSummary {
+    int first = -1;
+    int last = -1;
+    int rows = 0;
+    int repeat = 1;             // As stored on the first row
+    int parent = -1;            // Enclosing cycle on the first row
+    int repeatMismatchRow = -1;
+    int nestingMismatchRow = -1;
+};
+
+struct ChunkResult {
+    QList<ProgramDiagnostic> diagnostics;
+    QHash<int, CycleSummary> cycles;
+    qint64 totalSeconds = 0;
+    int overflowRow = -1;
+};
+
+void report(ChunkResult &result, Severity severity, Code code, int row, const QString &field, const QString &message)
+{
+    ProgramDiagnostic diagnostic;
+    diagnostic.severity = severity;
+    diagnostic.code = code;
+    diagnostic.row = row;
+    diagnostic.field = field;
+    diagnostic.message = message;
+    result.diagnostics.append(diagnostic);
+}
+
+void addSeconds(ChunkResult &result, qint64 seconds, int row)
+{
+    if (result.overflowRow == -1 && qAddOverflow(result.totalSeconds, seconds, &result.totalSeconds))
+        result.overflowRow = row;
+}
+
+void checkCycles(const Regime &regime, int row, ChunkResult &result)
+{
+    int parent = -1;
+    const int depth = regime.cycleDepth();
+    for (int level = 0; level < depth; ++level) {
+        const bool outer = level < regime.m_outerCycles.count();
+        const int id = outer ? regime.m_outerCycles.at(level).id : regime.m_cycleId;
+        const int repeat = outer ? regime.m_outerCycles.at(level).repeat : regime.m_cycleRepeat;
+
+        auto it = result.cycles.find(id);
+        if (it == result.cycles.end()) {
+            CycleSummary summary;
+            summary.first = summary.last = row;
+            summary.rows = 1;
+            summary.repeat = repeat;
+            summary.parent = parent;
+            result.cycles.insert(id, summary);
+        } else {
+            CycleSummary &summary = it.value();
+            summary.last = row;
+            ++summary.rows;
+            if (summary.repeat != repeat && summary.repeatMismatchRow == -1)
+                summary.repeatMismatchRow = row;
+            if (summary.parent != parent && summary.nestingMismatchRow == -1)
+                summary.nestingMismatchRow = row;
+        }
+        parent = id;
+    }
+}
+
+void checkRow(const Regime &regime, int row, ChunkResult &result)
+{
+    if (regime.m_name.trimmed().isEmpty())
+        report(result, Severity::Warning, Code::EmptyName, row, "name", QStringLiteral("Режим без названия"));
+    if (regime.m_repeatCount < 1 || regime.m_repeatCount > ProgramValidator::MaxRepeatCount) {
+        report(result, Severity::Error, Code::RepeatCountOutOfRange, row, "repeat",
+               QStringLiteral("Число повторов %1 вне диапазона 1..%2").arg(regime.m_repeatCount).arg(ProgramValidator::MaxRepeatCount));
+    }
+    if (regime.m_maxTime < 1 || regime.m_maxTime > ProgramValidator::MaxTimeSeconds) {
+        report(result, Severity::Error, Code::MaxTimeOutOfRange, row, "max_time",
+               QStringLiteral("Макс. время %1 с вне диапазона 1..%2 с").arg(regime.m_maxTime).arg(ProgramValidator::MaxTimeSeconds));
+    }
+
+    const Condition &condition = regime.m_condition;
+    if (condition.type == "time" || condition.type == "temp") {
+        if (condition.time < 0) {
+            report(result, Severity::Error, Code::ConditionTimeOutOfRange, row, "condition.time",
+                   QStringLiteral("Отрицательное время условия: %1 мин").arg(condition.time));
+        } else if (condition.time == 0 && condition.type == "time") {
+            report(result, Severity::Warning, Code::ConditionTimeOutOfRange, row, "condition.time",
+                   QStringLiteral("Условие по времени без времени ожидания"));
+        }
+    } else if (condition.type == "none") {
+        if (condition.time != 0 || condition.temp != 0.0) {
+            report(result, Severity::Warning, Code::ConditionFieldIgnored, row, "condition",
+                   QStringLiteral("Время и температура не используются без условия"));
+        }
+    } else {
+        report(result, Severity::Error, Code::UnknownConditionType, row, "condition.type",
+               QStringLiteral("Неизвестный тип условия \"%1\"").arg(condition.type));
+    }
+
+    if (regime.m_cycleId != -1)
+        checkCycles(regime, row, result);
+
+    // Planned seconds of the row over all its repeats and cycle passes
+    qint64 seconds = qint64(qMax(regime.conditionTimeInSeconds(), 0)) + qMax(regime.m_maxTime, 0);
+    bool overflow = qMulOverflow(seconds, qint64(qMax(regime.m_repeatCount, 0)), &seconds);
+    if (regime.m_cycleId != -1) {
+        overflow |= qMulOverflow(seconds, qint64(qMax(regime.m_cycleRepeat, 0)), &seconds);
+        for (const CycleLevel &level : regime.m_outerCycles)
+            overflow |= qMulOverflow(seconds, qint64(qMax(level.repeat, 0)), &seconds);
+    }
+    if (overflow) {
+        if (result.overflowRow == -1)
+            result.overflowRow = row;
+        return;
+    }
+    addSeconds(result, seconds, row);
+}
+
+/// Integral JSON number; missing keys are left to the range checks on the converted row
+void checkInteger(const QJsonObject &object, const QString &key, int row, const QString &field, ChunkResult &result)
+{
+    const QJsonValue value = object.value(key);
+    if (value.isUndefined() || (value.isDouble() && std::trunc(value.toDouble()) == value.toDouble()))
+        return;
+    report(result, Severity::Error, Code::InvalidJson, row, field, QStringLiteral("Поле \"%1\" должно быть целым числом").arg(field));
+}
+
+void checkJsonRow(const QJsonValue &value, int row, ChunkResult &result)
+{
+    if (!value.isObject()) {
+        report(result, Severity::Error, Code::InvalidJson, row, QString(), QStringLiteral("Строка программы должна быть объектом"));
+        return;
+    }
+    const QJsonObject object = value.toObject();
+    if (object.contains("name") && !object.value("name").isString())
+        report(result, Severity::Error, Code::InvalidJson, row, "name", QStringLiteral("Название должно быть строкой"));
+    checkInteger(object, "repeat", row, "repeat", result);
+    checkInteger(object, "max_time", row, "max_time", result);
+
+    const QJsonValue conditionValue = object.value("condition");
+    if (conditionValue.isObject()) {
+        const QJsonObject condition = conditionValue.toObject();
+        // Condition::fromJson() turns anything it does not know into "none"; only a missing or empty type means that
+        const QJsonValue type = condition.value("type");
+        if (!type.isUndefined() && !type.isString()) {
+            report(result, Severity::Error, Code::InvalidJson, row, "condition.type", QStringLiteral("Тип условия должен быть строкой"));
+        } else if (!type.toString().isEmpty() && type.toString() != "none" && type.toString() != "time" && type.toString() != "temp") {
+            report(result, Severity::Error, Code::UnknownConditionType, row, "condition.type",
+                   QStringLiteral("Неизвестный тип условия \"%1\"").arg(type.toString()));
+        }
+        checkInteger(condition, "time", row, "condition.time", result);
+        if (condition.contains("temp") && !condition.value("temp").isDouble())
+            report(result, Severity::Error, Code::InvalidJson, row, "condition.temp", QStringLiteral("Температура должна быть числом"));
+    } else if (!conditionValue.isUndefined() && !conditionValue.isNull()) {
+        report(result, Severity::Error, Code::InvalidJson, row, "condition", QStringLiteral("Условие должно быть объектом"));
+    }
+
+    const QJsonValue cycleValue = object.value("cycle");
+    if (cycleValue.isObject()) {
+        const QJsonObject cycle = cycleValue.toObject();
+        checkInteger(cycle, "id", row, "cycle.id", result);
+        checkInteger(cycle, "cycleRepeat", row, "cycle.cycleRepeat", result);
+        const QJsonValue outer = cycle.value("outer");
+        if (!outer.isUndefined() && !outer.isArray())
+            report(result, Severity::Error, Code::InvalidJson, row, "cycle.outer", QStringLiteral("Внешние циклы должны быть списком"));
+        for (const QJsonValue &level : outer.toArray()) {
+            if (!level.isObject()) {
+                report(result, Severity::Error, Code::InvalidJson, row, "cycle.outer", QStringLiteral("Внешний цикл должен быть объектом"));
+                continue;
+            }
+            checkInteger(level.toObject(), "id", row, "cycle.outer.id", result);
+            checkInteger(level.toObject(), "cycleRepeat", row, "cycle.outer.cycleRepeat", result);
+        }
+    } else if (!cycleValue.isUndefined() && !cycleValue.isNull()) {
+        report(result, Severity::Error, Code::InvalidJson, row, "cycle", QStringLiteral("Цикл должен быть объектом или null"));
+    }
+}
+
+int chunkCountFor(qsizetype rows)
+{
+    return int((rows + ChunkSize - 1) / ChunkSize);
+}
+
+void sortByRow(QList<ProgramDiagnostic> &diagnostics)
+{
+    std::stable_sort(diagnostics.begin(), diagnostics.end(), [](const ProgramDiagnostic &a, const ProgramDiagnostic &b) {
+        return a.row < b.row;
+    });
+}
+
+} // namespace
+
+namespace ProgramValidator {
+
+QList<ProgramDiagnostic> validate(const QList<Regime> &regimes, QThreadPool *pool)
+{
+    const int chunkCount = chunkCountFor(regimes.count());
+    QList<ChunkResult> chunks(chunkCount);
+    ChunkResult *results = chunks.data();
+    runParallelChunks(chunkCount, [&regimes, results](int chunk) {
+        const int first = chunk * ChunkSize;
+        const int end = int(qMin<qsizetype>(first + ChunkSize, regimes.count()));
+        for (int row = first; row < end; ++row)
+            checkRow(regimes.at(row), row, results[chunk]);
+    }, pool);
+
+    // Chunks are merged in row order, so the first row recorded for a problem is the earliest
+    ChunkResult merged;
+    QList<int> cycleOrder;
+    for (int index = 0; index < chunkCount; ++index) {
+        ChunkResult &chunk = results[index];
+        merged.diagnostics.append(std::move(chunk.diagnostics));
+        if (merged.overflowRow == -1) {
+            if (chunk.overflowRow != -1)
+                merged.overflowRow = chunk.overflowRow;
+            else if (qAddOverflow(merged.totalSeconds, chunk.totalSeconds, &merged.totalSeconds))
+                merged.overflowRow = index * ChunkSize;
+        }
+        for (auto it = chunk.cycles.cbegin(); it != chunk.cycles.cend(); ++it) {
+            const CycleSummary &part = it.value();
+            auto found = merged.cycles.find(it.key());
+            if (found == merged.cycles.end()) {
+                merged.cycles.insert(it.key(), part);
+                cycleOrder.append(it.key());
+                continue;
+            }
+            CycleSummary &summary = found.value();
+            summary.last = part.last;
+            summary.rows += part.rows;
+            if (summary.repeatMismatchRow == -1)
+                summary.repeatMismatchRow = part.repeat != summary.repeat ? part.first : part.repeatMismatchRow;
+            if (summary.nestingMismatchRow == -1)
+                summary.nestingMismatchRow = part.parent != summary.parent ? part.first : part.nestingMismatchRow;
+        }
+    }
+
+    for (int id : std::as_const(cycleOrder)) {
+        const CycleSummary &summary = merged.cycles.value(id);
+        if (summary.repeat < 1 || summary.repeat > MaxRepeatCount) {
+            report(merged, Severity::Error, Code::CycleRepeatOutOfRange, summary.first, "cycle.cycleRepeat",
+                   QStringLiteral("Число повторов цикла %1 вне диапазона 1..%2").arg(summary.repeat).arg(MaxRepeatCount));
+        }
+        if (summary.repeatMismatchRow != -1) {
+            report(merged, Severity::Error, Code::CycleRepeatMismatch, summary.repeatMismatchRow, "cycle.cycleRepeat",
+                   QStringLiteral("Строки цикла %1 расходятся в числе его повторов").arg(id));
+        }
+        if (summary.nestingMismatchRow != -1) {
+            report(merged, Severity::Error, Code::CycleNestingMismatch, summary.nestingMismatchRow, "cycle.outer",
+                   QStringLiteral("Строки цикла %1 расходятся во внешнем цикле").arg(id));
+        }
+        if (summary.last - summary.first + 1 != summary.rows) {
+            report(merged, Severity::Error, Code::CycleSplit, summary.first, "cycle.id",
+                   QStringLiteral("Строки цикла %1 идут не подряд (строки %2–%3)").arg(id).arg(summary.first).arg(summary.last));
+        }
+    }
+
+    if (merged.overflowRow != -1 || merged.totalSeconds > MaxTotalSeconds) {
+        report(merged, Severity::Error, Code::TotalTimeOverflow, -1, QString(),
+               QStringLiteral("Общее время программы превышает %1 с").arg(MaxTotalSeconds));
+    }
+
+    sortByRow(merged.diagnostics);
+    return merged.diagnostics;
+}
+
+QList<ProgramDiagnostic> validateJson(const QJsonArray &program, QList<Regime> *regimes, QThreadPool *pool)
+{
+    const int chunkCount = chunkCountFor(program.count());
+    QList<ChunkResult> chunks(chunkCount);
+    QList<Regime> converted(program.count());
+    // Workers write through plain pointers; the lists are detached once here
+    ChunkResult *results = chunks.data();
+    Regime *rows = converted.data();
+    runParallelChunks(chunkCount, [&program, results, rows](int chunk) {
+        const int first = chunk * ChunkSize;
+        const int end = int(qMin<qsizetype>(first + ChunkSize, program.count()));
+        for (int row = first; row < end; ++row) {
+            const QJsonValue value = program.at(row);
+            checkJsonRow(value, row, results[chunk]);
+            rows[row] = Regime::fromJson(value.toObject());
+        }
+    }, pool);
+
+    QList<ProgramDiagnostic> diagnostics;
+    for (ChunkResult &chunk : chunks)
+        diagnostics.append(std::move(chunk.diagnostics));
+    diagnostics.append(validate(converted, pool));
+    sortByRow(diagnostics);
+
+    if (regimes)
+        *regimes = std::move(converted);
+    return diagnostics;
+}
+
+bool hasErrors(const QList<ProgramDiagnostic> &diagnostics)
+{
+    return std::any_of(diagnostics.cbegin(), diagnostics.cend(), [](const ProgramDiagnostic &diagnostic) {
+        return diagnostic.isError();
+    });
+}
+
+} // namespace ProgramValidator
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QJsonArray>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QThreadPool>
+#include <limits>
+#include "regime.h"
+
+/// One problem found in a program
+struct ProgramDiagnostic {
+    Q_GADGET
+    Q_PROPERTY(int row MEMBER row)
+    Q_PROPERTY(bool error READ isError)
+    Q_PROPERTY(QString field MEMBER field)
+    Q_PROPERTY(QString message MEMBER message)
+
+public:
+    enum class Severity {
+        Warning,    // The program runs, but probably not as intended
+        Error       // The program must not be run
+    };
+
+    enum class Code {
+        InvalidJson,            // A field has the wrong JSON type and was coerced
+        EmptyName,
+        RepeatCountOutOfRange,
+        MaxTimeOutOfRange,
+        UnknownConditionType,
+        ConditionTimeOutOfRange,
+        ConditionFieldIgnored,  // Time or temperature set on a row without a condition
+        CycleRepeatOutOfRange,
+        CycleRepeatMismatch,    // Rows of one cycle disagree on its repeat count
+        CycleNestingMismatch,   // Rows of one cycle disagree on its enclosing cycle
+        CycleSplit,             // Rows of one cycle are not contiguous
+        TotalTimeOverflow
+    };
+
+    Severity severity = Severity::Error;
+    Code code = Code::InvalidJson;
+    int row = -1;               // -1 for the program as a whole
+    QString field;
+    QString message;
+
+    bool isError() const { return severity == Severity::Error; }
+};
+
+Q_DECLARE_METATYPE(ProgramDiagnostic)
+
+/**
+ * @brief Checks programs against every rule the editor enforces
+ *
+ * Field limits (the same ones setData() applies), condition consistency, cycle contiguity,
+ * nesting and repeat agreement, and the planned total time are checked in one pass over
+ * fixed-size chunks spread across the thread pool. Each chunk also summarises the cycles
+ * it has seen; the summaries are merged in row order, so rules spanning chunks cost
+ * O(cycles) on top of the parallel pass. Diagnostics come back sorted by row.
+ */
+namespace ProgramValidator {
+
+constexpr int MaxRepeatCount = 1000;
+constexpr int MaxTimeSeconds = 86399;
+/// Planned totals are kept in int seconds throughout the application
+constexpr qint64 MaxTotalSeconds = std::numeric_limits<int>::max();
+
+QList<ProgramDiagnostic> validate(const QList<Regime> &regimes, QThreadPool *pool = QThreadPool::globalInstance());
+/// Also reports fields that Regime::fromJson() would silently coerce; regimes receives the converted rows
+QList<ProgramDiagnostic> validateJson(const QJsonArray &program, QList<Regime> *regimes = nullptr,
+                                      QThreadPool *pool = QThreadPool::globalInstance());
+bool hasErrors(const QList<ProgramDiagnostic> &diagnostics);
+
+} // namespace ProgramValidator
@@ -0,0 +1,178 @@
+#include "progressingestor.h"
+#include "regimemanager.h"
+#include <QHash>
+#include <algorithm>
+
+namespace {
+
+bool isProgress(ProgressIngestor::RecordKind kind)
+{
+    return kind == ProgressIngestor::RecordKind::ConditionProgress
+        || kind == ProgressIngestor::RecordKind::RegimeProgress;
+}
+
+} // namespace
+
+ProgressIngestor::ProgressIngestor(RegimeManager *manager, int capacity, QObject *parent)
+    : QObject{parent}
+    , m_manager(manager)
+    , m_queue(size_t(qMax(2, capacity)))
+{
+    m_drainTimer.setSingleShot(true);
+    m_drainTimer.setTimerType(Qt::PreciseTimer);
+    m_drainTimer.setInterval(16);
+    connect(&m_drainTimer, &QTimer::timeout, this, &ProgressIngestor::drain);
+}
+
+bool ProgressIngestor::postConditionProgress(int regimeId, int conditionTimeElapsed, int currentRepeat)
+{
+    return post({RecordKind::ConditionProgress, regimeId, conditionTimeElapsed, currentRepeat});
+}
+
+bool ProgressIngestor::postRegimeProgress(int regimeId, int regimeTimeElapsed, int currentRepeat)
+{
+    return post({RecordKind::RegimeProgress, regimeId, regimeTimeElapsed, currentRepeat});
+}
+
+bool ProgressIngestor::postTransition(RecordKind kind, int regimeId, int currentRepeat)
+{
+    return post({kind, regimeId, 0, currentRepeat});
+}
+
+bool ProgressIngestor::post(const Record &record)
+{
+    if (!m_queue.tryPush(record)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Only the first record after a drain wakes the GUI thread
+    if (!m_wakePending.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, &ProgressIngestor::scheduleDrain, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+int ProgressIngestor::drain()
+{
+    // Cleared before popping: anything pushed from now on schedules another drain
+    m_wakePending.exchange(false, std::memory_order_acq_rel);
+
+    m_batch.clear();
+    const qsizetype limit = qsizetype(m_queue.capacity());
+    Record record;
+    while (m_batch.count() < limit && m_queue.tryPop(record)) {
+        m_batch.append(record);
+    }
+    if (m_batch.isEmpty())
+        return 0;
+
+    int applied = 0;
+    // Newest progress record per (kind, regime) since the last transition
+    QHash<quint64, qsizetype> latest;
+    auto flushProgress = [&]() {
+        QList<qsizetype> indices = latest.values();
+        std::sort(indices.begin(), indices.end());
+        for (qsizetype index : indices) {
+            apply(m_batch.at(index));
+            ++applied;
+        }
+        latest.clear();
+    };
+
+    for (qsizetype i = 0; i < m_batch.count(); ++i) {
+        const Record &current = m_batch.at(i);
+        if (isProgress(current.kind)) {
+            const quint64 key = (quint64(current.kind) << 32) | quint32(current.regimeId);
+            auto it = latest.find(key);
+            if (it != latest.end()) {
+                it.value() = i;
+                ++m_coalesced;
+            } else {
+                latest.insert(key, i);
+            }
+        } else {
+            flushProgress();
+            apply(current);
+            ++applied;
+        }
+    }
+    flushProgress();
+
+    // Hit the per-drain limit; pick up the rest on the next frame
+    if (m_batch.count() == limit)
+        scheduleDrain();
+
+    emit drained(applied);
+    return applied;
+}
+
+quint64 ProgressIngestor::droppedCount() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+quint64 ProgressIngestor::coalescedCount() const
+{
+    return m_coalesced;
+}
+
+quint64 ProgressIngestor::rejectedCount() const
+{
+    return m_rejected;
+}
+
+int ProgressIngestor::drainInterval() const
+{
+    return m_drainTimer.interval();
+}
+
+void ProgressIngestor::setDrainInterval(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (m_drainTimer.interval() != milliseconds) {
+        m_drainTimer.setInterval(milliseconds);
+        emit drainIntervalChanged();
+    }
+}
+
+void ProgressIngestor::scheduleDrain()
+{
+    if (!m_drainTimer.isActive())
+        m_drainTimer.start();
+}
+
+bool ProgressIngestor::apply(const Record &record)
+{
+    bool ok = false;
+    switch (record.kind) {
+    case RecordKind::ConditionProgress:
+        ok = m_manager->updateConditionProgress(record.regimeId, record.value, record.repeat);
+        break;
+    case RecordKind::RegimeProgress:
+        ok = m_manager->updateRegimeProgress(record.regimeId, record.value, record.repeat);
+        break;
+    case RecordKind::StartExecution:
+        ok = m_manager->startRegimeExecution(record.regimeId);
+        break;
+    case RecordKind::ConfirmCondition:
+        ok = m_manager->confirmConditionCompletion(record.regimeId, record.repeat);
+        break;
+    case RecordKind::CompleteRepeat:
+        ok = m_manager->completeCurrentRepeat(record.regimeId, record.repeat);
+        break;
+    case RecordKind::SkipRepeat:
+        ok = m_manager->skipCurrentRepeat(record.regimeId, record.repeat);
+        break;
+    case RecordKind::ErrorRepeat:
+        ok = m_manager->markRepeatAsError(record.regimeId, record.repeat);
+        break;
+    case RecordKind::CompleteRegime:
+        ok = m_manager->completeRegimeExecution(record.regimeId);
+        break;
+    }
+
+    if (!ok)
+        ++m_rejected;
+    return ok;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <atomic>
+#include "mpscringbuffer.h"
+
+class RegimeManager;
+
+/**
+ * @brief Thread-safe entry point for progress reports from acquisition threads
+ *
+ * Producers post fixed-size records into a lock-free ring buffer instead of queuing a
+ * signal (and a heap-allocated event) per update. The GUI thread drains the buffer at
+ * most once per frame and applies the records through the RegimeManager external
+ * module API. Progress records for the same regime and phase are coalesced
+ * (last value wins); transitions such as condition confirmation or repeat completion
+ * are applied in order and act as barriers for the progress posted before them.
+ */
+class ProgressIngestor : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int drainInterval READ drainInterval WRITE setDrainInterval NOTIFY drainIntervalChanged)
+
+public:
+    enum class RecordKind : quint8 {
+        ConditionProgress,
+        RegimeProgress,
+        StartExecution,
+        ConfirmCondition,
+        CompleteRepeat,
+        SkipRepeat,
+        ErrorRepeat,
+        CompleteRegime
+    };
+
+    struct Record {
+        RecordKind kind = RecordKind::ConditionProgress;
+        qint32 regimeId = 0;
+        qint32 value = 0;
+        qint32 repeat = 0;
+    };
+
+    explicit ProgressIngestor(RegimeManager *manager, int capacity = 16384, QObject *parent = nullptr);
+
+    // The post* functions may be called from any thread. They never block and only
+    // fail (returning false) when the queue is full.
+    bool postConditionProgress(int regimeId, int conditionTimeElapsed, int currentRepeat);
+    bool postRegimeProgress(int regimeId, int regimeTimeElapsed, int currentRepeat);
+    bool postTransition(RecordKind kind, int regimeId, int currentRepeat);
+    bool post(const Record &record);
+
+    /// Applies everything queued so far; GUI thread only. Returns the number of API calls made
+    int drain();
+
+    /// Records dropped because the queue was full
+    quint64 droppedCount() const;
+    /// Records coalesced away by newer progress for the same regime and phase
+    quint64 coalescedCount() const;
+    /// Records the RegimeManager API refused (wrong repeat, regime not running, ...)
+    quint64 rejectedCount() const;
+
+    int drainInterval() const;
+    void setDrainInterval(int milliseconds);
+
+signals:
+    void drainIntervalChanged();
+    void drained(int applied);
+
+private:
+    void scheduleDrain();
+    bool apply(const Record &record);
+
+    RegimeManager *m_manager = nullptr;
+    MpscRingBuffer<Record> m_queue;
+    QTimer m_drainTimer;
+    std::atomic<bool> m_wakePending{false};
+    std::atomic<quint64> m_dropped{0};
+    quint64 m_coalesced = 0;
+    quint64 m_rejected = 0;
+    QList<Record> m_batch;
+};
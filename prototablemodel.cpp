@@ -1,17 +1,46 @@
 #include "prototablemodel.h"
+#include <QSet>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+bool isRunningState(RegimeEnums::State state)
+{
+    return state != RegimeEnums::State::Waiting &&
+           state != RegimeEnums::State::Skipped &&
+           state != RegimeEnums::State::Done;
+}
+
+} // namespace
 
 void ProtoTableModel::updateCycleIds()
 {
     QMap<int, int> cycleIdMap;
     int nextCycleId = 0;
+    auto renumber = [&](int cycleId) {
+        if (!cycleIdMap.contains(cycleId)) {
+            cycleIdMap[cycleId] = nextCycleId++;
+        }
+        return cycleIdMap[cycleId];
+    };
 
+    // Outer levels first, so enclosing cycles get the lower ids
     for (int i = 0; i < m_regimes.count(); ++i) {
-        if (m_regimes[i].m_cycleId != -1) {
-            if (!cycleIdMap.contains(m_regimes[i].m_cycleId)) {
-                cycleIdMap[m_regimes[i].m_cycleId] = nextCycleId++;
-            }
-            m_regimes[i].m_cycleId = cycleIdMap[m_regimes[i].m_cycleId];
+        Regime &regime = m_regimes[i];
+        if (regime.m_cycleId == -1)
+            continue;
+        bool changed = false;
+        for (CycleLevel &level : regime.m_outerCycles) {
+            const int cycleId = renumber(level.id);
+            changed |= level.id != cycleId;
+            level.id = cycleId;
         }
+        const int cycleId = renumber(regime.m_cycleId);
+        changed |= regime.m_cycleId != cycleId;
+        regime.m_cycleId = cycleId;
+        if (changed)
+            rowDefinitionChanged(i);
     }
 }
 
@@ -19,6 +48,22 @@ ProtoTableModel::ProtoTableModel(QObject *parent)
     : QAbstractTableModel(parent)
 {
     m_columnNames << "Режим" << "Условие" << "Макс. время" << "Состояние";
+    RowRanges::registerConverters();
+
+    m_snapshot.store(std::make_shared<const ProgramSnapshot>());
+    // Every change marks the snapshot stale; a burst of changes is committed once
+    m_snapshotTimer.setSingleShot(true);
+    m_snapshotTimer.setInterval(0);
+    connect(&m_snapshotTimer, &QTimer::timeout, this, &ProtoTableModel::publishSnapshot);
+    connect(this, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                markSnapshotDirty(topLeft.row(), bottomRight.row());
+            });
+    connect(this, &QAbstractItemModel::rowsInserted, this, &ProtoTableModel::markSnapshotStale);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &ProtoTableModel::markSnapshotStale);
+    connect(this, &QAbstractItemModel::rowsMoved, this, &ProtoTableModel::markSnapshotStale);
+    connect(this, &QAbstractItemModel::modelReset, this, &ProtoTableModel::markSnapshotStale);
+    connect(this, &QAbstractItemModel::layoutChanged, this, &ProtoTableModel::markSnapshotStale);
 }
 
 int ProtoTableModel::rowCount(const QModelIndex &parent) const
@@ -37,14 +82,132 @@ int ProtoTableModel::columnCount(const QModelIndex &parent) const
     return m_columnNames.count();
 }
 
+const RoleTable<Regime> &ProtoTableModel::roleTable()
+{
+    using Descriptor = RoleDescriptor<Regime>;
+    static constexpr std::array<Descriptor, 18> descriptors{{
+        {.role = RegimeRole, .name = "regime",
+         .get = [](const QList<Regime> &regimes, qsizetype row) { return QVariant::fromValue(regimes.at(row)); },
+         .set = [](Regime &regime, const QVariant &value) {
+             regime = value.value<Regime>();
+             return true;
+         },
+         .flags = Descriptor::Definition, .dependents = {Qt::DisplayRole, -1}},
+        {.role = ConditionRole, .name = "condition",
+         .get = readMember<&Regime::m_condition>, .set = writeMember<&Regime::m_condition>,
+         .flags = Descriptor::Definition, .dependents = {Qt::DisplayRole, -1}},
+        {.role = RepeatRole, .name = "repeat",
+         .get = [](const QList<Regime> &regimes, qsizetype row) {
+             const Regime &regime = regimes.at(row);
+             return QVariant(regime.m_cycleId != -1 ? regime.m_cycleRepeat : regime.m_repeatCount);
+         },
+         .set = [](Regime &regime, const QVariant &value) {
+             const int repeatValue = value.toInt();
+             // Validate repeat count: must be between 1 and 1000
+             if (repeatValue < 1 || repeatValue > 1000)
+                 return false;
+             (regime.m_cycleId != -1 ? regime.m_cycleRepeat : regime.m_repeatCount) = repeatValue;
+             return true;
+         },
+         .flags = Descriptor::Definition | Descriptor::CycleWide},
+        {.role = MaxTimeRole, .name = "max_time",
+         .get = readMember<&Regime::m_maxTime>,
+         .set = [](Regime &regime, const QVariant &value) {
+             const int maxTimeValue = value.toInt();
+             // Validate max time: must be between 1 second and 23:59:59 (86399 seconds)
+             if (maxTimeValue < 1 || maxTimeValue > 86399)
+                 return false;
+             regime.m_maxTime = maxTimeValue;
+             return true;
+         },
+         .flags = Descriptor::Definition, .dependents = {Qt::DisplayRole, -1}},
+        {.role = CycleRowCountRole, .name = "cycle_row_count",
+         .get = [](const QList<Regime> &regimes, qsizetype row) {
+             const int cycleId = regimes.at(row).m_cycleId;
+             if (cycleId == -1)
+                 return QVariant(1);
+             // Only the first row of a cycle spans it; the others report 0
+             int span = 0;
+             for (qsizetype i = 0; i < regimes.count(); ++i) {
+                 if (regimes.at(i).m_cycleId != cycleId)
+                     continue;
+                 if (i < row)
+                     return QVariant(0);
+                 ++span;
+             }
+             return QVariant(span);
+         }},
+        {.role = CycleStatusRole, .name = "cycle_status",
+         .get = [](const QList<Regime> &regimes, qsizetype row) {
+             const int cycleId = regimes.at(row).m_cycleId;
+             if (cycleId == -1)
+                 return QVariant(0); // Not in a cycle
+             for (qsizetype i = 0; i < row; ++i) {
+                 if (regimes.at(i).m_cycleId == cycleId)
+                     return QVariant(2); // Subsequent row
+             }
+             return QVariant(1); // First row
+         }},
+        {.role = CycleRepeatRole, .name = "cycle_repeat",
+         .get = readMember<&Regime::m_cycleRepeat>,
+         .set = [](Regime &regime, const QVariant &value) {
+             const int cycleRepeatValue = value.toInt();
+             // Validate cycle repeat count: must be between 1 and 1000
+             if (cycleRepeatValue < 1 || cycleRepeatValue > 1000)
+                 return false;
+             regime.m_cycleRepeat = cycleRepeatValue;
+             return true;
+         },
+         .flags = Descriptor::Definition | Descriptor::CycleWide, .dependents = {RepeatRole, -1}},
+        {.role = StateRole, .name = "state",
+         .get = readMember<&Regime::m_state>, .set = writeMember<&Regime::m_state>},
+        {.role = TimePassedInSecondsRole, .name = "time_passed_in_seconds",
+         .get = readMember<&Regime::m_timePassedInSeconds>, .set = writeMember<&Regime::m_timePassedInSeconds>},
+        {.role = RepeatsDoneRole, .name = "repeats_done",
+         .get = readMember<&Regime::m_repeatsDone>, .set = writeMember<&Regime::m_repeatsDone>},
+        {.role = RepeatsSkippedRole, .name = "repeats_skipped",
+         .get = readMember<&Regime::m_repeatsSkipped>, .set = writeMember<&Regime::m_repeatsSkipped>},
+        {.role = RepeatsErrorRole, .name = "repeats_error",
+         .get = readMember<&Regime::m_repeatsError>, .set = writeMember<&Regime::m_repeatsError>},
+        {.role = CycleIdRole, .name = "cycle_id",
+         .get = readMember<&Regime::m_cycleId>},
+        {.role = CurrentRepeatRole, .name = "current_repeat",
+         .get = readMember<&Regime::m_currentRepeat>, .set = writeMember<&Regime::m_currentRepeat>},
+        {.role = ConditionCompletedRole, .name = "condition_completed",
+         .get = readMember<&Regime::m_conditionCompleted>, .set = writeMember<&Regime::m_conditionCompleted>},
+        {.role = ConditionTimePassedRole, .name = "condition_time_passed",
+         .get = readMember<&Regime::m_conditionTimePassed>,
+         .set = [](Regime &regime, const QVariant &value) {
+             regime.m_conditionTimePassed = value.toInt();
+             // Update total time passed
+             regime.m_timePassedInSeconds = regime.m_conditionTimePassed + regime.m_regimeTimePassed;
+             return true;
+         },
+         .dependents = {TimePassedInSecondsRole, -1}},
+        {.role = RegimeTimePassedRole, .name = "regime_time_passed",
+         .get = readMember<&Regime::m_regimeTimePassed>,
+         .set = [](Regime &regime, const QVariant &value) {
+             regime.m_regimeTimePassed = value.toInt();
+             // Update total time passed
+             regime.m_timePassedInSeconds = regime.m_conditionTimePassed + regime.m_regimeTimePassed;
+             return true;
+         },
+         .dependents = {TimePassedInSecondsRole, -1}},
+        {.role = CycleDepthRole, .name = "cycle_depth",
+         .get = [](const QList<Regime> &regimes, qsizetype row) { return QVariant(regimes.at(row).cycleDepth()); }},
+    }};
+    static_assert(RoleTable<Regime>::isContiguous(descriptors), "Role descriptors must follow the Role enum");
+    static constexpr RoleTable<Regime> table(descriptors);
+    return table;
+}
+
 QVariant ProtoTableModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid() || index.row() >= m_regimes.count())
         return QVariant();
 
-    const Regime &regime = m_regimes.at(index.row());
-
     if (role == Qt::DisplayRole) {
+        const Regime &regime = m_regimes.at(index.row());
         switch (index.column()) {
         case 0: return regime.m_name;
         case 1: return QVariant::fromValue(regime.m_condition);
@@ -54,106 +217,8 @@ QVariant ProtoTableModel::data(const QModelIndex &index, int role) const
         }
     }
 
-    if (role == RepeatRole) {
-        if (regime.m_cycleId != -1) {
-            return regime.m_cycleRepeat;
-        }
-        return regime.m_repeatCount;
-    }
-
-    if (role == MaxTimeRole) {
-        return regime.m_maxTime;
-    }
-
-    if (role == ConditionRole) {
-        return QVariant::fromValue(regime.m_condition);
-    }
-
-    if (role == RegimeRole) {
-        return QVariant::fromValue(regime);
-    }
-
-    if (role == CycleRowCountRole) {
-        if (regime.m_cycleId == -1) {
-            return 1;
-        }
-
-        int span = 0;
-        bool first = true;
-        for (int i = 0; i < m_regimes.count(); ++i) {
-            if (m_regimes.at(i).m_cycleId == regime.m_cycleId) {
-                if (i < index.row()) {
-                    first = false;
-                    break;
-                }
-                span++;
-            }
-        }
-
-        return first ? span : 0;
-    }
-
-    if (role == CycleStatusRole) {
-        if (regime.m_cycleId == -1) {
-            return 0; // Not in a cycle
-        }
-
-        bool first = true;
-        for (int i = 0; i < index.row(); ++i) {
-            if (m_regimes.at(i).m_cycleId == regime.m_cycleId) {
-                first = false;
-                break;
-            }
-        }
-
-        return first ? 1 : 2; // 1 for first, 2 for subsequent
-    }
-
-    if (role == CycleRepeatRole) {
-        return regime.m_cycleRepeat;
-    }
-
-    if (role == StateRole) {
-        return QVariant::fromValue(regime.m_state);
-    }
-
-    if (role == TimePassedInSecondsRole) {
-        return regime.m_timePassedInSeconds;
-    }
-
-    if (role == RepeatsDoneRole) {
-        return regime.m_repeatsDone;
-    }
-
-    if (role == RepeatsSkippedRole) {
-        return regime.m_repeatsSkipped;
-    }
-
-    if (role == RepeatsErrorRole) {
-        return regime.m_repeatsError;
-    }
-
-    if (role == CycleIdRole) {
-        return regime.m_cycleId;
-    }
-    
-    if (role == CurrentRepeatRole) {
-        return regime.m_currentRepeat;
-    }
-    
-    if (role == ConditionCompletedRole) {
-        return regime.m_conditionCompleted;
-    }
-    
-    if (role == ConditionTimePassedRole) {
-        return regime.m_conditionTimePassed;
-    }
-    
-    if (role == RegimeTimePassedRole) {
-        return regime.m_regimeTimePassed;
-    }
-
-    return QVariant();
+    const RoleDescriptor<Regime> *descriptor = roleTable().find(role);
+    return descriptor ? descriptor->get(m_regimes, index.row()) : QVariant();
 }
 
 bool ProtoTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
@@ -161,134 +226,48 @@ bool ProtoTableModel::setData(const QModelIndex &index, const QVariant &value, i
     if (!index.isValid() || index.row() >= m_regimes.count()) {
         return false;
     }
-    
-    Regime &regime = m_regimes[index.row()];
 
-    if (role == RepeatRole) {
-        int repeatValue = value.toInt();
-        // Validate repeat count: must be between 1 and 1000
-        if (repeatValue < 1 || repeatValue > 1000) {
+    const RoleDescriptor<Regime> *descriptor = roleTable().find(role);
+    if (!descriptor || !descriptor->set)
+        return false;
+    const bool definition = descriptor->flags & RoleDescriptor<Regime>::Definition;
+
+    // Definition edits from the table go into the undo history as one step each
+    if (definition && !m_history.isRecording()) {
+        beginEdit(QStringLiteral("Изменение"));
+        const bool changed = setData(index, value, role);
+        endEdit();
+        return changed;
+    }
+
+    QList<int> rows{index.row()};
+    const RegimeEnums::State previousState = m_regimes.at(index.row()).m_state;
+    const int cycleId = m_regimes.at(index.row()).m_cycleId;
+    if ((descriptor->flags & RoleDescriptor<Regime>::CycleWide) && cycleId != -1) {
+        // The setter validates and writes the cycle repeat on a copy; every row of the
+        // cycle, including rows of nested cycles that store it as an outer level, takes it
+        Regime edited = m_regimes.at(index.row());
+        if (!descriptor->set(edited, value))
             return false;
-        }
-        
-        if (regime.m_cycleId != -1) {
-            for (int i = 0; i < m_regimes.count(); ++i) {
-                if (m_regimes.at(i).m_cycleId == regime.m_cycleId) {
-                    m_regimes[i].m_cycleRepeat = repeatValue;
-                    emit dataChanged(this->index(i, 0), this->index(i, columnCount() - 1), {RepeatRole});
-                }
-            }
-        } else {
-            regime.m_repeatCount = repeatValue;
-            emit dataChanged(index, index, {RepeatRole});
-        }
-        emit totalTimeChanged();
-        return true;
-    }
-
-    if (role == CycleRepeatRole) {
-        int cycleRepeatValue = value.toInt();
-        // Validate cycle repeat count: must be between 1 and 1000
-        if (cycleRepeatValue < 1 || cycleRepeatValue > 1000) {
+        rows = setCycleRepeat(cycleId, edited.m_cycleRepeat);
+    } else {
+        if (!descriptor->set(m_regimes[index.row()], value))
             return false;
-        }
-        
-        for (int i = 0; i < m_regimes.count(); ++i) {
-            if (m_regimes.at(i).m_cycleId == regime.m_cycleId) {
-                m_regimes[i].m_cycleRepeat = cycleRepeatValue;
-                emit dataChanged(this->index(i, 0), this->index(i, columnCount() - 1), {RepeatRole});
-            }
-        }
-        emit totalTimeChanged();
-        return true;
+        if (definition)
+            rowDefinitionChanged(index.row());
+        else if (!m_cycleTreeDirty)
+            m_cycleTree.updateProgress(index.row(), m_regimes.at(index.row()));
     }
 
-    if (role == MaxTimeRole) {
-        int maxTimeValue = value.toInt();
-        // Validate max time: must be between 1 second and 23:59:59 (86399 seconds)
-        if (maxTimeValue < 1 || maxTimeValue > 86399) {
-            return false;
-        }
-        
-        regime.m_maxTime = maxTimeValue;
-        emit dataChanged(index, index, {role, Qt::DisplayRole});
-        emit totalTimeChanged();
-        return true;
-    }
+    const QList<int> roles = roleTable().changedRoles(role);
+    for (int row : rows)
+        emit dataChanged(this->index(row, 0), this->index(row, columnCount() - 1), roles);
 
-    if (role == ConditionRole) {
-        regime.m_condition = value.value<Condition>();
-        emit dataChanged(index, index, {role, Qt::DisplayRole});
+    if (definition)
         emit totalTimeChanged();
-        return true;
-    }
-
-    if (role == RegimeRole) {
-        m_regimes[index.row()] = value.value<Regime>();
-        emit dataChanged(index, index, {role, Qt::DisplayRole});
-        return true;
-    }
-
-    if (role == StateRole) {
-        regime.m_state = value.value<RegimeEnums::State>();
-        emit dataChanged(this->index(0, 0), this->index(rowCount() - 1, columnCount() - 1), {role});
-        checkAndUpdateRunningState();
-        return true;
-    }
-
-    if (role == TimePassedInSecondsRole) {
-        regime.m_timePassedInSeconds = value.toInt();
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role});
-        return true;
-    }
-
-    if (role == RepeatsDoneRole) {
-        regime.m_repeatsDone = value.toInt();
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role});
-        return true;
-    }
-
-    if (role == RepeatsSkippedRole) {
-        regime.m_repeatsSkipped = value.toInt();
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role});
-        return true;
-    }
-
-    if (role == RepeatsErrorRole) {
-        regime.m_repeatsError = value.toInt();
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role});
-        return true;
-    }
-    
-    if (role == CurrentRepeatRole) {
-        regime.m_currentRepeat = value.toInt();
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role});
-        return true;
-    }
-    
-    if (role == ConditionCompletedRole) {
-        regime.m_conditionCompleted = value.toBool();
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role});
-        return true;
-    }
-    
-    if (role == ConditionTimePassedRole) {
-        regime.m_conditionTimePassed = value.toInt();
-        // Update total time passed
-        regime.m_timePassedInSeconds = regime.m_conditionTimePassed + regime.m_regimeTimePassed;
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role, TimePassedInSecondsRole});
-        return true;
-    }
-    
-    if (role == RegimeTimePassedRole) {
-        regime.m_regimeTimePassed = value.toInt();
-        // Update total time passed
-        regime.m_timePassedInSeconds = regime.m_conditionTimePassed + regime.m_regimeTimePassed;
-        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1), {role, TimePassedInSecondsRole});
-        return true;
-    }
-
-    return false;
+    if (role == StateRole)
+        updateRunningState(index.row(), previousState);
+    return true;
 }
 
 QVariant ProtoTableModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -304,48 +283,32 @@ bool ProtoTableModel::moveRows(const QModelIndex &sourceParent, int sourceRow, i
     if (sourceParent.isValid() || destinationParent.isValid() || sourceRow < 0 || count <= 0 || destinationChild < 0 || sourceRow + count > m_regimes.count() || destinationChild > m_regimes.count())
         return false;
 
-    if (!beginMoveRows(sourceParent, sourceRow, sourceRow + count - 1, destinationParent, destinationChild))
+    // A move into its own range is a no-op that beginMoveRows would reject
+    if (destinationChild >= sourceRow && destinationChild <= sourceRow + count)
         return false;
 
-    QList<Regime> movedItems;
-    for (int i = 0; i < count; ++i) {
-        movedItems.append(m_regimes.takeAt(sourceRow));
-    }
-
-    int insertPos = destinationChild;
-    if (sourceRow < insertPos) {
-        insertPos -= count;
-    }
-
-    for (int i = 0; i < count; ++i) {
-        m_regimes.insert(insertPos + i, movedItems.at(i));
-    }
-
-    endMoveRows();
+    beginEdit(QStringLiteral("Перемещение"));
+    moveBlock(sourceRow, count, destinationChild);
+    m_history.recordMove(sourceRow, count, destinationChild);
     updateCycleIds();
-    emit dataChanged(index(0, 0), index(m_regimes.count() - 1, columnCount() - 1));
+    // Cycle ids are renumbered in row order, so only rows between source and destination change
+    const int first = qMin(sourceRow, destinationChild);
+    const int last = qMax(sourceRow + count, destinationChild) - 1;
+    emit dataChanged(index(first, 0), index(last, columnCount() - 1));
+    checkAndUpdateRunningState();
     emit totalTimeChanged();
+    endEdit();
     return true;
 }
 
 QHash<int, QByteArray> ProtoTableModel::roleNames() const
 {
-    return {
-        { Qt::DisplayRole, "display" },
-        { RegimeRole, "regime" },
-        { ConditionRole, "condition" },
-        { RepeatRole, "repeat" },
-        { MaxTimeRole, "max_time" },
-        { CycleRowCountRole, "cycle_row_count" },
-        { CycleStatusRole, "cycle_status" },
-        { CycleRepeatRole, "cycle_repeat" },
-        { StateRole, "state" },
-        { TimePassedInSecondsRole, "time_passed_in_seconds" },
-        { CurrentRepeatRole, "current_repeat" },
-        { ConditionCompletedRole, "condition_completed" },
-        { ConditionTimePassedRole, "condition_time_passed" },
-        { RegimeTimePassedRole, "regime_time_passed" }
-    };
+    static const QHash<int, QByteArray> names = [] {
+        QHash<int, QByteArray> names = roleTable().roleNames();
+        names.insert(Qt::DisplayRole, "display");
+        return names;
+    }();
+    return names;
 }
 
 Qt::ItemFlags ProtoTableModel::flags(const QModelIndex &index) const
@@ -357,8 +320,14 @@ void ProtoTableModel::setRegimes(const QList<Regime> &regimes)
 {
     beginResetModel();
     m_regimes = regimes;
+    m_definitions.clear();
+    m_definitions.intern(m_regimes);
+    m_hash.reset(m_regimes);
+    m_cycleTreeDirty = true;
     endResetModel();
     checkAndUpdateRunningState();
+    clearHistory();
+    emit definitionChanged();
 }
 
 QList<Regime> ProtoTableModel::getRegimes() const
@@ -366,111 +335,286 @@ QList<Regime> ProtoTableModel::getRegimes() const
     return m_regimes;
 }
 
-void ProtoTableModel::groupRows(QVariantList rows)
+void ProtoTableModel::groupRows(const RowRanges &selection)
 {
-    if (rows.count() < 2) return;
-
-    qDebug() << "groupRows called with rows:" << rows;
+    const RowRanges rows = selection.clipped(m_regimes.count());
+    if (!isSelectionGroupable(rows)) return;
 
     int newCycleId = 0;
     for (const auto &regime : m_regimes) {
-        if (regime.m_cycleId > newCycleId) {
-            newCycleId = regime.m_cycleId;
+        newCycleId = qMax(newCycleId, regime.m_cycleId);
+        for (const CycleLevel &level : regime.m_outerCycles) {
+            newCycleId = qMax(newCycleId, level.id);
         }
     }
     newCycleId++;
 
-    qDebug() << "New cycle ID will be:" << newCycleId;
-    
-    for (const QVariant &rowVariant : rows) {
-        int row = rowVariant.toInt();
-        if (row >= 0 && row < m_regimes.count()) {
-            m_regimes[row].m_cycleId = newCycleId;
-            m_regimes[row].m_cycleRepeat = 1;
-        } else {
-            qWarning() << "groupRows: Invalid row index" << row;
+    beginEdit(QStringLiteral("Группировка"));
+    RowRanges changed;
+    const int parentCycleId = nestingCycle(rows);
+    if (parentCycleId != -1) {
+        // Part of one cycle: the selected rows become a cycle nested in it
+        for (const RowRanges::Range &range : rows.ranges()) {
+            for (int row = range.first; row <= range.last; ++row) {
+                Regime &regime = m_regimes[row];
+                regime.m_outerCycles.append({regime.m_cycleId, regime.m_cycleRepeat});
+                regime.m_cycleId = newCycleId;
+                regime.m_cycleRepeat = 1;
+                rowDefinitionChanged(row);
+            }
+        }
+        changed = rows;
+    } else {
+        // Single rows join the new cycle; selected cycles are wrapped in it as a whole
+        QHash<int, int> wrappedCycles;  // Top-level cycle -> one of its rows
+        for (const RowRanges::Range &range : rows.ranges()) {
+            for (int row = range.first; row <= range.last; ++row) {
+                Regime &regime = m_regimes[row];
+                if (regime.m_cycleId == -1) {
+                    regime.m_cycleId = newCycleId;
+                    regime.m_cycleRepeat = 1;
+                    rowDefinitionChanged(row);
+                    changed.add(row, row);
+                } else {
+                    wrappedCycles.insert(regime.outermostCycleId(), row);
+                }
+            }
+        }
+        for (auto it = wrappedCycles.cbegin(); it != wrappedCycles.cend(); ++it) {
+            const RowRanges::Range span = cycleSpan(it.value(), it.key());
+            for (int row = span.first; row <= span.last; ++row) {
+                m_regimes[row].m_outerCycles.prepend({newCycleId, 1});
+                rowDefinitionChanged(row);
+            }
+            changed.add(span.first, span.last);
         }
     }
 
     updateCycleIds();
-    emit dataChanged(index(0, 0), index(m_regimes.count() - 1, columnCount() - 1), {CycleStatusRole, CycleRowCountRole});
+    for (const RowRanges::Range &range : changed.ranges())
+        emit dataChanged(index(range.first, 0), index(range.last, columnCount() - 1), {CycleStatusRole, CycleRowCountRole, CycleDepthRole});
+    endEdit();
     emit selectionShouldBeCleared();
     emit totalTimeChanged();
 }
 
-void ProtoTableModel::ungroupRows(QVariantList rows)
+void ProtoTableModel::ungroupRows(const RowRanges &selection)
 {
-    if (rows.isEmpty()) return;
-
-    qDebug() << "ungroupRows called with rows:" << rows;
+    const RowRanges rows = selection.clipped(m_regimes.count());
 
+    // Cycles are contiguous, so the rows to rewrite are the spans of the selected cycles
     QSet<int> cyclesToUngroup;
-    for (const QVariant &rowVariant : rows) {
-        int row = rowVariant.toInt();
-        if (row >= 0 && row < m_regimes.count()) {
-            if (m_regimes[row].m_cycleId != -1) {
-                cyclesToUngroup.insert(m_regimes[row].m_cycleId);
-            }
-        } else {
-            qWarning() << "ungroupRows: Invalid row index" << row;
+    RowRanges affected;
+    for (const RowRanges::Range &range : rows.ranges()) {
+        for (int row = range.first; row <= range.last; ++row) {
+            const int cycleId = m_regimes.at(row).m_cycleId;
+            if (cycleId == -1 || cyclesToUngroup.contains(cycleId))
+                continue;
+            cyclesToUngroup.insert(cycleId);
+            const RowRanges::Range span = cycleSpan(row, cycleId);
+            affected.add(span.first, span.last);
         }
     }
 
     if (cyclesToUngroup.isEmpty()) return;
 
-    qDebug() << "Cycles to ungroup:" << cyclesToUngroup;
-
-    for (int i = 0; i < m_regimes.count(); ++i) {
-        if (cyclesToUngroup.contains(m_regimes[i].m_cycleId)) {
-            m_regimes[i].m_cycleId = -1;
-            m_regimes[i].m_repeatCount = 1;
+    // Only the innermost cycle of the selected rows is dissolved; its rows stay in the enclosing one
+    beginEdit(QStringLiteral("Разгруппировка"));
+    for (const RowRanges::Range &range : affected.ranges()) {
+        for (int i = range.first; i <= range.last; ++i) {
+            Regime &regime = m_regimes[i];
+            const qsizetype outerLevels = regime.m_outerCycles.count();
+            regime.m_outerCycles.removeIf([&](const CycleLevel &level) { return cyclesToUngroup.contains(level.id); });
+            bool changed = regime.m_outerCycles.count() != outerLevels;
+            if (cyclesToUngroup.contains(regime.m_cycleId)) {
+                if (regime.m_outerCycles.isEmpty()) {
+                    regime.m_cycleId = -1;
+                } else {
+                    const CycleLevel parent = regime.m_outerCycles.takeLast();
+                    regime.m_cycleId = parent.id;
+                    regime.m_cycleRepeat = parent.repeat;
+                }
+                regime.m_repeatCount = 1;
+                changed = true;
+            }
+            if (changed)
+                rowDefinitionChanged(i);
         }
     }
 
     updateCycleIds();
-    emit dataChanged(index(0, 0), index(m_regimes.count() - 1, columnCount() - 1), {CycleRowCountRole, RepeatRole, CycleRepeatRole, CycleStatusRole});
+    for (const RowRanges::Range &range : affected.ranges())
+        emit dataChanged(index(range.first, 0), index(range.last, columnCount() - 1), {CycleRowCountRole, RepeatRole, CycleRepeatRole, CycleStatusRole, CycleDepthRole});
+    endEdit();
     emit selectionShouldBeCleared();
     emit totalTimeChanged();
 }
 
-QVariantList ProtoTableModel::moveSelection(QVariantList rows, bool up)
+RowRanges ProtoTableModel::moveSelection(const RowRanges &selection, bool up)
 {
+    const RowRanges rows = selection.clipped(m_regimes.count());
     if (rows.isEmpty())
-        return QVariantList();
+        return selection;
 
-    int blockStart = getBlockStart(rows);
-    int blockEnd = getBlockEnd(rows);
-    int count = blockEnd - blockStart + 1;
+    const int blockStart = outerSpan(rows.first()).first;
+    const int blockEnd = outerSpan(rows.last()).last;
+    const int count = blockEnd - blockStart + 1;
 
     int destinationChild;
     if (up) {
-        if (blockStart == 0) return rows; // Cannot move up
-        destinationChild = getBlockStart({blockStart - 1});
+        if (blockStart == 0) return selection; // Cannot move up
+        destinationChild = outerSpan(blockStart - 1).first;
     } else { // Moving down
-        if (blockEnd == m_regimes.count() - 1) return rows; // Cannot move down
-        destinationChild = getBlockEnd({blockEnd + 1}) + 1;
+        if (blockEnd == m_regimes.count() - 1) return selection; // Cannot move down
+        destinationChild = outerSpan(blockEnd + 1).last + 1;
     }
 
-    if (moveRows(QModelIndex(), blockStart, count, QModelIndex(), destinationChild)) {
-        QVariantList newSelection;
-        int newSelectionStart;
-        if (up) {
-            newSelectionStart = destinationChild;
-        } else {
-            newSelectionStart = destinationChild - count;
+    if (!moveRows(QModelIndex(), blockStart, count, QModelIndex(), destinationChild))
+        return selection;
+
+    const int newSelectionStart = up ? destinationChild : destinationChild - count;
+    RowRanges newSelection;
+    newSelection.add(newSelectionStart, newSelectionStart + count - 1);
+    return newSelection;
+}
+
+bool ProtoTableModel::reorderRows(const QList<int> &order)
+{
+    const int count = int(m_regimes.count());
+    if (order.count() != count) {
+        qWarning() << "ProtoTableModel: Reorder needs" << count << "rows, got" << order.count();
+        return false;
+    }
+
+    QList<bool> seen(count, false);
+    int firstMoved = -1;
+    int lastMoved = -1;
+    for (int newRow = 0; newRow < count; ++newRow) {
+        const int row = order.at(newRow);
+        if (row < 0 || row >= count || seen.at(row)) {
+            qWarning() << "ProtoTableModel: Reorder is not a permutation of the rows";
+            return false;
+        }
+        seen[row] = true;
+        if (row == newRow)
+            continue;
+        // A row can only leave its place if another one takes it, so checking targets covers sources too
+        if (newRow <= m_lastNonWaitingRow) {
+            qWarning() << "ProtoTableModel: Cannot reorder rows that have already started";
+            return false;
         }
+        if (firstMoved == -1)
+            firstMoved = newRow;
+        lastMoved = newRow;
+    }
+    if (firstMoved == -1)
+        return true;
+    if (!keepsCyclesContiguous(order)) {
+        qWarning() << "ProtoTableModel: Reorder would split a cycle";
+        return false;
+    }
+
+    beginEdit(QStringLiteral("Перемещение"));
+    permuteRows(order);
+    m_history.recordReorder(order);
+    updateCycleIds();
+    emit dataChanged(index(firstMoved, 0), index(lastMoved, columnCount() - 1));
+    checkAndUpdateRunningState();
+    emit totalTimeChanged();
+    endEdit();
+    return true;
+}
+
+RowRanges ProtoTableModel::moveRowsTo(const RowRanges &selection, int destination)
+{
+    const RowRanges rows = selection.clipped(m_regimes.count());
+    if (rows.isEmpty() || !isSelectionEditable(rows))
+        return selection;
+
+    // Nothing goes in front of a started row, and a drop inside a cycle lands in front of it
+    destination = qBound(m_lastNonWaitingRow + 1, destination, int(m_regimes.count()));
+    if (destination < m_regimes.count()) {
+        const RowRanges::Range span = outerSpan(destination);
+        destination = span.first > m_lastNonWaitingRow ? span.first : span.last + 1;
+    }
+
+    // Selected blocks keep their relative order; so do the blocks left in place
+    const QList<RowRanges::Range> &ranges = rows.ranges();
+    qsizetype nextRange = 0;
+    QList<int> kept;
+    QList<int> moved;
+    kept.reserve(m_regimes.count());
+    qsizetype insertAt = -1;
+    for (const RowRanges::Range &block : topLevelBlocks()) {
+        while (nextRange < ranges.count() && ranges.at(nextRange).last < block.first)
+            ++nextRange;
+        const bool selected = nextRange < ranges.count() && ranges.at(nextRange).first <= block.last;
+        if (block.first == destination)
+            insertAt = kept.count();
+        QList<int> &target = selected ? moved : kept;
+        for (int row = block.first; row <= block.last; ++row)
+            target.append(row);
+    }
+    if (insertAt == -1)
+        insertAt = kept.count();
+
+    const QList<int> order = kept.mid(0, insertAt) + moved + kept.mid(insertAt);
+    if (!reorderRows(order))
+        return selection;
+
+    RowRanges newSelection;
+    newSelection.add(int(insertAt), int(insertAt + moved.count()) - 1);
+    return newSelection;
+}
 
-        for (int i = 0; i < count; ++i) {
-            newSelection.append(newSelectionStart + i);
+bool ProtoTableModel::sortRows(SortKey key, bool ascending)
+{
+    struct Item {
+        RowRanges::Range block;
+        QString name;
+        qint64 duration = 0;
+    };
+
+    // Started rows stay on top in their order; the rest is sorted block by block
+    QList<int> order;
+    order.reserve(m_regimes.count());
+    QList<Item> items;
+    for (const RowRanges::Range &block : topLevelBlocks()) {
+        if (block.first <= m_lastNonWaitingRow) {
+            for (int row = block.first; row <= block.last; ++row)
+                order.append(row);
+            continue;
+        }
+        const Regime &first = m_regimes.at(block.first);
+        Item item;
+        item.block = block;
+        item.name = first.m_name;
+        if (key == SortByDuration) {
+            item.duration = first.m_cycleId == -1 ? cycleTree().rowDuration(block.first)
+                                                  : cycleTree().cycleDuration(first.outermostCycleId());
         }
-        return newSelection;
+        items.append(item);
     }
 
-    return rows;
+    auto less = [key](const Item &a, const Item &b) {
+        if (key == SortByDuration)
+            return a.duration < b.duration;
+        return a.name.localeAwareCompare(b.name) < 0;
+    };
+    std::stable_sort(items.begin(), items.end(), [&](const Item &a, const Item &b) {
+        return ascending ? less(a, b) : less(b, a);
+    });
+
+    for (const Item &item : items) {
+        for (int row = item.block.first; row <= item.block.last; ++row)
+            order.append(row);
+    }
+    return reorderRows(order);
 }
 
 void ProtoTableModel::addRow(const QString &regimeName)
 {
+    beginEdit(QStringLiteral("Добавление"));
     beginInsertRows(QModelIndex(), rowCount(), rowCount());
     Regime newRegime;
     newRegime.m_name = regimeName;
@@ -478,65 +622,62 @@ void ProtoTableModel::addRow(const QString &regimeName)
     newRegime.m_repeatCount = 1;     // Minimum valid repeat count
     newRegime.m_cycleRepeat = 1;     // Minimum valid cycle repeat count
     newRegime.m_maxTime = 60;        // Default to 1 minute (60 seconds)
+    m_definitions.intern(newRegime);
     m_regimes.append(newRegime);
+    m_hash.insert(m_regimes.count() - 1, {newRegime});
+    m_cycleTreeDirty = true;
     endInsertRows();
+    m_history.recordInsert(m_regimes.count() - 1, {newRegime});
     if (rowCount() > 1) {
         emit dataChanged(index(0, 0), index(rowCount() - 2, columnCount() - 1), {CycleStatusRole, CycleRowCountRole});
     }
     checkAndUpdateRunningState();
+    endEdit();
     emit totalTimeChanged();
 }
 
-void ProtoTableModel::deleteRows(QVariantList rows)
+void ProtoTableModel::deleteRows(const RowRanges &selection)
 {
-    if (rows.isEmpty()) return;
-
-    QSet<int> indicesToRemoveSet;
-    for (const QVariant &row : rows) {
-        bool ok;
-        int rowIndex = row.toInt(&ok);
-        if (!ok || rowIndex < 0 || rowIndex >= m_regimes.count()) continue;
-
-        if (m_regimes[rowIndex].m_state != RegimeEnums::State::Waiting) continue;
-
-        if (m_regimes[rowIndex].m_cycleId != -1) {
-            int cycleId = m_regimes[rowIndex].m_cycleId;
-            for (int i = 0; i < m_regimes.count(); ++i) {
-                if (m_regimes[i].m_cycleId == cycleId) {
-                    indicesToRemoveSet.insert(i);
-                }
-            }
-        } else {
-            indicesToRemoveSet.insert(rowIndex);
+    const RowRanges rows = selection.clipped(m_regimes.count());
+
+    // Waiting rows go with their whole innermost cycle
+    RowRanges toRemove;
+    for (const RowRanges::Range &range : rows.ranges()) {
+        for (int row = range.first; row <= range.last; ++row) {
+            const Regime &regime = m_regimes.at(row);
+            if (regime.m_state != RegimeEnums::State::Waiting || toRemove.contains(row)) continue;
+            const RowRanges::Range span = regime.m_cycleId != -1 ? cycleSpan(row, regime.m_cycleId) : RowRanges::Range{row, row};
+            toRemove.add(span.first, span.last);
         }
     }
 
-    QList<int> sortedIndicesToRemove = indicesToRemoveSet.values();
-    std::sort(sortedIndicesToRemove.begin(), sortedIndicesToRemove.end());
-
-    if (sortedIndicesToRemove.isEmpty()) return;
+    if (toRemove.isEmpty()) return;
 
-    int i = sortedIndicesToRemove.count() - 1;
-    while (i >= 0) {
-        int lastRow = sortedIndicesToRemove[i];
-        int firstRow = lastRow;
-        while (i > 0 && sortedIndicesToRemove[i-1] == firstRow - 1) {
-            firstRow--;
-            i--;
-        }
-
-        beginRemoveRows(QModelIndex(), firstRow, lastRow);
-        m_regimes.remove(firstRow, lastRow - firstRow + 1);
-        endRemoveRows();
-
-        i--;
+    beginEdit(QStringLiteral("Удаление"));
+    const QList<RowRanges::Range> &ranges = toRemove.ranges();
+    for (auto it = ranges.crbegin(); it != ranges.crend(); ++it) {
+        removeBlock(it->first, it->count());
+        m_history.recordRemove(it->first, it->count());
     }
 
     updateCycleIds();
-    if (rowCount() > 0) {
-        emit dataChanged(index(0, 0), index(m_regimes.count() - 1, columnCount() - 1), {CycleStatusRole, CycleRowCountRole});
+    // Cycle span and status can only change around the removed blocks
+    RowRanges touched;
+    int removedBefore = 0;
+    for (const RowRanges::Range &range : ranges) {
+        const int gap = range.first - removedBefore;
+        removedBefore += range.count();
+        for (int row : {gap - 1, gap}) {
+            if (row >= 0 && row < m_regimes.count()) {
+                const RowRanges::Range span = outerSpan(row);
+                touched.add(span.first, span.last);
+            }
+        }
     }
+    for (const RowRanges::Range &range : touched.ranges())
+        emit dataChanged(index(range.first, 0), index(range.last, columnCount() - 1), {CycleStatusRole, CycleRowCountRole});
     checkAndUpdateRunningState();
+    endEdit();
     emit totalTimeChanged();
 }
 
@@ -544,51 +685,44 @@ void ProtoTableModel::clear()
 {
     beginResetModel();
     m_regimes.clear();
+    m_hash.reset(m_regimes);
+    m_cycleTreeDirty = true;
     endResetModel();
     checkAndUpdateRunningState();
+    clearHistory();
+    emit definitionChanged();
 }
 
-bool ProtoTableModel::isSelectionGroupable(QVariantList rows) const
+bool ProtoTableModel::isSelectionGroupable(const RowRanges &rows) const
 {
-    if (rows.count() < 2) return false;
+    if (rows.rowCount() < 2 || !isSelectionEditable(rows)) return false;
 
-    for (const QVariant &row : rows) {
-        int rowIndex = row.toInt();
-        if (rowIndex < 0 || rowIndex >= m_regimes.count()) return false;
-        if (m_regimes[rowIndex].m_state != RegimeEnums::State::Waiting) return false;
-    }
-
-    int cycleCount = 0;
+    // Units are single rows and whole top-level cycles; two of them can be wrapped in a cycle
     int nonCycleCount = 0;
-
-    for (const QVariant &row : rows) {
-        int rowIndex = row.toInt();
-        if (rowIndex >= 0 && rowIndex < m_regimes.count()) {
-            if (m_regimes[rowIndex].m_cycleId != -1) {
-                cycleCount++;
+    QSet<int> outerCycles;
+    for (const RowRanges::Range &range : rows.ranges()) {
+        for (int row = range.first; row <= range.last; ++row) {
+            if (m_regimes[row].m_cycleId != -1) {
+                outerCycles.insert(m_regimes[row].outermostCycleId());
             } else {
                 nonCycleCount++;
             }
+            if (nonCycleCount + outerCycles.count() >= 2)
+                return true;
         }
     }
 
-    return (nonCycleCount >= 2) || (nonCycleCount >= 1 && cycleCount >=1);
+    // Part of one cycle can become a cycle nested in it
+    return nestingCycle(rows) != -1;
 }
 
-bool ProtoTableModel::isSelectionUngroupable(QVariantList rows) const
+bool ProtoTableModel::isSelectionUngroupable(const RowRanges &rows) const
 {
-    if (rows.isEmpty()) return false;
+    if (rows.isEmpty() || !isSelectionEditable(rows)) return false;
 
-    for (const QVariant &row : rows) {
-        int rowIndex = row.toInt();
-        if (rowIndex < 0 || rowIndex >= m_regimes.count()) return false;
-        if (m_regimes[rowIndex].m_state != RegimeEnums::State::Waiting) return false;
-    }
-
-    for (const QVariant &row : rows) {
-        int rowIndex = row.toInt();
-        if (rowIndex >= 0 && rowIndex < m_regimes.count()) {
-            if (m_regimes[rowIndex].m_cycleId != -1) {
+    for (const RowRanges::Range &range : rows.ranges()) {
+        for (int row = range.first; row <= range.last; ++row) {
+            if (m_regimes[row].m_cycleId != -1) {
                 return true;
             }
         }
@@ -597,41 +731,20 @@ bool ProtoTableModel::isSelectionUngroupable(QVariantList rows) const
     return false;
 }
 
-bool ProtoTableModel::isMoveUpEnabled(QVariantList rows) const
+bool ProtoTableModel::isMoveUpEnabled(const RowRanges &rows) const
 {
-    if (rows.isEmpty()) return false;
-    int blockStart = getBlockStart(rows);
+    if (rows.isEmpty() || !isSelectionEditable(rows)) return false;
+    const int blockStart = outerSpan(rows.first()).first;
     if (blockStart == 0) return false;
 
-    for (const QVariant &row : rows) {
-        int rowIndex = row.toInt();
-        if (rowIndex < 0 || rowIndex >= m_regimes.count()) return false;
-        if (m_regimes[rowIndex].m_state != RegimeEnums::State::Waiting) return false;
-    }
-
-    int lastNonWaiting = -1;
-    for (int i = 0; i < m_regimes.count(); ++i) {
-        if (m_regimes[i].m_state != RegimeEnums::State::Waiting) {
-            lastNonWaiting = i;
-        }
-    }
-
-    return blockStart > lastNonWaiting + 1;
+    return blockStart > m_lastNonWaitingRow + 1;
 }
 
-bool ProtoTableModel::isMoveDownEnabled(QVariantList rows) const
+bool ProtoTableModel::isMoveDownEnabled(const RowRanges &rows) const
 {
-    if (rows.isEmpty()) return false;
-    int blockEnd = getBlockEnd(rows);
-    if (blockEnd == -1 || blockEnd == m_regimes.count() - 1) return false;
-
-    for (const QVariant &row : rows) {
-        int rowIndex = row.toInt();
-        if (rowIndex < 0 || rowIndex >= m_regimes.count()) return false;
-        if (m_regimes[rowIndex].m_state != RegimeEnums::State::Waiting) return false;
-    }
-
-    return true;
+    if (rows.isEmpty() || !isSelectionEditable(rows)) return false;
+    const int blockEnd = outerSpan(rows.last()).last;
+    return blockEnd != m_regimes.count() - 1;
 }
 
 Regime ProtoTableModel::getRegime(int row) const
@@ -642,6 +755,11 @@ Regime ProtoTableModel::getRegime(int row) const
     return m_regimes.at(row);
 }
 
+const Regime &ProtoTableModel::regimeAt(int row) const
+{
+    return m_regimes.at(row);
+}
+
 QVariantMap ProtoTableModel::getRegimeAsVariantMap(int row) const
 {
     if (row < 0 || row >= m_regimes.count()) {
@@ -670,11 +788,18 @@ QVariantMap ProtoTableModel::getRegimeAsVariantMap(int row) const
 
 QVariant ProtoTableModel::get(int row, const QByteArray& roleName) const
 {
-    int role = roleNames().key(roleName);
-    if (role == 0) { // roleName not found
+    // Reverse of roleNames(), built once from the static role table instead of on every call from QML
+    static const QHash<QByteArray, int> roles = [] {
+        QHash<QByteArray, int> roles{{"display", Qt::DisplayRole}};
+        const QHash<int, QByteArray> names = roleTable().roleNames();
+        for (auto it = names.cbegin(); it != names.cend(); ++it)
+            roles.insert(it.value(), it.key());
+        return roles;
+    }();
+    const auto it = roles.constFind(roleName);
+    if (it == roles.cend()) // roleName not found
         return QVariant();
-    }
-    return data(index(row, 0), role);
+    return data(index(row, 0), it.value());
 }
 
 bool ProtoTableModel::isAnyRegimeRunning() const
@@ -684,85 +809,473 @@ bool ProtoTableModel::isAnyRegimeRunning() const
 
 void ProtoTableModel::checkAndUpdateRunningState()
 {
-    bool running = false;
-    for (const auto &regime : m_regimes) {
-        if (regime.m_state != RegimeEnums::State::Waiting &&
-            regime.m_state != RegimeEnums::State::Skipped &&
-            regime.m_state != RegimeEnums::State::Done) {
-            running = true;
-            break;
-        }
+    int runningRows = 0;
+    int lastNonWaiting = -1;
+    for (int i = 0; i < m_regimes.count(); ++i) {
+        const RegimeEnums::State state = m_regimes.at(i).m_state;
+        if (state != RegimeEnums::State::Waiting)
+            lastNonWaiting = i;
+        if (isRunningState(state))
+            ++runningRows;
     }
 
-    if (m_isAnyRegimeRunning != running) {
-        m_isAnyRegimeRunning = running;
+    m_lastNonWaitingRow = lastNonWaiting;
+    m_runningRows = runningRows;
+    m_isAnyRegimeRunning = runningRows > 0;
+}
+
+void ProtoTableModel::updateRunningState(int row, RegimeEnums::State previous)
+{
+    const RegimeEnums::State state = m_regimes.at(row).m_state;
+    if (state == previous)
+        return;
+    m_runningRows += int(isRunningState(state)) - int(isRunningState(previous));
+    m_isAnyRegimeRunning = m_runningRows > 0;
+
+    const int lastBefore = m_lastNonWaitingRow;
+    if (state != RegimeEnums::State::Waiting && row > m_lastNonWaitingRow) {
+        m_lastNonWaitingRow = row;
+    } else if (state == RegimeEnums::State::Waiting && row == m_lastNonWaitingRow) {
+        // Rows run top to bottom, so the scan usually stops right above
+        do {
+            --m_lastNonWaitingRow;
+        } while (m_lastNonWaitingRow >= 0 && m_regimes.at(m_lastNonWaitingRow).m_state == RegimeEnums::State::Waiting);
+    }
+    if (m_lastNonWaitingRow == lastBefore)
+        return;
+
+    // Rows whose block now starts on the other side of the boundary gain or lose their move-up arrow
+    const int first = qMin(lastBefore, m_lastNonWaitingRow) + 1;
+    const int next = qMax(lastBefore, m_lastNonWaitingRow) + 1;
+    const int last = next < m_regimes.count() ? outerSpan(next).last : int(m_regimes.count()) - 1;
+    if (first <= last)
+        emit dataChanged(index(first, 0), index(last, columnCount() - 1), {StateRole});
+}
+
+bool ProtoTableModel::isSelectionEditable(const RowRanges &rows) const
+{
+    if (rows.first() < 0 || rows.last() >= m_regimes.count()) return false;
+    for (const RowRanges::Range &range : rows.ranges()) {
+        for (int row = range.first; row <= range.last; ++row) {
+            if (m_regimes[row].m_state != RegimeEnums::State::Waiting) return false;
+        }
     }
+    return true;
 }
 
-int ProtoTableModel::getBlockStart(QVariantList rows) const
+RowRanges::Range ProtoTableModel::cycleSpan(int row, int cycleId) const
 {
-    if (rows.isEmpty()) return -1;
+    RowRanges::Range span{row, row};
+    while (span.first > 0 && m_regimes.at(span.first - 1).isInCycle(cycleId))
+        --span.first;
+    while (span.last < m_regimes.count() - 1 && m_regimes.at(span.last + 1).isInCycle(cycleId))
+        ++span.last;
+    return span;
+}
 
-    QList<int> selectedIndices;
-    for (const QVariant &v : rows) {
-        bool ok;
-        int index = v.toInt(&ok);
-        if (!ok || index < 0 || index >= m_regimes.count()) {
-            qWarning() << "getBlockStart: Invalid row index in list:" << v;
-            return -1; // Invalid index
+RowRanges::Range ProtoTableModel::outerSpan(int row) const
+{
+    const Regime &regime = m_regimes.at(row);
+    return regime.m_cycleId == -1 ? RowRanges::Range{row, row} : cycleSpan(row, regime.outermostCycleId());
+}
+
+QList<RowRanges::Range> ProtoTableModel::topLevelBlocks() const
+{
+    QList<RowRanges::Range> blocks;
+    for (int row = 0; row < m_regimes.count(); row = blocks.last().last + 1)
+        blocks.append(outerSpan(row));
+    return blocks;
+}
+
+bool ProtoTableModel::keepsCyclesContiguous(const QList<int> &order) const
+{
+    auto cycleAt = [](const Regime &regime, int level) {
+        return level < regime.m_outerCycles.count() ? regime.m_outerCycles.at(level).id : regime.m_cycleId;
+    };
+
+    // Walking the new order, a cycle closes when a row outside it follows and must not reopen
+    QSet<int> closed;
+    const Regime *previous = nullptr;
+    for (int row : order) {
+        const Regime &regime = m_regimes.at(row);
+        const int depth = regime.cycleDepth();
+        int shared = 0;
+        if (previous) {
+            const int previousDepth = previous->cycleDepth();
+            while (shared < depth && shared < previousDepth && cycleAt(*previous, shared) == cycleAt(regime, shared))
+                ++shared;
+            for (int level = shared; level < previousDepth; ++level)
+                closed.insert(cycleAt(*previous, level));
+        }
+        for (int level = shared; level < depth; ++level) {
+            if (closed.contains(cycleAt(regime, level)))
+                return false;
         }
-        selectedIndices.append(index);
+        previous = &regime;
     }
-    std::sort(selectedIndices.begin(), selectedIndices.end());
+    return true;
+}
+
+bool ProtoTableModel::undo()
+{
+    if (!m_history.canUndo())
+        return false;
+    if (m_isAnyRegimeRunning) {
+        qWarning() << "undo: Program is being executed";
+        return false;
+    }
+
+    const EditHistory::Step step = m_history.takeUndo();
+    for (auto it = step.ops.crbegin(); it != step.ops.crend(); ++it)
+        revertOp(*it);
+    finishHistoryJump(step);
+    return true;
+}
+
+bool ProtoTableModel::redo()
+{
+    if (!m_history.canRedo())
+        return false;
+    if (m_isAnyRegimeRunning) {
+        qWarning() << "redo: Program is being executed";
+        return false;
+    }
+
+    const EditHistory::Step step = m_history.takeRedo();
+    for (const EditHistory::Op &op : step.ops)
+        applyOp(op);
+    finishHistoryJump(step);
+    return true;
+}
+
+void ProtoTableModel::clearHistory()
+{
+    m_history.reset(m_regimes);
+    emit historyChanged();
+}
+
+quint64 ProtoTableModel::definitionHash() const
+{
+    return m_hash.value();
+}
 
-    if (selectedIndices.isEmpty()) return -1;
+const CycleTree &ProtoTableModel::cycleTree() const
+{
+    if (m_cycleTreeDirty) {
+        m_cycleTree.rebuild(m_regimes);
+        m_cycleTreeDirty = false;
+    }
+    return m_cycleTree;
+}
 
-    int blockStart = selectedIndices.first();
+void ProtoTableModel::rowDefinitionChanged(int row)
+{
+    // The history compares only these rows when the edit step ends
+    m_history.markTouched(row);
+    // Cycle ids are renumbered without a dataChanged of their own
+    markSnapshotDirty(row, row);
+    // An edited name or condition type detached from the pool; share it again
+    m_definitions.intern(m_regimes[row]);
+    m_hash.update(row, m_regimes.at(row));
+    // Duration edits are applied along the row's cycles; structural ones rebuild lazily
+    if (!m_cycleTreeDirty && !m_cycleTree.updateRow(row, m_regimes.at(row)))
+        m_cycleTreeDirty = true;
+}
 
-    for (int i = 0; i < selectedIndices.count(); ++i) {
-        int rowIndex = selectedIndices[i];
-        if (m_regimes[rowIndex].m_cycleId != -1) {
-            int cycleId = m_regimes[rowIndex].m_cycleId;
-            int cycleStart = rowIndex;
-            while (cycleStart > 0 && m_regimes[cycleStart - 1].m_cycleId == cycleId) {
-                cycleStart--;
+QList<int> ProtoTableModel::setCycleRepeat(int cycleId, int repeat)
+{
+    QList<int> rows;
+    for (int i = 0; i < m_regimes.count(); ++i) {
+        Regime &regime = m_regimes[i];
+        if (!regime.isInCycle(cycleId))
+            continue;
+        if (regime.m_cycleId == cycleId) {
+            regime.m_cycleRepeat = repeat;
+        } else {
+            for (CycleLevel &level : regime.m_outerCycles) {
+                if (level.id == cycleId)
+                    level.repeat = repeat;
             }
-            blockStart = qMin(blockStart, cycleStart);
         }
+        rowDefinitionChanged(i);
+        rows.append(i);
     }
-    return blockStart;
+    return rows;
 }
 
-int ProtoTableModel::getBlockEnd(QVariantList rows) const
+int ProtoTableModel::nestingCycle(const RowRanges &rows) const
 {
-    if (rows.isEmpty()) return -1;
-
-    QList<int> selectedIndices;
-    for (const QVariant &v : rows) {
-        bool ok;
-        int index = v.toInt(&ok);
-        if (!ok || index < 0 || index >= m_regimes.count()) {
-            qWarning() << "getBlockEnd: Invalid row index in list:" << v;
-            return -1; // Invalid index
+    // A strict subset of the rows whose innermost cycle is the same one, in one piece:
+    // a nested cycle split by a row of its parent would not run in table order
+    const int cycleId = m_regimes.at(rows.first()).m_cycleId;
+    if (cycleId == -1 || rows.rangeCount() != 1)
+        return -1;
+    for (const RowRanges::Range &range : rows.ranges()) {
+        for (int row = range.first; row <= range.last; ++row) {
+            if (m_regimes.at(row).m_cycleId != cycleId)
+                return -1;
         }
-        selectedIndices.append(index);
     }
-    std::sort(selectedIndices.begin(), selectedIndices.end());
+    return cycleSpan(rows.first(), cycleId).count() > rows.rowCount() ? cycleId : -1;
+}
+
+bool ProtoTableModel::isDefinitionRole(int role)
+{
+    return roleTable().hasFlag(role, RoleDescriptor<Regime>::Definition);
+}
 
-    if (selectedIndices.isEmpty()) return -1;
+bool ProtoTableModel::canUndo() const
+{
+    return m_history.canUndo();
+}
 
-    int blockEnd = selectedIndices.last();
+bool ProtoTableModel::canRedo() const
+{
+    return m_history.canRedo();
+}
 
-    for (int i = 0; i < selectedIndices.count(); ++i) {
-        int rowIndex = selectedIndices[i];
-        if (m_regimes[rowIndex].m_cycleId != -1) {
-            int cycleId = m_regimes[rowIndex].m_cycleId;
-            int cycleEnd = rowIndex;
-            while (cycleEnd < m_regimes.count() - 1 && m_regimes[cycleEnd + 1].m_cycleId == cycleId) {
-                cycleEnd++;
-            }
-            blockEnd = qMax(blockEnd, cycleEnd);
+QString ProtoTableModel::undoText() const
+{
+    return m_history.undoLabel();
+}
+
+QString ProtoTableModel::redoText() const
+{
+    return m_history.redoLabel();
+}
+
+void ProtoTableModel::beginEdit(const QString &label)
+{
+    m_history.beginStep(label);
+}
+
+void ProtoTableModel::endEdit()
+{
+    if (m_history.endStep(m_regimes))
+        emit definitionChanged();
+    if (!m_history.isRecording())
+        emit historyChanged();
+}
+
+void ProtoTableModel::moveBlock(int sourceRow, int count, int destinationChild)
+{
+    beginMoveRows(QModelIndex(), sourceRow, sourceRow + count - 1, QModelIndex(), destinationChild);
+    // One rotation of the rows in between instead of an insert per moved row
+    const auto begin = m_regimes.begin();
+    if (sourceRow < destinationChild)
+        std::rotate(begin + sourceRow, begin + sourceRow + count, begin + destinationChild);
+    else
+        std::rotate(begin + destinationChild, begin + sourceRow, begin + sourceRow + count);
+    m_hash.move(sourceRow, count, destinationChild);
+    m_cycleTreeDirty = true;
+    endMoveRows();
+}
+
+void ProtoTableModel::permuteRows(const QList<int> &order)
+{
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    QList<int> newRowOf(order.count());
+    QList<Regime> reordered;
+    reordered.reserve(order.count());
+    for (int newRow = 0; newRow < order.count(); ++newRow) {
+        newRowOf[order.at(newRow)] = newRow;
+        reordered.append(std::move(m_regimes[order.at(newRow)]));
+    }
+    m_regimes = std::move(reordered);
+    m_hash.reset(m_regimes);
+    m_cycleTreeDirty = true;
+
+    // Selections and the current index follow their rows
+    const QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.count());
+    for (const QModelIndex &oldIndex : from)
+        to.append(index(newRowOf.at(oldIndex.row()), oldIndex.column()));
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void ProtoTableModel::insertDefinitions(int row, const EditHistory::Document &document, int first, int count)
+{
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    const QList<Regime> definitions = document.mid(first, count).toList();
+    m_regimes.insert(row, count, Regime());
+    for (int i = 0; i < count; ++i) {
+        EditHistory::copyDefinition(m_regimes[row + i], definitions.at(i));
+    }
+    m_hash.insert(row, m_regimes.mid(row, count));
+    m_cycleTreeDirty = true;
+    endInsertRows();
+}
+
+void ProtoTableModel::removeBlock(int row, int count)
+{
+    beginRemoveRows(QModelIndex(), row, row + count - 1);
+    m_regimes.remove(row, count);
+    m_hash.remove(row, count);
+    m_cycleTreeDirty = true;
+    endRemoveRows();
+}
+
+void ProtoTableModel::updateDefinitions(const EditHistory::Document &document, int first, int count)
+{
+    for (int row = first; row < first + count; ++row) {
+        EditHistory::copyDefinition(m_regimes[row], document.at(row));
+        rowDefinitionChanged(row);
+    }
+    emit dataChanged(index(first, 0), index(first + count - 1, columnCount() - 1));
+}
+
+void ProtoTableModel::revertOp(const EditHistory::Op &op)
+{
+    switch (op.kind) {
+    case EditHistory::OpKind::Insert:
+        removeBlock(op.row, op.count);
+        break;
+    case EditHistory::OpKind::Remove:
+        insertDefinitions(op.row, op.before, op.row, op.count);
+        break;
+    case EditHistory::OpKind::Move: {
+        // The block now starts where the move put it; send it back to where it came from
+        const int movedTo = op.destination > op.row ? op.destination - op.count : op.destination;
+        moveBlock(movedTo, op.count, op.row > movedTo ? op.row + op.count : op.row);
+        break;
+    }
+    case EditHistory::OpKind::Reorder: {
+        QList<int> inverse(op.order.count());
+        for (int newRow = 0; newRow < op.order.count(); ++newRow)
+            inverse[op.order.at(newRow)] = newRow;
+        permuteRows(inverse);
+        break;
+    }
+    case EditHistory::OpKind::Update:
+        updateDefinitions(op.before, op.row, op.count);
+        break;
+    }
+}
+
+void ProtoTableModel::applyOp(const EditHistory::Op &op)
+{
+    switch (op.kind) {
+    case EditHistory::OpKind::Insert:
+        insertDefinitions(op.row, op.after, op.row, op.count);
+        break;
+    case EditHistory::OpKind::Remove:
+        removeBlock(op.row, op.count);
+        break;
+    case EditHistory::OpKind::Move:
+        moveBlock(op.row, op.count, op.destination);
+        break;
+    case EditHistory::OpKind::Reorder:
+        permuteRows(op.order);
+        break;
+    case EditHistory::OpKind::Update:
+        updateDefinitions(op.after, op.row, op.count);
+        break;
+    }
+}
+
+void ProtoTableModel::finishHistoryJump(const EditHistory::Step &step)
+{
+    // Rows in front of the earliest op keep their data; rows inserted or removed by the
+    // step can shift the last touched row by at most their count
+    int first = rowCount();
+    int last = -1;
+    int shifted = 0;
+    for (const EditHistory::Op &op : step.ops) {
+        int opFirst = op.row;
+        int opLast = op.row + op.count - 1;
+        if (op.kind == EditHistory::OpKind::Insert || op.kind == EditHistory::OpKind::Remove) {
+            shifted += op.count;
+        } else if (op.kind == EditHistory::OpKind::Move) {
+            opFirst = qMin(op.row, op.destination);
+            opLast = qMax(op.row + op.count, op.destination) - 1;
+        } else if (op.kind == EditHistory::OpKind::Reorder) {
+            opFirst = 0;
+            while (opFirst < op.order.count() && op.order.at(opFirst) == opFirst)
+                ++opFirst;
+            opLast = int(op.order.count()) - 1;
+            while (opLast > opFirst && op.order.at(opLast) == opLast)
+                --opLast;
         }
+        first = qMin(first, opFirst);
+        last = qMax(last, opLast);
     }
-    return blockEnd;
-}
\ No newline at end of file
+
+    // Cycle span and status of the cycles around the touched rows may have changed as well
+    if (rowCount() > 0 && last >= 0) {
+        first = qMin(first, rowCount() - 1);
+        last = qBound(first, last + shifted, rowCount() - 1);
+        if (first > 0)
+            first = outerSpan(first - 1).first;
+        if (last < rowCount() - 1)
+            last = outerSpan(last + 1).last;
+        emit dataChanged(index(first, 0), index(last, columnCount() - 1), {CycleStatusRole, CycleRowCountRole});
+    }
+    checkAndUpdateRunningState();
+    emit selectionShouldBeCleared();
+    emit totalTimeChanged();
+    emit historyChanged();
+    emit definitionChanged();
+}
+
+QVariantMap ProtoTableModel::memoryUsage() const
+{
+    const qint64 bytes = DefinitionPool::bytesUsed(m_regimes);
+    QVariantMap usage;
+    usage.insert("rows", m_regimes.count());
+    usage.insert("bytes", bytes);
+    usage.insert("bytesPerRow", m_regimes.isEmpty() ? 0.0 : double(bytes) / m_regimes.count());
+    usage.insert("sharedStrings", m_definitions.size());
+    return usage;
+}
+
+ProgramSnapshotPtr ProtoTableModel::snapshot() const
+{
+    // m_snapshotDirty belongs to the model's thread; other threads only load the pointer
+    if (QThread::currentThread() == thread() && m_snapshotDirty)
+        const_cast<ProtoTableModel*>(this)->publishSnapshot();
+    return m_snapshot.load(std::memory_order_acquire);
+}
+
+void ProtoTableModel::markSnapshotDirty(int first, int last)
+{
+    for (qsizetype chunk = first / SnapshotRows::ChunkRows; chunk <= last / SnapshotRows::ChunkRows; ++chunk)
+        m_snapshotChunks.insert(chunk);
+    m_snapshotDirty = true;
+    if (!m_snapshotTimer.isActive())
+        m_snapshotTimer.start();
+}
+
+void ProtoTableModel::markSnapshotStale()
+{
+    m_snapshotStale = true;
+    m_snapshotDirty = true;
+    if (!m_snapshotTimer.isActive())
+        m_snapshotTimer.start();
+}
+
+void ProtoTableModel::publishSnapshot()
+{
+    m_snapshotTimer.stop();
+    if (!m_snapshotDirty)
+        return;
+
+    auto snapshot = std::make_shared<ProgramSnapshot>();
+    snapshot->version = ++m_snapshotVersion;
+    // Only chunks with changed rows are copied; the live rows are never shared, so writing
+    // them in place stays O(1). Row counts and order changed: every chunk is copied
+    const ProgramSnapshotPtr previous = m_snapshot.load(std::memory_order_relaxed);
+    if (m_snapshotStale || previous->regimes.count() != m_regimes.count())
+        snapshot->regimes = SnapshotRows(m_regimes);
+    else
+        snapshot->regimes = previous->regimes.updated(m_regimes, m_snapshotChunks);
+    m_snapshotChunks.clear();
+    m_snapshotStale = false;
+    snapshot->definitionHash = m_hash.value();
+    m_snapshot.store(std::move(snapshot), std::memory_order_release);
+    m_snapshotDirty = false;
+    emit snapshotPublished(m_snapshotVersion);
+}
@@ -8,13 +8,33 @@
 #include <QDir>
 #include <QDebug>
 #include <QMap>
+#include <QTimer>
+#include <atomic>
+#include "cycletree.h"
+#include "definitionpool.h"
+#include "edithistory.h"
+#include "programhash.h"
+#include "programsnapshot.h"
 #include "regime.h"
+#include "roletable.h"
+#include "rowranges.h"
 
 class ProtoTableModel : public QAbstractTableModel
 {
     Q_OBJECT
+    Q_PROPERTY(bool canUndo READ canUndo NOTIFY historyChanged)
+    Q_PROPERTY(bool canRedo READ canRedo NOTIFY historyChanged)
+    Q_PROPERTY(QString undoText READ undoText NOTIFY historyChanged)
+    Q_PROPERTY(QString redoText READ redoText NOTIFY historyChanged)
 
 public:
+    /// Keys for sortRows()
+    enum SortKey {
+        SortByName,
+        SortByDuration
+    };
+    Q_ENUM(SortKey)
+
     explicit ProtoTableModel(QObject *parent = nullptr);
 
     enum Role {
@@ -36,7 +56,9 @@ public:
         CurrentRepeatRole,
         ConditionCompletedRole,
         ConditionTimePassedRole,
-        RegimeTimePassedRole
+        RegimeTimePassedRole,
+        // Number of cycle levels containing the row
+        CycleDepthRole
     };
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -54,37 +76,136 @@ public:
     Q_INVOKABLE void setRegimes(const QList<Regime> &regimes);
     Q_INVOKABLE QList<Regime> getRegimes() const;
 
-    Q_INVOKABLE void groupRows(QVariantList rows);
-    Q_INVOKABLE void ungroupRows(QVariantList rows);
-    Q_INVOKABLE QVariantList moveSelection(QVariantList rows, bool up);
+    // Selections are row ranges; QML may pass a selection, [first, last] pairs or row numbers
+    Q_INVOKABLE void groupRows(const RowRanges &rows);
+    Q_INVOKABLE void ungroupRows(const RowRanges &rows);
+    /// Moves the selection (widened to whole cycles) past its neighbour; returns the moved rows
+    Q_INVOKABLE RowRanges moveSelection(const RowRanges &rows, bool up);
+    /**
+     * @brief Applies any permutation in one layout change; order[newRow] is the row moved there
+     * @return false unless order is a permutation of all rows that keeps every cycle contiguous
+     *         and leaves rows up to the last started one in place
+     */
+    Q_INVOKABLE bool reorderRows(const QList<int> &order);
+    /// Moves the selection, widened to whole top-level cycles, in front of destination; returns the moved rows
+    Q_INVOKABLE RowRanges moveRowsTo(const RowRanges &rows, int destination);
+    /// Sorts the waiting rows; a top-level cycle moves as one item keyed by its first row or total duration
+    Q_INVOKABLE bool sortRows(SortKey key, bool ascending = true);
 
     Q_INVOKABLE void addRow(const QString &regimeName);
-    Q_INVOKABLE void deleteRows(QVariantList rows);
+    Q_INVOKABLE void deleteRows(const RowRanges &rows);
     Q_INVOKABLE void clear();
-    Q_INVOKABLE bool isSelectionGroupable(QVariantList rows) const;
-    Q_INVOKABLE bool isSelectionUngroupable(QVariantList rows) const;
-    Q_INVOKABLE bool isMoveUpEnabled(QVariantList rows) const;
-    Q_INVOKABLE bool isMoveDownEnabled(QVariantList rows) const;
+    Q_INVOKABLE bool isSelectionGroupable(const RowRanges &rows) const;
+    Q_INVOKABLE bool isSelectionUngroupable(const RowRanges &rows) const;
+    Q_INVOKABLE bool isMoveUpEnabled(const RowRanges &rows) const;
+    Q_INVOKABLE bool isMoveDownEnabled(const RowRanges &rows) const;
 
     Q_INVOKABLE Regime getRegime(int row) const;
+    /// Row without a copy for C++ observers; row must be valid
+    const Regime &regimeAt(int row) const;
         Q_INVOKABLE QVariantMap getRegimeAsVariantMap(int row) const;
     Q_INVOKABLE QVariant get(int row, const QByteArray& roleName) const;
     Q_INVOKABLE bool isAnyRegimeRunning() const;
 
+    // Undo/redo of program edits; refused while a program is being executed
+    Q_INVOKABLE bool undo();
+    Q_INVOKABLE bool redo();
+    Q_INVOKABLE void clearHistory();
+    bool canUndo() const;
+    bool canRedo() const;
+    QString undoText() const;
+    QString redoText() const;
+
+    /**
+     * @brief Latest published immutable copy of the program; callable from any thread
+     *
+     * Changes are committed to a new snapshot once per event loop pass. On the model's own
+     * thread pending changes are committed first, so the result is always current there.
+     */
+    ProgramSnapshotPtr snapshot() const;
+
+    /// Content hash of the definition fields of all rows, maintained incrementally
+    quint64 definitionHash() const;
+
+    /// {rows, bytes, bytesPerRow, sharedStrings}: memory held by the rows, shared buffers counted once
+    Q_INVOKABLE QVariantMap memoryUsage() const;
+
+    /// Cycle hierarchy with cached durations; rebuilt on first use after structural edits
+    const CycleTree &cycleTree() const;
+
+    /// True for roles that edit the program definition rather than execution progress
+    static bool isDefinitionRole(int role);
+
 public slots:
     Q_INVOKABLE int getRowCount() { return m_regimes.count(); }
 
 signals:
     void selectionShouldBeCleared();
     void totalTimeChanged();
+    void historyChanged();
+    void snapshotPublished(quint64 version);
+    /// The program definition changed (edit, undo/redo, reset); progress updates do not emit this
+    void definitionChanged();
 
 private:
+    /// Accessors and side effects of every custom role, indexed by role id
+    static const RoleTable<Regime> &roleTable();
+
     void updateCycleIds();
+    /// Keeps the definition hash and the cycle tree in step with an edited row
+    void rowDefinitionChanged(int row);
+    /// Writes the repeat of cycleId into every row containing it; returns those rows
+    QList<int> setCycleRepeat(int cycleId, int repeat);
+    /// Innermost cycle shared by all rows if they are adjacent and do not cover all of it, -1 otherwise
+    int nestingCycle(const RowRanges &rows) const;
     void checkAndUpdateRunningState();
-    int getBlockStart(QVariantList rows) const;
-    int getBlockEnd(QVariantList rows) const;
+    /// Follows a state change of row without rescanning; repaints rows whose move-up arrow changes
+    void updateRunningState(int row, RegimeEnums::State previous);
+    /// All rows exist and are waiting
+    bool isSelectionEditable(const RowRanges &rows) const;
+    /// Contiguous rows of cycleId around row, found by walking its neighbours
+    RowRanges::Range cycleSpan(int row, int cycleId) const;
+    /// The row's top-level cycle, or the row itself
+    RowRanges::Range outerSpan(int row) const;
+    /// Blocks that move as one: every single row and every top-level cycle, in row order
+    QList<RowRanges::Range> topLevelBlocks() const;
+    /// No cycle is split by the rows placed between its members
+    bool keepsCyclesContiguous(const QList<int> &order) const;
+
+    void beginEdit(const QString &label);
+    void endEdit();
+    void moveBlock(int sourceRow, int count, int destinationChild);
+    void permuteRows(const QList<int> &order);
+    void insertDefinitions(int row, const EditHistory::Document &document, int first, int count);
+    void removeBlock(int row, int count);
+    void updateDefinitions(const EditHistory::Document &document, int first, int count);
+    void revertOp(const EditHistory::Op &op);
+    void applyOp(const EditHistory::Op &op);
+    void finishHistoryJump(const EditHistory::Step &step);
+    /// Rows first to last changed in place
+    void markSnapshotDirty(int first, int last);
+    /// Rows were inserted, removed or reordered
+    void markSnapshotStale();
+    void publishSnapshot();
 
     QList<Regime> m_regimes;
     QStringList m_columnNames;
     bool m_isAnyRegimeRunning = false;
+    int m_lastNonWaitingRow = -1;
+    /// Rows neither waiting, skipped nor done
+    int m_runningRows = 0;
+    EditHistory m_history;
+    /// Names and condition types shared between rows
+    DefinitionPool m_definitions;
+    ProgramHash m_hash;
+    mutable CycleTree m_cycleTree;
+    mutable bool m_cycleTreeDirty = true;
+
+    std::atomic<ProgramSnapshotPtr> m_snapshot;
+    QTimer m_snapshotTimer;
+    bool m_snapshotDirty = false;
+    bool m_snapshotStale = true;
+    /// Chunks of SnapshotRows holding rows changed since the last publication
+    QSet<qsizetype> m_snapshotChunks;
+    quint64 m_snapshotVersion = 0;
 };
@@ -1,4 +1,5 @@
 #include "regime.h"
+#include <QJsonArray>
 #include <QJsonObject>
 
 QJsonObject Condition::toJson() const {
@@ -21,6 +22,42 @@ Condition Condition::fromJson(const QJsonObject &json) {
     return c;
 }
 
+int Regime::conditionTimeInSeconds() const {
+    if (m_condition.type == "time" || m_condition.type == "temp") {
+        return m_condition.time * 60; // Convert minutes to seconds
+    }
+    return 0;
+}
+
+int Regime::cycleDepth() const {
+    return m_cycleId == -1 ? 0 : int(m_outerCycles.count()) + 1;
+}
+
+int Regime::outermostCycleId() const {
+    return m_outerCycles.isEmpty() ? m_cycleId : m_outerCycles.first().id;
+}
+
+bool Regime::isInCycle(int cycleId) const {
+    if (cycleId == -1 || m_cycleId == -1)
+        return false;
+    if (m_cycleId == cycleId)
+        return true;
+    for (const CycleLevel &level : m_outerCycles) {
+        if (level.id == cycleId)
+            return true;
+    }
+    return false;
+}
+
+qint64 Regime::cyclePasses() const {
+    if (m_cycleId == -1)
+        return 1;
+    qint64 passes = m_cycleRepeat;
+    for (const CycleLevel &level : m_outerCycles)
+        passes *= level.repeat;
+    return passes;
+}
+
 QJsonObject Regime::toJson() const {
     QJsonObject json;
     json["name"] = m_name;
@@ -32,6 +69,17 @@ QJsonObject Regime::toJson() const {
         QJsonObject cycleObj;
         cycleObj["id"] = m_cycleId;
         cycleObj["cycleRepeat"] = m_cycleRepeat;
+        // Written only for nested cycles, so single-level files keep their format
+        if (!m_outerCycles.isEmpty()) {
+            QJsonArray outerArray;
+            for (const CycleLevel &level : m_outerCycles) {
+                QJsonObject levelObj;
+                levelObj["id"] = level.id;
+                levelObj["cycleRepeat"] = level.repeat;
+                outerArray.append(levelObj);
+            }
+            cycleObj["outer"] = outerArray;
+        }
         json["cycle"] = cycleObj;
     } else {
         json["cycle"] = QJsonValue();
@@ -49,6 +97,10 @@ Regime Regime::fromJson(const QJsonObject &json) {
         QJsonObject cycleObj = json["cycle"].toObject();
         r.m_cycleId = cycleObj["id"].toInt();
         r.m_cycleRepeat = cycleObj["cycleRepeat"].toInt();
+        for (const QJsonValue &value : cycleObj["outer"].toArray()) {
+            const QJsonObject levelObj = value.toObject();
+            r.m_outerCycles.append({levelObj["id"].toInt(), levelObj["cycleRepeat"].toInt()});
+        }
     }
     return r;
 }
\ No newline at end of file
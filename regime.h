@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QList>
 #include <QObject>
 #include <QString>
 #include <QJsonObject>
@@ -39,6 +40,14 @@ public:
 
 Q_DECLARE_METATYPE(Condition)
 
+/// One enclosing level of a nested cycle
+struct CycleLevel {
+    int id = -1;
+    int repeat = 1;
+
+    bool operator==(const CycleLevel &other) const = default;
+};
+
 class Regime {
     Q_GADGET
     Q_PROPERTY(QString name MEMBER m_name)
@@ -53,8 +62,11 @@ public:
     int m_repeatCount = 1;
     // Maximum time for the regime in seconds
     int m_maxTime = 60;
+    // Innermost cycle containing the row and its repeat count
     int m_cycleId = -1;
     int m_cycleRepeat = 1;
+    // Cycles enclosing m_cycleId, outermost first; empty for single-level cycles
+    QList<CycleLevel> m_outerCycles;
     RegimeEnums::State m_state = RegimeEnums::State::Waiting;
     // Time passed in seconds
     int m_timePassedInSeconds = 0;
@@ -70,6 +82,17 @@ public:
 
     bool operator==(const Regime &other) const = default;
 
+    // Duration of the condition phase in seconds (0 when there is nothing to wait for)
+    int conditionTimeInSeconds() const;
+    // Number of cycle levels containing the row (0 outside cycles)
+    int cycleDepth() const;
+    // Top-level cycle containing the row, -1 outside cycles
+    int outermostCycleId() const;
+    // True if the row belongs to cycleId at any nesting level
+    bool isInCycle(int cycleId) const;
+    // Product of the repeat counts of every cycle level containing the row
+    qint64 cyclePasses() const;
+
     QJsonObject toJson() const;
     static Regime fromJson(const QJsonObject &json);
 };
@@ -0,0 +1,164 @@
+#include "regimefiltermodel.h"
+#include "prototablemodel.h"
+#include <algorithm>
+
+RegimeFilterModel::RegimeFilterModel(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+    connect(this, &QAbstractItemModel::rowsInserted, this, &RegimeFilterModel::matchCountChanged);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &RegimeFilterModel::matchCountChanged);
+    connect(this, &QAbstractItemModel::modelReset, this, &RegimeFilterModel::matchCountChanged);
+    connect(this, &QAbstractItemModel::layoutChanged, this, &RegimeFilterModel::matchCountChanged);
+}
+
+void RegimeFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    for (const QMetaObject::Connection &connection : std::as_const(m_connections))
+        disconnect(connection);
+    m_connections.clear();
+
+    m_source = qobject_cast<ProtoTableModel*>(sourceModel);
+    if (m_source) {
+        // Connected ahead of the proxy's own handlers, so the flags are current when it re-checks rows
+        m_connections << connect(m_source, &QAbstractItemModel::dataChanged, this, &RegimeFilterModel::onDataChanged);
+        m_connections << connect(m_source, &QAbstractItemModel::rowsInserted, this,
+                                 [this](const QModelIndex &, int first, int last) { onRowsInserted(first, last); });
+        m_connections << connect(m_source, &QAbstractItemModel::rowsRemoved, this,
+                                 [this](const QModelIndex &, int first, int last) { onRowsRemoved(first, last); });
+        m_connections << connect(m_source, &QAbstractItemModel::rowsMoved, this, &RegimeFilterModel::onReset);
+        m_connections << connect(m_source, &QAbstractItemModel::layoutChanged, this, &RegimeFilterModel::onReset);
+        m_connections << connect(m_source, &QAbstractItemModel::modelReset, this, &RegimeFilterModel::onReset);
+    }
+    onReset();
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
+QString RegimeFilterModel::searchText() const
+{
+    return m_query.text;
+}
+
+void RegimeFilterModel::setSearchText(const QString &text)
+{
+    RegimeSearchIndex::Query query = m_query;
+    query.text = text.trimmed();
+    setQuery(query);
+}
+
+QString RegimeFilterModel::conditionType() const
+{
+    return m_query.conditionType;
+}
+
+void RegimeFilterModel::setConditionType(const QString &type)
+{
+    RegimeSearchIndex::Query query = m_query;
+    query.conditionType = type;
+    setQuery(query);
+}
+
+int RegimeFilterModel::stateFilter() const
+{
+    return m_query.state;
+}
+
+void RegimeFilterModel::setStateFilter(int state)
+{
+    RegimeSearchIndex::Query query = m_query;
+    query.state = state < 0 ? -1 : state;
+    setQuery(query);
+}
+
+bool RegimeFilterModel::isActive() const
+{
+    return !m_query.isEmpty();
+}
+
+int RegimeFilterModel::matchCount() const
+{
+    return rowCount();
+}
+
+int RegimeFilterModel::sourceRow(int row) const
+{
+    const QModelIndex source = mapToSource(index(row, 0));
+    return source.isValid() ? source.row() : -1;
+}
+
+bool RegimeFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent);
+    return !m_source || !isActive() || m_accepted.value(sourceRow);
+}
+
+void RegimeFilterModel::setQuery(const RegimeSearchIndex::Query &query)
+{
+    if (query.text == m_query.text && query.conditionType == m_query.conditionType && query.state == m_query.state)
+        return;
+    m_query = query;
+    refilter();
+    emit filterChanged();
+}
+
+void RegimeFilterModel::refilter()
+{
+    if (m_source && isActive()) {
+        m_accepted.fill(false);
+        for (int row : m_index.find(m_query))
+            m_accepted[row] = true;
+    }
+    invalidateRowsFilter();
+    emit matchCountChanged();
+}
+
+void RegimeFilterModel::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+{
+    // Cycle layout and timing roles do not affect the match
+    static const QList<int> searchedRoles = {Qt::DisplayRole, ProtoTableModel::RegimeRole,
+                                             ProtoTableModel::ConditionRole, ProtoTableModel::StateRole};
+    if (!roles.isEmpty() && std::none_of(roles.cbegin(), roles.cend(), [](int role) { return searchedRoles.contains(role); }))
+        return;
+
+    // A state change may span many rows of which few changed; compare the state alone
+    if (roles == QList<int>{ProtoTableModel::StateRole}) {
+        for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+            if (m_index.updateState(row, m_source->regimeAt(row).m_state) && isActive())
+                m_accepted[row] = m_index.matches(row, m_query);
+        }
+        return;
+    }
+
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        m_index.updateRow(row, m_source->regimeAt(row));
+        if (isActive())
+            m_accepted[row] = m_index.matches(row, m_query);
+    }
+}
+
+void RegimeFilterModel::onRowsInserted(int first, int last)
+{
+    const QList<Regime> regimes = m_source->getRegimes().mid(first, last - first + 1);
+    m_index.insertRows(first, regimes);
+    m_accepted.insert(first, regimes.count(), false);
+    if (isActive()) {
+        for (int row = first; row <= last; ++row)
+            m_accepted[row] = m_index.matches(row, m_query);
+    }
+}
+
+void RegimeFilterModel::onRowsRemoved(int first, int last)
+{
+    m_index.removeRows(first, last - first + 1);
+    m_accepted.remove(first, last - first + 1);
+}
+
+void RegimeFilterModel::onReset()
+{
+    // Row numbers moved; the proxy re-checks every row after this anyway
+    m_index.reset(m_source ? m_source->getRegimes() : QList<Regime>());
+    m_accepted = QList<bool>(m_index.rowCount(), false);
+    if (m_source && isActive()) {
+        for (int row : m_index.find(m_query))
+            m_accepted[row] = true;
+    }
+}
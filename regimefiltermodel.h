@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QList>
+#include <QSortFilterProxyModel>
+#include "regimesearchindex.h"
+
+class ProtoTableModel;
+
+/**
+ * @brief Rows of a ProtoTableModel narrowed by name, condition type and state
+ *
+ * A new filter is answered by RegimeSearchIndex and cached as one flag per source row, so
+ * filterAcceptsRow() is a lookup. Source edits update the index and the flags of the
+ * edited rows before the proxy re-checks them, so editing or progressing a row never
+ * re-filters the whole program.
+ */
+class RegimeFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+    Q_PROPERTY(QString searchText READ searchText WRITE setSearchText NOTIFY filterChanged)
+    Q_PROPERTY(QString conditionType READ conditionType WRITE setConditionType NOTIFY filterChanged)
+    Q_PROPERTY(int stateFilter READ stateFilter WRITE setStateFilter NOTIFY filterChanged)
+    Q_PROPERTY(bool active READ isActive NOTIFY filterChanged)
+    Q_PROPERTY(int matchCount READ matchCount NOTIFY matchCountChanged)
+
+public:
+    explicit RegimeFilterModel(QObject *parent = nullptr);
+
+    /// Only ProtoTableModel sources are filtered; other models pass through unfiltered
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    QString searchText() const;
+    void setSearchText(const QString &text);
+    QString conditionType() const;
+    void setConditionType(const QString &type);
+    int stateFilter() const;
+    void setStateFilter(int state);
+    bool isActive() const;
+    int matchCount() const;
+
+    /// Source row shown at row, -1 if there is none
+    Q_INVOKABLE int sourceRow(int row) const;
+
+signals:
+    void filterChanged();
+    void matchCountChanged();
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    void setQuery(const RegimeSearchIndex::Query &query);
+    /// Answers the current query from the index and re-filters once
+    void refilter();
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles);
+    void onRowsInserted(int first, int last);
+    void onRowsRemoved(int first, int last);
+    void onReset();
+
+    ProtoTableModel *m_source = nullptr;
+    RegimeSearchIndex m_index;
+    RegimeSearchIndex::Query m_query;
+    QList<bool> m_accepted;
+    QList<QMetaObject::Connection> m_connections;
+};
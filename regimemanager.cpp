@@ -3,24 +3,47 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QDateTime>
 #include <QDebug>
-#include <QSet>
+#include <QHash>
+#include <algorithm>
+#include <tuple>
 
 RegimeManager::RegimeManager(QObject *parent)
-    : QObject{parent}, m_model(this)
+    : RegimeManager(true, parent)
 {
-    loadDefaultRegimes();
-    connect(&m_model, &ProtoTableModel::dataChanged, this, [this]() { 
-        setDirty(true); 
-        // Force VisibleRegimeModel update when main model data changes
-        refreshVisibleRegimes();
+}
+
+RegimeManager::RegimeManager(bool loadDefaultProfile, QObject *parent)
+    : QObject{parent}, m_model(this), m_forecaster(&m_model), m_eta(&m_model), m_phaseClock(&m_model), m_ingestor(this), m_conditionEvaluator(this), m_sensorTraces(&m_model), m_autosave(&m_model), m_reports(&m_model)
+{
+    // Bursts of model changes collapse into one VisibleRegimeModel rebuild
+    m_refreshTimer.setSingleShot(true);
+    m_refreshTimer.setInterval(0);
+    connect(&m_refreshTimer, &QTimer::timeout, this, &RegimeManager::refreshVisibleRegimes);
+
+    if (loadDefaultProfile)
+        loadDefaultRegimes();
+    // Schedule VisibleRegimeModel update when main model data changes
+    connect(&m_model, &ProtoTableModel::dataChanged, this, &RegimeManager::scheduleVisibleRefresh);
+    // Only definition edits can make the program differ from its file; progress never does
+    connect(&m_model, &ProtoTableModel::definitionChanged, this, [this]() {
+        setDirty(m_model.definitionHash() != m_savedHash);
     });
+    // Structural edits publish through the same coalesced refresh as data changes
+    connect(&m_model, &ProtoTableModel::rowsInserted, this, &RegimeManager::scheduleVisibleRefresh);
+    connect(&m_model, &ProtoTableModel::rowsRemoved, this, &RegimeManager::scheduleVisibleRefresh);
+    connect(&m_model, &ProtoTableModel::rowsMoved, this, &RegimeManager::scheduleVisibleRefresh);
+    connect(&m_model, &ProtoTableModel::modelReset, this, &RegimeManager::scheduleVisibleRefresh);
+    connect(&m_model, &ProtoTableModel::layoutChanged, this, &RegimeManager::scheduleVisibleRefresh);
     // Connect ProtoTableModel totalTimeChanged to VisibleRegimeModel update function
     connect(&m_model, &ProtoTableModel::totalTimeChanged, &m_visibleRegimeModel, &VisibleRegimeModel::notifyTimelineUpdate);
     // Forward VisibleRegimeModel signal to RegimeManager signal for backward compatibility
     connect(&m_visibleRegimeModel, &VisibleRegimeModel::timelineUpdateRequired, this, &RegimeManager::totalTimeChanged);
 
     connect(this, &RegimeManager::stateChanged, this, &RegimeManager::updateRegimeState);
+    connect(&m_eta, &EtaEngine::repeatObserved, this, &RegimeManager::recordRepeat);
+    m_filterModel.setSourceModel(&m_model);
 }
 
 // delete late
@@ -65,6 +88,7 @@ void RegimeManager::setCurrentFilePath(const QUrl &url)
 {
     if (m_currentFilePath != url) {
         m_currentFilePath = url;
+        m_autosave.setJournalPath(url.isLocalFile() ? url.toLocalFile() + ".autosave" : QString());
         emit currentFilePathChanged();
     }
 }
@@ -76,6 +100,9 @@ bool RegimeManager::dirty() const
 
 void RegimeManager::setDirty(bool dirty)
 {
+    // Clean means "matches the file": later edits are compared against this version
+    if (!dirty)
+        m_savedHash = m_model.definitionHash();
     if (m_dirty != dirty) {
         m_dirty = dirty;
         emit dirtyChanged();
@@ -88,21 +115,29 @@ void RegimeManager::importRegimes(const QUrl &filePath)
     m_model.clear();
     m_model.setRegimes(regimes);
     setCurrentFilePath(filePath);
+    m_autosave.markSaved();
     setDirty(false);
+    setAutosaveAvailable(QFile::exists(m_autosave.journalPath()));
     emit totalTimeChanged();
 }
 
 void RegimeManager::exportRegimes(const QUrl &filePath)
 {
-    saveRegimesToFile(m_model.getRegimes(), filePath.toLocalFile());
+    if (!saveRegimesToFile(m_model.getRegimes(), filePath.toLocalFile()))
+        return;
     setCurrentFilePath(filePath);
+    m_autosave.discardJournal();
+    setAutosaveAvailable(false);
     setDirty(false);
 }
 
 void RegimeManager::saveRegimes()
 {
     if (m_currentFilePath.isEmpty() || !m_currentFilePath.isValid()) return;
-    saveRegimesToFile(m_model.getRegimes(), m_currentFilePath.toLocalFile());
+    if (!saveRegimesToFile(m_model.getRegimes(), m_currentFilePath.toLocalFile()))
+        return;
+    m_autosave.discardJournal();
+    setAutosaveAvailable(false);
     setDirty(false);
 }
 
@@ -113,45 +148,46 @@ void RegimeManager::loadDefaultRegimes()
     m_model.clear();
     m_model.setRegimes(regimes);
     setCurrentFilePath(QUrl::fromLocalFile(defaultFilePath));
+    m_autosave.markSaved();
     setDirty(false);
+    setAutosaveAvailable(QFile::exists(m_autosave.journalPath()));
     emit totalTimeChanged();
 }
 
 QList<Regime> RegimeManager::loadRegimesFromFile(const QString &filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Couldn't open file for reading:" << filePath;
-        return {};
-    }
-
-    QByteArray data = file.readAll();
-    QJsonDocument doc(QJsonDocument::fromJson(data));
-    QJsonArray regimesArray = doc.array();
-
-    QList<Regime> regimes;
-    for (const QJsonValue &value : regimesArray) {
-        regimes.append(Regime::fromJson(value.toObject()));
-    }
+    QList<Regime> regimes = ProgramFile::readJson(filePath, nullptr, &m_diagnostics);
+    if (ProgramValidator::hasErrors(m_diagnostics))
+        qWarning() << "loadRegimesFromFile:" << filePath << "has errors, it cannot be run until they are fixed";
+    emit diagnosticsChanged();
     return regimes;
 }
 
-void RegimeManager::saveRegimesToFile(const QList<Regime> &regimes, const QString &filePath)
+bool RegimeManager::validateProgram()
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "Couldn't open file for writing:" << filePath;
-        return;
-    }
+    m_diagnostics = ProgramValidator::validate(m_model.getRegimes(), m_workerPool);
+    emit diagnosticsChanged();
+    return !ProgramValidator::hasErrors(m_diagnostics);
+}
 
-    QJsonArray regimesArray;
-    for (const auto &regime : regimes) {
-        regimesArray.append(regime.toJson());
-    }
+const QList<ProgramDiagnostic> &RegimeManager::programDiagnostics() const
+{
+    return m_diagnostics;
+}
+
+QVariantList RegimeManager::diagnostics() const
+{
+    QVariantList list;
+    list.reserve(m_diagnostics.count());
+    for (const ProgramDiagnostic &diagnostic : m_diagnostics)
+        list.append(QVariant::fromValue(diagnostic));
+    return list;
+}
 
-    QJsonDocument doc(regimesArray);
-    file.write(doc.toJson());
-    file.close();
+bool RegimeManager::saveRegimesToFile(const QList<Regime> &regimes, const QString &filePath)
+{
+    // Temp file plus rename: an interrupted save keeps the previous file intact
+    return ProgramFile::writeJson(regimes, filePath);
 }
 
 void RegimeManager::updateTotalTime()
@@ -164,35 +200,210 @@ VisibleRegimeModel* RegimeManager::visibleRegimeModel()
     return &m_visibleRegimeModel;
 }
 
+CompletionForecaster* RegimeManager::forecaster()
+{
+    return &m_forecaster;
+}
+
+EtaEngine* RegimeManager::eta()
+{
+    return &m_eta;
+}
+
+PhaseClock* RegimeManager::phaseClock()
+{
+    return &m_phaseClock;
+}
+
+RegimeFilterModel* RegimeManager::filterModel()
+{
+    return &m_filterModel;
+}
+
+bool RegimeManager::setHistoryPath(const QString &filePath)
+{
+    if (filePath.isEmpty()) {
+        m_history.close();
+        return true;
+    }
+    return m_history.open(filePath);
+}
+
+const RunHistoryStore &RegimeManager::runHistory() const
+{
+    return m_history;
+}
+
+RunReportWriter* RegimeManager::reports()
+{
+    return &m_reports;
+}
+
+void RegimeManager::exportRowReport(const QUrl &filePath)
+{
+    const QString path = filePath.toLocalFile();
+    m_reports.writeRows(path, RunReport::formatForPath(path));
+}
+
+void RegimeManager::exportRepeatReport(const QUrl &filePath)
+{
+    if (!m_history.isOpen() || m_runId == 0) {
+        qWarning() << "exportRepeatReport: No run has been recorded";
+        return;
+    }
+    const QString path = filePath.toLocalFile();
+    m_reports.writeRepeats(path, m_history.filePath(), m_runId, RunReport::formatForPath(path));
+}
+
+void RegimeManager::recordRepeat(int row, int repeatIndex, RegimeEnums::State outcome, qint64 conditionMs, qint64 executionMs)
+{
+    if (!m_history.isOpen() || row < 0 || row >= m_model.rowCount())
+        return;
+
+    const Regime regime = m_model.getRegime(row);
+    RepeatRecord record;
+    record.runId = m_runId;
+    record.finishedAt = QDateTime::currentMSecsSinceEpoch();
+    record.programHash = m_model.definitionHash();
+    record.regimeName = regime.m_name;
+    record.repeatIndex = repeatIndex;
+    record.outcome = outcome;
+    record.plannedConditionSeconds = regime.conditionTimeInSeconds();
+    record.plannedExecutionSeconds = regime.m_maxTime;
+    record.conditionMs = conditionMs;
+    record.executionMs = executionMs;
+    m_history.append(record);
+}
+
 void RegimeManager::updateVisibleRegimes(int visibleStartTime, int visibleEndTime)
 {
+    const QList<Regime> regimes = m_model.getRegimes();
+    const CycleTree &tree = m_model.cycleTree();
+    const QList<qint64> &starts = tree.firstStartOffsets();
+
+    // Cycles are kept or dropped whole: they span from their first row to the end of their last pass
+    QHash<int, std::pair<qint64, qint64>> cycleSpans;
     QList<Regime> visibleRegimes;
-    int startTime = 0;
-    for (int i = 0; i < m_model.rowCount(); ++i)
+    QList<int> visibleRows;
+    for (int i = 0; i < regimes.count(); ++i)
     {
-        Regime regime = m_model.getRegime(i);
-        
-        // Calculate condition time in seconds
-        int conditionTimeInSeconds = 0;
-        if (regime.m_condition.type == "time" || regime.m_condition.type == "temp") {
-            conditionTimeInSeconds = regime.m_condition.time * 60; // Convert minutes to seconds
+        const Regime &regime = regimes.at(i);
+        qint64 startTime = starts.at(i);
+        qint64 endTime = startTime + tree.rowDuration(i);
+        if (regime.m_cycleId != -1) {
+            const int cycleId = regime.outermostCycleId();
+            if (!cycleSpans.contains(cycleId))
+                cycleSpans.insert(cycleId, {startTime, startTime + tree.cycleDuration(cycleId)});
+            std::tie(startTime, endTime) = cycleSpans.value(cycleId);
         }
-        
-        // Total regime time includes condition time
-        int totalRegimeTime = (conditionTimeInSeconds + regime.m_maxTime) * regime.m_repeatCount;
-        int endTime = startTime + totalRegimeTime;
-        
+
         if (endTime >= visibleStartTime && startTime <= visibleEndTime)
         {
             visibleRegimes.append(regime);
+            visibleRows.append(i);
         }
-        startTime = endTime;
     }
-    m_visibleRegimeModel.setRegimes(visibleRegimes);
+    m_visibleRegimeModel.setRegimes(visibleRegimes, visibleRows);
+}
+
+void RegimeManager::scheduleVisibleRefresh()
+{
+    // Not restarted on purpose: a steady stream of updates still refreshes once per interval
+    if (!m_refreshTimer.isActive())
+        m_refreshTimer.start();
+}
+
+int RegimeManager::refreshInterval() const
+{
+    return m_refreshTimer.interval();
+}
+
+void RegimeManager::setRefreshInterval(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (m_refreshTimer.interval() != milliseconds) {
+        m_refreshTimer.setInterval(milliseconds);
+        emit refreshIntervalChanged();
+    }
+}
+
+QVariantMap RegimeManager::memoryUsage() const
+{
+    QVariantMap usage = m_model.memoryUsage();
+    const int entries = m_visibleRegimeModel.rowCount();
+    usage.insert("timelineEntries", entries);
+    usage.insert("timelineBytesPerEntry", entries > 0 ? double(m_visibleRegimeModel.bytesUsed()) / entries : 0.0);
+    return usage;
+}
+
+void RegimeManager::setWorkerPool(QThreadPool *pool)
+{
+    m_forecaster.setThreadPool(pool);
+    m_workerPool = pool ? pool : QThreadPool::globalInstance();
+}
+
+ProgressIngestor* RegimeManager::progressIngestor()
+{
+    return &m_ingestor;
+}
+
+ConditionEvaluator* RegimeManager::conditionEvaluator()
+{
+    return &m_conditionEvaluator;
+}
+
+SensorTraceStore* RegimeManager::sensorTraces()
+{
+    return &m_sensorTraces;
+}
+
+AutosaveWorker* RegimeManager::autosave()
+{
+    return &m_autosave;
+}
+
+bool RegimeManager::isAutosaveAvailable() const
+{
+    return m_autosaveAvailable;
+}
+
+bool RegimeManager::restoreAutosave()
+{
+    if (!m_autosaveAvailable)
+        return false;
+
+    QList<Regime> regimes;
+    if (!AutosaveWorker::recover(m_autosave.journalPath(), regimes)) {
+        qWarning() << "restoreAutosave: Couldn't read" << m_autosave.journalPath();
+        return false;
+    }
+    // The file's hash stays the saved version, so the restored edits show as unsaved
+    m_model.clear();
+    m_model.setRegimes(regimes);
+    setAutosaveAvailable(false);
+    validateProgram();
+    emit totalTimeChanged();
+    return true;
+}
+
+void RegimeManager::discardAutosave()
+{
+    m_autosave.discardJournal();
+    setAutosaveAvailable(false);
+}
+
+void RegimeManager::setAutosaveAvailable(bool available)
+{
+    if (m_autosaveAvailable != available) {
+        m_autosaveAvailable = available;
+        emit autosaveAvailableChanged();
+    }
 }
 
 void RegimeManager::refreshVisibleRegimes()
 {
+    m_refreshTimer.stop();
+
     // Get current visible time range from TimeProgressBar or use full range
     int totalTime = getTotalEstimatedTime();
     if (totalTime > 0) {
@@ -293,29 +504,17 @@ int RegimeManager::getTimeLeftForCycle(int regimeId) const
     if (regimeId < 0 || regimeId >= m_model.rowCount())
         return 0;
 
-    int cycleId = m_model.data(m_model.index(regimeId, 0), ProtoTableModel::CycleIdRole).toInt();
+    const int cycleId = m_model.regimeAt(regimeId).m_cycleId;
     if (cycleId == -1)
         return getTimeLeftForRegime(regimeId);
 
-    int timeLeft = 0;
-    for (int i = 0; i < m_model.rowCount(); ++i)
-    {
-        if (m_model.data(m_model.index(i, 0), ProtoTableModel::CycleIdRole).toInt() == cycleId)
-        {
-            timeLeft += getTimeLeftForRegime(i) * getRepeatsLeft(i);
-        }
-    }
-    return timeLeft;
+    // Summed per cycle as progress arrives, nested cycles included
+    return int(m_model.cycleTree().cycleTimeLeft(cycleId));
 }
 
 int RegimeManager::getEstimatedTimeLeft() const
 {
-    int timeLeft = 0;
-    for (int i = 0; i < m_model.rowCount(); ++i)
-    {
-        timeLeft += getTimeLeftForRegime(i) * getRepeatsLeft(i);
-    }
-    return timeLeft;
+    return m_eta.secondsLeft();
 }
 
 int RegimeManager::getTotalTimeForRegime(int regimeId) const
@@ -348,26 +547,12 @@ int RegimeManager::getTotalTimeForCycle(int regimeId) const
     if (regimeId < 0 || regimeId >= m_model.rowCount())
         return 0;
 
-    Regime firstRegime = m_model.data(m_model.index(regimeId, 0), ProtoTableModel::RegimeRole).value<Regime>();
-    if (firstRegime.m_cycleId == -1)
+    const int cycleId = m_model.getRegime(regimeId).m_cycleId;
+    if (cycleId == -1)
         return getTotalTimeForRegime(regimeId);
 
-    int totalTimeForOneCycleIteration = 0;
-    for (int i = 0; i < m_model.rowCount(); ++i)
-    {
-        Regime currentRegime = m_model.data(m_model.index(i, 0), ProtoTableModel::RegimeRole).value<Regime>();
-        if (currentRegime.m_cycleId == firstRegime.m_cycleId)
-        {
-            // Calculate condition time in seconds for each regime in the cycle
-            int conditionTimeInSeconds = 0;
-            if (currentRegime.m_condition.type == "time" || currentRegime.m_condition.type == "temp") {
-                conditionTimeInSeconds = currentRegime.m_condition.time * 60; // Convert minutes to seconds
-            }
-            
-            totalTimeForOneCycleIteration += (conditionTimeInSeconds + currentRegime.m_maxTime) * currentRegime.m_repeatCount;
-        }
-    }
-    return totalTimeForOneCycleIteration * firstRegime.m_cycleRepeat;
+    // Cached per cycle, nested cycles included
+    return int(m_model.cycleTree().cycleDuration(cycleId));
 }
 
 int RegimeManager::getElapsedTimeForCycle(int regimeId) const
@@ -375,20 +560,11 @@ int RegimeManager::getElapsedTimeForCycle(int regimeId) const
     if (regimeId < 0 || regimeId >= m_model.rowCount())
         return 0;
 
-    Regime firstRegime = m_model.data(m_model.index(regimeId, 0), ProtoTableModel::RegimeRole).value<Regime>();
-    if (firstRegime.m_cycleId == -1)
+    const int cycleId = m_model.regimeAt(regimeId).m_cycleId;
+    if (cycleId == -1)
         return getElapsedTimeForRegime(regimeId);
 
-    int elapsedTime = 0;
-    for (int i = 0; i < m_model.rowCount(); ++i)
-    {
-        Regime currentRegime = m_model.data(m_model.index(i, 0), ProtoTableModel::RegimeRole).value<Regime>();
-        if (currentRegime.m_cycleId == firstRegime.m_cycleId)
-        {
-            elapsedTime += getElapsedTimeForRegime(i);
-        }
-    }
-    return elapsedTime;
+    return int(m_model.cycleTree().cycleElapsed(cycleId));
 }
 
 // ========== EXTERNAL MODULE API IMPLEMENTATION ==========
@@ -406,7 +582,22 @@ bool RegimeManager::startRegimeExecution(int regimeId)
         return false;
     }
     
-    // Reset execution tracking
+    // The first regime started on an untouched program begins a new run in the history
+    const QList<Regime> regimes = m_model.getRegimes();
+    const bool untouched = std::all_of(regimes.cbegin(), regimes.cend(), [](const Regime &regime) {
+        return regime.m_state == RegimeEnums::State::Waiting
+            && regime.m_repeatsDone + regime.m_repeatsSkipped + regime.m_repeatsError == 0;
+    });
+    // A program with errors is refused before anything of it runs
+    if (untouched && !validateProgram()) {
+        qWarning() << "startRegimeExecution: The program has errors, see diagnostics";
+        return false;
+    }
+    if (untouched || m_runId == 0)
+        m_runId = QDateTime::currentMSecsSinceEpoch();
+
+    // Reset execution tracking; the repeats start over, and so do their traces
+    m_sensorTraces.removeRow(regimeId);
     m_model.setData(m_model.index(regimeId, 0), 0, ProtoTableModel::CurrentRepeatRole);
     m_model.setData(m_model.index(regimeId, 0), false, ProtoTableModel::ConditionCompletedRole);
     m_model.setData(m_model.index(regimeId, 0), 0, ProtoTableModel::ConditionTimePassedRole);
@@ -415,8 +606,8 @@ bool RegimeManager::startRegimeExecution(int regimeId)
     // Set state to running
     setRegimeState(regimeId, RegimeEnums::State::Running);
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     
     qDebug() << "Started execution for regime" << regimeId;
     return true;
@@ -466,8 +657,8 @@ bool RegimeManager::updateConditionProgress(int regimeId, int conditionTimeElaps
     // Update condition progress
     m_model.setData(m_model.index(regimeId, 0), conditionTimeElapsed, ProtoTableModel::ConditionTimePassedRole);
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -505,8 +696,8 @@ bool RegimeManager::confirmConditionCompletion(int regimeId, int currentRepeat)
     
     qDebug() << "Condition completed for regime" << regimeId << "repeat" << currentRepeat;
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -545,8 +736,8 @@ bool RegimeManager::updateRegimeProgress(int regimeId, int regimeTimeElapsed, in
     // Update regime progress
     m_model.setData(m_model.index(regimeId, 0), regimeTimeElapsed, ProtoTableModel::RegimeTimePassedRole);
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -593,8 +784,8 @@ bool RegimeManager::completeCurrentRepeat(int regimeId, int currentRepeat)
         qDebug() << "Regime" << regimeId << "moved to repeat" << (currentRepeat + 1);
     }
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -615,8 +806,8 @@ bool RegimeManager::completeRegimeExecution(int regimeId)
     
     qDebug() << "Regime" << regimeId << "execution completed";
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -657,8 +848,8 @@ bool RegimeManager::skipCurrentRepeat(int regimeId, int currentRepeat)
         qDebug() << "Regime" << regimeId << "skipped repeat" << currentRepeat << "moved to repeat" << (currentRepeat + 1);
     }
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -700,8 +891,8 @@ bool RegimeManager::markRepeatAsError(int regimeId, int currentRepeat)
         qDebug() << "Regime" << regimeId << "error in repeat" << currentRepeat << "moved to repeat" << (currentRepeat + 1);
     }
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -753,6 +944,7 @@ bool RegimeManager::resetRegimeExecution(int regimeId)
     }
     
     // Reset all execution tracking
+    m_sensorTraces.removeRow(regimeId);
     m_model.setData(m_model.index(regimeId, 0), 0, ProtoTableModel::CurrentRepeatRole);
     m_model.setData(m_model.index(regimeId, 0), false, ProtoTableModel::ConditionCompletedRole);
     m_model.setData(m_model.index(regimeId, 0), 0, ProtoTableModel::ConditionTimePassedRole);
@@ -766,8 +958,8 @@ bool RegimeManager::resetRegimeExecution(int regimeId)
     
     qDebug() << "Reset execution for regime" << regimeId;
     
-    // Force immediate UI update
-    refreshVisibleRegimes();
+    // Coalesced UI update
+    scheduleVisibleRefresh();
     emit totalTimeChanged();
     return true;
 }
@@ -818,22 +1010,19 @@ int RegimeManager::getConditionTimeLeftForRegime(int regimeId) const
 
 int RegimeManager::getTotalEstimatedTime() const
 {
-    int totalTime = 0;
-    QSet<int> processedCycleIds;
+    return int(m_model.cycleTree().totalDuration());
+}
 
-    for (int i = 0; i < m_model.rowCount(); ++i)
-    {
-        Regime regime = m_model.data(m_model.index(i, 0), ProtoTableModel::RegimeRole).value<Regime>(); // to const auto& ?
-        if (regime.m_cycleId != -1) {
-            if (!processedCycleIds.contains(regime.m_cycleId)) {
-                totalTime += getTotalTimeForCycle(i);
-                processedCycleIds.insert(regime.m_cycleId);
-            }
-        } else {
-            totalTime += getTotalTimeForRegime(i);
-        }
-    }
-    return totalTime;
+QVariantMap RegimeManager::timelineColumns(quint64 knownVersion) const
+{
+    const ProgramSnapshotPtr snapshot = m_model.snapshot();
+    if (knownVersion != 0 && knownVersion == snapshot->version)
+        return {{"version", snapshot->version}, {"rowCount", int(snapshot->regimes.count())}};
+
+    // Repeated calls between changes hand out the same shared arrays
+    if (m_timelineColumns.version != snapshot->version)
+        m_timelineColumns = TimelineColumns::build(*snapshot);
+    return m_timelineColumns.toVariantMap();
 }
 
 int RegimeManager::getTotalElapsedTime() const
@@ -1,8 +1,21 @@
 #pragma once
 
 #include <QObject>
+#include <QTimer>
 #include <QUrl>
+#include "autosaveworker.h"
+#include "completionforecaster.h"
+#include "conditionevaluator.h"
+#include "etaengine.h"
+#include "phaseclock.h"
+#include "programvalidator.h"
+#include "progressingestor.h"
 #include "prototablemodel.h"
+#include "regimefiltermodel.h"
+#include "runhistory.h"
+#include "runreport.h"
+#include "sensortracestore.h"
+#include "timelinecolumns.h"
 #include "visibleregimemodel.h"
 
 class RegimeManager : public QObject
@@ -12,15 +25,30 @@ class RegimeManager : public QObject
     Q_PROPERTY(QUrl currentFilePath READ currentFilePath WRITE setCurrentFilePath NOTIFY currentFilePathChanged)
     Q_PROPERTY(bool dirty READ dirty WRITE setDirty NOTIFY dirtyChanged)
     Q_PROPERTY(VisibleRegimeModel* visibleRegimeModel READ visibleRegimeModel CONSTANT)
+    Q_PROPERTY(CompletionForecaster* forecaster READ forecaster CONSTANT)
+    Q_PROPERTY(EtaEngine* eta READ eta CONSTANT)
+    Q_PROPERTY(PhaseClock* phaseClock READ phaseClock CONSTANT)
+    Q_PROPERTY(ConditionEvaluator* conditionEvaluator READ conditionEvaluator CONSTANT)
+    Q_PROPERTY(SensorTraceStore* sensorTraces READ sensorTraces CONSTANT)
+    Q_PROPERTY(RegimeFilterModel* filterModel READ filterModel CONSTANT)
+    Q_PROPERTY(QVariantList diagnostics READ diagnostics NOTIFY diagnosticsChanged)
+    Q_PROPERTY(int refreshInterval READ refreshInterval WRITE setRefreshInterval NOTIFY refreshIntervalChanged)
+    Q_PROPERTY(AutosaveWorker* autosave READ autosave CONSTANT)
+    Q_PROPERTY(bool autosaveAvailable READ isAutosaveAvailable NOTIFY autosaveAvailableChanged)
+    Q_PROPERTY(RunReportWriter* reports READ reports CONSTANT)
 
 public:
     explicit RegimeManager(QObject *parent = nullptr);
+    /// Creates a manager that starts from an empty program unless loadDefaultProfile is set
+    RegimeManager(bool loadDefaultProfile, QObject *parent);
 
     ProtoTableModel* model();
     QUrl currentFilePath() const;
     void setCurrentFilePath(const QUrl &url);
 
+    /// True while the program definition differs from the last loaded or saved file
     bool dirty() const;
+    /// setDirty(false) records the current definition hash as the saved version
     void setDirty(bool dirty);
 
     Q_INVOKABLE void loadDefaultRegimes();
@@ -28,7 +56,22 @@ public:
     Q_INVOKABLE void exportRegimes(const QUrl &filePath);
     Q_INVOKABLE void saveRegimes();
 
+    /// Checks the current program with ProgramValidator; false if it has errors
+    Q_INVOKABLE bool validateProgram();
+    /// Result of the last validation or file load, sorted by row
+    const QList<ProgramDiagnostic> &programDiagnostics() const;
+    /// programDiagnostics() as a list of ProgramDiagnostic gadgets for QML
+    QVariantList diagnostics() const;
+
     VisibleRegimeModel* visibleRegimeModel();
+    /// Monte Carlo P50/P90/P99 forecast of the remaining program time
+    CompletionForecaster* forecaster();
+    /// Time left and projected finish, corrected by the phase durations observed in this run
+    EtaEngine* eta();
+    /// Progress of the running rows extrapolated between driver reports, for per-frame redraws
+    PhaseClock* phaseClock();
+    /// The table narrowed by name, condition type and state for the search field
+    RegimeFilterModel* filterModel();
 
     Q_INVOKABLE void setRegimeState(int regimeId, RegimeEnums::State state);
     Q_INVOKABLE int getRepeatsDone(int regimeId) const;
@@ -39,7 +82,7 @@ public:
     Q_INVOKABLE int getTimeLeftForRegime(int regimeId) const;
     // Returns the time left for a specific cycle in seconds.
     Q_INVOKABLE int getTimeLeftForCycle(int regimeId) const;
-    // Returns the total estimated time left for all regimes in seconds.
+    // Returns the total estimated time left for all regimes in seconds, condition phases and observed durations included.
     Q_INVOKABLE int getEstimatedTimeLeft() const;
 
     // Returns the total time for a specific regime in seconds.
@@ -57,9 +100,56 @@ public:
 
     Q_INVOKABLE void updateTotalTime();
     Q_INVOKABLE void updateVisibleRegimes(int visibleStartTime, int visibleEndTime);
+
+    /**
+     * @brief Whole program as typed columns (ArrayBuffers) in one call, see TimelineColumns
+     * @param knownVersion Version the caller already holds; while it is current only
+     *        {version, rowCount} is returned and the caller keeps its arrays
+     */
+    Q_INVOKABLE QVariantMap timelineColumns(quint64 knownVersion = 0) const;
+
+    /// ProtoTableModel::memoryUsage() plus {timelineEntries, timelineBytesPerEntry} of VisibleRegimeModel
+    Q_INVOKABLE QVariantMap memoryUsage() const;
     
     /// Forces refresh of VisibleRegimeModel with current data
     void refreshVisibleRegimes();
+    /// Schedules a coalesced refresh of VisibleRegimeModel (at most one per refreshInterval)
+    void scheduleVisibleRefresh();
+
+    /// Minimum delay in milliseconds between two VisibleRegimeModel refreshes
+    int refreshInterval() const;
+    void setRefreshInterval(int milliseconds);
+
+    /// Thread pool for background analytics (shared between stations)
+    void setWorkerPool(QThreadPool *pool);
+
+    /// Lock-free queue for progress reports posted from acquisition threads
+    ProgressIngestor* progressIngestor();
+    /// Confirms "temp" and "time" conditions from sensor samples and the phase clock
+    ConditionEvaluator* conditionEvaluator();
+    /// Temperature samples of every repeat, downsampled for the timeline
+    SensorTraceStore* sensorTraces();
+
+    /// Background journal of definition changes, kept next to the current file as "<file>.autosave"
+    AutosaveWorker* autosave();
+    /// The file just loaded has a journal of edits that were never saved, e.g. after a crash
+    bool isAutosaveAvailable() const;
+    /// Replaces the loaded program with the one in the journal; it stays dirty until saved
+    Q_INVOKABLE bool restoreAutosave();
+    /// Deletes the journal and keeps the program as loaded from the file
+    Q_INVOKABLE void discardAutosave();
+
+    /// Opens the run-history file every finished repeat is recorded to; an empty path stops recording
+    bool setHistoryPath(const QString &filePath);
+    /// Observed durations of past runs, queried by regime name or program hash
+    const RunHistoryStore &runHistory() const;
+
+    /// Writes run reports off the GUI thread
+    RunReportWriter* reports();
+    /// Queues the per-row report of the program (columnar for ".grr", CSV otherwise)
+    Q_INVOKABLE void exportRowReport(const QUrl &filePath);
+    /// Queues the per-repeat report of the current or last run from the run history
+    Q_INVOKABLE void exportRepeatReport(const QUrl &filePath);
     
     /// Returns the condition time passed for a specific regime in seconds
     Q_INVOKABLE int getConditionTimePassedForRegime(int regimeId) const;
@@ -157,13 +247,35 @@ signals:
     void dirtyChanged();
     void totalTimeChanged();
     void stateChanged(int regimeIndex, RegimeEnums::State state, int timePassedInSeconds);
-    void regimeDataUpdated(); // Signal for immediate UI refresh
+    void regimeDataUpdated(); // Emitted once per coalesced refresh after model changes
+    void refreshIntervalChanged();
+    void diagnosticsChanged();
+    void autosaveAvailableChanged();
 
 private:
     ProtoTableModel m_model;
     VisibleRegimeModel m_visibleRegimeModel;
+    CompletionForecaster m_forecaster;
+    EtaEngine m_eta;
+    PhaseClock m_phaseClock;
+    RegimeFilterModel m_filterModel;
+    QTimer m_refreshTimer;
+    ProgressIngestor m_ingestor;
+    ConditionEvaluator m_conditionEvaluator;
+    SensorTraceStore m_sensorTraces;
+    AutosaveWorker m_autosave;
+    RunReportWriter m_reports;
     QUrl m_currentFilePath;
     bool m_dirty = false;
+    bool m_autosaveAvailable = false;
+    quint64 m_savedHash = 0;
+    mutable TimelineColumns m_timelineColumns;
+    RunHistoryStore m_history;
+    QList<ProgramDiagnostic> m_diagnostics;
+    QThreadPool *m_workerPool = QThreadPool::globalInstance();
+    qint64 m_runId = 0;
+    void recordRepeat(int row, int repeatIndex, RegimeEnums::State outcome, qint64 conditionMs, qint64 executionMs);
     QList<Regime> loadRegimesFromFile(const QString &filePath);
-    void saveRegimesToFile(const QList<Regime> &regimes, const QString &filePath);
+    bool saveRegimesToFile(const QList<Regime> &regimes, const QString &filePath);
+    void setAutosaveAvailable(bool available);
 };
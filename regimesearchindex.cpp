@@ -0,0 +1,185 @@
+#include "regimesearchindex.h"
+#include <algorithm>
+
+RegimeSearchIndex::Keys RegimeSearchIndex::keysOf(const Regime &regime)
+{
+    Keys keys;
+    keys.name = regime.m_name.toCaseFolded();
+    keys.conditionType = regime.m_condition.type;
+    keys.state = int(regime.m_state);
+    return keys;
+}
+
+QList<quint64> RegimeSearchIndex::trigramsOf(const QString &text)
+{
+    QList<quint64> trigrams;
+    for (qsizetype i = 0; i + 3 <= text.size(); ++i) {
+        trigrams.append(quint64(text.at(i).unicode()) << 32
+                        | quint64(text.at(i + 1).unicode()) << 16
+                        | quint64(text.at(i + 2).unicode()));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+void RegimeSearchIndex::addRow(QList<int> &bucket, int row)
+{
+    // Rebuilds and appended rows arrive in order
+    if (bucket.isEmpty() || bucket.last() < row) {
+        bucket.append(row);
+        return;
+    }
+    auto it = std::lower_bound(bucket.begin(), bucket.end(), row);
+    if (it == bucket.end() || *it != row)
+        bucket.insert(it, row);
+}
+
+void RegimeSearchIndex::removeRow(QList<int> &bucket, int row)
+{
+    auto it = std::lower_bound(bucket.begin(), bucket.end(), row);
+    if (it != bucket.end() && *it == row)
+        bucket.erase(it);
+}
+
+void RegimeSearchIndex::reset(const QList<Regime> &regimes)
+{
+    m_keys.clear();
+    m_keys.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        m_keys.append(keysOf(regime));
+    rebuild();
+}
+
+void RegimeSearchIndex::updateRow(int row, const Regime &regime)
+{
+    if (row < 0 || row >= m_keys.count())
+        return;
+
+    Keys keys = keysOf(regime);
+    const Keys &current = m_keys.at(row);
+    if (!m_stale) {
+        // Progress updates usually change only the state; touch just the buckets that differ
+        if (keys.name != current.name) {
+            for (quint64 trigram : trigramsOf(current.name))
+                removeRow(m_trigrams[trigram], row);
+            for (quint64 trigram : trigramsOf(keys.name))
+                addRow(m_trigrams[trigram], row);
+        }
+        if (keys.conditionType != current.conditionType) {
+            removeRow(m_conditionTypes[current.conditionType], row);
+            addRow(m_conditionTypes[keys.conditionType], row);
+        }
+        if (keys.state != current.state) {
+            removeRow(m_states[current.state], row);
+            addRow(m_states[keys.state], row);
+        }
+    }
+    m_keys[row] = std::move(keys);
+}
+
+bool RegimeSearchIndex::updateState(int row, RegimeEnums::State state)
+{
+    if (row < 0 || row >= m_keys.count() || m_keys.at(row).state == int(state))
+        return false;
+
+    Keys &keys = m_keys[row];
+    if (!m_stale) {
+        removeRow(m_states[keys.state], row);
+        addRow(m_states[int(state)], row);
+    }
+    keys.state = int(state);
+    return true;
+}
+
+void RegimeSearchIndex::insertRows(int row, const QList<Regime> &regimes)
+{
+    QList<Keys> keys;
+    keys.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        keys.append(keysOf(regime));
+    m_keys.insert(row, regimes.count(), Keys());
+    std::move(keys.begin(), keys.end(), m_keys.begin() + row);
+    m_stale = true;
+}
+
+void RegimeSearchIndex::removeRows(int row, int count)
+{
+    m_keys.remove(row, count);
+    m_stale = true;
+}
+
+int RegimeSearchIndex::rowCount() const
+{
+    return int(m_keys.count());
+}
+
+bool RegimeSearchIndex::matches(int row, const Query &query) const
+{
+    const Keys &keys = m_keys.at(row);
+    return (query.state < 0 || keys.state == query.state)
+        && (query.conditionType.isEmpty() || keys.conditionType == query.conditionType)
+        && (query.text.isEmpty() || keys.name.contains(query.text, Qt::CaseInsensitive));
+}
+
+QList<int> RegimeSearchIndex::find(const Query &query)
+{
+    if (m_stale)
+        rebuild();
+
+    // Candidate lists every match must be in; a missing key means no match at all
+    static const QList<int> noRows;
+    QList<const QList<int> *> buckets;
+    auto addBucket = [&buckets](const auto &hash, const auto &key) {
+        const auto it = hash.constFind(key);
+        buckets.append(it == hash.cend() ? &noRows : &it.value());
+    };
+    if (!query.conditionType.isEmpty())
+        addBucket(m_conditionTypes, query.conditionType);
+    if (query.state >= 0)
+        addBucket(m_states, query.state);
+    for (quint64 trigram : trigramsOf(query.text.toCaseFolded()))
+        addBucket(m_trigrams, trigram);
+
+    QList<int> result;
+    if (buckets.isEmpty()) {
+        // Text too short for trigrams
+        for (int row = 0; row < m_keys.count(); ++row) {
+            if (matches(row, query))
+                result.append(row);
+        }
+        return result;
+    }
+
+    // The shortest list drives, the others are probed; matches() confirms the trigram order
+    std::sort(buckets.begin(), buckets.end(), [](const QList<int> *a, const QList<int> *b) {
+        return a->count() < b->count();
+    });
+    for (int row : *buckets.first()) {
+        bool inAll = true;
+        for (qsizetype i = 1; i < buckets.count() && inAll; ++i)
+            inAll = std::binary_search(buckets.at(i)->cbegin(), buckets.at(i)->cend(), row);
+        if (inAll && matches(row, query))
+            result.append(row);
+    }
+    return result;
+}
+
+void RegimeSearchIndex::indexRow(int row)
+{
+    const Keys &keys = m_keys.at(row);
+    for (quint64 trigram : trigramsOf(keys.name))
+        addRow(m_trigrams[trigram], row);
+    addRow(m_conditionTypes[keys.conditionType], row);
+    addRow(m_states[keys.state], row);
+}
+
+void RegimeSearchIndex::rebuild()
+{
+    m_trigrams.clear();
+    m_conditionTypes.clear();
+    m_states.clear();
+    for (int row = 0; row < m_keys.count(); ++row)
+        indexRow(row);
+    m_stale = false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "regime.h"
+
+/**
+ * @brief Search index over the rows of a program: name trigrams, condition type and state buckets
+ *
+ * Every bucket is a sorted list of rows, so a query intersects the shortest candidate lists
+ * first and only checks the rows left over. Editing a row moves it between buckets in
+ * O(log n + bucket) per changed key. Inserted, removed or moved rows shift the row numbers
+ * of every bucket, so structural changes only update the per-row keys and the buckets are
+ * rebuilt on the next find().
+ */
+class RegimeSearchIndex
+{
+public:
+    struct Query {
+        QString text;               // Case-insensitive substring of the regime name
+        QString conditionType;      // Empty matches any condition
+        int state = -1;             // RegimeEnums::State, -1 matches any state
+
+        bool isEmpty() const { return text.isEmpty() && conditionType.isEmpty() && state < 0; }
+    };
+
+    void reset(const QList<Regime> &regimes);
+    void updateRow(int row, const Regime &regime);
+    /// Moves the row to the bucket of state; returns false if it was already there
+    bool updateState(int row, RegimeEnums::State state);
+    void insertRows(int row, const QList<Regime> &regimes);
+    void removeRows(int row, int count);
+    int rowCount() const;
+
+    /// Checks one row against query without the buckets
+    bool matches(int row, const Query &query) const;
+    /// All matching rows in ascending order
+    QList<int> find(const Query &query);
+
+private:
+    struct Keys {
+        QString name;               // Case-folded
+        QString conditionType;
+        int state = 0;
+    };
+
+    static Keys keysOf(const Regime &regime);
+    /// Trigrams of text packed into 48 bits, without duplicates
+    static QList<quint64> trigramsOf(const QString &text);
+    static void addRow(QList<int> &bucket, int row);
+    static void removeRow(QList<int> &bucket, int row);
+    void indexRow(int row);
+    void rebuild();
+
+    QList<Keys> m_keys;
+    QHash<quint64, QList<int>> m_trigrams;
+    QHash<QString, QList<int>> m_conditionTypes;
+    QHash<int, QList<int>> m_states;
+    bool m_stale = false;
+};
@@ -0,0 +1,236 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMap>
+#include <QTextStream>
+#include "cycletree.h"
+#include "etaengine.h"
+#include "programfile.h"
+#include "programvalidator.h"
+#include "regime.h"
+#include "runhistory.h"
+#include "runreport.h"
+
+// Headless counterpart of the table: works on program and history files with QtCore only
+
+namespace {
+
+enum ExitCode {
+    Success = 0,
+    Failure = 1,    // Invalid program or I/O error
+    Usage = 2
+};
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+bool isJson(const QString &filePath)
+{
+    return QFileInfo(filePath).suffix().compare("json", Qt::CaseInsensitive) == 0;
+}
+
+// JSON program or binary journal (anything but ".json"), validated either way
+bool readProgram(const QString &filePath, QList<Regime> &regimes, QList<ProgramDiagnostic> &diagnostics)
+{
+    bool ok = false;
+    if (isJson(filePath)) {
+        regimes = ProgramFile::readJson(filePath, &ok, &diagnostics);
+    } else {
+        ok = ProgramJournal::read(filePath, regimes);
+        if (ok)
+            diagnostics = ProgramValidator::validate(regimes);
+    }
+    if (!ok)
+        err() << "Couldn't read program " << filePath << Qt::endl;
+    return ok;
+}
+
+QString formatDuration(qint64 seconds)
+{
+    return QString("%1:%2:%3")
+        .arg(seconds / 3600)
+        .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+        .arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+int validate(const QString &filePath)
+{
+    QList<Regime> regimes;
+    QList<ProgramDiagnostic> diagnostics;
+    if (!readProgram(filePath, regimes, diagnostics))
+        return Failure;
+
+    for (const ProgramDiagnostic &diagnostic : diagnostics) {
+        out() << (diagnostic.isError() ? "error" : "warning");
+        if (diagnostic.row >= 0)
+            out() << " row " << diagnostic.row;
+        if (!diagnostic.field.isEmpty())
+            out() << " " << diagnostic.field;
+        out() << ": " << diagnostic.message << '\n';
+    }
+    out() << regimes.count() << " rows, " << diagnostics.count() << " diagnostics" << Qt::endl;
+    return ProgramValidator::hasErrors(diagnostics) ? Failure : Success;
+}
+
+int convert(const QString &inputPath, const QString &outputPath)
+{
+    QList<Regime> regimes;
+    QList<ProgramDiagnostic> diagnostics;
+    if (!readProgram(inputPath, regimes, diagnostics))
+        return Failure;
+
+    const bool written = isJson(outputPath) ? ProgramFile::writeJson(regimes, outputPath)
+                                            : ProgramJournal(outputPath).compact(regimes);
+    if (!written) {
+        err() << "Couldn't write " << outputPath << Qt::endl;
+        return Failure;
+    }
+    return Success;
+}
+
+int totals(const QString &filePath, bool perRow)
+{
+    QList<Regime> regimes;
+    QList<ProgramDiagnostic> diagnostics;
+    if (!readProgram(filePath, regimes, diagnostics))
+        return Failure;
+
+    CycleTree tree;
+    tree.rebuild(regimes);
+    qint64 repeats = 0;
+    EtaEngine::Remaining remaining;
+    for (int row = 0; row < regimes.count(); ++row) {
+        const Regime &regime = regimes.at(row);
+        const EtaEngine::Remaining left = EtaEngine::remainingFor(regime);
+        repeats += regime.m_repeatCount * regime.cyclePasses();
+        remaining.condition += left.condition;
+        remaining.execution += left.execution;
+        if (perRow)
+            out() << row << '\t' << regime.m_name << '\t' << formatDuration(tree.rowDuration(row)) << '\n';
+    }
+
+    const qint64 left = remaining.condition + remaining.execution;
+    out() << "rows:      " << regimes.count() << '\n'
+          << "repeats:   " << repeats << '\n'
+          << "planned:   " << formatDuration(tree.totalDuration()) << '\n'
+          << "left:      " << formatDuration(left)
+          << " (condition " << formatDuration(remaining.condition)
+          << ", execution " << formatDuration(remaining.execution) << ")\n"
+          << "finish:    " << QDateTime::currentDateTime().addSecs(left).toString(Qt::ISODate) << Qt::endl;
+    return ProgramValidator::hasErrors(diagnostics) ? Failure : Success;
+}
+
+int timeline(const QString &filePath)
+{
+    QList<Regime> regimes;
+    QList<ProgramDiagnostic> diagnostics;
+    if (!readProgram(filePath, regimes, diagnostics))
+        return Failure;
+    if (ProgramValidator::hasErrors(diagnostics)) {
+        err() << filePath << " has errors, run validate for details" << Qt::endl;
+        return Failure;
+    }
+
+    // One line per planned repeat, in the order they run; names are quoted as in run reports
+    CycleTree tree;
+    tree.rebuild(regimes);
+    qint64 start = 0;
+    out() << "start_s,row,repeat,cycle_pass,condition_s,execution_s,name\n";
+    tree.forEachRepeat([&](int row, int repeat, int cyclePass) {
+        const Regime &regime = regimes.at(row);
+        const int condition = regime.conditionTimeInSeconds();
+        out() << start << ',' << row << ',' << repeat << ',' << cyclePass << ','
+              << condition << ',' << regime.m_maxTime << ',' << RunReport::csvField(regime.m_name) << '\n';
+        start += condition + regime.m_maxTime;
+    });
+    out().flush();
+    return Success;
+}
+
+int stats(const QString &historyPath)
+{
+    struct RegimeStats {
+        qint64 done = 0;
+        qint64 skipped = 0;
+        qint64 error = 0;
+    };
+
+    RunHistoryStore history;
+    if (!history.open(historyPath))
+        return Failure;
+
+    QMap<QString, RegimeStats> byRegime;
+    for (int i = 0; i < history.recordCount(); ++i) {
+        const RepeatRecord &record = history.record(i);
+        RegimeStats &regime = byRegime[record.regimeName];
+        if (record.outcome == RegimeEnums::State::Skipped)
+            ++regime.skipped;
+        else if (record.outcome == RegimeEnums::State::Error)
+            ++regime.error;
+        else
+            ++regime.done;
+    }
+
+    out() << "regime,done,skipped,error,median_condition_s,median_execution_s\n";
+    for (auto it = byRegime.cbegin(); it != byRegime.cend(); ++it) {
+        out() << RunReport::csvField(it.key()) << ',' << it->done << ',' << it->skipped << ',' << it->error << ','
+              << history.median(it.key(), RunHistoryStore::Measure::ConditionTime) << ','
+              << history.median(it.key(), RunHistoryStore::Measure::ExecutionTime) << '\n';
+    }
+    out() << history.recordCount() << " repeats" << Qt::endl;
+    return Success;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("regimetool");
+    QCoreApplication::setApplicationVersion("1.0.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Works on GRAMs program and run-history files without a display.\n\n"
+        "Commands:\n"
+        "  validate <program>        Lists the diagnostics of a program\n"
+        "  convert <input> <output>  Converts between JSON and the binary journal by suffix\n"
+        "  totals <program>          Planned totals and the finish time if started now\n"
+        "  timeline <program>        Every planned repeat as CSV\n"
+        "  stats <history>           Outcomes and median phase times per regime\n\n"
+        "Files not ending in .json are read and written as binary journals.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command", "validate, convert, totals, timeline or stats");
+    parser.addPositionalArgument("files", "Input (and output) files", "<files...>");
+    const QCommandLineOption rowsOption("rows", "totals: also list the planned time of every row");
+    parser.addOption(rowsOption);
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    const QString command = arguments.value(0);
+    const int files = int(arguments.count()) - 1;
+    if (command == "validate" && files == 1)
+        return validate(arguments.at(1));
+    if (command == "convert" && files == 2)
+        return convert(arguments.at(1), arguments.at(2));
+    if (command == "totals" && files == 1)
+        return totals(arguments.at(1), parser.isSet(rowsOption));
+    if (command == "timeline" && files == 1)
+        return timeline(arguments.at(1));
+    if (command == "stats" && files == 1)
+        return stats(arguments.at(1));
+
+    err() << parser.helpText();
+    return Usage;
+}
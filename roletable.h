@@ -0,0 +1,151 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVariant>
+#include <array>
+#include <type_traits>
+
+/**
+ * @brief Describes one item model role: its id, QML name, accessors and side effects
+ *
+ * Getters receive the whole item list and the row, so roles derived from neighbouring
+ * rows (cycle spans) fit the same shape as plain field reads. A setter validates the
+ * value and writes the item; it returns false and leaves the item untouched on invalid
+ * input. Read-only roles have no setter.
+ */
+template <typename Item>
+struct RoleDescriptor {
+    using Getter = QVariant (*)(const QList<Item> &items, qsizetype row);
+    using Setter = bool (*)(Item &item, const QVariant &value);
+
+    enum Flag : quint8 {
+        NoFlags = 0,
+        Definition = 0x1,   ///< Edits the program definition (undo history, dirty tracking, total time)
+        CycleWide = 0x2     ///< Writing one row of a cycle writes every row of that cycle
+    };
+
+    int role = 0;
+    const char *name = nullptr;
+    Getter get = nullptr;
+    Setter set = nullptr;
+    quint8 flags = NoFlags;
+    /// Further roles whose value changes with this one; -1 ends the list
+    std::array<int, 2> dependents = {-1, -1};
+};
+
+/**
+ * @brief Role dispatch over a constexpr descriptor array
+ *
+ * Descriptors must list consecutive role ids starting at firstRole, so lookup is an array
+ * index instead of a compare chain. Tables are declared as constexpr arrays next to the
+ * model and checked with isContiguous() in a static_assert.
+ */
+template <typename Item>
+class RoleTable
+{
+public:
+    using Descriptor = RoleDescriptor<Item>;
+
+    template <std::size_t N>
+    constexpr RoleTable(const std::array<Descriptor, N> &descriptors)
+        : m_descriptors(descriptors.data())
+        , m_count(int(N))
+        , m_firstRole(N > 0 ? descriptors[0].role : 0)
+    {
+    }
+
+    template <std::size_t N>
+    static constexpr bool isContiguous(const std::array<Descriptor, N> &descriptors)
+    {
+        for (std::size_t i = 0; i < N; ++i) {
+            if (descriptors[i].role != descriptors[0].role + int(i) || !descriptors[i].get)
+                return false;
+        }
+        return true;
+    }
+
+    /// Descriptor for role, nullptr if the table does not know it
+    constexpr const Descriptor *find(int role) const
+    {
+        const int offset = role - m_firstRole;
+        return offset >= 0 && offset < m_count ? &m_descriptors[offset] : nullptr;
+    }
+
+    constexpr bool hasFlag(int role, quint8 flag) const
+    {
+        const Descriptor *descriptor = find(role);
+        return descriptor && (descriptor->flags & flag);
+    }
+
+    /// Role plus its dependents, as passed to dataChanged
+    QList<int> changedRoles(int role) const
+    {
+        QList<int> roles{role};
+        if (const Descriptor *descriptor = find(role)) {
+            for (int dependent : descriptor->dependents) {
+                if (dependent < 0)
+                    break;
+                roles.append(dependent);
+            }
+        }
+        return roles;
+    }
+
+    /// Role names for roleNames(); build once and keep it in a function-local static
+    QHash<int, QByteArray> roleNames() const
+    {
+        QHash<int, QByteArray> names;
+        names.reserve(m_count);
+        for (int i = 0; i < m_count; ++i)
+            names.insert(m_descriptors[i].role, m_descriptors[i].name);
+        return names;
+    }
+
+private:
+    const Descriptor *m_descriptors;
+    int m_count;
+    int m_firstRole;
+};
+
+template <typename T>
+struct MemberPointerTraits;
+
+template <typename Class, typename Field>
+struct MemberPointerTraits<Field Class::*> {
+    using ClassType = Class;
+    using FieldType = Field;
+};
+
+/// Follows a chain of member pointers, e.g. memberAt<&Entry::regime, &Regime::m_name>(entry);
+/// pointer fields along the chain are dereferenced
+template <auto First, auto... Rest, typename Object>
+constexpr auto &memberAt(Object &object)
+{
+    if constexpr (sizeof...(Rest) == 0) {
+        return object.*First;
+    } else {
+        auto &next = object.*First;
+        if constexpr (std::is_pointer_v<std::remove_reference_t<decltype(next)>>)
+            return memberAt<Rest...>(*next);
+        else
+            return memberAt<Rest...>(next);
+    }
+}
+
+/// RoleDescriptor getter reading a (nested) field of the item
+template <auto First, auto... Rest>
+QVariant readMember(const QList<typename MemberPointerTraits<decltype(First)>::ClassType> &items, qsizetype row)
+{
+    return QVariant::fromValue(memberAt<First, Rest...>(items.at(row)));
+}
+
+/// RoleDescriptor setter writing a (nested) field of the item without validation
+template <auto First, auto... Rest>
+bool writeMember(typename MemberPointerTraits<decltype(First)>::ClassType &item, const QVariant &value)
+{
+    auto &field = memberAt<First, Rest...>(item);
+    field = value.value<std::remove_reference_t<decltype(field)>>();
+    return true;
+}
@@ -0,0 +1,163 @@
+#include "rowranges.h"
+#include <algorithm>
+
+RowRanges::RowRanges(std::initializer_list<int> rows)
+    : RowRanges(fromRows(QList<int>(rows)))
+{
+}
+
+RowRanges RowRanges::fromRows(QList<int> rows)
+{
+    std::sort(rows.begin(), rows.end());
+    RowRanges result;
+    for (int row : rows)
+        result.add(row, row);
+    return result;
+}
+
+RowRanges RowRanges::fromSelection(const QItemSelection &selection)
+{
+    RowRanges result;
+    for (const QItemSelectionRange &range : selection) {
+        if (range.isValid())
+            result.add(range.top(), range.bottom());
+    }
+    return result;
+}
+
+RowRanges RowRanges::fromVariant(const QVariant &value)
+{
+    if (value.metaType() == QMetaType::fromType<RowRanges>())
+        return value.value<RowRanges>();
+    if (value.metaType() == QMetaType::fromType<QItemSelection>())
+        return fromSelection(value.value<QItemSelection>());
+
+    // Rows are sorted once; [first, last] pairs are taken as they come
+    const QVariantList list = value.toList();
+    QList<int> rows;
+    RowRanges result;
+    for (const QVariant &item : list) {
+        if (item.metaType() == QMetaType::fromType<QVariantList>()) {
+            const QVariantList pair = item.toList();
+            if (pair.count() == 2)
+                result.add(pair.at(0).toInt(), pair.at(1).toInt());
+            continue;
+        }
+        bool ok = false;
+        const int row = item.toInt(&ok);
+        if (ok)
+            rows.append(row);
+    }
+    if (!rows.isEmpty()) {
+        std::sort(rows.begin(), rows.end());
+        for (int row : rows)
+            result.add(row, row);
+    }
+    return result;
+}
+
+void RowRanges::add(int first, int last)
+{
+    if (last < first)
+        return;
+
+    // Common case: ascending input extends or follows the last range
+    if (m_ranges.isEmpty() || first > m_ranges.last().last + 1) {
+        m_ranges.append({first, last});
+        m_rowCount += last - first + 1;
+        return;
+    }
+
+    // First range that could touch [first, last]
+    auto it = std::lower_bound(m_ranges.begin(), m_ranges.end(), first,
+                               [](const Range &range, int row) { return range.last + 1 < row; });
+    auto end = it;
+    Range merged{first, last};
+    while (end != m_ranges.end() && end->first <= last + 1) {
+        merged.first = qMin(merged.first, end->first);
+        merged.last = qMax(merged.last, end->last);
+        m_rowCount -= end->count();
+        ++end;
+    }
+    const qsizetype index = it - m_ranges.begin();
+    m_ranges.erase(it, end);
+    m_ranges.insert(index, merged);
+    m_rowCount += merged.count();
+}
+
+bool RowRanges::isEmpty() const
+{
+    return m_ranges.isEmpty();
+}
+
+int RowRanges::rangeCount() const
+{
+    return int(m_ranges.count());
+}
+
+int RowRanges::rowCount() const
+{
+    return m_rowCount;
+}
+
+int RowRanges::first() const
+{
+    return m_ranges.isEmpty() ? -1 : m_ranges.first().first;
+}
+
+int RowRanges::last() const
+{
+    return m_ranges.isEmpty() ? -1 : m_ranges.last().last;
+}
+
+bool RowRanges::contains(int row) const
+{
+    auto it = std::lower_bound(m_ranges.cbegin(), m_ranges.cend(), row,
+                               [](const Range &range, int value) { return range.last < value; });
+    return it != m_ranges.cend() && it->first <= row;
+}
+
+const QList<RowRanges::Range> &RowRanges::ranges() const
+{
+    return m_ranges;
+}
+
+QList<int> RowRanges::rows() const
+{
+    QList<int> result;
+    result.reserve(m_rowCount);
+    for (const Range &range : m_ranges) {
+        for (int row = range.first; row <= range.last; ++row)
+            result.append(row);
+    }
+    return result;
+}
+
+RowRanges RowRanges::clipped(int rowCount) const
+{
+    RowRanges result;
+    for (const Range &range : m_ranges)
+        result.add(qMax(range.first, 0), qMin(range.last, rowCount - 1));
+    return result;
+}
+
+QVariantList RowRanges::toVariantList() const
+{
+    QVariantList result;
+    result.reserve(m_ranges.count());
+    for (const Range &range : m_ranges)
+        result.append(QVariant(QVariantList{range.first, range.last}));
+    return result;
+}
+
+void RowRanges::registerConverters()
+{
+    static const bool registered = [] {
+        QMetaType::registerConverter<QVariantList, RowRanges>([](const QVariantList &list) {
+            return fromVariant(list);
+        });
+        QMetaType::registerConverter<QItemSelection, RowRanges>(&RowRanges::fromSelection);
+        return true;
+    }();
+    Q_UNUSED(registered);
+}
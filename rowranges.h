@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QItemSelection>
+#include <QList>
+#include <QMetaType>
+#include <QVariant>
+#include <initializer_list>
+
+/**
+ * @brief A selection of table rows as sorted, disjoint, non-adjacent intervals
+ *
+ * Selections of thousands of rows are usually a handful of blocks, so operations that
+ * take a RowRanges cost O(ranges + affected rows) instead of converting, sorting and
+ * searching per-row lists. QML may pass an ItemSelectionModel selection, an array of
+ * [first, last] pairs or, as before, an array of row numbers wherever a RowRanges is
+ * expected (see registerConverters()).
+ */
+class RowRanges
+{
+    Q_GADGET
+    Q_PROPERTY(int rowCount READ rowCount)
+    Q_PROPERTY(int first READ first)
+    Q_PROPERTY(int last READ last)
+    Q_PROPERTY(QVariantList ranges READ toVariantList)
+
+public:
+    struct Range {
+        int first = 0;
+        int last = 0;
+
+        int count() const { return last - first + 1; }
+        bool operator==(const Range &) const = default;
+    };
+
+    RowRanges() = default;
+    RowRanges(std::initializer_list<int> rows);
+
+    static RowRanges fromRows(QList<int> rows);
+    static RowRanges fromSelection(const QItemSelection &selection);
+    /// Accepts RowRanges, QItemSelection, or a list of rows or [first, last] pairs
+    static RowRanges fromVariant(const QVariant &value);
+
+    /// Adds first..last, merging with touching ranges; O(1) when added in ascending order
+    void add(int first, int last);
+
+    bool isEmpty() const;
+    int rangeCount() const;
+    int rowCount() const;
+    /// First selected row, -1 if empty
+    int first() const;
+    /// Last selected row, -1 if empty
+    int last() const;
+    /// O(log ranges)
+    Q_INVOKABLE bool contains(int row) const;
+
+    const QList<Range> &ranges() const;
+    /// Every selected row in ascending order
+    QList<int> rows() const;
+    /// The part of the selection inside [0, rowCount)
+    RowRanges clipped(int rowCount) const;
+    /// [[first, last], ...] for QML
+    Q_INVOKABLE QVariantList toVariantList() const;
+
+    bool operator==(const RowRanges &other) const { return m_ranges == other.m_ranges; }
+
+    /// Lets QML arrays and selections convert to RowRanges in Q_INVOKABLE arguments
+    static void registerConverters();
+
+private:
+    QList<Range> m_ranges;
+    int m_rowCount = 0;
+};
+
+Q_DECLARE_METATYPE(RowRanges)
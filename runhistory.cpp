@@ -0,0 +1,270 @@
+#include "runhistory.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QSet>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr char HistoryMagic[4] = {'G', 'R', 'H', '1'};
+constexpr quint32 MaxPayloadSize = 1 << 20;
+
+QByteArray encodeRecord(const RepeatRecord &record)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << record.runId << record.finishedAt << record.programHash << record.regimeName
+           << qint32(record.repeatIndex) << quint8(record.outcome)
+           << qint32(record.plannedConditionSeconds) << qint32(record.plannedExecutionSeconds)
+           << record.conditionMs << record.executionMs;
+
+    // u32 payload size | payload | u16 checksum over the payload
+    QByteArray framed;
+    QDataStream out(&framed, QIODevice::WriteOnly);
+    out << quint32(payload.size());
+    out.writeRawData(payload.constData(), int(payload.size()));
+    out << qChecksum(payload);
+    return framed;
+}
+
+bool decodeRecord(const QByteArray &payload, RepeatRecord &record)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_6_0);
+    qint32 repeatIndex = 0, plannedCondition = 0, plannedExecution = 0;
+    quint8 outcome = 0;
+    stream >> record.runId >> record.finishedAt >> record.programHash >> record.regimeName
+           >> repeatIndex >> outcome >> plannedCondition >> plannedExecution
+           >> record.conditionMs >> record.executionMs;
+    record.repeatIndex = repeatIndex;
+    record.outcome = RegimeEnums::State(outcome);
+    record.plannedConditionSeconds = plannedCondition;
+    record.plannedExecutionSeconds = plannedExecution;
+    return stream.status() == QDataStream::Ok;
+}
+
+qint64 measured(const RepeatRecord &record, RunHistoryStore::Measure measure)
+{
+    switch (measure) {
+    case RunHistoryStore::Measure::ConditionTime:
+        return record.conditionMs;
+    case RunHistoryStore::Measure::ExecutionTime:
+        return record.executionMs;
+    case RunHistoryStore::Measure::RepeatTime:
+        return record.conditionMs >= 0 && record.executionMs >= 0 ? record.conditionMs + record.executionMs : -1;
+    }
+    return -1;
+}
+
+} // namespace
+
+RunHistoryStore::RunHistoryStore(const QString &filePath)
+{
+    if (!filePath.isEmpty())
+        open(filePath);
+}
+
+QString RunHistoryStore::filePath() const
+{
+    return m_filePath;
+}
+
+bool RunHistoryStore::open(const QString &filePath)
+{
+    close();
+    m_filePath = filePath;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning() << "RunHistoryStore: Couldn't open" << filePath << file.errorString();
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    const QByteArray magic(HistoryMagic, sizeof(HistoryMagic));
+    if (data.isEmpty()) {
+        if (file.write(magic) != magic.size() || !file.flush()) {
+            qWarning() << "RunHistoryStore: Couldn't write" << filePath << file.errorString();
+            return false;
+        }
+        m_open = true;
+        return true;
+    }
+    if (!data.startsWith(magic)) {
+        qWarning() << "RunHistoryStore: Not a run history file:" << filePath;
+        return false;
+    }
+
+    qsizetype offset = magic.size();
+    while (data.size() - offset >= 4 + 2) {
+        QDataStream header(data.mid(offset, 4));
+        quint32 payloadSize = 0;
+        header >> payloadSize;
+        const qsizetype recordSize = 4 + qsizetype(payloadSize) + 2;
+        if (data.size() - offset < recordSize)
+            break;
+
+        const QByteArray payload = data.mid(offset + 4, payloadSize);
+        QDataStream trailer(data.mid(offset + 4 + payloadSize, 2));
+        quint16 checksum = 0;
+        trailer >> checksum;
+        RepeatRecord record;
+        if (checksum != qChecksum(payload) || !decodeRecord(payload, record))
+            break;
+
+        m_records.append(record);
+        index(record);
+        offset += recordSize;
+    }
+
+    // Cut off a record torn by a crash, so later appends stay readable
+    if (offset < data.size()) {
+        qWarning() << "RunHistoryStore: Dropping" << data.size() - offset << "damaged bytes at the end of" << filePath;
+        if (!file.resize(offset))
+            return false;
+    }
+    m_open = true;
+    return true;
+}
+
+bool RunHistoryStore::isOpen() const
+{
+    return m_open;
+}
+
+void RunHistoryStore::close()
+{
+    m_open = false;
+    m_records.clear();
+    m_byRegime.clear();
+    m_byProgram.clear();
+}
+
+bool RunHistoryStore::append(const RepeatRecord &record)
+{
+    if (!m_open)
+        return false;
+
+    const QByteArray framed = encodeRecord(record);
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(framed) != framed.size() || !file.flush()) {
+        qWarning() << "RunHistoryStore: Couldn't append to" << m_filePath << file.errorString();
+        return false;
+    }
+
+    m_records.append(record);
+    index(record);
+    return true;
+}
+
+int RunHistoryStore::recordCount() const
+{
+    return int(m_records.count());
+}
+
+const RepeatRecord &RunHistoryStore::record(int index) const
+{
+    return m_records.at(index);
+}
+
+QList<RepeatRecord> RunHistoryStore::recordsFor(const QString &regimeName, int runs) const
+{
+    QList<RepeatRecord> result;
+    for (int index : latestRuns(regimeName, runs))
+        result.append(m_records.at(index));
+    return result;
+}
+
+QList<RepeatRecord> RunHistoryStore::recordsForProgram(quint64 programHash) const
+{
+    QList<RepeatRecord> result;
+    for (int index : m_byProgram.value(programHash))
+        result.append(m_records.at(index));
+    return result;
+}
+
+double RunHistoryStore::median(const QString &regimeName, Measure measure, int runs) const
+{
+    std::vector<qint64> values;
+    for (int index : latestRuns(regimeName, runs)) {
+        const qint64 value = measured(m_records.at(index), measure);
+        if (value >= 0)
+            values.push_back(value);
+    }
+    if (values.empty())
+        return -1.0;
+
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double median = double(values[middle]);
+    if (values.size() % 2 == 0)
+        median = (median + double(*std::max_element(values.begin(), values.begin() + middle))) / 2.0;
+    return median / 1000.0;
+}
+
+bool RunHistoryStore::forEachRecord(const QString &filePath, const std::function<bool(const RepeatRecord &)> &visit)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "RunHistoryStore: Couldn't open" << filePath << file.errorString();
+        return false;
+    }
+    if (file.read(sizeof(HistoryMagic)) != QByteArray(HistoryMagic, sizeof(HistoryMagic))) {
+        qWarning() << "RunHistoryStore: Not a run history file:" << filePath;
+        return false;
+    }
+
+    // Same framing as open(), one record in memory at a time
+    QDataStream stream(&file);
+    RepeatRecord record;
+    QByteArray payload;
+    while (!stream.atEnd()) {
+        quint32 payloadSize = 0;
+        quint16 checksum = 0;
+        stream >> payloadSize;
+        // A torn size would otherwise ask for gigabytes
+        if (stream.status() != QDataStream::Ok || payloadSize > MaxPayloadSize)
+            break;
+        payload.resize(payloadSize);
+        if (stream.readRawData(payload.data(), int(payloadSize)) != int(payloadSize))
+            break;
+        stream >> checksum;
+        if (stream.status() != QDataStream::Ok || checksum != qChecksum(payload) || !decodeRecord(payload, record))
+            break;
+        if (!visit(record))
+            break;
+    }
+    return true;
+}
+
+void RunHistoryStore::index(const RepeatRecord &record)
+{
+    const int position = int(m_records.count()) - 1;
+    m_byRegime[record.regimeName].append(position);
+    m_byProgram[record.programHash].append(position);
+}
+
+QList<int> RunHistoryStore::latestRuns(const QString &regimeName, int runs) const
+{
+    const auto it = m_byRegime.constFind(regimeName);
+    if (it == m_byRegime.cend() || runs <= 0)
+        return {};
+
+    // Walk back from the newest record until `runs` distinct runs are collected
+    const QList<int> &positions = it.value();
+    QSet<qint64> seen;
+    qsizetype first = positions.count();
+    while (first > 0) {
+        const qint64 runId = m_records.at(positions.at(first - 1)).runId;
+        if (!seen.contains(runId)) {
+            if (seen.count() == runs)
+                break;
+            seen.insert(runId);
+        }
+        --first;
+    }
+    return positions.mid(first);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <functional>
+#include "regime.h"
+
+/// One finished repeat as observed during a run
+struct RepeatRecord {
+    qint64 runId = 0;               ///< Start of the run, ms since epoch
+    qint64 finishedAt = 0;          ///< ms since epoch
+    quint64 programHash = 0;        ///< ProgramHash of the definition that ran
+    QString regimeName;
+    int repeatIndex = 0;
+    RegimeEnums::State outcome = RegimeEnums::State::Done;  ///< Done, Skipped or Error
+    int plannedConditionSeconds = 0;
+    int plannedExecutionSeconds = 0;
+    qint64 conditionMs = -1;        ///< Observed condition phase, -1 if it was not timed
+    qint64 executionMs = -1;        ///< Observed execution phase, -1 if it was not timed
+};
+
+/**
+ * @brief Append-only file of finished repeats with in-memory indexes for statistics
+ *
+ * Every repeat is one checksummed record appended at the end of the file, so recording
+ * costs one small write and a crash can lose at most the record being written; open()
+ * drops a torn tail. While open, records are indexed by regime name and by program hash
+ * in finishing order, so "the last N runs of regime X" touches only X's records instead of
+ * scanning the whole history.
+ *
+ * Not thread-safe; use from one thread at a time.
+ */
+class RunHistoryStore
+{
+public:
+    enum class Measure {
+        ConditionTime,
+        ExecutionTime,
+        RepeatTime      ///< Condition plus execution, repeats with both phases timed
+    };
+
+    explicit RunHistoryStore(const QString &filePath = QString());
+
+    QString filePath() const;
+    /// Loads an existing history (or starts a new one) and builds the indexes; false on I/O errors
+    bool open(const QString &filePath);
+    bool isOpen() const;
+    void close();
+
+    /// Appends one repeat to the file and the indexes
+    bool append(const RepeatRecord &record);
+
+    int recordCount() const;
+    const RepeatRecord &record(int index) const;
+
+    /// Records of a regime from its last `runs` runs, oldest first
+    QList<RepeatRecord> recordsFor(const QString &regimeName, int runs = 100) const;
+    /// Records of every run of one program definition, oldest first
+    QList<RepeatRecord> recordsForProgram(quint64 programHash) const;
+
+    /**
+     * @brief Median observed duration of a regime's finished repeats in seconds
+     * @param runs How many of the regime's latest runs to consider
+     * @return -1 if no repeat of those runs has the measure timed
+     */
+    double median(const QString &regimeName, Measure measure, int runs = 100) const;
+
+    /**
+     * @brief Reads a history file record by record without loading or indexing it
+     *
+     * Safe while another store appends to the same file: reading stops at the first
+     * incomplete or damaged record. visit returns false to stop early.
+     * @return false if the file can't be opened or isn't a run history
+     */
+    static bool forEachRecord(const QString &filePath, const std::function<bool(const RepeatRecord &)> &visit);
+
+private:
+    void index(const RepeatRecord &record);
+    QList<int> latestRuns(const QString &regimeName, int runs) const;
+
+    QString m_filePath;
+    bool m_open = false;
+    QList<RepeatRecord> m_records;
+    QHash<QString, QList<int>> m_byRegime;
+    QHash<quint64, QList<int>> m_byProgram;
+};
@@ -0,0 +1,435 @@
+#include "runreport.h"
+#include "prototablemodel.h"
+#include "runhistory.h"
+#include <QDebug>
+#include <QHash>
+#include <QMetaEnum>
+#include <QSaveFile>
+#include <QStringList>
+#include <QtEndian>
+#include <charconv>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace {
+
+constexpr char ReportMagic[4] = {'G', 'R', 'R', '1'};
+constexpr qsizetype FlushSize = 64 * 1024;
+// Texts kept in the columnar dictionary before it starts over at the next block
+constexpr qsizetype MaxDictionarySize = 1 << 16;
+
+enum class ColumnType : quint8 {
+    Int32 = 1,
+    Int64 = 2,
+    Text = 3
+};
+
+struct Column {
+    const char *name;
+    ColumnType type;
+};
+
+constexpr Column RowColumns[] = {
+    {"row", ColumnType::Int32},
+    {"name", ColumnType::Text},
+    {"cycle_id", ColumnType::Int32},
+    {"state", ColumnType::Text},
+    {"repeats_planned", ColumnType::Int32},
+    {"repeats_done", ColumnType::Int32},
+    {"repeats_skipped", ColumnType::Int32},
+    {"repeats_error", ColumnType::Int32},
+    {"repeats_left", ColumnType::Int32},
+    {"cycle_passes", ColumnType::Int64},
+    {"condition_s", ColumnType::Int32},
+    {"execution_s", ColumnType::Int32},
+    {"planned_total_s", ColumnType::Int64},
+    {"time_passed_s", ColumnType::Int32},
+};
+
+constexpr Column RepeatColumns[] = {
+    {"run_id", ColumnType::Int64},
+    {"finished_at", ColumnType::Int64},
+    {"regime", ColumnType::Text},
+    {"repeat", ColumnType::Int32},
+    {"outcome", ColumnType::Text},
+    {"planned_condition_s", ColumnType::Int32},
+    {"planned_execution_s", ColumnType::Int32},
+    {"condition_ms", ColumnType::Int64},
+    {"execution_ms", ColumnType::Int64},
+};
+
+template <typename T>
+void appendLittleEndian(QByteArray &buffer, T value)
+{
+    const T encoded = qToLittleEndian(value);
+    buffer.append(reinterpret_cast<const char *>(&encoded), sizeof(T));
+}
+
+QString stateName(RegimeEnums::State state)
+{
+    static const QStringList names = [] {
+        const QMetaEnum meta = QMetaEnum::fromType<RegimeEnums::State>();
+        QStringList list;
+        for (int i = 0; i < meta.keyCount(); ++i)
+            list.append(QString::fromLatin1(meta.key(i)));
+        return list;
+    }();
+    const int index = int(state);
+    return index >= 0 && index < names.count() ? names.at(index) : QString::number(index);
+}
+
+// Encodes report lines cell by cell, left to right
+class Sink
+{
+public:
+    explicit Sink(QIODevice *device) : m_device(device) {}
+    virtual ~Sink() = default;
+
+    virtual void int32(qint32 value) = 0;
+    virtual void int64(qint64 value) = 0;
+    virtual void text(const QString &value) = 0;
+    /// False once a write has failed
+    virtual bool endLine() = 0;
+    virtual bool finish() = 0;
+
+protected:
+    bool write(QByteArray &buffer)
+    {
+        if (m_ok && !buffer.isEmpty())
+            m_ok = m_device->write(buffer) == buffer.size();
+        // Keeps the capacity for the next lines
+        buffer.resize(0);
+        return m_ok;
+    }
+
+    QIODevice *m_device = nullptr;
+    bool m_ok = true;
+};
+
+class CsvSink : public Sink
+{
+public:
+    CsvSink(QIODevice *device, std::span<const Column> columns)
+        : Sink(device)
+    {
+        m_buffer.reserve(FlushSize + 1024);
+        for (const Column &column : columns) {
+            separate();
+            m_buffer.append(column.name);
+        }
+        endLine();
+    }
+
+    void int32(qint32 value) override { number(value); }
+    void int64(qint64 value) override { number(value); }
+
+    void text(const QString &value) override
+    {
+        separate();
+        m_buffer.append(RunReport::csvField(value));
+    }
+
+    bool endLine() override
+    {
+        m_buffer.append('\n');
+        m_lineStart = true;
+        return m_buffer.size() >= FlushSize ? write(m_buffer) : m_ok;
+    }
+
+    bool finish() override
+    {
+        return write(m_buffer);
+    }
+
+private:
+    void separate()
+    {
+        if (!m_lineStart)
+            m_buffer.append(',');
+        m_lineStart = false;
+    }
+
+    void number(qint64 value)
+    {
+        separate();
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        m_buffer.append(digits, result.ptr - digits);
+    }
+
+    QByteArray m_buffer;
+    bool m_lineStart = true;
+};
+
+class ColumnarSink : public Sink
+{
+public:
+    ColumnarSink(QIODevice *device, std::span<const Column> columns)
+        : Sink(device)
+    {
+        // "GRR1" | u16 column count | per column: u8 type, u16 name size, name
+        QByteArray header(ReportMagic, sizeof(ReportMagic));
+        appendLittleEndian(header, quint16(columns.size()));
+        m_columns.resize(columns.size());
+        for (size_t i = 0; i < columns.size(); ++i) {
+            const QByteArray name(columns[i].name);
+            appendLittleEndian(header, quint8(columns[i].type));
+            appendLittleEndian(header, quint16(name.size()));
+            header.append(name);
+
+            m_columns[i].type = columns[i].type;
+            m_columns[i].data.reserve(RunReport::BlockLines * (columns[i].type == ColumnType::Int64 ? 8 : 4));
+        }
+        write(header);
+    }
+
+    void int32(qint32 value) override { appendLittleEndian(m_columns[m_cursor++].data, value); }
+    void int64(qint64 value) override { appendLittleEndian(m_columns[m_cursor++].data, value); }
+
+    void text(const QString &value) override
+    {
+        ColumnState &column = m_columns[m_cursor++];
+        auto it = column.dictionary.constFind(value);
+        if (it == column.dictionary.cend()) {
+            it = column.dictionary.insert(value, quint32(column.dictionary.size()));
+            const QByteArray utf8 = value.toUtf8();
+            appendLittleEndian(column.added, quint32(utf8.size()));
+            column.added.append(utf8);
+            ++column.addedCount;
+        }
+        appendLittleEndian(column.data, it.value());
+    }
+
+    bool endLine() override
+    {
+        m_cursor = 0;
+        return ++m_lines == RunReport::BlockLines ? writeBlock() : m_ok;
+    }
+
+    bool finish() override
+    {
+        if (m_lines > 0)
+            writeBlock();
+        // An empty block ends the file
+        QByteArray end;
+        appendLittleEndian(end, quint32(0));
+        return write(end);
+    }
+
+private:
+    struct ColumnState {
+        ColumnType type = ColumnType::Int32;
+        QByteArray data;
+        // Text columns only
+        QHash<QString, quint32> dictionary;
+        QByteArray added;           // u32 size | UTF-8, per entry new in this block
+        quint32 addedCount = 0;
+        bool reset = false;         // Dictionary started over with this block
+    };
+
+    // u32 lines | per text column: u8 reset, u32 entries, entries | per column: values
+    bool writeBlock()
+    {
+        QByteArray header;
+        appendLittleEndian(header, quint32(m_lines));
+        for (ColumnState &column : m_columns) {
+            if (column.type != ColumnType::Text)
+                continue;
+            appendLittleEndian(header, quint8(column.reset));
+            appendLittleEndian(header, column.addedCount);
+            header.append(column.added);
+        }
+        write(header);
+        for (ColumnState &column : m_columns) {
+            write(column.data);
+            if (column.type != ColumnType::Text)
+                continue;
+            column.added.resize(0);
+            column.addedCount = 0;
+            column.reset = column.dictionary.size() >= MaxDictionarySize;
+            if (column.reset)
+                column.dictionary.clear();
+        }
+        m_lines = 0;
+        return m_ok;
+    }
+
+    std::vector<ColumnState> m_columns;
+    size_t m_cursor = 0;
+    int m_lines = 0;
+};
+
+std::unique_ptr<Sink> makeSink(QIODevice *device, RunReport::Format format, std::span<const Column> columns)
+{
+    if (format == RunReport::Format::Columnar)
+        return std::make_unique<ColumnarSink>(device, columns);
+    return std::make_unique<CsvSink>(device, columns);
+}
+
+// Rows is QList<Regime> or SnapshotRows; both are read by index
+template <typename Rows>
+qint64 writeRowLines(const Rows &regimes, QIODevice *device, RunReport::Format format)
+{
+    const std::unique_ptr<Sink> sink = makeSink(device, format, RowColumns);
+    bool ok = true;
+    for (int row = 0; row < regimes.count() && ok; ++row) {
+        const Regime &regime = regimes.at(row);
+        const int condition = regime.conditionTimeInSeconds();
+        const int finished = regime.m_repeatsDone + regime.m_repeatsSkipped + regime.m_repeatsError;
+        sink->int32(row);
+        sink->text(regime.m_name);
+        sink->int32(regime.m_cycleId);
+        sink->text(stateName(regime.m_state));
+        sink->int32(regime.m_repeatCount);
+        sink->int32(regime.m_repeatsDone);
+        sink->int32(regime.m_repeatsSkipped);
+        sink->int32(regime.m_repeatsError);
+        sink->int32(qMax(0, regime.m_repeatCount - finished));
+        sink->int64(regime.cyclePasses());
+        sink->int32(condition);
+        sink->int32(regime.m_maxTime);
+        sink->int64(qint64(condition + regime.m_maxTime) * regime.m_repeatCount * regime.cyclePasses());
+        sink->int32(regime.m_timePassedInSeconds);
+        ok = sink->endLine();
+    }
+    if (!sink->finish() || !ok) {
+        qWarning() << "RunReport: Couldn't write the row report" << device->errorString();
+        return -1;
+    }
+    return regimes.count();
+}
+
+} // namespace
+
+RunReport::Format RunReport::formatForPath(const QString &filePath)
+{
+    return filePath.endsWith(".grr", Qt::CaseInsensitive) ? Format::Columnar : Format::Csv;
+}
+
+QByteArray RunReport::csvField(const QString &value)
+{
+    QByteArray utf8 = value.toUtf8();
+    if (!utf8.contains(',') && !utf8.contains('"') && !utf8.contains('\n') && !utf8.contains('\r'))
+        return utf8;
+
+    QByteArray quoted;
+    quoted.reserve(utf8.size() + 2);
+    quoted.append('"');
+    for (char c : std::as_const(utf8)) {
+        if (c == '"')
+            quoted.append('"');
+        quoted.append(c);
+    }
+    quoted.append('"');
+    return quoted;
+}
+
+qint64 RunReport::writeRows(const QList<Regime> &regimes, QIODevice *device, Format format)
+{
+    return writeRowLines(regimes, device, format);
+}
+
+qint64 RunReport::writeRows(const SnapshotRows &regimes, QIODevice *device, Format format)
+{
+    return writeRowLines(regimes, device, format);
+}
+
+qint64 RunReport::writeRepeats(const QString &historyPath, qint64 runId, QIODevice *device, Format format)
+{
+    const std::unique_ptr<Sink> sink = makeSink(device, format, RepeatColumns);
+    qint64 lines = 0;
+    bool ok = true;
+    const bool read = RunHistoryStore::forEachRecord(historyPath, [&](const RepeatRecord &record) {
+        if (runId != 0 && record.runId != runId)
+            return true;
+        sink->int64(record.runId);
+        sink->int64(record.finishedAt);
+        sink->text(record.regimeName);
+        sink->int32(record.repeatIndex);
+        sink->text(stateName(record.outcome));
+        sink->int32(record.plannedConditionSeconds);
+        sink->int32(record.plannedExecutionSeconds);
+        sink->int64(record.conditionMs);
+        sink->int64(record.executionMs);
+        ++lines;
+        ok = sink->endLine();
+        return ok;
+    });
+    if (!read)
+        return -1;
+    if (!sink->finish() || !ok) {
+        qWarning() << "RunReport: Couldn't write the repeat report" << device->errorString();
+        return -1;
+    }
+    return lines;
+}
+
+RunReportWriter::RunReportWriter(ProtoTableModel *model, QObject *parent)
+    : QObject{parent}
+    , m_model(model)
+{
+    // Reports are written one after another, off the GUI thread
+    m_writer.setMaxThreadCount(1);
+    m_writer.setObjectName("RunReportWriter");
+}
+
+RunReportWriter::~RunReportWriter()
+{
+    m_writer.waitForDone();
+}
+
+bool RunReportWriter::isBusy() const
+{
+    return m_queued > 0;
+}
+
+void RunReportWriter::writeRows(const QString &filePath, RunReport::Format format)
+{
+    const ProgramSnapshotPtr snapshot = m_model->snapshot();
+    queue(filePath, [snapshot, format](QIODevice *device) {
+        return RunReport::writeRows(snapshot->regimes, device, format);
+    });
+}
+
+void RunReportWriter::writeRepeats(const QString &filePath, const QString &historyPath, qint64 runId, RunReport::Format format)
+{
+    queue(filePath, [historyPath, runId, format](QIODevice *device) {
+        return RunReport::writeRepeats(historyPath, runId, device, format);
+    });
+}
+
+void RunReportWriter::waitForIdle()
+{
+    m_writer.waitForDone();
+}
+
+void RunReportWriter::queue(const QString &filePath, std::function<qint64(QIODevice *)> write)
+{
+    if (++m_queued == 1)
+        emit busyChanged();
+
+    m_writer.start([this, filePath, write = std::move(write)]() {
+        QSaveFile file(filePath);
+        qint64 lines = -1;
+        if (file.open(QIODevice::WriteOnly)) {
+            lines = write(&file);
+            if (lines < 0)
+                file.cancelWriting();
+            else if (!file.commit())
+                lines = -1;
+        }
+        if (lines < 0)
+            qWarning() << "RunReportWriter: Couldn't write" << filePath << file.errorString();
+
+        // The destructor waits for the writer, so `this` is alive here
+        QMetaObject::invokeMethod(this, [this, filePath, lines]() {
+            if (--m_queued == 0)
+                emit busyChanged();
+            if (lines >= 0)
+                emit finished(filePath, lines);
+            else
+                emit failed(filePath);
+        }, Qt::QueuedConnection);
+    });
+}
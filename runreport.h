@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+#include <QString>
+#include <functional>
+#include "regime.h"
+
+class QIODevice;
+class ProtoTableModel;
+class SnapshotRows;
+
+/**
+ * @brief Per-row and per-repeat run reports, streamed to CSV or a compact columnar file
+ *
+ * The row report has one line per program row with its planned times and the done,
+ * skipped and error counters. The repeat report has one line per finished repeat with
+ * its planned and observed phase times; it is read record by record from the run-history
+ * file, because the model only keeps per-row counters. Lines are encoded into a buffer
+ * that is written out whenever it fills (64 KiB of CSV or one columnar block), so memory
+ * stays constant however many repeats the run had.
+ *
+ * CSV is UTF-8 with a header line, ',' separators and names quoted where needed.
+ * The columnar format ("GRR1") stores the column names and types once, then blocks of
+ * up to BlockLines lines, each holding every column contiguously: little-endian int32 or
+ * int64 values, or uint32 indexes into a dictionary of texts. A block first lists the
+ * dictionary entries it adds; a block with no lines ends the file.
+ */
+namespace RunReport {
+
+enum class Format {
+    Csv,
+    Columnar
+};
+
+constexpr int BlockLines = 65536;
+
+/// Columnar for ".grr" files, CSV otherwise
+Format formatForPath(const QString &filePath);
+/// value as one UTF-8 CSV field, quoted with doubled quotes if it holds ',', '"' or a line break
+QByteArray csvField(const QString &value);
+
+/// Writes the row report of regimes; returns the number of lines written or -1 on write errors
+qint64 writeRows(const QList<Regime> &regimes, QIODevice *device, Format format);
+/// Same for the rows of a snapshot, read in place
+qint64 writeRows(const SnapshotRows &regimes, QIODevice *device, Format format);
+/**
+ * @brief Writes the repeats of one run recorded in a run-history file
+ * @param runId Run to export; 0 exports every run in the file
+ * @return Number of lines written, -1 if the history can't be read or the device written
+ */
+qint64 writeRepeats(const QString &historyPath, qint64 runId, QIODevice *device, Format format);
+
+} // namespace RunReport
+
+/**
+ * @brief Writes run reports to files on a dedicated thread
+ *
+ * The row report is taken from the model's immutable snapshot, so the GUI thread keeps
+ * running while a large program is written. Files are replaced atomically; a report that
+ * fails leaves the previous file in place.
+ */
+class RunReportWriter : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool busy READ isBusy NOTIFY busyChanged)
+
+public:
+    explicit RunReportWriter(ProtoTableModel *model, QObject *parent = nullptr);
+    ~RunReportWriter() override;
+
+    /// True while reports are queued or being written
+    bool isBusy() const;
+
+    /// Queues the row report of the current program
+    void writeRows(const QString &filePath, RunReport::Format format);
+    /// Queues the repeat report of run runId (0 for all runs) from a run-history file
+    void writeRepeats(const QString &filePath, const QString &historyPath, qint64 runId, RunReport::Format format);
+    /// Blocks until all queued reports are written
+    void waitForIdle();
+
+signals:
+    void busyChanged();
+    /// A report was written with the given number of lines
+    void finished(const QString &filePath, qint64 lines);
+    void failed(const QString &filePath);
+
+private:
+    void queue(const QString &filePath, std::function<qint64(QIODevice *)> write);
+
+    ProtoTableModel *m_model = nullptr;
+    QThreadPool m_writer;
+    int m_queued = 0;
+};
@@ -0,0 +1,512 @@
+#include "sensortracestore.h"
+#include "prototablemodel.h"
+#include <QByteArray>
+#include <cmath>
+#include <limits>
+
+SensorTraceStore::SensorTraceStore(ProtoTableModel *model, QObject *parent)
+    : QObject{parent}
+    , m_model(model)
+{
+    m_notifyTimer.setSingleShot(true);
+    m_notifyTimer.setInterval(250);
+    connect(&m_notifyTimer, &QTimer::timeout, this, &SensorTraceStore::tracesChanged);
+
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::dataChanged, this,
+                [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                    updateRunning(topLeft.row(), bottomRight.row());
+                });
+        // Persistent indexes already point at the new rows; removed rows lose their traces
+        auto onStructureChanged = [this]() {
+            for (qsizetype i = m_rows.count() - 1; i >= 0; --i) {
+                if (m_rows.at(i).index.isValid())
+                    continue;
+                for (const Trace &trace : std::as_const(m_rows.at(i).repeats)) {
+                    for (const Chunk &chunk : trace.chunks)
+                        m_bytes -= chunkBytes(chunk);
+                }
+                m_rows.removeAt(i);
+            }
+            m_byRowDirty = true;
+            rebuildRunning();
+            scheduleNotify();
+        };
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, onStructureChanged);
+        connect(m_model, &QAbstractItemModel::rowsRemoved, this, onStructureChanged);
+        connect(m_model, &QAbstractItemModel::rowsMoved, this, onStructureChanged);
+        connect(m_model, &QAbstractItemModel::layoutChanged, this, onStructureChanged);
+        connect(m_model, &QAbstractItemModel::modelReset, this, [this]() {
+            clear();
+            rebuildRunning();
+        });
+        rebuildRunning();
+    }
+}
+
+void SensorTraceStore::appendRunning(const float *values, qsizetype count, qint64 timestampUs, int intervalUs)
+{
+    for (auto it = m_running.cbegin(); it != m_running.cend(); ++it)
+        append(it.key(), it.value(), values, count, timestampUs, intervalUs);
+}
+
+void SensorTraceStore::append(int row, int repeat, const float *values, qsizetype count, qint64 timestampUs, int intervalUs)
+{
+    if (!values || count <= 0 || intervalUs <= 0)
+        return;
+    RowTraces *traces = rowTraces(row, true);
+    if (!traces)
+        return;
+
+    Trace &trace = traces->repeats[repeat];
+    qsizetype done = 0;
+    while (done < count) {
+        // Halved chunks only take halved samples, in merges
+        if (trace.chunks.isEmpty() || trace.chunks.last().values.count() >= ChunkSize || trace.chunks.last().level > 0)
+            trace.chunks.append(Chunk());
+        Chunk &chunk = trace.chunks.last();
+        const qsizetype n = qMin(count - done, ChunkSize - chunk.values.count());
+        const qint64 before = chunkBytes(chunk);
+        appendToChunk(chunk, values + done, n, timestampUs + done * intervalUs, intervalUs);
+        m_bytes += chunkBytes(chunk) - before;
+        trace.samples += n;
+        done += n;
+    }
+
+    enforceBudget();
+    scheduleNotify();
+}
+
+QVariantMap SensorTraceStore::trace(int row, int repeat, int width, Downsampling method) const
+{
+    const Trace *stored = findTrace(row, repeat);
+    if (!stored || stored->samples == 0 || width <= 0)
+        return {};
+
+    const qint64 fromUs = stored->chunks.first().times.first();
+    const qint64 toUs = stored->chunks.last().times.last();
+    const QList<QPointF> points = downsample(row, repeat, width, method, fromUs, toUs);
+
+    // QByteArray values reach QML as ArrayBuffer, read there as Float64Array/Float32Array
+    QByteArray times(points.count() * qsizetype(sizeof(double)), Qt::Uninitialized);
+    QByteArray values(points.count() * qsizetype(sizeof(float)), Qt::Uninitialized);
+    double *timeData = reinterpret_cast<double *>(times.data());
+    float *valueData = reinterpret_cast<float *>(values.data());
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = std::numeric_limits<double>::lowest();
+    for (qsizetype i = 0; i < points.count(); ++i) {
+        timeData[i] = (points.at(i).x() - double(fromUs)) / 1e6;
+        valueData[i] = float(points.at(i).y());
+        minimum = qMin(minimum, points.at(i).y());
+        maximum = qMax(maximum, points.at(i).y());
+    }
+
+    return {
+        {"times", times},
+        {"values", values},
+        {"min", minimum},
+        {"max", maximum},
+        {"samples", qint64(stored->samples)}
+    };
+}
+
+QList<QPointF> SensorTraceStore::downsample(int row, int repeat, int width, Downsampling method, qint64 fromUs, qint64 toUs) const
+{
+    const Trace *stored = findTrace(row, repeat);
+    if (!stored || width <= 0 || toUs < fromUs)
+        return {};
+
+    if (method == MinMax)
+        return minMax(*stored, width, fromUs, toUs);
+    // LTTB needs every point it chooses from; the envelope at four columns per pixel keeps that cheap
+    return largestTriangles(minMax(*stored, width * 4, fromUs, toUs), width);
+}
+
+bool SensorTraceStore::hasTrace(int row, int repeat) const
+{
+    const Trace *stored = findTrace(row, repeat);
+    return stored && stored->samples > 0;
+}
+
+qsizetype SensorTraceStore::sampleCount(int row, int repeat) const
+{
+    const Trace *stored = findTrace(row, repeat);
+    return stored ? stored->samples : 0;
+}
+
+void SensorTraceStore::removeRow(int row)
+{
+    reindex();
+    const auto it = m_byRow.constFind(row);
+    if (it == m_byRow.cend())
+        return;
+
+    for (const Trace &trace : std::as_const(m_rows.at(*it).repeats)) {
+        for (const Chunk &chunk : trace.chunks)
+            m_bytes -= chunkBytes(chunk);
+    }
+    m_rows.removeAt(*it);
+    m_byRowDirty = true;
+    scheduleNotify();
+}
+
+void SensorTraceStore::clear()
+{
+    m_rows.clear();
+    m_byRow.clear();
+    m_byRowDirty = false;
+    m_bytes = 0;
+    scheduleNotify();
+}
+
+qint64 SensorTraceStore::bytesUsed() const
+{
+    return m_bytes;
+}
+
+qint64 SensorTraceStore::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
+void SensorTraceStore::setMemoryBudget(qint64 bytes)
+{
+    bytes = qMax<qint64>(0, bytes);
+    if (m_memoryBudget == bytes)
+        return;
+    m_memoryBudget = bytes;
+    enforceBudget();
+    emit memoryBudgetChanged();
+}
+
+const SensorTraceStore::Trace *SensorTraceStore::findTrace(int row, int repeat) const
+{
+    reindex();
+    const auto rowIt = m_byRow.constFind(row);
+    if (rowIt == m_byRow.cend())
+        return nullptr;
+    const QMap<int, Trace> &repeats = m_rows.at(*rowIt).repeats;
+    const auto it = repeats.constFind(repeat);
+    return it != repeats.cend() ? &*it : nullptr;
+}
+
+SensorTraceStore::RowTraces *SensorTraceStore::rowTraces(int row, bool create)
+{
+    reindex();
+    const auto it = m_byRow.constFind(row);
+    if (it != m_byRow.cend())
+        return &m_rows[*it];
+    if (!create || !m_model || row < 0 || row >= m_model->rowCount())
+        return nullptr;
+
+    m_rows.append({QPersistentModelIndex(m_model->index(row, 0)), {}});
+    m_byRow.insert(row, m_rows.count() - 1);
+    return &m_rows.last();
+}
+
+void SensorTraceStore::reindex() const
+{
+    if (!m_byRowDirty)
+        return;
+    m_byRow.clear();
+    for (qsizetype i = 0; i < m_rows.count(); ++i) {
+        if (m_rows.at(i).index.isValid())
+            m_byRow.insert(m_rows.at(i).index.row(), i);
+    }
+    m_byRowDirty = false;
+}
+
+void SensorTraceStore::rebuildRunning()
+{
+    m_running.clear();
+    if (m_model)
+        updateRunning(0, m_model->rowCount() - 1);
+}
+
+void SensorTraceStore::updateRunning(int first, int last)
+{
+    const QList<Regime> &regimes = m_model->getRegimes();
+    for (int row = qMax(0, first); row <= last && row < regimes.count(); ++row) {
+        const Regime &regime = regimes.at(row);
+        if (regime.m_state == RegimeEnums::State::Running)
+            m_running.insert(row, regime.m_currentRepeat);
+        else
+            m_running.remove(row);
+    }
+}
+
+void SensorTraceStore::appendToChunk(Chunk &chunk, const float *values, qsizetype count, qint64 timestampUs, int intervalUs)
+{
+    for (qsizetype i = 0; i < count; ++i) {
+        const qsizetype at = chunk.values.count();
+        const float value = values[i];
+        chunk.times.append(timestampUs + i * intervalUs);
+        chunk.values.append(value);
+        if (at % PageSize == 0) {
+            chunk.pages.append({value, value, quint16(at), quint16(at)});
+            continue;
+        }
+        Page &page = chunk.pages.last();
+        if (value < page.min) {
+            page.min = value;
+            page.minAt = quint16(at);
+        }
+        if (value > page.max) {
+            page.max = value;
+            page.maxAt = quint16(at);
+        }
+    }
+}
+
+void SensorTraceStore::rebuildPages(Chunk &chunk)
+{
+    const QList<float> values = chunk.values;
+    const QList<qint64> times = chunk.times;
+    chunk.values.clear();
+    chunk.times.clear();
+    chunk.pages.clear();
+    // Times are no longer evenly spaced, so samples are re-added one by one with their own time
+    for (qsizetype i = 0; i < values.count(); ++i)
+        appendToChunk(chunk, values.constData() + i, 1, times.at(i), 1);
+    chunk.values.squeeze();
+    chunk.times.squeeze();
+    chunk.pages.squeeze();
+}
+
+void SensorTraceStore::enforceBudget()
+{
+    while (m_bytes > m_memoryBudget && (compactOldest() || dropOldest())) {
+    }
+}
+
+bool SensorTraceStore::compactOldest()
+{
+    // The oldest chunk at the finest level; chunks still being written are left alone
+    Trace *victimTrace = nullptr;
+    qsizetype victimIndex = -1;
+    int victimLevel = std::numeric_limits<int>::max();
+    for (RowTraces &traces : m_rows) {
+        const int runningRepeat = traces.index.isValid() ? m_running.value(traces.index.row(), -1) : -1;
+        for (auto it = traces.repeats.begin(); it != traces.repeats.end() && victimLevel > 0; ++it) {
+            const qsizetype usable = it->chunks.count() - (it.key() == runningRepeat ? 1 : 0);
+            for (qsizetype i = 0; i < usable; ++i) {
+                const Chunk &chunk = it->chunks.at(i);
+                if (chunk.values.count() > PageSize && chunk.level < victimLevel) {
+                    victimTrace = &*it;
+                    victimIndex = i;
+                    victimLevel = chunk.level;
+                }
+            }
+        }
+        if (victimLevel == 0)
+            break;
+    }
+    if (!victimTrace)
+        return false;
+
+    Chunk &chunk = victimTrace->chunks[victimIndex];
+    const qint64 before = chunkBytes(chunk);
+    const qsizetype count = chunk.values.count();
+
+    // Minimum and maximum of every four samples, in time order
+    QList<qint64> times;
+    QList<float> values;
+    times.reserve(count / 2 + 2);
+    values.reserve(count / 2 + 2);
+    for (qsizetype group = 0; group < count; group += 4) {
+        const qsizetype end = qMin(group + 4, count);
+        qsizetype minAt = group;
+        qsizetype maxAt = group;
+        for (qsizetype i = group + 1; i < end; ++i) {
+            if (chunk.values.at(i) < chunk.values.at(minAt))
+                minAt = i;
+            if (chunk.values.at(i) > chunk.values.at(maxAt))
+                maxAt = i;
+        }
+        for (qsizetype i : {qMin(minAt, maxAt), qMax(minAt, maxAt)}) {
+            times.append(chunk.times.at(i));
+            values.append(chunk.values.at(i));
+            if (minAt == maxAt)
+                break;
+        }
+    }
+    chunk.times = times;
+    chunk.values = values;
+    ++chunk.level;
+    victimTrace->samples += values.count() - count;
+
+    // Halved neighbours at the same level are merged, so chunks stay large and can be halved again
+    if (victimIndex > 0) {
+        Chunk &previous = victimTrace->chunks[victimIndex - 1];
+        if (previous.level == chunk.level && previous.values.count() + chunk.values.count() <= ChunkSize) {
+            const qint64 previousBytes = chunkBytes(previous);
+            previous.times.append(chunk.times);
+            previous.values.append(chunk.values);
+            rebuildPages(previous);
+            victimTrace->chunks.removeAt(victimIndex);
+            m_bytes += chunkBytes(previous) - previousBytes - before;
+            return true;
+        }
+    }
+
+    rebuildPages(chunk);
+    m_bytes += chunkBytes(chunk) - before;
+    return true;
+}
+
+bool SensorTraceStore::dropOldest()
+{
+    for (qsizetype row = 0; row < m_rows.count(); ++row) {
+        RowTraces &traces = m_rows[row];
+        const int runningRepeat = traces.index.isValid() ? m_running.value(traces.index.row(), -1) : -1;
+        for (auto it = traces.repeats.begin(); it != traces.repeats.end(); ++it) {
+            if (it.key() == runningRepeat)
+                continue;
+            for (const Chunk &chunk : std::as_const(it->chunks))
+                m_bytes -= chunkBytes(chunk);
+            traces.repeats.erase(it);
+            if (traces.repeats.isEmpty()) {
+                m_rows.removeAt(row);
+                m_byRowDirty = true;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void SensorTraceStore::scheduleNotify()
+{
+    if (!m_notifyTimer.isActive())
+        m_notifyTimer.start();
+}
+
+qint64 SensorTraceStore::chunkBytes(const Chunk &chunk)
+{
+    return chunk.times.count() * qint64(sizeof(qint64))
+         + chunk.values.count() * qint64(sizeof(float))
+         + chunk.pages.count() * qint64(sizeof(Page));
+}
+
+QList<QPointF> SensorTraceStore::minMax(const Trace &trace, int buckets, qint64 fromUs, qint64 toUs)
+{
+    struct Bucket {
+        qint64 minAt = -1;
+        qint64 maxAt = -1;
+        float min = 0;
+        float max = 0;
+    };
+    QList<Bucket> columns(buckets);
+    const double span = double(toUs - fromUs) + 1.0;
+    auto columnOf = [&](qint64 time) {
+        return qBound(0, int(double(time - fromUs) / span * buckets), buckets - 1);
+    };
+    auto fold = [&](int column, qint64 time, float value) {
+        Bucket &bucket = columns[column];
+        if (bucket.minAt < 0) {
+            bucket = {time, time, value, value};
+            return;
+        }
+        if (value < bucket.min) {
+            bucket.min = value;
+            bucket.minAt = time;
+        }
+        if (value > bucket.max) {
+            bucket.max = value;
+            bucket.maxAt = time;
+        }
+    };
+
+    for (const Chunk &chunk : trace.chunks) {
+        const qsizetype count = chunk.values.count();
+        if (count == 0 || chunk.times.last() < fromUs || chunk.times.first() > toUs)
+            continue;
+        for (qsizetype p = 0; p < chunk.pages.count(); ++p) {
+            const qsizetype first = p * PageSize;
+            const qsizetype last = qMin(first + PageSize, count) - 1;
+            const qint64 firstTime = chunk.times.at(first);
+            const qint64 lastTime = chunk.times.at(last);
+            if (lastTime < fromUs || firstTime > toUs)
+                continue;
+
+            // A page inside one column contributes its summary instead of its samples
+            if (firstTime >= fromUs && lastTime <= toUs && columnOf(firstTime) == columnOf(lastTime)) {
+                const Page &page = chunk.pages.at(p);
+                const int column = columnOf(firstTime);
+                fold(column, chunk.times.at(page.minAt), page.min);
+                fold(column, chunk.times.at(page.maxAt), page.max);
+                continue;
+            }
+            for (qsizetype i = first; i <= last; ++i) {
+                const qint64 time = chunk.times.at(i);
+                if (time >= fromUs && time <= toUs)
+                    fold(columnOf(time), time, chunk.values.at(i));
+            }
+        }
+    }
+
+    QList<QPointF> points;
+    points.reserve(buckets * 2);
+    for (const Bucket &bucket : std::as_const(columns)) {
+        if (bucket.minAt < 0)
+            continue;
+        if (bucket.minAt == bucket.maxAt) {
+            points.append(QPointF(double(bucket.minAt), bucket.min));
+        } else if (bucket.minAt < bucket.maxAt) {
+            points.append(QPointF(double(bucket.minAt), bucket.min));
+            points.append(QPointF(double(bucket.maxAt), bucket.max));
+        } else {
+            points.append(QPointF(double(bucket.maxAt), bucket.max));
+            points.append(QPointF(double(bucket.minAt), bucket.min));
+        }
+    }
+    return points;
+}
+
+QList<QPointF> SensorTraceStore::largestTriangles(const QList<QPointF> &points, int threshold)
+{
+    const qsizetype count = points.count();
+    if (threshold >= count || threshold < 3)
+        return points;
+
+    QList<QPointF> sampled;
+    sampled.reserve(threshold);
+    sampled.append(points.first());
+
+    // The first and last points are kept; the rest is split into threshold - 2 buckets
+    const double every = double(count - 2) / (threshold - 2);
+    qsizetype previous = 0;
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        // Average of the next bucket, the third corner of the triangles
+        const qsizetype nextStart = qsizetype(std::floor((bucket + 1) * every)) + 1;
+        const qsizetype nextEnd = qMin(qsizetype(std::floor((bucket + 2) * every)) + 1, count);
+        double averageX = 0;
+        double averageY = 0;
+        for (qsizetype i = nextStart; i < nextEnd; ++i) {
+            averageX += points.at(i).x();
+            averageY += points.at(i).y();
+        }
+        const qsizetype nextCount = qMax<qsizetype>(1, nextEnd - nextStart);
+        averageX /= nextCount;
+        averageY /= nextCount;
+
+        const qsizetype start = qsizetype(std::floor(bucket * every)) + 1;
+        const qsizetype end = qsizetype(std::floor((bucket + 1) * every)) + 1;
+        const QPointF &a = points.at(previous);
+        double largestArea = -1;
+        qsizetype chosen = start;
+        for (qsizetype i = start; i < end; ++i) {
+            const double area = std::abs((a.x() - averageX) * (points.at(i).y() - a.y())
+                                         - (a.x() - points.at(i).x()) * (averageY - a.y()));
+            if (area > largestArea) {
+                largestArea = area;
+                chosen = i;
+            }
+        }
+        sampled.append(points.at(chosen));
+        previous = chosen;
+    }
+
+    sampled.append(points.last());
+    return sampled;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPersistentModelIndex>
+#include <QPointF>
+#include <QTimer>
+#include <QVariantMap>
+
+class ProtoTableModel;
+
+/**
+ * @brief Measured sensor samples of every repeat that ran, for drawing next to the timeline
+ *
+ * Samples are appended to the repeat each running row is in and kept per (row, repeat) in
+ * chunks of separate time and value columns. Every page of 64 samples in a chunk keeps
+ * its minimum and maximum, so downsampling to a few hundred pixels touches pages instead
+ * of samples. Memory is bounded: above the budget the oldest chunk at the finest
+ * resolution is halved, keeping the minimum and maximum of every four samples, and merged
+ * with its neighbour, so long traces lose resolution rather than range. Chunks still being
+ * written are never halved; once nothing else is left, finished traces are dropped, oldest
+ * rows first. Rows are tracked with persistent indexes, so traces follow their rows
+ * through moves.
+ */
+class SensorTraceStore : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(qint64 memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY memoryBudgetChanged)
+
+public:
+    enum Downsampling {
+        MinMax, // Minimum and maximum of every pixel column, at most two points per pixel
+        Lttb    // Largest-Triangle-Three-Buckets over the min/max envelope, one point per pixel
+    };
+    Q_ENUM(Downsampling)
+
+    static constexpr int ChunkSize = 4096;
+    static constexpr int PageSize = 64;
+
+    explicit SensorTraceStore(ProtoTableModel *model, QObject *parent = nullptr);
+
+    /// Adds evenly spaced samples to the current repeat of every running row
+    void appendRunning(const float *values, qsizetype count, qint64 timestampUs, int intervalUs);
+    void append(int row, int repeat, const float *values, qsizetype count, qint64 timestampUs, int intervalUs);
+
+    /**
+     * @brief Trace of one repeat reduced to width pixel columns
+     * @return {times, values} with times in seconds since the first sample of the repeat,
+     *         {min, max} of the values and the number of samples stored; empty without samples
+     */
+    Q_INVOKABLE QVariantMap trace(int row, int repeat, int width, Downsampling method = MinMax) const;
+    /// Points (time in microseconds, value) of one repeat between fromUs and toUs reduced to width pixel columns
+    QList<QPointF> downsample(int row, int repeat, int width, Downsampling method, qint64 fromUs, qint64 toUs) const;
+    Q_INVOKABLE bool hasTrace(int row, int repeat) const;
+    /// Samples kept for one repeat; fewer than were appended once the repeat has been compacted
+    qsizetype sampleCount(int row, int repeat) const;
+
+    /// Forgets the traces of one row, e.g. when it starts over
+    void removeRow(int row);
+    void clear();
+
+    /// Bytes held by all samples and page summaries
+    qint64 bytesUsed() const;
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+signals:
+    /// Samples were added or dropped; emitted at most a few times a second
+    void tracesChanged();
+    void memoryBudgetChanged();
+
+private:
+    struct Page {
+        float min = 0;
+        float max = 0;
+        quint16 minAt = 0;  // Sample indexes within the chunk
+        quint16 maxAt = 0;
+    };
+
+    struct Chunk {
+        QList<qint64> times;    // Microseconds, ascending
+        QList<float> values;
+        QList<Page> pages;
+        int level = 0;          // Times the chunk was halved to stay within the budget
+    };
+
+    struct Trace {
+        QList<Chunk> chunks;
+        qsizetype samples = 0;
+    };
+
+    struct RowTraces {
+        QPersistentModelIndex index;
+        QMap<int, Trace> repeats;
+    };
+
+    const Trace *findTrace(int row, int repeat) const;
+    RowTraces *rowTraces(int row, bool create);
+    void reindex() const;
+    void rebuildRunning();
+    void updateRunning(int first, int last);
+    void appendToChunk(Chunk &chunk, const float *values, qsizetype count, qint64 timestampUs, int intervalUs);
+    void rebuildPages(Chunk &chunk);
+    void enforceBudget();
+    bool compactOldest();
+    bool dropOldest();
+    void scheduleNotify();
+    static qint64 chunkBytes(const Chunk &chunk);
+    static QList<QPointF> minMax(const Trace &trace, int buckets, qint64 fromUs, qint64 toUs);
+    static QList<QPointF> largestTriangles(const QList<QPointF> &points, int threshold);
+
+    ProtoTableModel *m_model = nullptr;
+    QList<RowTraces> m_rows;
+    mutable QHash<int, qsizetype> m_byRow;      // Row -> index into m_rows
+    mutable bool m_byRowDirty = false;
+    QHash<int, int> m_running;                  // Running row -> its current repeat
+    qint64 m_bytes = 0;
+    qint64 m_memoryBudget = 64 * 1024 * 1024;
+    QTimer m_notifyTimer;
+};
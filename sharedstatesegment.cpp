@@ -0,0 +1,257 @@
+#include "sharedstatesegment.h"
+#include "regimemanager.h"
+#include <QDebug>
+#include <QHash>
+#include <cstring>
+
+using namespace SharedStateLayout;
+
+namespace {
+
+std::atomic_ref<quint64> sequenceOf(const Header *header)
+{
+    return std::atomic_ref<quint64>(const_cast<Header*>(header)->sequence);
+}
+
+} // namespace
+
+SharedStateSegment::SharedStateSegment(RegimeManager *manager, QObject *parent)
+    : QObject{parent}
+    , m_manager(manager)
+{
+    connect(m_manager, &RegimeManager::regimeDataUpdated, this, &SharedStateSegment::publish);
+}
+
+SharedStateSegment::~SharedStateSegment()
+{
+    release();
+}
+
+bool SharedStateSegment::create(const QString &key, int rowCapacity, int stringCapacity)
+{
+    release();
+    rowCapacity = qMax(1, rowCapacity);
+    stringCapacity = qMax(1, stringCapacity);
+
+    const qsizetype rowsOffset = qsizetype(sizeof(Header));
+    const qsizetype stringsOffset = rowsOffset + qsizetype(rowCapacity) * qsizetype(sizeof(Row));
+    const qsizetype size = stringsOffset + stringCapacity;
+
+    m_memory.setKey(key);
+    if (!m_memory.create(size)) {
+        // A segment left behind by a crashed process can be reused if it is large enough
+        if (m_memory.error() != QSharedMemory::AlreadyExists || !m_memory.attach() || m_memory.size() < size) {
+            qWarning() << "SharedStateSegment: Couldn't create segment" << key << m_memory.errorString();
+            m_memory.detach();
+            return false;
+        }
+    }
+
+    m_memory.lock();
+    auto *header = static_cast<Header*>(m_memory.data());
+    const bool reused = header->magic == Magic && header->version == Version;
+    // Keep the sequence running so readers of a reused segment notice the new content
+    const quint64 sequence = reused ? (sequenceOf(header).load(std::memory_order_relaxed) + 1) & ~quint64(1) : 0;
+    std::memset(header, 0, sizeof(Header));
+    header->magic = Magic;
+    header->version = Version;
+    header->sequence = sequence;
+    header->rowCapacity = quint32(rowCapacity);
+    header->rowsOffset = quint32(rowsOffset);
+    header->stringsOffset = quint32(stringsOffset);
+    header->stringsCapacity = quint32(stringCapacity);
+    m_memory.unlock();
+
+    m_warnedTruncated = false;
+    publish();
+    return true;
+}
+
+void SharedStateSegment::release()
+{
+    if (m_memory.isAttached())
+        m_memory.detach();
+}
+
+bool SharedStateSegment::isAttached() const
+{
+    return m_memory.isAttached();
+}
+
+quint64 SharedStateSegment::publishCount() const
+{
+    if (!m_memory.isAttached())
+        return 0;
+    return sequenceOf(static_cast<const Header*>(m_memory.constData())).load(std::memory_order_relaxed) / 2;
+}
+
+void SharedStateSegment::publish()
+{
+    if (!m_memory.isAttached())
+        return;
+
+    auto *base = static_cast<char*>(m_memory.data());
+    auto *header = reinterpret_cast<Header*>(base);
+    auto *rows = reinterpret_cast<Row*>(base + header->rowsOffset);
+    char *strings = base + header->stringsOffset;
+
+    const QList<Regime> regimes = m_manager->model()->getRegimes();
+
+    std::atomic_ref<quint64> sequence(header->sequence);
+    const quint64 start = sequence.load(std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Identical names (cycle members, condition types) are stored once
+    QHash<QString, quint32> interned;
+    quint32 stringsSize = 0;
+    bool truncated = false;
+    auto intern = [&](const QString &text, quint32 &offset, quint32 &length) {
+        const QByteArray utf8 = text.toUtf8();
+        auto it = interned.constFind(text);
+        if (it != interned.constEnd()) {
+            offset = it.value();
+            length = quint32(utf8.size());
+            return true;
+        }
+        if (stringsSize + quint32(utf8.size()) > header->stringsCapacity)
+            return false;
+        std::memcpy(strings + stringsSize, utf8.constData(), size_t(utf8.size()));
+        offset = stringsSize;
+        length = quint32(utf8.size());
+        interned.insert(text, offset);
+        stringsSize += length;
+        return true;
+    };
+
+    quint32 rowCount = 0;
+    for (const Regime &regime : regimes) {
+        if (rowCount == header->rowCapacity) {
+            truncated = true;
+            break;
+        }
+        Row row{};
+        if (!intern(regime.m_name, row.nameOffset, row.nameLength)
+            || !intern(regime.m_condition.type, row.conditionTypeOffset, row.conditionTypeLength)) {
+            truncated = true;
+            break;
+        }
+        row.conditionTemp = regime.m_condition.temp;
+        row.conditionTime = regime.m_condition.time;
+        row.repeatCount = regime.m_repeatCount;
+        row.maxTime = regime.m_maxTime;
+        row.cycleId = regime.m_cycleId;
+        row.cycleRepeat = regime.m_cycleRepeat;
+        row.state = qint32(regime.m_state);
+        row.timePassedInSeconds = regime.m_timePassedInSeconds;
+        row.repeatsDone = regime.m_repeatsDone;
+        row.repeatsSkipped = regime.m_repeatsSkipped;
+        row.repeatsError = regime.m_repeatsError;
+        row.currentRepeat = regime.m_currentRepeat;
+        row.conditionCompleted = regime.m_conditionCompleted ? 1 : 0;
+        row.conditionTimePassed = regime.m_conditionTimePassed;
+        row.regimeTimePassed = regime.m_regimeTimePassed;
+        std::memcpy(rows + rowCount, &row, sizeof(Row));
+        ++rowCount;
+    }
+
+    header->rowCount = rowCount;
+    header->stringsSize = stringsSize;
+    header->truncated = truncated ? 1 : 0;
+
+    sequence.store(start + 2, std::memory_order_release);
+
+    if (truncated && !m_warnedTruncated) {
+        qWarning() << "SharedStateSegment: Program does not fit the segment, published" << rowCount
+                   << "of" << regimes.count() << "rows";
+        m_warnedTruncated = true;
+    }
+}
+
+int SharedStateReader::View::rowCount() const
+{
+    return int(qMin(header->rowCount, header->rowCapacity));
+}
+
+QString SharedStateReader::View::string(quint32 offset, quint32 length) const
+{
+    if (quint64(offset) + length > header->stringsCapacity)
+        return QString();
+    return QString::fromUtf8(strings + offset, qsizetype(length));
+}
+
+SharedStateReader::~SharedStateReader()
+{
+    detach();
+}
+
+bool SharedStateReader::attach(const QString &key)
+{
+    detach();
+    m_memory = new QSharedMemory(key);
+    if (!m_memory->attach(QSharedMemory::ReadOnly)) {
+        qWarning() << "SharedStateReader: Couldn't attach to" << key << m_memory->errorString();
+        detach();
+        return false;
+    }
+
+    const auto *header = static_cast<const Header*>(m_memory->constData());
+    if (m_memory->size() < qsizetype(sizeof(Header)) || header->magic != Magic || header->version != Version) {
+        qWarning() << "SharedStateReader: Segment" << key << "has an unknown layout";
+        detach();
+        return false;
+    }
+    return true;
+}
+
+void SharedStateReader::detach()
+{
+    delete m_memory;
+    m_memory = nullptr;
+}
+
+bool SharedStateReader::isAttached() const
+{
+    return m_memory && m_memory->isAttached();
+}
+
+quint64 SharedStateReader::sequence() const
+{
+    if (!isAttached())
+        return 0;
+    return sequenceOf(static_cast<const Header*>(m_memory->constData())).load(std::memory_order_acquire);
+}
+
+quint64 SharedStateReader::readRows(QList<RowData> &rows) const
+{
+    quint64 sequence = 0;
+    const bool ok = visit([&](const View &view) {
+        rows.resize(view.rowCount());
+        for (int i = 0; i < rows.count(); ++i) {
+            const Row &row = view.rows[i];
+            rows[i].row = row;
+            rows[i].name = view.string(row.nameOffset, row.nameLength);
+            rows[i].conditionType = view.string(row.conditionTypeOffset, row.conditionTypeLength);
+        }
+        sequence = sequenceOf(view.header).load(std::memory_order_relaxed);
+    });
+    return ok ? sequence : 0;
+}
+
+bool SharedStateReader::beginRead(quint64 &sequence, View &view) const
+{
+    const auto *base = static_cast<const char*>(m_memory->constData());
+    view.header = reinterpret_cast<const Header*>(base);
+    sequence = sequenceOf(view.header).load(std::memory_order_acquire);
+    if (sequence & 1)
+        return false; // Writer in progress
+    view.rows = reinterpret_cast<const Row*>(base + view.header->rowsOffset);
+    view.strings = base + view.header->stringsOffset;
+    return true;
+}
+
+bool SharedStateReader::endRead(quint64 sequence) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequenceOf(static_cast<const Header*>(m_memory->constData())).load(std::memory_order_relaxed) == sequence;
+}
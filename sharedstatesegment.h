@@ -0,0 +1,166 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QSharedMemory>
+#include <QString>
+#include <atomic>
+
+class RegimeManager;
+
+/**
+ * Fixed layout of the shared-memory segment published by SharedStateSegment.
+ *
+ * The segment holds a Header, rowCapacity Row records and a UTF-8 string table. Names are
+ * stored once in the string table and referenced by (offset, length). All fields are
+ * native-endian since the segment never leaves the host.
+ *
+ * Consistency uses a seqlock: the writer makes Header::sequence odd before touching the
+ * segment and even again afterwards. Readers read the sequence, read the data in place and
+ * accept it only if the sequence was even and has not changed.
+ */
+namespace SharedStateLayout {
+
+constexpr quint32 Magic = 0x534d5247; // "GRMS"
+constexpr quint32 Version = 1;
+
+struct Header {
+    quint32 magic;
+    quint32 version;
+    alignas(8) quint64 sequence;
+    quint32 rowCount;
+    quint32 rowCapacity;
+    quint32 rowsOffset;
+    quint32 stringsOffset;
+    quint32 stringsSize;
+    quint32 stringsCapacity;
+    // Non-zero when the program did not fit and only the first rowCount rows are present
+    quint32 truncated;
+    quint32 reserved;
+};
+
+struct Row {
+    quint32 nameOffset;
+    quint32 nameLength;
+    quint32 conditionTypeOffset;
+    quint32 conditionTypeLength;
+    double conditionTemp;
+    qint32 conditionTime;       // minutes
+    qint32 repeatCount;
+    qint32 maxTime;             // seconds
+    qint32 cycleId;
+    qint32 cycleRepeat;
+    qint32 state;               // RegimeEnums::State
+    qint32 timePassedInSeconds;
+    qint32 repeatsDone;
+    qint32 repeatsSkipped;
+    qint32 repeatsError;
+    qint32 currentRepeat;
+    qint32 conditionCompleted;
+    qint32 conditionTimePassed; // seconds
+    qint32 regimeTimePassed;    // seconds
+};
+
+static_assert(std::atomic_ref<quint64>::is_always_lock_free, "seqlock needs a lock-free 64-bit counter");
+
+} // namespace SharedStateLayout
+
+/**
+ * @brief Publishes the program and execution state of a RegimeManager into shared memory
+ *
+ * The segment is rewritten after every coalesced change (RegimeManager::regimeDataUpdated),
+ * so local tools can poll the complete state without syscalls or IPC round trips.
+ */
+class SharedStateSegment : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SharedStateSegment(RegimeManager *manager, QObject *parent = nullptr);
+    ~SharedStateSegment() override;
+
+    /// Creates (or takes over) the segment; rows beyond rowCapacity are not published
+    bool create(const QString &key, int rowCapacity = 4096, int stringCapacity = 256 * 1024);
+    void release();
+    bool isAttached() const;
+
+    /// Rewrites the segment from the current model contents
+    void publish();
+
+    /// Number of completed publishes (the seqlock sequence divided by two)
+    quint64 publishCount() const;
+
+private:
+    RegimeManager *m_manager = nullptr;
+    QSharedMemory m_memory;
+    bool m_warnedTruncated = false;
+};
+
+/**
+ * @brief Read side of SharedStateSegment for local consumer processes
+ *
+ * Reading never enters the kernel once attached. visit() hands out the rows in place;
+ * copy what you need inside the callback, since its result is discarded and the call
+ * retried if the writer was active at the same time.
+ */
+class SharedStateReader
+{
+public:
+    struct View {
+        const SharedStateLayout::Header *header = nullptr;
+        const SharedStateLayout::Row *rows = nullptr;
+        const char *strings = nullptr;
+
+        /// Row count clamped to the capacity, safe to use even on a torn read
+        int rowCount() const;
+        /// Bounds-checked string table lookup
+        QString string(quint32 offset, quint32 length) const;
+    };
+
+    struct RowData {
+        QString name;
+        QString conditionType;
+        SharedStateLayout::Row row{};
+    };
+
+    SharedStateReader() = default;
+    ~SharedStateReader();
+    Q_DISABLE_COPY(SharedStateReader)
+
+    bool attach(const QString &key);
+    void detach();
+    bool isAttached() const;
+
+    /// Sequence of the last publish; cheap to poll for changes
+    quint64 sequence() const;
+
+    /// Calls fn(view) on a consistent state; returns false if no consistent read succeeded
+    template<typename Fn>
+    bool visit(Fn &&fn, int maxAttempts = 64) const;
+
+    /// Copies all rows; returns the sequence they belong to, or 0 on failure
+    quint64 readRows(QList<RowData> &rows) const;
+
+private:
+    bool beginRead(quint64 &sequence, View &view) const;
+    bool endRead(quint64 sequence) const;
+
+    QSharedMemory *m_memory = nullptr;
+};
+
+template<typename Fn>
+bool SharedStateReader::visit(Fn &&fn, int maxAttempts) const
+{
+    if (!isAttached())
+        return false;
+    for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+        quint64 sequence = 0;
+        View view;
+        if (!beginRead(sequence, view))
+            continue;
+        fn(view);
+        if (endRead(sequence))
+            return true;
+    }
+    return false;
+}
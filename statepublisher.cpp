@@ -0,0 +1,284 @@
+#include "statepublisher.h"
+#include "localserver.h"
+#include "regimemanager.h"
+#include <QCborMap>
+#include <QDebug>
+#include <QLocalSocket>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+QByteArray frameFor(const QCborMap &message)
+{
+    const QByteArray body = message.toCborValue().toCbor();
+    QByteArray frame(qsizetype(sizeof(quint32)), Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(body.size()), frame.data());
+    frame.append(body);
+    return frame;
+}
+
+} // namespace
+
+StatePublisher::StatePublisher(RegimeManager *manager, QObject *parent)
+    : QObject{parent}
+    , m_manager(manager)
+{
+    m_publishTimer.setSingleShot(true);
+    m_publishTimer.setInterval(50);
+    connect(&m_publishTimer, &QTimer::timeout, this, &StatePublisher::publish);
+    connect(&m_server, &QLocalServer::newConnection, this, &StatePublisher::acceptConnections);
+
+    ProtoTableModel *model = m_manager->model();
+    connect(model, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                markRowsDirty(topLeft.row(), bottomRight.row());
+            });
+    connect(model, &QAbstractItemModel::rowsInserted, this, &StatePublisher::markStructureDirty);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &StatePublisher::markStructureDirty);
+    connect(model, &QAbstractItemModel::rowsMoved, this, &StatePublisher::markStructureDirty);
+    connect(model, &QAbstractItemModel::modelReset, this, &StatePublisher::markStructureDirty);
+    connect(model, &QAbstractItemModel::layoutChanged, this, &StatePublisher::markStructureDirty);
+}
+
+StatePublisher::~StatePublisher()
+{
+    close();
+}
+
+bool StatePublisher::listen(const QString &serverName)
+{
+    close();
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!LocalServer::listen(m_server, serverName)) {
+        qWarning() << "StatePublisher: Couldn't listen on" << serverName << m_server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void StatePublisher::close()
+{
+    m_server.close();
+
+    const QList<QLocalSocket*> sockets = m_subscribers.keys();
+    m_subscribers.clear();
+    for (QLocalSocket *socket : sockets) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    if (!sockets.isEmpty())
+        emit subscriberCountChanged();
+}
+
+int StatePublisher::subscriberCount() const
+{
+    return m_subscribers.count();
+}
+
+quint64 StatePublisher::sequence() const
+{
+    return m_sequence;
+}
+
+int StatePublisher::publishInterval() const
+{
+    return m_publishTimer.interval();
+}
+
+void StatePublisher::setPublishInterval(int milliseconds)
+{
+    milliseconds = qMax(0, milliseconds);
+    if (m_publishTimer.interval() != milliseconds) {
+        m_publishTimer.setInterval(milliseconds);
+        emit publishIntervalChanged();
+    }
+}
+
+QStringList StatePublisher::fieldNames()
+{
+    return {
+        "name", "condition_type", "condition_temp", "condition_time", "repeat_count", "max_time",
+        "cycle_id", "cycle_repeat", "state", "time_passed_in_seconds", "repeats_done",
+        "repeats_skipped", "repeats_error", "current_repeat", "condition_completed",
+        "condition_time_passed", "regime_time_passed"
+    };
+}
+
+QCborArray StatePublisher::encodeRow(const Regime &regime)
+{
+    // Order must match fieldNames()
+    return {
+        regime.m_name,
+        regime.m_condition.type,
+        regime.m_condition.temp,
+        regime.m_condition.time,
+        regime.m_repeatCount,
+        regime.m_maxTime,
+        regime.m_cycleId,
+        regime.m_cycleRepeat,
+        int(regime.m_state),
+        regime.m_timePassedInSeconds,
+        regime.m_repeatsDone,
+        regime.m_repeatsSkipped,
+        regime.m_repeatsError,
+        regime.m_currentRepeat,
+        regime.m_conditionCompleted,
+        regime.m_conditionTimePassed,
+        regime.m_regimeTimePassed
+    };
+}
+
+void StatePublisher::publish()
+{
+    m_publishTimer.stop();
+
+    if (m_structureDirty) {
+        rebuildPublishedState();
+        if (!m_subscribers.isEmpty())
+            broadcast(snapshotFrame(), true);
+        return;
+    }
+    if (m_dirtyRows.isEmpty())
+        return;
+
+    QList<int> rows(m_dirtyRows.cbegin(), m_dirtyRows.cend());
+    std::sort(rows.begin(), rows.end());
+    m_dirtyRows.clear();
+
+    ProtoTableModel *model = m_manager->model();
+    QCborArray changes;
+    for (int row : rows) {
+        if (row < 0 || row >= m_published.count() || row >= model->rowCount())
+            continue;
+
+        const QCborArray current = encodeRow(model->getRegime(row));
+        QCborArray &previous = m_published[row];
+        QCborArray change{row};
+        for (qsizetype field = 0; field < current.size(); ++field) {
+            if (current.at(field) != previous.at(field)) {
+                change.append(field);
+                change.append(current.at(field));
+            }
+        }
+        if (change.size() > 1) {
+            changes.append(change);
+            previous = current;
+        }
+    }
+    if (changes.isEmpty())
+        return;
+
+    ++m_sequence;
+    if (m_subscribers.isEmpty())
+        return;
+
+    QCborMap message;
+    message.insert(QStringLiteral("type"), QStringLiteral("delta"));
+    message.insert(QStringLiteral("seq"), qint64(m_sequence));
+    message.insert(QStringLiteral("rows"), changes);
+    broadcast(frameFor(message), false);
+}
+
+void StatePublisher::acceptConnections()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        m_subscribers.insert(socket, Subscriber{});
+        // Viewers are read-only; anything they send is discarded
+        connect(socket, &QLocalSocket::readyRead, socket, [socket]() { socket->readAll(); });
+        connect(socket, &QLocalSocket::bytesWritten, this, [this, socket]() { resyncIfDrained(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            m_subscribers.remove(socket);
+            socket->deleteLater();
+            emit subscriberCountChanged();
+        });
+
+        // Pending edits go out first so the snapshot is not immediately followed by a stale delta
+        if (m_structureDirty || !m_dirtyRows.isEmpty())
+            publish();
+        socket->write(snapshotFrame());
+        emit subscriberCountChanged();
+    }
+}
+
+void StatePublisher::markRowsDirty(int first, int last)
+{
+    if (m_structureDirty)
+        return;
+    for (int row = first; row <= last; ++row)
+        m_dirtyRows.insert(row);
+    schedulePublish();
+}
+
+void StatePublisher::markStructureDirty()
+{
+    m_structureDirty = true;
+    m_dirtyRows.clear();
+    schedulePublish();
+}
+
+void StatePublisher::schedulePublish()
+{
+    if (!m_publishTimer.isActive())
+        m_publishTimer.start();
+}
+
+void StatePublisher::rebuildPublishedState()
+{
+    const QList<Regime> regimes = m_manager->model()->getRegimes();
+    m_published.clear();
+    m_published.reserve(regimes.count());
+    for (const Regime &regime : regimes)
+        m_published.append(encodeRow(regime));
+    m_structureDirty = false;
+    m_dirtyRows.clear();
+    ++m_sequence;
+}
+
+QByteArray StatePublisher::snapshotFrame()
+{
+    if (m_structureDirty)
+        rebuildPublishedState();
+    if (!m_snapshotCache.isEmpty() && m_snapshotSequence == m_sequence)
+        return m_snapshotCache;
+
+    QCborArray rows;
+    for (const QCborArray &row : std::as_const(m_published))
+        rows.append(row);
+
+    QCborMap message;
+    message.insert(QStringLiteral("type"), QStringLiteral("snapshot"));
+    message.insert(QStringLiteral("seq"), qint64(m_sequence));
+    message.insert(QStringLiteral("fields"), QCborArray::fromStringList(fieldNames()));
+    message.insert(QStringLiteral("rows"), rows);
+
+    m_snapshotCache = frameFor(message);
+    m_snapshotSequence = m_sequence;
+    return m_snapshotCache;
+}
+
+void StatePublisher::broadcast(const QByteArray &frame, bool isSnapshot)
+{
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        QLocalSocket *socket = it.key();
+        Subscriber &subscriber = it.value();
+        if (socket->bytesToWrite() > HighWatermark || (subscriber.needsSnapshot && !isSnapshot)) {
+            // Too far behind for deltas; resynchronise from a snapshot once drained
+            subscriber.needsSnapshot = true;
+            continue;
+        }
+        subscriber.needsSnapshot = false;
+        socket->write(frame);
+    }
+}
+
+void StatePublisher::resyncIfDrained(QLocalSocket *socket)
+{
+    auto it = m_subscribers.find(socket);
+    if (it == m_subscribers.end() || !it->needsSnapshot || socket->bytesToWrite() > LowWatermark)
+        return;
+
+    it->needsSnapshot = false;
+    socket->write(snapshotFrame());
+}
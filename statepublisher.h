@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCborArray>
+#include <QHash>
+#include <QList>
+#include <QLocalServer>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+
+class QLocalSocket;
+class RegimeManager;
+class Regime;
+
+/**
+ * @brief Streams the program and its execution state to read-only viewers over a local socket
+ *
+ * Each subscriber first receives a snapshot of every row and then delta frames that carry
+ * only the rows and fields that changed, tagged with consecutive sequence numbers. Frames
+ * are a little-endian u32 length followed by a CBOR map:
+ *
+ *     {"type": "snapshot", "seq": n, "fields": [names...], "rows": [[values...], ...]}
+ *     {"type": "delta", "seq": n, "rows": [[row, field, value, field, value, ...], ...]}
+ *
+ * Changes are collected from the model and published at most once per publishInterval.
+ * A frame is encoded once and the same bytes are written to every subscriber, so the cost
+ * on the GUI thread does not grow with the number of viewers. A subscriber whose socket
+ * falls behind (more than the high watermark unsent) stops receiving deltas and is sent a
+ * fresh snapshot once it has drained below the low watermark. Structural edits (rows
+ * inserted, removed or moved) are published as a snapshot to everyone.
+ */
+class StatePublisher : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int subscriberCount READ subscriberCount NOTIFY subscriberCountChanged)
+    Q_PROPERTY(int publishInterval READ publishInterval WRITE setPublishInterval NOTIFY publishIntervalChanged)
+
+public:
+    explicit StatePublisher(RegimeManager *manager, QObject *parent = nullptr);
+    ~StatePublisher() override;
+
+    /// Starts listening on serverName, replacing a stale socket left by a crashed process; fails while another instance serves it
+    bool listen(const QString &serverName);
+    void close();
+
+    int subscriberCount() const;
+    quint64 sequence() const;
+
+    int publishInterval() const;
+    void setPublishInterval(int milliseconds);
+
+    /// Publishes pending changes right away instead of waiting for the timer
+    void publish();
+
+    /// Field names in the order used by snapshot and delta frames
+    static QStringList fieldNames();
+
+signals:
+    void subscriberCountChanged();
+    void publishIntervalChanged();
+
+private:
+    struct Subscriber {
+        bool needsSnapshot = false;
+    };
+
+    static constexpr qint64 HighWatermark = 512 * 1024;
+    static constexpr qint64 LowWatermark = 64 * 1024;
+
+    static QCborArray encodeRow(const Regime &regime);
+
+    void acceptConnections();
+    void markRowsDirty(int first, int last);
+    void markStructureDirty();
+    void schedulePublish();
+    void rebuildPublishedState();
+    QByteArray snapshotFrame();
+    void broadcast(const QByteArray &frame, bool isSnapshot);
+    void resyncIfDrained(QLocalSocket *socket);
+
+    RegimeManager *m_manager = nullptr;
+    QLocalServer m_server;
+    QHash<QLocalSocket*, Subscriber> m_subscribers;
+    QTimer m_publishTimer;
+
+    // Rows as last published; deltas are computed against this
+    QList<QCborArray> m_published;
+    QSet<int> m_dirtyRows;
+    bool m_structureDirty = true;
+    quint64 m_sequence = 0;
+
+    // Snapshot of m_published at m_snapshotSequence, reused for every resync at that sequence
+    QByteArray m_snapshotCache;
+    quint64 m_snapshotSequence = 0;
+};
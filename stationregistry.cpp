@@ -0,0 +1,161 @@
+#include "stationregistry.h"
+#include <QDebug>
+#include <QThread>
+
+namespace {
+// About one refresh per displayed frame for the station on screen
+constexpr int kFocusedRefreshInterval = 16;
+}
+
+StationRegistry::StationRegistry(QObject *parent)
+    : QObject{parent}
+{
+    m_workerPool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+StationRegistry::~StationRegistry()
+{
+    // Managers go before the pool so no new jobs are queued while it drains
+    qDeleteAll(m_stations);
+    m_stations.clear();
+    m_workerPool.waitForDone();
+}
+
+int StationRegistry::count() const
+{
+    return m_stations.count();
+}
+
+QStringList StationRegistry::stationNames() const
+{
+    return m_names;
+}
+
+QList<RegimeManager*> StationRegistry::stations() const
+{
+    return m_stations;
+}
+
+RegimeManager* StationRegistry::addStation(const QString &name, const QUrl &programFile)
+{
+    if (name.isEmpty() || m_names.contains(name)) {
+        qWarning() << "addStation: Invalid or duplicate station name" << name;
+        return nullptr;
+    }
+
+    auto *manager = new RegimeManager(false, this);
+    manager->setObjectName(name);
+    manager->setWorkerPool(&m_workerPool);
+    if (programFile.isValid() && !programFile.isEmpty()) {
+        manager->importRegimes(programFile);
+    }
+
+    m_stations.append(manager);
+    m_names.append(name);
+    applyRefreshIntervals();
+
+    emit stationAdded(name);
+    emit stationsChanged();
+    return manager;
+}
+
+bool StationRegistry::removeStation(const QString &name)
+{
+    const int index = indexOf(name);
+    if (index == -1) {
+        qWarning() << "removeStation: Unknown station" << name;
+        return false;
+    }
+
+    RegimeManager *manager = m_stations.at(index);
+    if (manager->model()->isAnyRegimeRunning()) {
+        qWarning() << "removeStation: Station" << name << "is running";
+        return false;
+    }
+
+    m_stations.removeAt(index);
+    m_names.removeAt(index);
+    manager->deleteLater();
+
+    // Focus stays on the same station; removing the focused one passes it to the next
+    const int focused = m_focusedStation;
+    if (index < m_focusedStation)
+        --m_focusedStation;
+    else if (m_focusedStation >= m_stations.count())
+        m_focusedStation = m_stations.count() - 1;
+    if (index == focused) {
+        if (RegimeManager *next = station(m_focusedStation))
+            next->scheduleVisibleRefresh();
+    }
+    applyRefreshIntervals();
+    if (index <= focused)
+        emit focusedStationChanged();
+
+    emit stationRemoved(name);
+    emit stationsChanged();
+    return true;
+}
+
+RegimeManager* StationRegistry::station(int index) const
+{
+    if (index < 0 || index >= m_stations.count())
+        return nullptr;
+    return m_stations.at(index);
+}
+
+RegimeManager* StationRegistry::stationByName(const QString &name) const
+{
+    return station(indexOf(name));
+}
+
+int StationRegistry::indexOf(const QString &name) const
+{
+    return m_names.indexOf(name);
+}
+
+int StationRegistry::focusedStation() const
+{
+    return m_focusedStation;
+}
+
+void StationRegistry::setFocusedStation(int index)
+{
+    if (index < -1 || index >= m_stations.count() || index == m_focusedStation)
+        return;
+
+    m_focusedStation = index;
+    applyRefreshIntervals();
+    // The newly focused timeline may be stale after running at the background rate
+    if (RegimeManager *manager = station(index))
+        manager->scheduleVisibleRefresh();
+    emit focusedStationChanged();
+}
+
+int StationRegistry::backgroundRefreshInterval() const
+{
+    return m_backgroundRefreshInterval;
+}
+
+void StationRegistry::setBackgroundRefreshInterval(int milliseconds)
+{
+    milliseconds = qMax(kFocusedRefreshInterval, milliseconds);
+    if (m_backgroundRefreshInterval == milliseconds)
+        return;
+
+    m_backgroundRefreshInterval = milliseconds;
+    applyRefreshIntervals();
+    emit backgroundRefreshIntervalChanged();
+}
+
+QThreadPool* StationRegistry::workerPool()
+{
+    return &m_workerPool;
+}
+
+void StationRegistry::applyRefreshIntervals()
+{
+    for (int i = 0; i < m_stations.count(); ++i) {
+        m_stations.at(i)->setRefreshInterval(i == m_focusedStation ? kFocusedRefreshInterval
+                                                                   : m_backgroundRefreshInterval);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QUrl>
+#include "regimemanager.h"
+
+/**
+ * @brief Hosts several independent RegimeManager instances (one per chamber) in one process
+ *
+ * Every station owns its own model, timeline and forecaster; all of them share one worker
+ * pool for background analytics. Stations are addressed from QML by index or name.
+ *
+ * GUI-thread refreshes are coalesced per station: the focused station refreshes its
+ * timeline at frame rate, background stations at backgroundRefreshInterval, so the
+ * refresh cost stays bounded no matter how many programs report progress at once.
+ */
+class StationRegistry : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY stationsChanged)
+    Q_PROPERTY(QStringList stationNames READ stationNames NOTIFY stationsChanged)
+    Q_PROPERTY(QList<RegimeManager*> stations READ stations NOTIFY stationsChanged)
+    Q_PROPERTY(int focusedStation READ focusedStation WRITE setFocusedStation NOTIFY focusedStationChanged)
+    Q_PROPERTY(int backgroundRefreshInterval READ backgroundRefreshInterval WRITE setBackgroundRefreshInterval NOTIFY backgroundRefreshIntervalChanged)
+
+public:
+    explicit StationRegistry(QObject *parent = nullptr);
+    ~StationRegistry() override;
+
+    int count() const;
+    QStringList stationNames() const;
+    QList<RegimeManager*> stations() const;
+
+    /**
+     * @brief Creates a new station with an empty program
+     * @param name Unique station name
+     * @param programFile Optional program to import into the new station
+     * @return The station's manager, or nullptr if the name is empty or already taken
+     */
+    Q_INVOKABLE RegimeManager* addStation(const QString &name, const QUrl &programFile = QUrl());
+
+    /**
+     * @brief Removes a station; refused while any of its regimes is running
+     * @return true if the station was removed
+     */
+    Q_INVOKABLE bool removeStation(const QString &name);
+
+    Q_INVOKABLE RegimeManager* station(int index) const;
+    Q_INVOKABLE RegimeManager* stationByName(const QString &name) const;
+    Q_INVOKABLE int indexOf(const QString &name) const;
+
+    /// Station whose timeline is on screen; -1 when none is
+    int focusedStation() const;
+    void setFocusedStation(int index);
+
+    /// Refresh interval in milliseconds for stations that are not focused
+    int backgroundRefreshInterval() const;
+    void setBackgroundRefreshInterval(int milliseconds);
+
+    /// Pool shared by all stations for I/O and analytics
+    QThreadPool* workerPool();
+
+signals:
+    void stationsChanged();
+    void stationAdded(const QString &name);
+    void stationRemoved(const QString &name);
+    void focusedStationChanged();
+    void backgroundRefreshIntervalChanged();
+
+private:
+    void applyRefreshIntervals();
+
+    QList<RegimeManager*> m_stations;
+    QStringList m_names;
+    QThreadPool m_workerPool;
+    int m_focusedStation = 0;
+    int m_backgroundRefreshInterval = 500;
+};
@@ -0,0 +1,43 @@
+# Runs regimetool on a fixture program: validate, a JSON -> journal -> JSON round trip and
+# the timeline of both. Invoked by CTest with REGIMETOOL, PROGRAM and WORK_DIR set.
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+function(run_tool output)
+    execute_process(COMMAND "${REGIMETOOL}" ${ARGN}
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE stdout
+        ERROR_VARIABLE stderr)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "regimetool ${ARGN} exited with ${result}: ${stderr}")
+    endif()
+    set(${output} "${stdout}" PARENT_SCOPE)
+endfunction()
+
+run_tool(validated validate "${PROGRAM}")
+if(NOT validated MATCHES "3 rows, 0 diagnostics")
+    message(FATAL_ERROR "Unexpected validate output:\n${validated}")
+endif()
+
+run_tool(ignored convert "${PROGRAM}" "${WORK_DIR}/program.grj")
+run_tool(ignored convert "${WORK_DIR}/program.grj" "${WORK_DIR}/program.json")
+
+run_tool(timeline timeline "${PROGRAM}")
+run_tool(roundTrip timeline "${WORK_DIR}/program.json")
+if(NOT timeline STREQUAL roundTrip)
+    message(FATAL_ERROR "Timeline changed by the round trip:\n${timeline}\n---\n${roundTrip}")
+endif()
+
+# Two repeats of the first row, then two passes over the cycle; names are quoted as needed
+string(CONCAT expected
+    "start_s,row,repeat,cycle_pass,condition_s,execution_s,name\n"
+    "0,0,0,0,600,60,\"Нагрев, \"\"медленный\"\"\"\n"
+    "660,0,1,0,600,60,\"Нагрев, \"\"медленный\"\"\"\n"
+    "1320,1,0,0,0,10,Режим а\n"
+    "1330,2,0,0,0,10,Режим б\n"
+    "1340,1,0,1,0,10,Режим а\n"
+    "1350,2,0,1,0,10,Режим б\n")
+if(NOT timeline STREQUAL expected)
+    message(FATAL_ERROR "Unexpected timeline:\n${timeline}")
+endif()
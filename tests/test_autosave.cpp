@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "autosaveworker.h"
+#include "programfile.h"
+#include "prototablemodel.h"
+#include "regimemanager.h"
+
+namespace {
+
+QList<Regime> makeProgram(int count)
+{
+    QList<Regime> regimes;
+    for (int i = 0; i < count; ++i) {
+        Regime regime;
+        regime.m_name = QString("Regime %1").arg(i);
+        regime.m_condition.type = "time";
+        regime.m_condition.time = 10 + i;
+        regime.m_maxTime = 60;
+        regimes.append(regime);
+    }
+    return regimes;
+}
+
+QStringList names(const QList<Regime> &regimes)
+{
+    QStringList result;
+    for (const Regime &regime : regimes)
+        result.append(regime.m_name);
+    return result;
+}
+
+} // namespace
+
+TEST(ProgramJournalTest, AppendsOnlyChangedRows)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("program.autosave");
+    ProgramJournal journal(path);
+
+    QList<Regime> program = makeProgram(20);
+    ASSERT_TRUE(journal.update(program));
+    const qint64 baseSize = journal.lastWriteSize();
+
+    program[3].m_name = "Changed";
+    ASSERT_TRUE(journal.update(program));
+    ASSERT_GT(journal.lastWriteSize(), 0);
+    ASSERT_LT(journal.lastWriteSize(), baseSize / 4);
+
+    program.append(makeProgram(1));
+    ASSERT_TRUE(journal.update(program));
+
+    // Nothing changed, nothing written
+    ASSERT_TRUE(journal.update(program));
+    ASSERT_EQ(journal.lastWriteSize(), 0);
+
+    QList<Regime> restored;
+    ASSERT_TRUE(ProgramJournal::read(path, restored));
+    ASSERT_EQ(names(restored), names(program));
+    ASSERT_EQ(restored.at(20).m_condition.time, 10);
+}
+
+TEST(ProgramJournalTest, IgnoresTornTail)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("program.autosave");
+    ProgramJournal journal(path);
+
+    QList<Regime> program = makeProgram(10);
+    ASSERT_TRUE(journal.update(program));
+    const QList<Regime> saved = program;
+    program[0].m_name = "Lost";
+    ASSERT_TRUE(journal.update(program));
+
+    // Simulate a crash in the middle of the last append
+    QFile file(path);
+    ASSERT_TRUE(file.resize(file.size() - 3));
+
+    QList<Regime> restored;
+    ASSERT_TRUE(ProgramJournal::read(path, restored));
+    ASSERT_EQ(names(restored), names(saved));
+}
+
+TEST(ProgramJournalTest, WriteJsonRoundTrip)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("program.json");
+    const QList<Regime> program = makeProgram(3);
+    ASSERT_TRUE(ProgramFile::writeJson(program, path));
+
+    bool ok = false;
+    const QList<Regime> loaded = ProgramFile::readJson(path, &ok);
+    ASSERT_TRUE(ok);
+    ASSERT_EQ(names(loaded), names(program));
+}
+
+TEST(AutosaveWorkerTest, SavesDefinitionChangesOnly)
+{
+    QTemporaryDir dir;
+    ProtoTableModel model;
+    model.setRegimes(makeProgram(5));
+
+    AutosaveWorker autosave(&model);
+    autosave.setInterval(0);
+    autosave.setJournalPath(dir.filePath("program.autosave"));
+    autosave.saveNow();
+    autosave.waitForIdle();
+    ASSERT_FALSE(autosave.isPending());
+
+    // Execution progress is not a definition change
+    model.setData(model.index(0, 0), QVariant::fromValue(RegimeEnums::State::Running), ProtoTableModel::StateRole);
+    ASSERT_FALSE(autosave.isPending());
+
+    model.setData(model.index(2, 0), 90, ProtoTableModel::MaxTimeRole);
+    ASSERT_TRUE(autosave.isPending());
+
+    QSignalSpy savedSpy(&autosave, &AutosaveWorker::saved);
+    autosave.saveNow();
+    autosave.waitForIdle();
+    ASSERT_TRUE(savedSpy.wait(1000));
+
+    QList<Regime> restored;
+    ASSERT_TRUE(AutosaveWorker::recover(autosave.journalPath(), restored));
+    ASSERT_EQ(restored.at(2).m_maxTime, 90);
+}
+
+TEST(AutosaveWorkerTest, LoadingOffersJournalLeftBehind)
+{
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath("program.json");
+    ASSERT_TRUE(ProgramFile::writeJson(makeProgram(3), filePath));
+
+    RegimeManager manager(false, nullptr);
+    manager.importRegimes(QUrl::fromLocalFile(filePath));
+    ASSERT_FALSE(manager.isAutosaveAvailable());
+
+    // Edits journaled by a session that never saved them
+    QList<Regime> edited = makeProgram(4);
+    edited[1].m_name = "Откачка";
+    ASSERT_TRUE(ProgramJournal(filePath + ".autosave").compact(edited));
+
+    QSignalSpy available(&manager, &RegimeManager::autosaveAvailableChanged);
+    manager.importRegimes(QUrl::fromLocalFile(filePath));
+    ASSERT_EQ(available.count(), 1);
+    ASSERT_TRUE(manager.isAutosaveAvailable());
+    ASSERT_EQ(manager.model()->rowCount(), 3);
+
+    ASSERT_TRUE(manager.restoreAutosave());
+    ASSERT_FALSE(manager.isAutosaveAvailable());
+    ASSERT_EQ(names(manager.model()->getRegimes()), names(edited));
+    ASSERT_TRUE(manager.dirty());
+
+    // Declining deletes the journal, so it is not offered again
+    manager.importRegimes(QUrl::fromLocalFile(filePath));
+    ASSERT_TRUE(manager.isAutosaveAvailable());
+    manager.discardAutosave();
+    manager.autosave()->waitForIdle();
+    ASSERT_FALSE(QFile::exists(filePath + ".autosave"));
+}
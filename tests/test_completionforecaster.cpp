@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "completionforecaster.h"
+#include "prototablemodel.h"
+#include <QSignalSpy>
+#include <QThreadPool>
+
+namespace {
+
+Regime makeRegime(const QString &conditionType, int conditionMinutes, int maxTime, int repeats)
+{
+    Regime regime;
+    regime.m_name = "Forecast";
+    regime.m_condition.type = conditionType;
+    regime.m_condition.time = conditionMinutes;
+    regime.m_maxTime = maxTime;
+    regime.m_repeatCount = repeats;
+    return regime;
+}
+
+QHash<QString, CompletionForecaster::Distribution> defaultDistributions()
+{
+    return {
+        { "none", {0.0, 0.0} },
+        { "time", {1.0, 1.0} },
+        { "temp", {0.25, 1.0} }
+    };
+}
+
+} // namespace
+
+TEST(CompletionForecasterTest, FixedConditionsCollapsePercentiles)
+{
+    QThreadPool pool;
+    QList<Regime> regimes { makeRegime("time", 1, 60, 2), makeRegime("none", 0, 30, 1) };
+
+    auto forecast = CompletionForecaster::simulate(regimes, defaultDistributions(), 2000, 1, &pool);
+
+    // (60 s condition + 60 s execution) * 2 + 30 s
+    ASSERT_EQ(forecast.p50, 270);
+    ASSERT_EQ(forecast.p90, 270);
+    ASSERT_EQ(forecast.p99, 270);
+}
+
+TEST(CompletionForecasterTest, TempConditionSpreadsPercentiles)
+{
+    QThreadPool pool;
+    QList<Regime> regimes { makeRegime("temp", 10, 60, 4) };
+
+    auto forecast = CompletionForecaster::simulate(regimes, defaultDistributions(), 5000, 7, &pool);
+
+    // Each condition takes 150..600 s, followed by 60 s of execution
+    ASSERT_GE(forecast.p50, 4 * (150 + 60));
+    ASSERT_LE(forecast.p99, 4 * (600 + 60));
+    ASSERT_LE(forecast.p50, forecast.p90);
+    ASSERT_LE(forecast.p90, forecast.p99);
+    ASSERT_LT(forecast.p50, forecast.p99);
+}
+
+TEST(CompletionForecasterTest, SameSeedGivesSameForecast)
+{
+    QThreadPool pool;
+    QList<Regime> regimes { makeRegime("temp", 5, 30, 100) };
+
+    auto first = CompletionForecaster::simulate(regimes, defaultDistributions(), 4096, 42, &pool);
+    auto second = CompletionForecaster::simulate(regimes, defaultDistributions(), 4096, 42, &pool);
+
+    ASSERT_EQ(first.p50, second.p50);
+    ASSERT_EQ(first.p90, second.p90);
+    ASSERT_EQ(first.p99, second.p99);
+}
+
+TEST(CompletionForecasterTest, ProgressAndFinishedRegimesReduceRemainingTime)
+{
+    QThreadPool pool;
+    Regime done = makeRegime("time", 1, 60, 1);
+    done.m_state = RegimeEnums::State::Done;
+
+    Regime running = makeRegime("time", 1, 60, 2);
+    running.m_state = RegimeEnums::State::Running;
+    running.m_conditionCompleted = true;
+    running.m_regimeTimePassed = 20;
+
+    auto forecast = CompletionForecaster::simulate({ done, running }, defaultDistributions(), 1000, 1, &pool);
+
+    // 40 s left in the current repeat plus one full repeat of 120 s
+    ASSERT_EQ(forecast.p50, 160);
+}
+
+TEST(CompletionForecasterTest, ForecastFollowsRowEdits)
+{
+    QThreadPool pool;
+    ProtoTableModel model;
+    model.setRegimes(QList<Regime>(1000, makeRegime("time", 1, 60, 1)));
+    CompletionForecaster forecaster(&model);
+    forecaster.setThreadPool(&pool);
+    QSignalSpy changed(&forecaster, &CompletionForecaster::forecastChanged);
+    forecaster.requestUpdate();
+    ASSERT_TRUE(changed.wait(3000));
+    ASSERT_EQ(forecaster.p50(), 1000 * 120);
+
+    // One row is done and the next is half way through its execution
+    model.setData(model.index(0, 0), QVariant::fromValue(RegimeEnums::State::Done), ProtoTableModel::StateRole);
+    model.setData(model.index(1, 0), true, ProtoTableModel::ConditionCompletedRole);
+    model.setData(model.index(1, 0), 30, ProtoTableModel::RegimeTimePassedRole);
+    model.setData(model.index(1, 0), QVariant::fromValue(RegimeEnums::State::Running), ProtoTableModel::StateRole);
+    ASSERT_TRUE(changed.wait(3000));
+    ASSERT_EQ(forecaster.p50(), 998 * 120 + 30);
+
+    // Inserted rows are picked up by re-reading the program; a new row has no condition
+    model.addRow("Откачка");
+    ASSERT_TRUE(changed.wait(3000));
+    ASSERT_EQ(forecaster.p50(), 998 * 120 + 30 + 60);
+}
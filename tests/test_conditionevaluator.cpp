@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <QSignalSpy>
+#include "regimemanager.h"
+#include <vector>
+
+namespace {
+
+constexpr int kIntervalUs = 100; // 10 kHz
+
+QList<Regime> temperatureRegime(double target)
+{
+    Regime r;
+    r.m_name = "Heat";
+    r.m_maxTime = 600;
+    r.m_condition.type = "temp";
+    r.m_condition.temp = target;
+    r.m_condition.time = 10;
+    return { r };
+}
+
+bool conditionCompleted(RegimeManager &manager)
+{
+    return manager.getRegimeExecutionInfo(0)["conditionCompleted"].toBool();
+}
+
+} // namespace
+
+TEST(ConditionEvaluatorTest, TemperatureMustHoldPastHysteresis)
+{
+    RegimeManager manager(false, nullptr);
+    manager.model()->setRegimes(temperatureRegime(100.0));
+    ConditionEvaluator *evaluator = manager.conditionEvaluator();
+    evaluator->setEnabled(true);
+    evaluator->setHysteresis(0.5);
+    evaluator->setHoldTime(100);
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+
+    // Heating up to the target, then 50 ms at it with noise inside the hysteresis band
+    std::vector<float> samples;
+    for (int i = 0; i < 1000; ++i)
+        samples.push_back(90.0f + i * 0.01f);
+    for (int i = 0; i < 500; ++i)
+        samples.push_back(i % 2 ? 100.2f : 99.7f);
+    ASSERT_TRUE(evaluator->postSamples(0, samples.data(), qsizetype(samples.size()), 0, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 0);
+    ASSERT_FALSE(conditionCompleted(manager));
+
+    // A dip past the hysteresis restarts the hold time, so 60 ms more are not enough
+    const qint64 resumedUs = qint64(samples.size()) * kIntervalUs;
+    samples.assign(1, 99.0f);
+    samples.insert(samples.end(), 599, 100.1f);
+    ASSERT_TRUE(evaluator->postSamples(0, samples.data(), qsizetype(samples.size()), resumedUs, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 0);
+    ASSERT_FALSE(conditionCompleted(manager));
+
+    // Samples of other channels are ignored
+    samples.assign(2000, 100.1f);
+    ASSERT_TRUE(evaluator->postSamples(1, samples.data(), qsizetype(samples.size()), resumedUs + 60000, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 0);
+
+    ASSERT_TRUE(evaluator->postSamples(0, samples.data(), 500, resumedUs + 60000, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 1);
+    ASSERT_TRUE(conditionCompleted(manager));
+    ASSERT_EQ(evaluator->processedCount(), 1500u + 600u + 2000u + 500u);
+    ASSERT_EQ(evaluator->droppedCount(), 0u);
+}
+
+TEST(ConditionEvaluatorTest, TargetIsApproachedFromEitherSide)
+{
+    RegimeManager manager(false, nullptr);
+    QList<Regime> regimes = temperatureRegime(20.0);
+    regimes[0].m_repeatCount = 2;
+    manager.model()->setRegimes(regimes);
+    ConditionEvaluator *evaluator = manager.conditionEvaluator();
+    evaluator->setEnabled(true);
+    evaluator->setHoldTime(0);
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+
+    const std::vector<float> cooling = {25.0f, 22.0f, 19.5f};
+    ASSERT_TRUE(evaluator->postSamples(0, cooling.data(), 3, 0, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 1);
+
+    // The next repeat starts over from the side its first sample is on
+    ASSERT_TRUE(manager.completeCurrentRepeat(0, 0));
+    ASSERT_FALSE(conditionCompleted(manager));
+    const std::vector<float> heating = {18.0f, 19.0f, 19.9f};
+    ASSERT_TRUE(evaluator->postSamples(0, heating.data(), 3, 300, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 0);
+    const float reached = 20.0f;
+    ASSERT_TRUE(evaluator->postSamples(0, &reached, 1, 600, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 1);
+    ASSERT_TRUE(conditionCompleted(manager));
+}
+
+TEST(ConditionEvaluatorTest, TimeConditionFollowsPhaseClock)
+{
+    RegimeManager manager(false, nullptr);
+    QList<Regime> regimes = temperatureRegime(0.0);
+    regimes[0].m_condition.type = "time";
+    regimes[0].m_condition.time = 1;
+    manager.model()->setRegimes(regimes);
+
+    qint64 clock = 0;
+    manager.phaseClock()->setClock([&clock]() { return clock; });
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+
+    // Off until the driver opts in, so it can still confirm the condition itself
+    ConditionEvaluator *evaluator = manager.conditionEvaluator();
+    ASSERT_FALSE(evaluator->isEnabled());
+    clock = 60000;
+    ASSERT_EQ(evaluator->drain(), 0);
+    ASSERT_FALSE(conditionCompleted(manager));
+
+    evaluator->setEnabled(true);
+    clock = 59000;
+    ASSERT_EQ(evaluator->drain(), 0);
+    clock = 60000;
+    ASSERT_EQ(evaluator->drain(), 1);
+    ASSERT_TRUE(conditionCompleted(manager));
+}
+
+TEST(ConditionEvaluatorTest, HoldSurvivesRemovingRowsAbove)
+{
+    RegimeManager manager(false, nullptr);
+    Regime waiting;
+    waiting.m_name = "Wait";
+    manager.model()->setRegimes({waiting, temperatureRegime(100.0).constFirst()});
+    ConditionEvaluator *evaluator = manager.conditionEvaluator();
+    evaluator->setEnabled(true);
+    evaluator->setHoldTime(100);
+    ASSERT_TRUE(manager.startRegimeExecution(1));
+
+    // Half of the hold time at the target, then the row above is deleted
+    std::vector<float> samples(500, 100.1f);
+    ASSERT_TRUE(evaluator->postSamples(0, samples.data(), qsizetype(samples.size()), 0, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 0);
+    manager.model()->deleteRows({0});
+    ASSERT_EQ(manager.model()->getRegime(0).m_state, RegimeEnums::State::Running);
+
+    QSignalSpy confirmed(evaluator, &ConditionEvaluator::conditionConfirmed);
+    ASSERT_TRUE(evaluator->postSamples(0, samples.data(), qsizetype(samples.size()), 50000, kIntervalUs));
+    ASSERT_EQ(evaluator->drain(), 1);
+    ASSERT_TRUE(conditionCompleted(manager));
+    ASSERT_EQ(confirmed.count(), 1);
+    ASSERT_EQ(confirmed.at(0).at(0).toInt(), 0);
+}
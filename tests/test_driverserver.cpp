@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "driverclient.h"
+#include "driverserver.h"
+#include "regimemanager.h"
+
+namespace {
+
+using DriverProtocol::Opcode;
+using DriverProtocol::Status;
+
+QList<Regime> timedRegime()
+{
+    Regime r;
+    r.m_name = "Heat";
+    r.m_maxTime = 60;
+    r.m_condition.type = "time";
+    r.m_condition.time = 1;
+    return { r };
+}
+
+bool waitForReplies(QSignalSpy &spy, int count)
+{
+    while (spy.count() < count) {
+        if (!spy.wait(3000))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(DriverServerTest, ListenReplacesOnlyStaleSockets)
+{
+    QTemporaryDir dir;
+    const QString name = dir.filePath("driver");
+    RegimeManager manager(false, nullptr);
+
+    // A file left where the socket was, as after a crash, answers no connect probe
+    QFile stale(name);
+    ASSERT_TRUE(stale.open(QIODevice::WriteOnly));
+    stale.close();
+    DriverServer server(&manager);
+    ASSERT_TRUE(server.listen(name));
+
+    // A second instance must not take the name over from a live server
+    DriverServer second(&manager);
+    ASSERT_FALSE(second.listen(name));
+    ASSERT_FALSE(second.isListening());
+    ASSERT_TRUE(server.isListening());
+
+    DriverClient client;
+    client.connectToServer(name);
+    ASSERT_TRUE(client.waitForConnected());
+    QSignalSpy replies(&client, &DriverClient::replyReceived);
+    const quint32 requestId = client.requestExecutionInfo(1);
+    ASSERT_TRUE(waitForReplies(replies, 1));
+    ASSERT_EQ(replies.at(0).at(0).toUInt(), requestId);
+    ASSERT_EQ(replies.at(0).at(2).toUInt(), quint8(Status::Rejected));
+}
+
+TEST(DriverServerTest, PipelinedRequestsAreAnsweredInOrder)
+{
+    QTemporaryDir dir;
+    const QString name = dir.filePath("driver");
+    RegimeManager manager(false, nullptr);
+    manager.model()->setRegimes(timedRegime());
+    DriverServer server(&manager);
+    ASSERT_TRUE(server.listen(name));
+
+    DriverClient client;
+    client.connectToServer(name);
+    ASSERT_TRUE(client.waitForConnected());
+    QSignalSpy replies(&client, &DriverClient::replyReceived);
+
+    const quint32 start = client.startExecution(0);
+    ASSERT_EQ(client.conditionProgress(0, 5, 0), 0u);
+    client.queueConditionProgress(0, 7, 0);
+    client.queueConditionProgress(0, 9, 0);
+    const quint32 batch = client.flushProgress(true);
+    const quint32 wrongRepeat = client.completeRepeat(0, 3);
+    const quint32 info = client.requestExecutionInfo(0);
+    ASSERT_TRUE(waitForReplies(replies, 4));
+    ASSERT_EQ(server.clientCount(), 1);
+
+    const QList<quint32> ids = {start, batch, wrongRepeat, info};
+    for (int i = 0; i < ids.count(); ++i)
+        ASSERT_EQ(replies.at(i).at(0).toUInt(), ids.at(i));
+    ASSERT_EQ(replies.at(0).at(1).toUInt(), quint8(Opcode::StartExecution));
+    ASSERT_EQ(replies.at(0).at(2).toUInt(), quint8(Status::Ok));
+
+    // Both records of the batch are for one regime and phase, so only the newest is applied
+    const QVariantMap applied = replies.at(1).at(3).toMap();
+    ASSERT_EQ(applied.value("applied").toInt(), 1);
+    ASSERT_EQ(applied.value("rejected").toInt(), 0);
+    ASSERT_EQ(replies.at(2).at(2).toUInt(), quint8(Status::Rejected));
+
+    const QVariantMap state = replies.at(3).at(3).toMap();
+    ASSERT_EQ(state.value("state").toInt(), int(RegimeEnums::State::Running));
+    ASSERT_EQ(state.value("conditionTimePassed").toInt(), 9);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include <QSignalSpy>
+#include "persistentvector.h"
+#include "prototablemodel.h"
+
+namespace {
+
+QStringList names(const ProtoTableModel &model)
+{
+    QStringList result;
+    for (const Regime &regime : model.getRegimes())
+        result.append(regime.m_name);
+    return result;
+}
+
+} // namespace
+
+TEST(PersistentVectorTest, VersionsAreIndependent)
+{
+    const auto original = PersistentVector<int>::fromList({0, 1, 2, 3, 4});
+    const auto changed = original.set(2, 20).insert(0, -1).remove(5);
+    const auto moved = original.move(0, 2, 5);
+
+    ASSERT_EQ(original.toList(), QList<int>({0, 1, 2, 3, 4}));
+    ASSERT_EQ(changed.toList(), QList<int>({-1, 0, 1, 20, 3}));
+    ASSERT_EQ(moved.toList(), QList<int>({2, 3, 4, 0, 1}));
+    ASSERT_EQ(original.mid(1, 3).toList(), QList<int>({1, 2, 3}));
+}
+
+TEST(EditHistoryTest, UndoRedoAddAndDelete)
+{
+    ProtoTableModel model;
+    model.addRow("A");
+    model.addRow("B");
+    model.addRow("C");
+    ASSERT_TRUE(model.canUndo());
+
+    model.deleteRows({1});
+    ASSERT_EQ(names(model), QStringList({"A", "C"}));
+
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy reset(&model, &QAbstractItemModel::modelReset);
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(names(model), QStringList({"A", "B", "C"}));
+    ASSERT_EQ(inserted.count(), 1);
+    ASSERT_EQ(reset.count(), 0);
+
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(names(model), QStringList({"A", "B"}));
+    ASSERT_TRUE(model.redo());
+    ASSERT_TRUE(model.redo());
+    ASSERT_EQ(names(model), QStringList({"A", "C"}));
+    ASSERT_FALSE(model.canRedo());
+}
+
+TEST(EditHistoryTest, UndoGroupMoveAndFieldEdits)
+{
+    ProtoTableModel model;
+    model.addRow("A");
+    model.addRow("B");
+    model.addRow("C");
+    model.addRow("D");
+
+    model.groupRows({0, 1});
+    ASSERT_NE(model.getRegime(0).m_cycleId, -1);
+    model.moveSelection({3}, true);
+    ASSERT_EQ(names(model), QStringList({"A", "B", "D", "C"}));
+    ASSERT_TRUE(model.setData(model.index(2, 0), 300, ProtoTableModel::MaxTimeRole));
+
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(model.getRegime(2).m_maxTime, 60);
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(names(model), QStringList({"A", "B", "C", "D"}));
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(model.getRegime(0).m_cycleId, -1);
+    ASSERT_EQ(model.getRegime(1).m_cycleId, -1);
+
+    ASSERT_TRUE(model.redo());
+    ASSERT_EQ(model.getRegime(0).m_cycleId, model.getRegime(1).m_cycleId);
+    ASSERT_NE(model.getRegime(0).m_cycleId, -1);
+}
+
+TEST(EditHistoryTest, UndoSignalsOnlyTouchedRows)
+{
+    QList<Regime> regimes(1000);
+    for (int row = 0; row < regimes.count(); ++row)
+        regimes[row].m_name = QString::number(row);
+    ProtoTableModel model;
+    model.setRegimes(regimes);
+    model.groupRows({500, 501});
+
+    // Edited in the middle of a cycle: the signals cover the cycle, not the table
+    ASSERT_TRUE(model.setData(model.index(501, 0), 300, ProtoTableModel::MaxTimeRole));
+    QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(model.getRegime(501).m_maxTime, 60);
+    ASSERT_FALSE(changed.isEmpty());
+    for (const QList<QVariant> &arguments : changed) {
+        ASSERT_GE(arguments.at(0).toModelIndex().row(), 499);
+        ASSERT_LE(arguments.at(1).toModelIndex().row(), 502);
+    }
+
+    // Moving a cycle renumbers the ids of both cycles, at the rows' new positions
+    model.groupRows({10, 11});
+    const int firstCycle = model.getRegime(10).m_cycleId;
+    const int movedCycle = model.getRegime(500).m_cycleId;
+    ASSERT_TRUE(model.moveRows(QModelIndex(), 500, 2, QModelIndex(), 0));
+    ASSERT_EQ(model.getRegime(0).m_name, "500");
+    ASSERT_EQ(model.getRegime(0).m_cycleId, firstCycle);
+    ASSERT_EQ(model.getRegime(12).m_cycleId, movedCycle);
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(model.getRegime(500).m_name, "500");
+    ASSERT_EQ(model.getRegime(500).m_cycleId, movedCycle);
+    ASSERT_EQ(model.getRegime(10).m_cycleId, firstCycle);
+    ASSERT_TRUE(model.redo());
+    ASSERT_EQ(model.getRegime(1).m_cycleId, firstCycle);
+    ASSERT_EQ(model.getRegime(13).m_cycleId, movedCycle);
+}
+
+TEST(EditHistoryTest, ProgressIsNotUndone)
+{
+    ProtoTableModel model;
+    model.addRow("A");
+    ASSERT_TRUE(model.setData(model.index(0, 0), 120, ProtoTableModel::MaxTimeRole));
+    model.setData(model.index(0, 0), 42, ProtoTableModel::RegimeTimePassedRole);
+
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(model.getRegime(0).m_maxTime, 60);
+    ASSERT_EQ(model.getRegime(0).m_regimeTimePassed, 42);
+}
+
+TEST(EditHistoryTest, SetRegimesClearsHistory)
+{
+    ProtoTableModel model;
+    model.addRow("A");
+    model.setRegimes({});
+    ASSERT_FALSE(model.canUndo());
+    ASSERT_FALSE(model.undo());
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "programvalidator.h"
+#include "regimemanager.h"
+#include <QJsonDocument>
+
+namespace {
+
+Regime makeRegime(const QString &name)
+{
+    Regime regime;
+    regime.m_name = name;
+    regime.m_maxTime = 60;
+    return regime;
+}
+
+QList<ProgramDiagnostic::Code> codesAt(const QList<ProgramDiagnostic> &diagnostics, int row)
+{
+    QList<ProgramDiagnostic::Code> codes;
+    for (const ProgramDiagnostic &diagnostic : diagnostics) {
+        if (diagnostic.row == row)
+            codes.append(diagnostic.code);
+    }
+    return codes;
+}
+
+} // namespace
+
+TEST(ProgramValidatorTest, ReportsRowLimitsAndConditions)
+{
+    QList<Regime> regimes(4, makeRegime("Нагрев"));
+    regimes[0].m_repeatCount = 0;
+    regimes[1].m_maxTime = 90000;
+    regimes[2].m_condition.type = "pressure";
+    regimes[3].m_condition.time = 5;
+    regimes[3].m_name = " ";
+
+    const QList<ProgramDiagnostic> diagnostics = ProgramValidator::validate(regimes);
+    ASSERT_EQ(codesAt(diagnostics, 0), QList{ProgramDiagnostic::Code::RepeatCountOutOfRange});
+    ASSERT_EQ(codesAt(diagnostics, 1), QList{ProgramDiagnostic::Code::MaxTimeOutOfRange});
+    ASSERT_EQ(codesAt(diagnostics, 2), QList{ProgramDiagnostic::Code::UnknownConditionType});
+    ASSERT_EQ(codesAt(diagnostics, 3), (QList{ProgramDiagnostic::Code::EmptyName, ProgramDiagnostic::Code::ConditionFieldIgnored}));
+    // Sorted by row: the two warnings of row 3 come last
+    ASSERT_FALSE(diagnostics.last().isError());
+    ASSERT_TRUE(ProgramValidator::hasErrors(diagnostics));
+    ASSERT_FALSE(ProgramValidator::hasErrors(ProgramValidator::validate({makeRegime("Нагрев")})));
+}
+
+TEST(ProgramValidatorTest, CycleRulesHoldAcrossChunks)
+{
+    // Large enough to spread over several chunks
+    QList<Regime> regimes(40000, makeRegime("Режим"));
+    for (int row = 16380; row < 16390; ++row) {
+        regimes[row].m_cycleId = 1;
+        regimes[row].m_cycleRepeat = 2;
+    }
+    regimes[16388].m_cycleRepeat = 3;
+    regimes[100].m_cycleId = 2;
+    regimes[30000].m_cycleId = 2;
+
+    const QList<ProgramDiagnostic> diagnostics = ProgramValidator::validate(regimes);
+    ASSERT_EQ(diagnostics.count(), 2);
+    ASSERT_EQ(codesAt(diagnostics, 100), QList{ProgramDiagnostic::Code::CycleSplit});
+    ASSERT_EQ(codesAt(diagnostics, 16388), QList{ProgramDiagnostic::Code::CycleRepeatMismatch});
+}
+
+TEST(ProgramValidatorTest, DetectsTotalTimeOverflow)
+{
+    Regime regime = makeRegime("Выдержка");
+    regime.m_maxTime = ProgramValidator::MaxTimeSeconds;
+    regime.m_repeatCount = ProgramValidator::MaxRepeatCount;
+    regime.m_cycleId = 1;
+    regime.m_cycleRepeat = ProgramValidator::MaxRepeatCount;
+
+    const QList<ProgramDiagnostic> diagnostics = ProgramValidator::validate({regime});
+    ASSERT_EQ(codesAt(diagnostics, -1), QList{ProgramDiagnostic::Code::TotalTimeOverflow});
+}
+
+TEST(ProgramValidatorTest, ReportsCoercedJson)
+{
+    const QJsonArray program = QJsonDocument::fromJson(R"([
+        {"name": "Вакуум", "condition": {"type": "pressure", "time": 0, "temp": 0}, "max_time": 10, "repeat": "3", "cycle": null},
+        {"name": "Режим а", "condition": {"type": "time", "time": 1.5, "temp": 0}, "max_time": 10, "repeat": 1, "cycle": {"id": 1, "cycleRepeat": 2}}
+    ])").array();
+
+    QList<Regime> regimes;
+    const QList<ProgramDiagnostic> diagnostics = ProgramValidator::validateJson(program, &regimes);
+    ASSERT_EQ(regimes.count(), 2);
+    const QList<ProgramDiagnostic::Code> first = codesAt(diagnostics, 0);
+    ASSERT_TRUE(first.contains(ProgramDiagnostic::Code::UnknownConditionType));
+    ASSERT_TRUE(first.contains(ProgramDiagnostic::Code::InvalidJson));
+    ASSERT_TRUE(codesAt(diagnostics, 1).contains(ProgramDiagnostic::Code::InvalidJson));
+}
+
+TEST(ProgramValidatorTest, ManagerRefusesToStartInvalidProgram)
+{
+    RegimeManager manager(false, nullptr);
+    Regime regime = makeRegime("Нагрев");
+    regime.m_repeatCount = 0;
+    manager.model()->setRegimes({regime, makeRegime("Выдержка")});
+
+    ASSERT_FALSE(manager.startRegimeExecution(0));
+    ASSERT_EQ(manager.programDiagnostics().count(), 1);
+    ASSERT_EQ(manager.programDiagnostics().first().row, 0);
+
+    ASSERT_TRUE(manager.model()->setData(manager.model()->index(0, 0), 2, ProtoTableModel::RepeatRole));
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+    ASSERT_TRUE(manager.programDiagnostics().isEmpty());
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "regimemanager.h"
+#include <thread>
+#include <vector>
+
+namespace {
+
+QList<Regime> singleRegime(int repeats)
+{
+    Regime r;
+    r.m_name = "Ingest";
+    r.m_maxTime = 600;
+    r.m_repeatCount = repeats;
+    r.m_condition.type = "time";
+    r.m_condition.time = 10;
+    return { r };
+}
+
+} // namespace
+
+TEST(ProgressIngestorTest, ProgressIsCoalescedLastValueWins)
+{
+    RegimeManager manager(false, nullptr);
+    manager.model()->setRegimes(singleRegime(1));
+    ProgressIngestor *ingestor = manager.progressIngestor();
+
+    ASSERT_TRUE(ingestor->postTransition(ProgressIngestor::RecordKind::StartExecution, 0, 0));
+    for (int second = 1; second <= 100; ++second) {
+        ASSERT_TRUE(ingestor->postConditionProgress(0, second, 0));
+    }
+
+    // One start plus a single coalesced progress update
+    ASSERT_EQ(ingestor->drain(), 2);
+    ASSERT_EQ(ingestor->coalescedCount(), 99u);
+    ASSERT_EQ(manager.getRegimeExecutionInfo(0)["conditionTimePassed"].toInt(), 100);
+}
+
+TEST(ProgressIngestorTest, TransitionsActAsBarriers)
+{
+    RegimeManager manager(false, nullptr);
+    manager.model()->setRegimes(singleRegime(2));
+    ProgressIngestor *ingestor = manager.progressIngestor();
+
+    ingestor->postTransition(ProgressIngestor::RecordKind::StartExecution, 0, 0);
+    ingestor->postRegimeProgress(0, 100, 0);
+    ingestor->postTransition(ProgressIngestor::RecordKind::CompleteRepeat, 0, 0);
+    // Belongs to the second repeat and must not be merged with the first one
+    ingestor->postRegimeProgress(0, 5, 1);
+    ingestor->drain();
+
+    auto info = manager.getRegimeExecutionInfo(0);
+    ASSERT_EQ(info["currentRepeat"].toInt(), 1);
+    ASSERT_EQ(info["repeatsDone"].toInt(), 1);
+    ASSERT_EQ(info["regimeTimePassed"].toInt(), 5);
+    ASSERT_EQ(ingestor->rejectedCount(), 0u);
+}
+
+TEST(ProgressIngestorTest, ConcurrentProducersDoNotLoseRecords)
+{
+    RegimeManager manager(false, nullptr);
+    manager.model()->setRegimes(singleRegime(1));
+    ProgressIngestor ingestor(&manager, 1 << 16);
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&ingestor]() {
+            for (int i = 0; i < 1000; ++i)
+                ingestor.postConditionProgress(0, i % 600, 0);
+        });
+    }
+    for (auto &producer : producers)
+        producer.join();
+
+    ingestor.drain();
+    ASSERT_EQ(ingestor.droppedCount(), 0u);
+    ASSERT_EQ(ingestor.coalescedCount(), 3999u);
+}
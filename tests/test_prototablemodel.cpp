@@ -1,4 +1,8 @@
 #include <gtest/gtest.h>
+#include <QSignalSpy>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
 #include "prototablemodel.h"
 #include "regimemanager.h"
 
@@ -14,4 +18,293 @@ TEST(ProtoTableModelTest, SetRegimes) {
     model.setRegimes(regimes);
     ASSERT_EQ(model.rowCount(), 2);
     ASSERT_EQ(model.data(model.index(0, 0), Qt::DisplayRole).toString(), QString("Test Regime 1"));
-}
\ No newline at end of file
+}
+TEST(ProtoTableModelTest, SnapshotsAreImmutable) {
+    ProtoTableModel model;
+    model.addRow("First");
+    const ProgramSnapshotPtr before = model.snapshot();
+    ASSERT_EQ(before->regimes.count(), 1);
+
+    model.addRow("Second");
+    model.setData(model.index(0, 0), 30, ProtoTableModel::RegimeTimePassedRole);
+
+    // The held snapshot is untouched, a fresh one sees the edits
+    ASSERT_EQ(before->regimes.count(), 1);
+    ASSERT_EQ(before->regimes.at(0).m_regimeTimePassed, 0);
+    const ProgramSnapshotPtr after = model.snapshot();
+    ASSERT_GT(after->version, before->version);
+    ASSERT_EQ(after->regimes.count(), 2);
+    ASSERT_EQ(after->regimes.at(0).m_regimeTimePassed, 30);
+
+    // No changes, no new version
+    ASSERT_EQ(model.snapshot(), after);
+}
+
+TEST(ProtoTableModelTest, SnapshotsCopyOnlyChangedChunks) {
+    ProtoTableModel model;
+    model.setRegimes(QList<Regime>(1000));
+    const ProgramSnapshotPtr before = model.snapshot();
+    const Regime *live = &model.regimeAt(0);
+
+    // Progress after a publication writes the live rows in place
+    model.setData(model.index(0, 0), 30, ProtoTableModel::RegimeTimePassedRole);
+    ASSERT_EQ(&model.regimeAt(0), live);
+    const ProgramSnapshotPtr after = model.snapshot();
+    ASSERT_EQ(&model.regimeAt(0), live);
+    ASSERT_NE(&after->regimes.at(0), live);
+
+    // Only the chunk of row 0 was copied
+    ASSERT_EQ(before->regimes.at(0).m_regimeTimePassed, 0);
+    ASSERT_EQ(after->regimes.at(0).m_regimeTimePassed, 30);
+    ASSERT_NE(after->regimes.chunkOf(0).constData(), before->regimes.chunkOf(0).constData());
+    ASSERT_EQ(after->regimes.chunkOf(999).constData(), before->regimes.chunkOf(999).constData());
+
+    // Renumbered cycle ids reach the snapshot too, though only the grouped rows are notified
+    model.groupRows({900, 901});
+    model.groupRows({10, 11});
+    ASSERT_EQ(model.snapshot()->regimes.at(900).m_cycleId, model.regimeAt(900).m_cycleId);
+    ASSERT_EQ(model.snapshot()->regimes.toList(), model.getRegimes());
+}
+
+TEST(ProtoTableModelTest, SnapshotsFromPoolThreadsWhileEditing) {
+    ProtoTableModel model;
+    model.addRow("First");
+    model.setData(model.index(0, 0), 1, ProtoTableModel::RegimeTimePassedRole);
+    model.snapshot();
+
+    // A reader on a pool thread only ever sees complete, increasing snapshots
+    std::atomic<bool> stop{false};
+    std::atomic<bool> consistent{true};
+    std::atomic<int> reads{0};
+    QThreadPool pool;
+    pool.start([&]() {
+        quint64 lastVersion = 0;
+        while (!stop.load()) {
+            const ProgramSnapshotPtr snapshot = model.snapshot();
+            if (snapshot->version < lastVersion || snapshot->regimes.isEmpty())
+                consistent = false;
+            for (const Regime &regime : snapshot->regimes) {
+                if (regime.m_regimeTimePassed != int(snapshot->regimes.count()))
+                    consistent = false;
+            }
+            lastVersion = snapshot->version;
+            ++reads;
+        }
+    });
+
+    for (int i = 0; i < 200; ++i) {
+        model.addRow(QString("Row %1").arg(i));
+        // Every row holds the row count, so a torn snapshot would show
+        for (int row = 0; row < model.rowCount(); ++row)
+            model.setData(model.index(row, 0), model.rowCount(), ProtoTableModel::RegimeTimePassedRole);
+        model.snapshot();
+    }
+    while (reads.load() < 100)
+        QThread::yieldCurrentThread();
+    stop = true;
+    pool.waitForDone();
+
+    ASSERT_TRUE(consistent.load());
+    ASSERT_EQ(model.snapshot()->regimes.count(), 201);
+}
+
+TEST(ProtoTableModelTest, DefinitionHashFollowsEdits) {
+    ProtoTableModel model;
+    model.addRow("A");
+    model.addRow("B");
+    model.addRow("C");
+    const quint64 initial = model.definitionHash();
+    ASSERT_EQ(initial, ProgramHash::of(model.getRegimes()));
+
+    // Progress is not part of the definition
+    model.setData(model.index(1, 0), 30, ProtoTableModel::RegimeTimePassedRole);
+    ASSERT_EQ(model.definitionHash(), initial);
+
+    model.setData(model.index(1, 0), 120, ProtoTableModel::MaxTimeRole);
+    ASSERT_NE(model.definitionHash(), initial);
+    ASSERT_EQ(model.definitionHash(), ProgramHash::of(model.getRegimes()));
+
+    model.moveSelection({2}, true);
+    model.groupRows({0, 1});
+    model.deleteRows({2});
+    ASSERT_EQ(model.definitionHash(), ProgramHash::of(model.getRegimes()));
+
+    while (model.canUndo())
+        model.undo();
+    ASSERT_EQ(model.definitionHash(), initial);
+}
+
+TEST(ProtoTableModelTest, RoleTableDispatch) {
+    ProtoTableModel model;
+    model.addRow("A");
+    model.addRow("B");
+    model.addRow("C");
+    model.groupRows({0, 1});
+
+    ASSERT_EQ(model.get(2, "max_time").toInt(), 60);
+    ASSERT_EQ(model.get(0, "cycle_row_count").toInt(), 2);
+    ASSERT_EQ(model.get(1, "cycle_status").toInt(), 2);
+    ASSERT_FALSE(model.get(0, "no_such_role").isValid());
+
+    // Repeat of a cycle row applies to the whole cycle
+    ASSERT_TRUE(model.setData(model.index(1, 0), 4, ProtoTableModel::RepeatRole));
+    ASSERT_EQ(model.get(0, "repeat").toInt(), 4);
+    ASSERT_EQ(model.get(2, "repeat").toInt(), 1);
+    ASSERT_FALSE(model.setData(model.index(0, 0), 0, ProtoTableModel::RepeatRole));
+    ASSERT_FALSE(model.setData(model.index(0, 0), 1, ProtoTableModel::CycleIdRole));
+
+    // Dependent roles are part of the change notification
+    QSignalSpy spy(&model, &QAbstractItemModel::dataChanged);
+    model.setData(model.index(2, 0), 15, ProtoTableModel::ConditionTimePassedRole);
+    ASSERT_EQ(spy.count(), 1);
+    const QList<int> roles = spy.at(0).at(2).value<QList<int>>();
+    ASSERT_TRUE(roles.contains(ProtoTableModel::TimePassedInSecondsRole));
+    ASSERT_EQ(model.get(2, "time_passed_in_seconds").toInt(), 15);
+}
+
+TEST(ProtoTableModelTest, RangeSelections) {
+    RowRanges ranges{7, 3, 4, 5, 9, 8};
+    ASSERT_EQ(ranges.rangeCount(), 2);
+    ASSERT_EQ(ranges.rowCount(), 6);
+    ranges.add(6, 6);
+    ASSERT_EQ(ranges.rangeCount(), 1);
+    ASSERT_TRUE(ranges.contains(9));
+    ASSERT_FALSE(ranges.contains(10));
+    ASSERT_EQ(RowRanges::fromVariant(QVariantList{QVariantList{0, 2}, QVariantList{5, 5}}).rowCount(), 4);
+
+    ProtoTableModel model;
+    QList<Regime> regimes(20000);
+    for (int i = 0; i < regimes.count(); ++i)
+        regimes[i].m_name = QString::number(i);
+    model.setRegimes(regimes);
+    model.groupRows({10, 11, 12});
+
+    // Removals are notified once per contiguous block, and rows of a cycle go with it
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    RowRanges selection;
+    selection.add(0, 4999);
+    selection.add(11, 11);
+    selection.add(15000, 19999);
+    ASSERT_TRUE(model.isSelectionUngroupable(selection));
+    model.deleteRows(selection);
+    ASSERT_EQ(removed.count(), 2);
+    ASSERT_EQ(model.rowCount(), 10000);
+    ASSERT_EQ(model.get(0, "regime").value<Regime>().m_name, QString("5000"));
+
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(model.rowCount(), 20000);
+    ASSERT_EQ(model.get(11, "cycle_row_count").toInt(), 0);
+}
+
+TEST(ProtoTableModelTest, ReorderInOneLayoutChange) {
+    ProtoTableModel model;
+    QList<Regime> regimes(6);
+    for (int i = 0; i < regimes.count(); ++i)
+        regimes[i].m_name = QString::number(i);
+    model.setRegimes(regimes);
+    model.groupRows({1, 2});
+
+    auto names = [&model] {
+        QString result;
+        for (int row = 0; row < model.rowCount(); ++row)
+            result += model.get(row, "regime").value<Regime>().m_name;
+        return result;
+    };
+
+    // Non-contiguous drop: both rows go to the end, persistent indexes follow them
+    QSignalSpy layoutChanged(&model, &QAbstractItemModel::layoutChanged);
+    QSignalSpy moved(&model, &QAbstractItemModel::rowsMoved);
+    const QPersistentModelIndex tracked(model.index(4, 0));
+    const RowRanges selection = model.moveRowsTo({0, 4}, model.rowCount());
+    ASSERT_EQ(names(), QString("123504"));
+    ASSERT_EQ(selection, RowRanges({4, 5}));
+    ASSERT_EQ(layoutChanged.count(), 1);
+    ASSERT_EQ(moved.count(), 0);
+    ASSERT_EQ(tracked.row(), 5);
+
+    // The cycle now spans rows 0..1 and cannot be split
+    ASSERT_FALSE(model.reorderRows({0, 2, 1, 3, 4, 5}));
+    ASSERT_FALSE(model.reorderRows({0, 0, 1, 2, 3, 4}));
+
+    // The cycle sorts as one item under its first row's name
+    ASSERT_TRUE(model.sortRows(ProtoTableModel::SortByName, false));
+    ASSERT_EQ(names(), QString("543120"));
+    ASSERT_EQ(model.get(3, "regime").value<Regime>().m_cycleId, model.get(4, "regime").value<Regime>().m_cycleId);
+
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(names(), QString("123504"));
+    ASSERT_TRUE(model.undo());
+    ASSERT_EQ(names(), QString("012345"));
+    ASSERT_TRUE(model.redo());
+    ASSERT_EQ(names(), QString("123504"));
+}
+
+TEST(ProtoTableModelTest, DefinitionsAreShared) {
+    // Rows as loaded from a file: equal text, separate buffers
+    QList<Regime> regimes(10000);
+    for (int i = 0; i < regimes.count(); ++i) {
+        regimes[i].m_name = QString("Нагрев ") + QString::number(i % 4);
+        regimes[i].m_condition.type = QString("ti") + QString("me");
+    }
+    const qint64 before = DefinitionPool::bytesUsed(regimes);
+
+    ProtoTableModel model;
+    model.setRegimes(regimes);
+    regimes.clear();
+    const QVariantMap usage = model.memoryUsage();
+    ASSERT_EQ(usage.value("sharedStrings").toInt(), 5);
+    ASSERT_LT(usage.value("bytes").toLongLong(), before);
+    ASSERT_LE(usage.value("bytesPerRow").toDouble(), double(sizeof(Regime)) + 1.0);
+
+    // Editing one row leaves the rows it shared text with alone
+    Regime renamed = model.getRegime(0);
+    renamed.m_name = "Откачка";
+    ASSERT_TRUE(model.setData(model.index(0, 0), QVariant::fromValue(renamed), ProtoTableModel::RegimeRole));
+    ASSERT_EQ(model.getRegime(4).m_name, QString("Нагрев 0"));
+    ASSERT_EQ(model.memoryUsage().value("sharedStrings").toInt(), 6);
+
+    // Names no row uses any more are dropped as the pool grows
+    for (int i = 0; i < 1000; ++i) {
+        renamed.m_name = QString("Откачка %1").arg(i);
+        ASSERT_TRUE(model.setData(model.index(0, 0), QVariant::fromValue(renamed), ProtoTableModel::RegimeRole));
+    }
+    ASSERT_LE(model.memoryUsage().value("sharedStrings").toInt(), DefinitionPool::MinPruneSize);
+}
+
+TEST(ProtoTableModelTest, StateChangesNotifyNearbyRowsOnly) {
+    ProtoTableModel model;
+    model.setRegimes(QList<Regime>(10000));
+    model.groupRows({2, 3, 4});
+
+    QSignalSpy spy(&model, &QAbstractItemModel::dataChanged);
+    auto setState = [&](int row, RegimeEnums::State state) {
+        spy.clear();
+        model.setData(model.index(row, 0), QVariant::fromValue(state), ProtoTableModel::StateRole);
+        int first = model.rowCount(), last = -1;
+        for (const QList<QVariant> &arguments : std::as_const(spy)) {
+            first = qMin(first, arguments.at(0).toModelIndex().row());
+            last = qMax(last, arguments.at(1).toModelIndex().row());
+        }
+        return std::make_pair(first, last);
+    };
+
+    // Row 1 can no longer move up once row 0 runs
+    ASSERT_EQ(setState(0, RegimeEnums::State::Running), std::make_pair(0, 1));
+    ASSERT_TRUE(model.isAnyRegimeRunning());
+    ASSERT_FALSE(model.isMoveUpEnabled({1}));
+    ASSERT_TRUE(model.isMoveUpEnabled({5}));
+
+    // Same boundary: only the row itself
+    ASSERT_EQ(setState(0, RegimeEnums::State::Done), std::make_pair(0, 0));
+    ASSERT_FALSE(model.isAnyRegimeRunning());
+
+    // The cycle after row 1 moves as one block
+    ASSERT_EQ(setState(1, RegimeEnums::State::Running), std::make_pair(1, 4));
+    ASSERT_FALSE(model.isMoveUpEnabled({2}));
+
+    // Back to waiting: the boundary returns to the done row above
+    ASSERT_EQ(setState(1, RegimeEnums::State::Waiting), std::make_pair(1, 4));
+    ASSERT_FALSE(model.isAnyRegimeRunning());
+    ASSERT_TRUE(model.isMoveUpEnabled({2}));
+    ASSERT_FALSE(model.isMoveUpEnabled({1}));
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "prototablemodel.h"
+#include "regimefiltermodel.h"
+
+namespace {
+
+QList<Regime> makeProgram(int count)
+{
+    QList<Regime> regimes(count);
+    for (int i = 0; i < count; ++i) {
+        regimes[i].m_name = i % 3 == 0 ? QString("Нагрев %1").arg(i) : QString("Выдержка %1").arg(i);
+        regimes[i].m_condition.type = i % 2 == 0 ? "temp" : "time";
+    }
+    return regimes;
+}
+
+} // namespace
+
+TEST(RegimeFilterModelTest, IndexAnswersCombinedQueries)
+{
+    RegimeSearchIndex index;
+    index.reset(makeProgram(30000));
+
+    RegimeSearchIndex::Query query;
+    query.text = "нагрев";
+    ASSERT_EQ(index.find(query).count(), 10000);
+    query.conditionType = "temp";
+    // Multiples of 6
+    ASSERT_EQ(index.find(query).count(), 5000);
+    query.text = "29994";
+    ASSERT_EQ(index.find(query), QList<int>{29994});
+    // Shorter than a trigram: checked row by row
+    query.text = "в";
+    ASSERT_EQ(index.find(query).count(), 15000);
+
+    Regime edited = makeProgram(1).first();
+    edited.m_name = "Охлаждение";
+    edited.m_state = RegimeEnums::State::Done;
+    index.updateRow(6, edited);
+    query = RegimeSearchIndex::Query();
+    query.text = "охлажд";
+    ASSERT_EQ(index.find(query), QList<int>{6});
+    query.state = int(RegimeEnums::State::Done);
+    ASSERT_EQ(index.find(query), QList<int>{6});
+
+    index.removeRows(0, 6);
+    ASSERT_EQ(index.find(query), QList<int>{0});
+}
+
+TEST(RegimeFilterModelTest, ProxyFollowsSourceEdits)
+{
+    ProtoTableModel model;
+    model.setRegimes(makeProgram(300));
+    RegimeFilterModel filter;
+    filter.setSourceModel(&model);
+    ASSERT_EQ(filter.matchCount(), 300);
+
+    filter.setSearchText("Нагрев 29");
+    // 291, 294 and 297
+    ASSERT_EQ(filter.matchCount(), 3);
+    ASSERT_EQ(filter.sourceRow(0), 291);
+
+    // A rename updates only that row's match
+    Regime renamed = model.getRegime(291);
+    renamed.m_name = "Откачка";
+    ASSERT_TRUE(model.setData(model.index(291, 0), QVariant::fromValue(renamed), ProtoTableModel::RegimeRole));
+    ASSERT_EQ(filter.matchCount(), 2);
+    ASSERT_EQ(filter.sourceRow(0), 294);
+
+    model.addRow("Нагрев 2999");
+    ASSERT_EQ(filter.matchCount(), 3);
+    ASSERT_EQ(filter.sourceRow(2), 300);
+
+    model.deleteRows({294});
+    ASSERT_EQ(filter.matchCount(), 2);
+    ASSERT_EQ(filter.sourceRow(0), 296);
+
+    filter.setSearchText("");
+    ASSERT_FALSE(filter.isActive());
+    ASSERT_EQ(filter.matchCount(), model.rowCount());
+}
+
+TEST(RegimeFilterModelTest, StateChangesMoveOnlyTheirRow)
+{
+    ProtoTableModel model;
+    model.setRegimes(makeProgram(300));
+    RegimeFilterModel filter;
+    filter.setSourceModel(&model);
+    filter.setStateFilter(int(RegimeEnums::State::Done));
+    ASSERT_EQ(filter.matchCount(), 0);
+
+    ASSERT_TRUE(model.setData(model.index(7, 0), QVariant::fromValue(RegimeEnums::State::Done), ProtoTableModel::StateRole));
+    ASSERT_EQ(filter.matchCount(), 1);
+    ASSERT_EQ(filter.sourceRow(0), 7);
+
+    ASSERT_TRUE(model.setData(model.index(7, 0), QVariant::fromValue(RegimeEnums::State::Running), ProtoTableModel::StateRole));
+    ASSERT_EQ(filter.matchCount(), 0);
+
+    // The index reports whether the row changed bucket
+    RegimeSearchIndex index;
+    index.reset(makeProgram(3));
+    ASSERT_FALSE(index.updateState(1, RegimeEnums::State::Waiting));
+    ASSERT_TRUE(index.updateState(1, RegimeEnums::State::Skipped));
+    RegimeSearchIndex::Query query;
+    query.state = int(RegimeEnums::State::Skipped);
+    ASSERT_EQ(index.find(query), QList<int>{1});
+}
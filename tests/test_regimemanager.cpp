@@ -25,7 +25,8 @@ protected:
         dir.mkdir("profile");
         QFile dummyFile(dir.filePath("profile/regime_a.json"));
         ASSERT_TRUE(dummyFile.open(QIODevice::WriteOnly));
-        dummyFile.write("[{\"name\": \"Test Regime\", \"condition\": {\"type\": \"temp\", \"temp\": 100, \"time\": 0}, \"repeat\": {\"count\": 1}, \"max_time\": 0, \"cycle\": null}]");
+        // A program without validation errors, so tests can start it
+        dummyFile.write("[{\"name\": \"Test Regime\", \"condition\": {\"type\": \"temp\", \"temp\": 100, \"time\": 10}, \"repeat\": {\"count\": 1}, \"max_time\": 60, \"cycle\": null}]");
         dummyFile.close();
     }
 
@@ -101,6 +102,86 @@ TEST_F(RegimeManagerTest, SaveRegimes) {
     ASSERT_TRUE(data.contains("Save Test"));
 }
 
+TEST_F(RegimeManagerTest, DirtyTracksDefinitionOnly) {
+    RegimeManager manager;
+    manager.loadDefaultRegimes();
+    ProtoTableModel* model = manager.model();
+    ASSERT_FALSE(ProgramValidator::hasErrors(manager.programDiagnostics()));
+    ASSERT_FALSE(manager.dirty());
+
+    // Execution progress does not make the program differ from its file
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+    ASSERT_EQ(model->getRegime(0).m_state, RegimeEnums::State::Running);
+    ASSERT_FALSE(manager.dirty());
+    ASSERT_TRUE(manager.resetRegimeExecution(0));
+
+    model->setData(model->index(0, 0), 300, ProtoTableModel::MaxTimeRole);
+    ASSERT_TRUE(manager.dirty());
+
+    // Undoing back to the saved version is clean again
+    model->undo();
+    ASSERT_FALSE(manager.dirty());
+}
+
+TEST_F(RegimeManagerTest, TimelineColumns) {
+    RegimeManager manager(false, nullptr);
+    Regime single;
+    single.m_name = "Single";
+    single.m_maxTime = 60;
+    single.m_repeatCount = 2;
+    Regime first;
+    first.m_name = "First";
+    first.m_maxTime = 30;
+    first.m_condition.type = "time";
+    first.m_condition.time = 1;
+    first.m_cycleId = 0;
+    first.m_cycleRepeat = 3;
+    Regime second = first;
+    second.m_name = "Second";
+    second.m_condition.type = "none";
+    manager.model()->setRegimes({single, first, second});
+
+    const QVariantMap result = manager.timelineColumns();
+    const quint64 version = result.value("version").toULongLong();
+    ASSERT_GT(version, 0u);
+    ASSERT_EQ(result.value("rowCount").toInt(), 3);
+
+    const QVariantMap columns = result.value("columns").toMap();
+    const QByteArray start = columns.value("startOffset").toByteArray();
+    const QByteArray duration = columns.value("duration").toByteArray();
+    ASSERT_EQ(start.size(), qsizetype(3 * sizeof(double)));
+    const auto *starts = reinterpret_cast<const double *>(start.constData());
+    const auto *durations = reinterpret_cast<const double *>(duration.constData());
+    ASSERT_EQ(starts[0], 0);
+    ASSERT_EQ(durations[0], 120);
+    ASSERT_EQ(starts[1], 120);
+    ASSERT_EQ(durations[1], (60 + 30) * 3);
+    ASSERT_EQ(starts[2], 120 + 90);
+    ASSERT_EQ(durations[2], 30 * 3);
+    ASSERT_EQ(starts[0] + durations[0] + durations[1] + durations[2], manager.getTotalEstimatedTime());
+
+    // Unchanged program: only the version comes back
+    ASSERT_FALSE(manager.timelineColumns(version).contains("columns"));
+    manager.model()->setData(manager.model()->index(0, 0), 10, ProtoTableModel::TimePassedInSecondsRole);
+    const QVariantMap updated = manager.timelineColumns(version);
+    ASSERT_GT(updated.value("version").toULongLong(), version);
+    const QByteArray elapsed = updated.value("columns").toMap().value("elapsed").toByteArray();
+    ASSERT_EQ(reinterpret_cast<const qint32 *>(elapsed.constData())[0], 10);
+
+    // Totals past INT32_MAX are kept, not wrapped
+    single.m_maxTime = 2000000000;
+    single.m_repeatCount = 3;
+    manager.model()->setRegimes({single, first, second});
+    const QVariantMap large = manager.timelineColumns().value("columns").toMap();
+    const QByteArray largeStart = large.value("startOffset").toByteArray();
+    const QByteArray largeDuration = large.value("duration").toByteArray();
+    const auto *largeStarts = reinterpret_cast<const double *>(largeStart.constData());
+    const auto *largeDurations = reinterpret_cast<const double *>(largeDuration.constData());
+    ASSERT_EQ(largeDurations[0], 6000000000.0);
+    ASSERT_EQ(largeStarts[1], 6000000000.0);
+    ASSERT_EQ(largeStarts[2], 6000000000.0 + 90);
+}
+
 TEST_F(RegimeManagerTest, ExternalModuleAPI) {
     RegimeManager manager;
     QList<Regime> regimes;
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "runhistory.h"
+#include "regimemanager.h"
+#include <QFile>
+#include <QTemporaryDir>
+
+namespace {
+
+RepeatRecord makeRecord(qint64 runId, const QString &name, qint64 conditionMs, qint64 executionMs)
+{
+    RepeatRecord record;
+    record.runId = runId;
+    record.finishedAt = runId + 1000;
+    record.programHash = 0xABCDULL;
+    record.regimeName = name;
+    record.plannedConditionSeconds = 60;
+    record.plannedExecutionSeconds = 30;
+    record.conditionMs = conditionMs;
+    record.executionMs = executionMs;
+    return record;
+}
+
+} // namespace
+
+TEST(RunHistoryTest, ReopenRestoresRecordsAndIndexes)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("history.grh");
+    {
+        RunHistoryStore store;
+        ASSERT_TRUE(store.open(path));
+        ASSERT_TRUE(store.append(makeRecord(1, "Heat", 50000, 30000)));
+        ASSERT_TRUE(store.append(makeRecord(1, "Soak", 10000, 30000)));
+        ASSERT_TRUE(store.append(makeRecord(2, "Heat", 70000, -1)));
+    }
+
+    RunHistoryStore store(path);
+    ASSERT_TRUE(store.isOpen());
+    ASSERT_EQ(store.recordCount(), 3);
+    ASSERT_EQ(store.recordsFor("Heat").count(), 2);
+    ASSERT_EQ(store.recordsForProgram(0xABCDULL).count(), 3);
+    ASSERT_EQ(store.record(2).executionMs, -1);
+    ASSERT_DOUBLE_EQ(store.median("Heat", RunHistoryStore::Measure::ConditionTime), 60.0);
+    // Only the first run timed both phases
+    ASSERT_DOUBLE_EQ(store.median("Heat", RunHistoryStore::Measure::RepeatTime), 80.0);
+    ASSERT_EQ(store.median("Missing", RunHistoryStore::Measure::ConditionTime), -1.0);
+}
+
+TEST(RunHistoryTest, MedianCoversOnlyLatestRuns)
+{
+    QTemporaryDir dir;
+    RunHistoryStore store(dir.filePath("history.grh"));
+    for (qint64 run = 1; run <= 150; ++run) {
+        // Two repeats per run; older runs heat up much slower
+        const qint64 conditionMs = run <= 50 ? 500000 : run * 1000;
+        store.append(makeRecord(run, "Heat", conditionMs, 30000));
+        store.append(makeRecord(run, "Heat", conditionMs, 30000));
+    }
+
+    ASSERT_EQ(store.recordsFor("Heat", 100).count(), 200);
+    ASSERT_EQ(store.recordsFor("Heat", 100).first().runId, 51);
+    // Runs 51..150 -> median of 51..150 s
+    ASSERT_DOUBLE_EQ(store.median("Heat", RunHistoryStore::Measure::ConditionTime, 100), 100.5);
+    ASSERT_DOUBLE_EQ(store.median("Heat", RunHistoryStore::Measure::ConditionTime, 1), 150.0);
+}
+
+TEST(RunHistoryTest, TornTailIsDropped)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("history.grh");
+    {
+        RunHistoryStore store(path);
+        store.append(makeRecord(1, "Heat", 1000, 2000));
+        store.append(makeRecord(1, "Heat", 3000, 4000));
+    }
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadWrite));
+    ASSERT_TRUE(file.resize(file.size() - 5));
+    file.close();
+
+    RunHistoryStore store(path);
+    ASSERT_EQ(store.recordCount(), 1);
+    ASSERT_TRUE(store.append(makeRecord(2, "Heat", 5000, 6000)));
+
+    RunHistoryStore reopened(path);
+    ASSERT_EQ(reopened.recordCount(), 2);
+    ASSERT_EQ(reopened.record(1).runId, 2);
+}
+
+TEST(RunHistoryTest, ManagerRecordsFinishedRepeats)
+{
+    QTemporaryDir dir;
+    RegimeManager manager(false, nullptr);
+    Regime regime;
+    regime.m_name = "Heat";
+    regime.m_condition.type = "time";
+    regime.m_condition.time = 1;
+    regime.m_maxTime = 30;
+    regime.m_repeatCount = 2;
+    manager.model()->setRegimes({regime});
+    ASSERT_TRUE(manager.setHistoryPath(dir.filePath("history.grh")));
+
+    qint64 clock = 0;
+    manager.eta()->setClock([&clock]() { return clock; });
+
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+    clock = 90000;
+    ASSERT_TRUE(manager.confirmConditionCompletion(0, 0));
+    clock = 120000;
+    ASSERT_TRUE(manager.completeCurrentRepeat(0, 0));
+    ASSERT_TRUE(manager.skipCurrentRepeat(0, 1));
+
+    const RunHistoryStore &history = manager.runHistory();
+    ASSERT_EQ(history.recordCount(), 2);
+    ASSERT_EQ(history.record(0).conditionMs, 90000);
+    ASSERT_EQ(history.record(0).executionMs, 30000);
+    ASSERT_EQ(history.record(0).programHash, manager.model()->definitionHash());
+    ASSERT_EQ(history.record(1).outcome, RegimeEnums::State::Skipped);
+    ASSERT_EQ(history.record(1).repeatIndex, 1);
+    ASSERT_EQ(history.record(0).runId, history.record(1).runId);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include "prototablemodel.h"
+#include "runhistory.h"
+#include "runreport.h"
+#include <QBuffer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+namespace {
+
+RepeatRecord makeRecord(qint64 runId, const QString &name, int repeat, RegimeEnums::State outcome)
+{
+    RepeatRecord record;
+    record.runId = runId;
+    record.finishedAt = runId + repeat;
+    record.regimeName = name;
+    record.repeatIndex = repeat;
+    record.outcome = outcome;
+    record.plannedConditionSeconds = 60;
+    record.plannedExecutionSeconds = 30;
+    record.conditionMs = 1000 * repeat;
+    record.executionMs = 30000;
+    return record;
+}
+
+template <typename T>
+T take(const QByteArray &data, qsizetype &offset)
+{
+    const T value = qFromLittleEndian<T>(data.constData() + offset);
+    offset += sizeof(T);
+    return value;
+}
+
+} // namespace
+
+TEST(RunReportTest, RowReportCarriesCounters)
+{
+    Regime heat;
+    heat.m_name = "Heat, slow";
+    heat.m_repeatCount = 5;
+    heat.m_maxTime = 30;
+    heat.m_condition.type = "time";
+    heat.m_condition.time = 1;
+    heat.m_state = RegimeEnums::State::Running;
+    heat.m_repeatsDone = 2;
+    heat.m_repeatsSkipped = 1;
+    Regime soak;
+    soak.m_name = "Soak";
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    ASSERT_EQ(RunReport::writeRows({heat, soak}, &buffer, RunReport::Format::Csv), 2);
+
+    const QList<QByteArray> lines = buffer.data().split('\n');
+    ASSERT_EQ(lines.count(), 4);
+    ASSERT_TRUE(lines[0].startsWith("row,name,cycle_id,state,repeats_planned,repeats_done"));
+    // Names with separators are quoted; 450 s = (60 + 30) * 5
+    ASSERT_EQ(lines[1], "0,\"Heat, slow\",-1,Running,5,2,1,0,2,1,60,30,450,0");
+    ASSERT_EQ(lines[2], "1,Soak,-1,Waiting,1,0,0,0,1,1,0,60,60,0");
+    ASSERT_TRUE(lines[3].isEmpty());
+}
+
+TEST(RunReportTest, RepeatReportStreamsOneRunAsColumns)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("history.grh");
+    {
+        RunHistoryStore store(path);
+        store.append(makeRecord(1, "Heat", 0, RegimeEnums::State::Done));
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            store.append(makeRecord(2, "Heat", repeat, repeat == 1 ? RegimeEnums::State::Skipped : RegimeEnums::State::Done));
+            store.append(makeRecord(2, "Soak", repeat, RegimeEnums::State::Error));
+        }
+    }
+
+    QBuffer csv;
+    csv.open(QIODevice::WriteOnly);
+    ASSERT_EQ(RunReport::writeRepeats(path, 0, &csv, RunReport::Format::Csv), 7);
+
+    QBuffer columnar;
+    columnar.open(QIODevice::WriteOnly);
+    ASSERT_EQ(RunReport::writeRepeats(path, 2, &columnar, RunReport::Format::Columnar), 6);
+
+    const QByteArray data = columnar.data();
+    ASSERT_TRUE(data.startsWith("GRR1"));
+    qsizetype offset = 4;
+    const int columns = take<quint16>(data, offset);
+    ASSERT_EQ(columns, 9);
+    for (int i = 0; i < columns; ++i) {
+        take<quint8>(data, offset);
+        offset += take<quint16>(data, offset);
+    }
+
+    ASSERT_EQ(take<quint32>(data, offset), 6u);
+    // Dictionaries of "regime" and "outcome"
+    QList<QByteArray> regimes, outcomes;
+    for (QList<QByteArray> *dictionary : {&regimes, &outcomes}) {
+        ASSERT_EQ(take<quint8>(data, offset), 0);
+        const quint32 entries = take<quint32>(data, offset);
+        for (quint32 i = 0; i < entries; ++i) {
+            const quint32 size = take<quint32>(data, offset);
+            dictionary->append(data.mid(offset, size));
+            offset += size;
+        }
+    }
+    ASSERT_EQ(regimes, QList<QByteArray>({"Heat", "Soak"}));
+    ASSERT_EQ(outcomes, QList<QByteArray>({"Done", "Error", "Skipped"}));
+
+    // run_id, finished_at and regime columns; the rest is skipped
+    for (int line = 0; line < 6; ++line)
+        ASSERT_EQ(take<qint64>(data, offset), 2);
+    offset += 6 * sizeof(qint64);
+    for (int line = 0; line < 6; ++line)
+        ASSERT_EQ(take<quint32>(data, offset), quint32(line % 2));
+    offset += 6 * (4 + 4 + 4 + 4 + 8 + 8);
+
+    // Terminating empty block
+    ASSERT_EQ(take<quint32>(data, offset), 0u);
+    ASSERT_EQ(offset, data.size());
+}
+
+TEST(RunReportTest, WriterReplacesFileOffThread)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("rows.csv");
+    Regime regime;
+    regime.m_name = "Heat";
+    ProtoTableModel model;
+    model.setRegimes({regime});
+
+    RunReportWriter writer(&model);
+    writer.writeRows(path, RunReport::Format::Csv);
+    ASSERT_TRUE(writer.isBusy());
+    writer.waitForIdle();
+
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+    ASSERT_EQ(file.readAll().count('\n'), 2);
+
+    // A missing history fails without touching the previous report
+    writer.writeRepeats(path, dir.filePath("missing.grh"), 0, RunReport::Format::Csv);
+    writer.waitForIdle();
+    file.seek(0);
+    ASSERT_EQ(file.readAll().count('\n'), 2);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "prototablemodel.h"
+#include "regimemanager.h"
+#include "sensortracestore.h"
+#include <QtMath>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr int kIntervalUs = 1000; // 1 kHz
+
+QList<Regime> regimes(int count)
+{
+    QList<Regime> list;
+    for (int i = 0; i < count; ++i) {
+        Regime r;
+        r.m_name = QString("Trace %1").arg(i);
+        list.append(r);
+    }
+    return list;
+}
+
+// A slow sine with one spike at spikeAt
+std::vector<float> samples(int count, int spikeAt)
+{
+    std::vector<float> values(size_t(count));
+    for (int i = 0; i < count; ++i)
+        values[size_t(i)] = 20.0f + 5.0f * float(qSin(i / 5000.0));
+    values[size_t(spikeAt)] = 80.0f;
+    return values;
+}
+
+double maximum(const QList<QPointF> &points)
+{
+    return std::max_element(points.cbegin(), points.cend(),
+                            [](const QPointF &a, const QPointF &b) { return a.y() < b.y(); })->y();
+}
+
+} // namespace
+
+TEST(SensorTraceStoreTest, DownsamplingKeepsExtremes)
+{
+    ProtoTableModel model;
+    model.setRegimes(regimes(1));
+    SensorTraceStore store(&model);
+
+    const std::vector<float> values = samples(100000, 54321);
+    store.append(0, 0, values.data(), qsizetype(values.size()), 0, kIntervalUs);
+    ASSERT_TRUE(store.hasTrace(0, 0));
+    ASSERT_FALSE(store.hasTrace(0, 1));
+    ASSERT_EQ(store.sampleCount(0, 0), 100000);
+
+    const qint64 lastUs = qint64(values.size() - 1) * kIntervalUs;
+    const QList<QPointF> envelope = store.downsample(0, 0, 200, SensorTraceStore::MinMax, 0, lastUs);
+    ASSERT_LE(envelope.count(), 400);
+    ASSERT_DOUBLE_EQ(maximum(envelope), 80.0);
+    ASSERT_TRUE(std::is_sorted(envelope.cbegin(), envelope.cend(),
+                               [](const QPointF &a, const QPointF &b) { return a.x() < b.x(); }));
+
+    const QList<QPointF> lttb = store.downsample(0, 0, 200, SensorTraceStore::Lttb, 0, lastUs);
+    ASSERT_EQ(lttb.count(), 200);
+    ASSERT_DOUBLE_EQ(maximum(lttb), 80.0);
+    ASSERT_DOUBLE_EQ(lttb.first().x(), 0.0);
+
+    const QVariantMap trace = store.trace(0, 0, 200);
+    ASSERT_EQ(trace["values"].toByteArray().size(), qsizetype(envelope.count() * sizeof(float)));
+    ASSERT_DOUBLE_EQ(trace["max"].toDouble(), 80.0);
+}
+
+TEST(SensorTraceStoreTest, MemoryStaysWithinBudget)
+{
+    ProtoTableModel model;
+    model.setRegimes(regimes(2));
+    SensorTraceStore store(&model);
+    store.setMemoryBudget(256 * 1024);
+    model.setData(model.index(0, 0), QVariant::fromValue(RegimeEnums::State::Running), ProtoTableModel::StateRole);
+
+    // An hour of 1 kHz data for the running row, appended in acquisition-sized blocks
+    const int total = 3600 * 1000;
+    const std::vector<float> values = samples(total, total / 3);
+    for (int offset = 0; offset < total; offset += 256)
+        store.appendRunning(values.data() + offset, qMin(256, total - offset), qint64(offset) * kIntervalUs, kIntervalUs);
+    ASSERT_FALSE(store.hasTrace(1, 0));
+
+    ASSERT_LE(store.bytesUsed(), 256 * 1024);
+    ASSERT_LT(store.sampleCount(0, 0), total);
+    const QList<QPointF> envelope = store.downsample(0, 0, 500, SensorTraceStore::MinMax, 0, qint64(total) * kIntervalUs);
+    ASSERT_DOUBLE_EQ(maximum(envelope), 80.0);
+    // The whole hour is still covered
+    ASSERT_LT(envelope.first().x(), 60.0 * 1e6);
+    ASSERT_GT(envelope.last().x(), 3540.0 * 1e6);
+}
+
+TEST(SensorTraceStoreTest, TracesFollowTheirRows)
+{
+    ProtoTableModel model;
+    model.setRegimes(regimes(3));
+    SensorTraceStore store(&model);
+
+    const std::vector<float> values = samples(1000, 10);
+    store.append(0, 0, values.data(), 1000, 0, kIntervalUs);
+    store.append(2, 1, values.data(), 1000, 0, kIntervalUs);
+
+    model.deleteRows({0});
+    ASSERT_FALSE(store.hasTrace(0, 0));
+    ASSERT_TRUE(store.hasTrace(1, 1));
+    ASSERT_EQ(store.bytesUsed(), 1000 * qint64(sizeof(qint64) + sizeof(float)) + 16 * 12);
+
+    store.removeRow(1);
+    ASSERT_FALSE(store.hasTrace(1, 1));
+    ASSERT_EQ(store.bytesUsed(), 0);
+}
+
+TEST(SensorTraceStoreTest, PartialWindowFindsTraceByProgramRow)
+{
+    RegimeManager manager(false, nullptr);
+    manager.model()->setRegimes(regimes(3));
+    SensorTraceStore *store = manager.sensorTraces();
+    const std::vector<float> values = samples(1000, 10);
+    store->append(2, 0, values.data(), 1000, 0, kIntervalUs);
+
+    // Rows 1 and 2 are visible; the block of row 2 is the second entry
+    manager.updateVisibleRegimes(70, 170);
+    VisibleRegimeModel *visible = manager.visibleRegimeModel();
+    const QModelIndex entry = visible->index(1);
+    const int row = visible->data(entry, VisibleRegimeModel::RegimeIndexRole).toInt();
+    const int repeat = visible->data(entry, VisibleRegimeModel::RepeatIndexRole).toInt();
+    ASSERT_TRUE(store->hasTrace(row, repeat));
+    ASSERT_FALSE(store->hasTrace(visible->data(visible->index(0), VisibleRegimeModel::RegimeIndexRole).toInt(), 0));
+    ASSERT_FALSE(store->trace(row, repeat, 100).isEmpty());
+}
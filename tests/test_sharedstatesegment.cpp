@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <QCoreApplication>
+#include "regimemanager.h"
+#include "sharedstatesegment.h"
+
+namespace {
+
+QString uniqueKey(const char *name)
+{
+    return QStringLiteral("grams-test-%1-%2").arg(QLatin1String(name)).arg(QCoreApplication::applicationPid());
+}
+
+} // namespace
+
+TEST(SharedStateSegmentTest, ReaderSeesPublishedRows)
+{
+    RegimeManager manager(false, nullptr);
+    Regime first;
+    first.m_name = "Warmup";
+    first.m_condition.type = "temp";
+    first.m_condition.time = 5;
+    first.m_maxTime = 120;
+    Regime second = first;
+    second.m_name = "Soak";
+    second.m_state = RegimeEnums::State::Running;
+    second.m_currentRepeat = 2;
+    manager.model()->setRegimes({first, second});
+
+    SharedStateSegment segment(&manager);
+    const QString key = uniqueKey("rows");
+    ASSERT_TRUE(segment.create(key, 16, 1024));
+
+    SharedStateReader reader;
+    ASSERT_TRUE(reader.attach(key));
+
+    QList<SharedStateReader::RowData> rows;
+    const quint64 sequence = reader.readRows(rows);
+    ASSERT_NE(sequence, 0u);
+    ASSERT_EQ(rows.count(), 2);
+    ASSERT_EQ(rows.at(0).name, "Warmup");
+    ASSERT_EQ(rows.at(1).name, "Soak");
+    ASSERT_EQ(rows.at(1).conditionType, "temp");
+    ASSERT_EQ(rows.at(1).row.state, int(RegimeEnums::State::Running));
+    ASSERT_EQ(rows.at(1).row.currentRepeat, 2);
+    ASSERT_EQ(rows.at(0).row.maxTime, 120);
+
+    // Shared condition type is stored once
+    ASSERT_EQ(rows.at(0).row.conditionTypeOffset, rows.at(1).row.conditionTypeOffset);
+
+    manager.model()->addRow("Cooldown");
+    segment.publish();
+    ASSERT_GT(reader.sequence(), sequence);
+    reader.readRows(rows);
+    ASSERT_EQ(rows.count(), 3);
+    ASSERT_EQ(rows.at(2).name, "Cooldown");
+}
+
+TEST(SharedStateSegmentTest, TruncatesWhenCapacityIsExceeded)
+{
+    RegimeManager manager(false, nullptr);
+    for (int i = 0; i < 5; ++i)
+        manager.model()->addRow(QStringLiteral("Regime %1").arg(i));
+
+    SharedStateSegment segment(&manager);
+    const QString key = uniqueKey("truncate");
+    ASSERT_TRUE(segment.create(key, 3, 1024));
+
+    SharedStateReader reader;
+    ASSERT_TRUE(reader.attach(key));
+    bool truncated = false;
+    int rowCount = 0;
+    ASSERT_TRUE(reader.visit([&](const SharedStateReader::View &view) {
+        truncated = view.header->truncated != 0;
+        rowCount = view.rowCount();
+    }));
+    ASSERT_TRUE(truncated);
+    ASSERT_EQ(rowCount, 3);
+}
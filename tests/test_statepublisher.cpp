@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QFile>
+#include <QLocalSocket>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include "regimemanager.h"
+#include "statepublisher.h"
+
+namespace {
+
+// Next length-prefixed CBOR frame, or an empty map if none arrives in time
+QCborMap readFrame(QLocalSocket &socket, QByteArray &buffer)
+{
+    for (;;) {
+        buffer.append(socket.readAll());
+        if (buffer.size() >= qsizetype(sizeof(quint32))) {
+            const qsizetype size = qFromLittleEndian<quint32>(buffer.constData());
+            if (buffer.size() >= qsizetype(sizeof(quint32)) + size) {
+                const QCborMap message = QCborValue::fromCbor(buffer.mid(sizeof(quint32), size)).toMap();
+                buffer.remove(0, qsizetype(sizeof(quint32)) + size);
+                return message;
+            }
+        }
+        QSignalSpy readyRead(&socket, &QLocalSocket::readyRead);
+        if (!readyRead.wait(3000))
+            return {};
+    }
+}
+
+} // namespace
+
+TEST(StatePublisherTest, ListenReplacesOnlyStaleSockets)
+{
+    QTemporaryDir dir;
+    const QString name = dir.filePath("state");
+    RegimeManager manager(false, nullptr);
+
+    QFile stale(name);
+    ASSERT_TRUE(stale.open(QIODevice::WriteOnly));
+    stale.close();
+    StatePublisher publisher(&manager);
+    ASSERT_TRUE(publisher.listen(name));
+
+    StatePublisher second(&manager);
+    ASSERT_FALSE(second.listen(name));
+
+    QLocalSocket viewer;
+    viewer.connectToServer(name);
+    ASSERT_TRUE(viewer.waitForConnected(3000));
+    QByteArray buffer;
+    ASSERT_EQ(readFrame(viewer, buffer).value(QStringLiteral("type")).toString(), QString("snapshot"));
+    ASSERT_EQ(publisher.subscriberCount(), 1);
+}
+
+TEST(StatePublisherTest, SnapshotThenDeltasOfChangedFields)
+{
+    QTemporaryDir dir;
+    const QString name = dir.filePath("state");
+    RegimeManager manager(false, nullptr);
+    Regime regime;
+    regime.m_name = "Heat";
+    manager.model()->setRegimes({regime});
+    StatePublisher publisher(&manager);
+    ASSERT_TRUE(publisher.listen(name));
+
+    QLocalSocket viewer;
+    viewer.connectToServer(name);
+    ASSERT_TRUE(viewer.waitForConnected(3000));
+    QByteArray buffer;
+    const QCborMap snapshot = readFrame(viewer, buffer);
+    ASSERT_EQ(snapshot.value(QStringLiteral("type")).toString(), QString("snapshot"));
+    ASSERT_EQ(snapshot.value(QStringLiteral("fields")).toArray().size(), StatePublisher::fieldNames().count());
+    const QCborArray rows = snapshot.value(QStringLiteral("rows")).toArray();
+    ASSERT_EQ(rows.size(), 1);
+    ASSERT_EQ(rows.at(0).toArray().at(0).toString(), QString("Heat"));
+    const qint64 sequence = snapshot.value(QStringLiteral("seq")).toInteger();
+
+    // Only the edited field of the edited row goes out
+    ASSERT_TRUE(manager.model()->setData(manager.model()->index(0, 0), 120, ProtoTableModel::MaxTimeRole));
+    publisher.publish();
+    const QCborMap delta = readFrame(viewer, buffer);
+    ASSERT_EQ(delta.value(QStringLiteral("type")).toString(), QString("delta"));
+    ASSERT_EQ(delta.value(QStringLiteral("seq")).toInteger(), sequence + 1);
+    const QCborArray change = delta.value(QStringLiteral("rows")).toArray().at(0).toArray();
+    const qsizetype maxTime = StatePublisher::fieldNames().indexOf("max_time");
+    ASSERT_EQ(change.size(), 3);
+    ASSERT_EQ(change.at(0).toInteger(), 0);
+    ASSERT_EQ(change.at(1).toInteger(), maxTime);
+    ASSERT_EQ(change.at(2).toInteger(), 120);
+
+    // Structural edits resend the whole program
+    manager.model()->addRow("Soak");
+    publisher.publish();
+    const QCborMap resent = readFrame(viewer, buffer);
+    ASSERT_EQ(resent.value(QStringLiteral("type")).toString(), QString("snapshot"));
+    ASSERT_EQ(resent.value(QStringLiteral("rows")).toArray().size(), 2);
+    ASSERT_GT(resent.value(QStringLiteral("seq")).toInteger(), sequence + 1);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <QSignalSpy>
+#include "stationregistry.h"
+
+TEST(StationRegistryTest, StationsAreIndependent)
+{
+    StationRegistry registry;
+    RegimeManager *first = registry.addStation("chamber-1");
+    RegimeManager *second = registry.addStation("chamber-2");
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(registry.count(), 2);
+
+    first->model()->addRow("Only in first");
+    ASSERT_EQ(first->model()->rowCount(), 1);
+    ASSERT_EQ(second->model()->rowCount(), 0);
+
+    ASSERT_EQ(registry.stationByName("chamber-2"), second);
+    ASSERT_EQ(registry.station(0), first);
+    ASSERT_EQ(registry.station(5), nullptr);
+}
+
+TEST(StationRegistryTest, RejectsDuplicateNames)
+{
+    StationRegistry registry;
+    ASSERT_NE(registry.addStation("chamber"), nullptr);
+    ASSERT_EQ(registry.addStation("chamber"), nullptr);
+    ASSERT_EQ(registry.addStation(""), nullptr);
+    ASSERT_EQ(registry.count(), 1);
+}
+
+TEST(StationRegistryTest, FocusedStationRefreshesFaster)
+{
+    StationRegistry registry;
+    registry.addStation("a");
+    registry.addStation("b");
+    registry.setBackgroundRefreshInterval(400);
+
+    registry.setFocusedStation(1);
+    ASSERT_LT(registry.station(1)->refreshInterval(), registry.station(0)->refreshInterval());
+    ASSERT_EQ(registry.station(0)->refreshInterval(), 400);
+
+    ASSERT_TRUE(registry.removeStation("a"));
+    ASSERT_EQ(registry.count(), 1);
+    ASSERT_EQ(registry.indexOf("b"), 0);
+}
+
+TEST(StationRegistryTest, FocusFollowsStationOnRemove)
+{
+    StationRegistry registry;
+    registry.addStation("a");
+    registry.addStation("b");
+    registry.addStation("c");
+    registry.setFocusedStation(2);
+    QSignalSpy focusChanged(&registry, &StationRegistry::focusedStationChanged);
+
+    // A station in front of the focused one shifts its index, not the focus
+    ASSERT_TRUE(registry.removeStation("a"));
+    ASSERT_EQ(registry.focusedStation(), 1);
+    ASSERT_EQ(registry.station(registry.focusedStation()), registry.stationByName("c"));
+    ASSERT_EQ(focusChanged.count(), 1);
+    ASSERT_LT(registry.stationByName("c")->refreshInterval(), registry.stationByName("b")->refreshInterval());
+
+    // Stations behind it leave the focus alone
+    registry.addStation("d");
+    ASSERT_TRUE(registry.removeStation("d"));
+    ASSERT_EQ(registry.focusedStation(), 1);
+    ASSERT_EQ(focusChanged.count(), 1);
+
+    ASSERT_TRUE(registry.removeStation("c"));
+    ASSERT_EQ(registry.focusedStation(), 0);
+    ASSERT_EQ(focusChanged.count(), 2);
+    ASSERT_TRUE(registry.removeStation("b"));
+    ASSERT_EQ(registry.focusedStation(), -1);
+    ASSERT_EQ(focusChanged.count(), 3);
+}
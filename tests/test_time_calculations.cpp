@@ -50,6 +50,32 @@ TEST(TimeCalculations, GetElapsedTimeForCycle)
     ASSERT_EQ(manager.getElapsedTimeForCycle(0), 8);
 }
 
+TEST(TimeCalculations, CycleProgressFollowsRowUpdates)
+{
+    RegimeManager manager(false, nullptr);
+    ProtoTableModel *model = manager.model();
+    for (const QString &name : {"A", "B", "C", "D"})
+        model->addRow(name);
+    model->groupRows({0, 1, 2});
+    model->groupRows({1, 2});
+    ASSERT_NE(model->getRegime(1).m_cycleId, model->getRegime(0).m_cycleId);
+    ASSERT_EQ(model->cycleTree().firstStartOffsets().at(3), 180);
+
+    model->setData(model->index(0, 0), 5, ProtoTableModel::TimePassedInSecondsRole);
+    model->setData(model->index(2, 0), 4, ProtoTableModel::TimePassedInSecondsRole);
+    ASSERT_EQ(manager.getElapsedTimeForCycle(0), 9);
+    ASSERT_EQ(manager.getElapsedTimeForCycle(1), 4);
+    ASSERT_EQ(manager.getTimeLeftForCycle(0), 55 + 60 + 56);
+    ASSERT_EQ(manager.getTimeLeftForCycle(1), 60 + 56);
+
+    // Finished repeats and definition edits reach every enclosing cycle
+    model->setData(model->index(1, 0), 1, ProtoTableModel::RepeatsDoneRole);
+    ASSERT_TRUE(model->setData(model->index(2, 0), 100, ProtoTableModel::MaxTimeRole));
+    ASSERT_EQ(manager.getTimeLeftForCycle(1), 96);
+    ASSERT_EQ(manager.getTimeLeftForCycle(0), 55 + 96);
+    ASSERT_EQ(model->cycleTree().firstStartOffsets().at(3), 220);
+}
+
 TEST(TimeCalculations, GetTotalEstimatedTime)
 {
     RegimeManager manager;
@@ -75,3 +101,211 @@ TEST(TimeCalculations, GetTotalElapsedTime)
 
     ASSERT_EQ(manager.getTotalElapsedTime(), 8);
 }
+
+TEST(TimeCalculations, NestedCycles)
+{
+    // repeat (A, repeat (B, C) x5) x20
+    RegimeManager manager(false, nullptr);
+    ProtoTableModel *model = manager.model();
+    model->addRow("A");
+    model->addRow("B");
+    model->addRow("C");
+    model->setData(model->index(0, 0), 10, ProtoTableModel::MaxTimeRole);
+    model->setData(model->index(1, 0), 20, ProtoTableModel::MaxTimeRole);
+    model->setData(model->index(2, 0), 30, ProtoTableModel::MaxTimeRole);
+
+    ASSERT_TRUE(model->isSelectionGroupable({1, 2}));
+    model->groupRows({1, 2});
+    model->setData(model->index(1, 0), 5, ProtoTableModel::CycleRepeatRole);
+    ASSERT_TRUE(model->isSelectionGroupable({0, 1}));
+    model->groupRows({0, 1});
+    model->setData(model->index(0, 0), 20, ProtoTableModel::CycleRepeatRole);
+
+    ASSERT_EQ(model->get(0, "cycle_depth").toInt(), 1);
+    ASSERT_EQ(model->get(2, "cycle_depth").toInt(), 2);
+    ASSERT_EQ(model->getRegime(2).m_outerCycles.first().repeat, 20);
+    ASSERT_EQ(manager.getTotalEstimatedTime(), 20 * (10 + 5 * (20 + 30)));
+    ASSERT_EQ(manager.getTotalTimeForCycle(1), 5 * (20 + 30));
+
+    // A duration edit goes through the cached tree
+    model->setData(model->index(0, 0), 20, ProtoTableModel::MaxTimeRole);
+    ASSERT_EQ(manager.getTotalEstimatedTime(), 20 * (20 + 5 * (20 + 30)));
+
+    manager.updateVisibleRegimes(0, manager.getTotalEstimatedTime());
+    manager.refreshVisibleRegimes();
+    ASSERT_EQ(manager.visibleRegimeModel()->rowCount(), 20 * (1 + 5 * 2));
+
+    // Nested levels survive the program file
+    const Regime restored = Regime::fromJson(model->getRegime(2).toJson());
+    ASSERT_EQ(restored.m_outerCycles, model->getRegime(2).m_outerCycles);
+    ASSERT_EQ(restored.m_cycleRepeat, 5);
+
+    // Ungrouping dissolves only the inner cycle
+    model->ungroupRows({1});
+    ASSERT_EQ(model->getRegime(1).m_cycleId, model->getRegime(0).m_cycleId);
+    ASSERT_EQ(model->getRegime(1).cycleDepth(), 1);
+    ASSERT_EQ(manager.getTotalEstimatedTime(), 20 * (20 + 20 + 30));
+
+    // A nested cycle must not be split by a row of its parent
+    ASSERT_FALSE(model->isSelectionGroupable({0, 2}));
+    model->groupRows({0, 2});
+    ASSERT_EQ(model->getRegime(0).cycleDepth(), 1);
+    ASSERT_EQ(model->getRegime(2).cycleDepth(), 1);
+    ASSERT_TRUE(model->isSelectionGroupable({1, 2}));
+}
+
+TEST(TimeCalculations, EstimatedTimeLeftUsesObservedPhases)
+{
+    RegimeManager manager(false, nullptr);
+    Regime regime;
+    regime.m_name = "Eta";
+    regime.m_condition.type = "time";
+    regime.m_condition.time = 1;
+    regime.m_maxTime = 60;
+    regime.m_repeatCount = 3;
+    manager.model()->setRegimes({regime});
+
+    qint64 clock = 0;
+    manager.eta()->setClock([&clock]() { return clock; });
+
+    // Condition phases count too: 3 * (60 + 60)
+    ASSERT_EQ(manager.getEstimatedTimeLeft(), 360);
+
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+    ASSERT_TRUE(manager.updateConditionProgress(0, 30, 0));
+    ASSERT_EQ(manager.eta()->plannedSecondsLeft(), 330);
+
+    // The condition takes 120 s instead of 60, the execution exactly its 60 s
+    clock = 120000;
+    ASSERT_TRUE(manager.confirmConditionCompletion(0, 0));
+    clock = 180000;
+    ASSERT_TRUE(manager.updateRegimeProgress(0, 60, 0));
+    ASSERT_TRUE(manager.completeCurrentRepeat(0, 0));
+
+    ASSERT_EQ(manager.eta()->plannedSecondsLeft(), 240);
+    ASSERT_GT(manager.eta()->conditionFactor(), 1.0);
+    ASSERT_DOUBLE_EQ(manager.eta()->executionFactor(), 1.0);
+    ASSERT_EQ(manager.getEstimatedTimeLeft(), qRound(120 * manager.eta()->conditionFactor()) + 120);
+    ASSERT_GT(manager.eta()->finishTime(), QDateTime::currentDateTime().addSecs(240));
+}
+
+TEST(TimeCalculations, PhaseClockExtrapolatesBetweenReports)
+{
+    RegimeManager manager(false, nullptr);
+    Regime regime;
+    regime.m_name = "Clock";
+    regime.m_condition.type = "time";
+    regime.m_condition.time = 1;
+    regime.m_maxTime = 60;
+    regime.m_repeatCount = 1;
+    manager.model()->setRegimes({regime});
+
+    qint64 clock = 0;
+    PhaseClock *phaseClock = manager.phaseClock();
+    phaseClock->setClock([&clock]() { return clock; });
+    ASSERT_FALSE(phaseClock->isActive());
+
+    ASSERT_TRUE(manager.startRegimeExecution(0));
+    ASSERT_TRUE(phaseClock->isActive());
+    clock = 10000;
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 10.0);
+    ASSERT_DOUBLE_EQ(phaseClock->regimeElapsed(0), 0.0);
+    ASSERT_DOUBLE_EQ(phaseClock->totalElapsed(), 10.0);
+
+    // Capped at the planned condition time until the driver reports the transition
+    clock = 90000;
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 60.0);
+
+    // A report overrides the extrapolation and restarts it
+    ASSERT_TRUE(manager.updateConditionProgress(0, 30, 0));
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 30.0);
+    clock = 95000;
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 35.0);
+
+    clock = 100000;
+    ASSERT_TRUE(manager.confirmConditionCompletion(0, 0));
+    clock = 112500;
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 60.0);
+    ASSERT_DOUBLE_EQ(phaseClock->regimeElapsed(0), 12.5);
+    ASSERT_DOUBLE_EQ(phaseClock->totalElapsed(), 72.5);
+
+    ASSERT_TRUE(manager.updateRegimeProgress(0, 60, 0));
+    ASSERT_TRUE(manager.completeCurrentRepeat(0, 0));
+    ASSERT_FALSE(phaseClock->isActive());
+    clock = 200000;
+    ASSERT_DOUBLE_EQ(phaseClock->regimeElapsed(0), 60.0);
+    ASSERT_DOUBLE_EQ(phaseClock->totalElapsed(), double(manager.getTotalElapsedTime()));
+}
+
+TEST(TimeCalculations, PartialWindowKeepsProgramRows)
+{
+    RegimeManager manager(false, nullptr);
+    QList<Regime> regimes(3);
+    for (int i = 0; i < regimes.count(); ++i)
+        regimes[i].m_name = QString("Row %1").arg(i);
+    manager.model()->setRegimes(regimes);
+
+    // Row 0 ends before the window starts
+    manager.updateVisibleRegimes(70, 170);
+    VisibleRegimeModel *visible = manager.visibleRegimeModel();
+    ASSERT_EQ(visible->rowCount(), 2);
+    ASSERT_EQ(visible->data(visible->index(0), VisibleRegimeModel::RegimeIndexRole).toInt(), 1);
+    ASSERT_EQ(visible->data(visible->index(0), VisibleRegimeModel::NameRole).toString(), QString("Row 1"));
+    ASSERT_EQ(visible->data(visible->index(1), VisibleRegimeModel::RegimeIndexRole).toInt(), 2);
+}
+
+TEST(TimeCalculations, PhaseClockFollowsProgramRowInPartialWindow)
+{
+    RegimeManager manager(false, nullptr);
+    QList<Regime> regimes(3);
+    for (int i = 0; i < regimes.count(); ++i) {
+        regimes[i].m_name = QString("Row %1").arg(i);
+        regimes[i].m_condition.type = "time";
+        regimes[i].m_condition.time = 1;
+    }
+    manager.model()->setRegimes(regimes);
+    qint64 clock = 0;
+    PhaseClock *phaseClock = manager.phaseClock();
+    phaseClock->setClock([&clock]() { return clock; });
+    ASSERT_TRUE(manager.startRegimeExecution(1));
+    clock = 10000;
+
+    // The timeline asks the clock for the row of its first visible entry, as TimeProgressBar does
+    manager.updateVisibleRegimes(130, 250);
+    VisibleRegimeModel *visible = manager.visibleRegimeModel();
+    const int row = visible->data(visible->index(0), VisibleRegimeModel::RegimeIndexRole).toInt();
+    ASSERT_EQ(row, 1);
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(row), 10.0);
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 0.0);
+}
+
+TEST(TimeCalculations, PhaseClockKeepsRunningRowThroughEdits)
+{
+    RegimeManager manager(false, nullptr);
+    QList<Regime> regimes(3);
+    for (int i = 0; i < regimes.count(); ++i) {
+        regimes[i].m_name = QString("Row %1").arg(i);
+        regimes[i].m_condition.type = "time";
+        regimes[i].m_condition.time = 1;
+    }
+    manager.model()->setRegimes(regimes);
+    qint64 clock = 0;
+    PhaseClock *phaseClock = manager.phaseClock();
+    phaseClock->setClock([&clock]() { return clock; });
+    ASSERT_TRUE(manager.startRegimeExecution(1));
+    clock = 10000;
+
+    // The waiting row above goes away; the running one keeps its stamp at its new index
+    manager.model()->deleteRows({0});
+    ASSERT_TRUE(phaseClock->isActive());
+    clock = 15000;
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 15.0);
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(1), 0.0);
+
+    manager.model()->addRow("Row 3");
+    ASSERT_TRUE(manager.model()->moveRows(QModelIndex(), 2, 1, QModelIndex(), 0));
+    ASSERT_EQ(manager.model()->getRegime(1).m_name, QString("Row 1"));
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(1), 15.0);
+    ASSERT_DOUBLE_EQ(phaseClock->conditionElapsed(0), 0.0);
+    ASSERT_DOUBLE_EQ(phaseClock->totalElapsed(), 15.0);
+}
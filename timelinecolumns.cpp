@@ -0,0 +1,73 @@
+#include "timelinecolumns.h"
+#include "cycletree.h"
+
+namespace {
+
+template <typename T>
+T *column(QByteArray &bytes, int rowCount)
+{
+    bytes = QByteArray(qsizetype(rowCount) * qsizetype(sizeof(T)), Qt::Uninitialized);
+    return reinterpret_cast<T *>(bytes.data());
+}
+
+} // namespace
+
+TimelineColumns TimelineColumns::build(const ProgramSnapshot &snapshot)
+{
+    const QList<Regime> regimes = snapshot.regimes.toList();
+    const int rowCount = int(regimes.count());
+
+    TimelineColumns columns;
+    columns.version = snapshot.version;
+    columns.rowCount = rowCount;
+    double *start = column<double>(columns.startOffset, rowCount);
+    double *duration = column<double>(columns.duration, rowCount);
+    qint32 *conditionTime = column<qint32>(columns.conditionTime, rowCount);
+    qint32 *maxTime = column<qint32>(columns.maxTime, rowCount);
+    double *repeatCount = column<double>(columns.repeatCount, rowCount);
+    qint32 *cycleId = column<qint32>(columns.cycleId, rowCount);
+    quint8 *state = column<quint8>(columns.state, rowCount);
+    qint32 *elapsed = column<qint32>(columns.elapsed, rowCount);
+    qint32 *currentRepeat = column<qint32>(columns.currentRepeat, rowCount);
+
+    // Planned offsets: a cycle runs all its rows in order, repeat times, where its first row is
+    CycleTree tree;
+    tree.rebuild(regimes);
+    const QList<qint64> &starts = tree.firstStartOffsets();
+
+    for (int row = 0; row < rowCount; ++row) {
+        const Regime &regime = regimes.at(row);
+        // Sums over repeats and cycle passes outgrow Int32; doubles hold them exactly up to 2^53
+        start[row] = double(starts.at(row));
+        duration[row] = double(tree.rowDuration(row));
+        conditionTime[row] = regime.conditionTimeInSeconds();
+        maxTime[row] = regime.m_maxTime;
+        repeatCount[row] = double(regime.m_repeatCount * regime.cyclePasses());
+        cycleId[row] = regime.m_cycleId;
+        state[row] = quint8(regime.m_state);
+        elapsed[row] = regime.m_timePassedInSeconds;
+        currentRepeat[row] = regime.m_currentRepeat;
+    }
+    return columns;
+}
+
+QVariantMap TimelineColumns::toVariantMap() const
+{
+    // QByteArray values reach QML as ArrayBuffer, sharing the data instead of copying per row
+    const QVariantMap data{
+        {"startOffset", startOffset},
+        {"duration", duration},
+        {"conditionTime", conditionTime},
+        {"maxTime", maxTime},
+        {"repeatCount", repeatCount},
+        {"cycleId", cycleId},
+        {"state", state},
+        {"elapsed", elapsed},
+        {"currentRepeat", currentRepeat}
+    };
+    return {
+        {"version", version},
+        {"rowCount", rowCount},
+        {"columns", data}
+    };
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVariantMap>
+#include "programsnapshot.h"
+
+/**
+ * @brief The whole program as typed columns, one entry per row, for bulk reads from QML/JS
+ *
+ * Each column is a QByteArray of native-endian values that QML receives as an ArrayBuffer,
+ * so script code wraps it in a Float64Array/Int32Array/Uint8Array view instead of fetching one
+ * QVariantMap per row. Times are in seconds; startOffset is where the row first runs in
+ * the planned timeline (cycles expanded the same way as VisibleRegimeModel), duration is
+ * its planned total over all repeats and cycle passes.
+ */
+struct TimelineColumns
+{
+    /// Snapshot version the columns were built from
+    quint64 version = 0;
+    int rowCount = 0;
+
+    QByteArray startOffset;     ///< Float64, whole seconds
+    QByteArray duration;        ///< Float64, whole seconds
+    QByteArray conditionTime;   ///< Int32, per repeat
+    QByteArray maxTime;         ///< Int32, per repeat
+    QByteArray repeatCount;     ///< Float64, effective repeats (row repeats times all enclosing cycle passes)
+    QByteArray cycleId;         ///< Int32, -1 outside cycles
+    QByteArray state;           ///< Uint8, RegimeEnums::State
+    QByteArray elapsed;         ///< Int32, time passed so far
+    QByteArray currentRepeat;   ///< Int32
+
+    static TimelineColumns build(const ProgramSnapshot &snapshot);
+
+    /// {version, rowCount, columns: {name: ArrayBuffer}} for QML
+    QVariantMap toVariantMap() const;
+};
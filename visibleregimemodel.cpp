@@ -1,4 +1,5 @@
 #include "visibleregimemodel.h"
+#include "cycletree.h"
 
 VisibleRegimeModel::VisibleRegimeModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -13,173 +14,122 @@ int VisibleRegimeModel::rowCount(const QModelIndex &parent) const
     return m_repeatEntries.count();
 }
 
+const RoleTable<VisibleRegimeModel::RepeatEntry> &VisibleRegimeModel::roleTable()
+{
+    using Entries = QList<RepeatEntry>;
+    static constexpr std::array<RoleDescriptor<RepeatEntry>, 17> descriptors{{
+        {.role = NameRole, .name = "name", .get = readMember<&RepeatEntry::regime, &Regime::m_name>},
+        {.role = MaxTimeRole, .name = "maxTime",
+         .get = [](const Entries &entries, qsizetype row) {
+             // Include condition time in the displayed max time
+             const RepeatEntry &entry = entries.at(row);
+             return QVariant(entry.regime->m_maxTime + entry.conditionTime);
+         }},
+        {.role = RepeatCountRole, .name = "repeatCount",
+         .get = [](const Entries &entries, qsizetype row) {
+             // Return appropriate repeat count: cycle repeat for cycles, individual repeat for regimes
+             const Regime &regime = *entries.at(row).regime;
+             return QVariant(regime.m_cycleId != -1 ? regime.m_cycleRepeat : regime.m_repeatCount);
+         }},
+        {.role = StateRole, .name = "state", .get = readMember<&RepeatEntry::regime, &Regime::m_state>},
+        {.role = TimePassedInSecondsRole, .name = "timePassedInSeconds",
+         .get = readMember<&RepeatEntry::regime, &Regime::m_timePassedInSeconds>},
+        {.role = CycleIdRole, .name = "cycleId", .get = readMember<&RepeatEntry::regime, &Regime::m_cycleId>},
+        {.role = IsCycleRole, .name = "isCycle",
+         .get = [](const Entries &entries, qsizetype row) { return QVariant(entries.at(row).regime->m_cycleId != -1); }},
+        {.role = ConditionTimeRole, .name = "conditionTime", .get = readMember<&RepeatEntry::conditionTime>},
+        // Pure regime execution time without condition
+        {.role = RegimeExecutionTimeRole, .name = "regimeExecutionTime",
+         .get = readMember<&RepeatEntry::regime, &Regime::m_maxTime>},
+        {.role = CurrentRepeatRole, .name = "currentRepeat",
+         .get = readMember<&RepeatEntry::regime, &Regime::m_currentRepeat>},
+        {.role = ConditionCompletedRole, .name = "conditionCompleted",
+         .get = [](const Entries &entries, qsizetype row) {
+             // For this specific repeat entry, check if it's completed
+             const RepeatEntry &entry = entries.at(row);
+             if (entry.repeatIndex < entry.regime->m_currentRepeat)
+                 return QVariant(true); // Past repeats are completed
+             if (entry.repeatIndex == entry.regime->m_currentRepeat)
+                 return QVariant(entry.regime->m_conditionCompleted); // Current repeat status
+             return QVariant(false); // Future repeats not completed
+         }},
+        {.role = ConditionTimePassedRole, .name = "conditionTimePassed",
+         .get = [](const Entries &entries, qsizetype row) {
+             const RepeatEntry &entry = entries.at(row);
+             if (entry.repeatIndex < entry.regime->m_currentRepeat)
+                 return QVariant(entry.conditionTime); // Past repeats: show full condition time
+             if (entry.repeatIndex == entry.regime->m_currentRepeat)
+                 return QVariant(entry.regime->m_conditionTimePassed); // Current repeat progress
+             return QVariant(0); // Future repeats have no progress
+         }},
+        {.role = RegimeTimePassedRole, .name = "regimeTimePassed",
+         .get = [](const Entries &entries, qsizetype row) {
+             const RepeatEntry &entry = entries.at(row);
+             if (entry.repeatIndex < entry.regime->m_currentRepeat)
+                 return QVariant(entry.regime->m_maxTime); // Past repeats: show full execution time
+             if (entry.repeatIndex == entry.regime->m_currentRepeat)
+                 return QVariant(entry.regime->m_regimeTimePassed); // Current repeat progress
+             return QVariant(0); // Future repeats have no progress
+         }},
+        {.role = RepeatIndexRole, .name = "repeatIndex", .get = readMember<&RepeatEntry::repeatIndex>},
+        {.role = RegimeIndexRole, .name = "regimeIndex", .get = readMember<&RepeatEntry::regimeIndex>},
+        {.role = IsCycleEntryRole, .name = "isCycleEntry", .get = readMember<&RepeatEntry::isCycleEntry>},
+        {.role = CycleRepeatIndexRole, .name = "cycleRepeatIndex", .get = readMember<&RepeatEntry::cycleRepeatIndex>},
+    }};
+    static_assert(RoleTable<RepeatEntry>::isContiguous(descriptors), "Role descriptors must follow the Role enum");
+    static constexpr RoleTable<RepeatEntry> table(descriptors);
+    return table;
+}
+
 QVariant VisibleRegimeModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid() || index.row() >= m_repeatEntries.count())
         return QVariant();
 
-    const RepeatEntry &entry = m_repeatEntries.at(index.row());
-    const Regime &regime = entry.regime;
-
-    switch (role) {
-    case NameRole:
-        return regime.m_name;
-    case MaxTimeRole:
-        // Include condition time in the displayed max time
-        {
-            int conditionTimeInSeconds = 0;
-            if (regime.m_condition.type == "time" || regime.m_condition.type == "temp") {
-                conditionTimeInSeconds = regime.m_condition.time * 60; // Convert minutes to seconds
-            }
-            return regime.m_maxTime + conditionTimeInSeconds;
-        }
-    case RepeatCountRole:
-        // Return appropriate repeat count: cycle repeat for cycles, individual repeat for regimes
-        if (regime.m_cycleId != -1) {
-            return regime.m_cycleRepeat;
-        }
-        return regime.m_repeatCount;
-    case StateRole:
-        return QVariant::fromValue(regime.m_state);
-    case TimePassedInSecondsRole:
-        return regime.m_timePassedInSeconds;
-    case CycleIdRole:
-        return regime.m_cycleId;
-    case IsCycleRole:
-        return regime.m_cycleId != -1;
-    case ConditionTimeRole:
-        {
-            int conditionTimeInSeconds = 0;
-            if (regime.m_condition.type == "time" || regime.m_condition.type == "temp") {
-                conditionTimeInSeconds = regime.m_condition.time * 60; // Convert minutes to seconds
-            }
-            return conditionTimeInSeconds;
-        }
-    case RegimeExecutionTimeRole:
-        return regime.m_maxTime; // Pure regime execution time without condition
-    case CurrentRepeatRole:
-        return regime.m_currentRepeat;
-    case ConditionCompletedRole:
-        // For this specific repeat entry, check if it's completed
-        if (entry.repeatIndex < regime.m_currentRepeat) {
-            return true; // Past repeats are completed
-        } else if (entry.repeatIndex == regime.m_currentRepeat) {
-            return regime.m_conditionCompleted; // Current repeat status
-        }
-        return false; // Future repeats not completed
-    case ConditionTimePassedRole:
-        // For this specific repeat entry, return appropriate progress
-        if (entry.repeatIndex < regime.m_currentRepeat) {
-            // Past repeats: show full condition time
-            int conditionTimeInSeconds = 0;
-            if (regime.m_condition.type == "time" || regime.m_condition.type == "temp") {
-                conditionTimeInSeconds = regime.m_condition.time * 60;
-            }
-            return conditionTimeInSeconds;
-        } else if (entry.repeatIndex == regime.m_currentRepeat) {
-            return regime.m_conditionTimePassed; // Current repeat progress
-        }
-        return 0; // Future repeats have no progress
-    case RegimeTimePassedRole:
-        // For this specific repeat entry, return appropriate progress
-        if (entry.repeatIndex < regime.m_currentRepeat) {
-            return regime.m_maxTime; // Past repeats: show full execution time
-        } else if (entry.repeatIndex == regime.m_currentRepeat) {
-            return regime.m_regimeTimePassed; // Current repeat progress
-        }
-        return 0; // Future repeats have no progress
-    case RepeatIndexRole:
-        return entry.repeatIndex;
-    case RegimeIndexRole:
-        return entry.regimeIndex;
-    case IsCycleEntryRole:
-        return entry.isCycleEntry;
-    case CycleRepeatIndexRole:
-        return entry.cycleRepeatIndex;
-    }
-
-    return QVariant();
+    const RoleDescriptor<RepeatEntry> *descriptor = roleTable().find(role);
+    return descriptor ? descriptor->get(m_repeatEntries, index.row()) : QVariant();
 }
 
 QHash<int, QByteArray> VisibleRegimeModel::roleNames() const
 {
-    return {
-        { NameRole, "name" },
-        { MaxTimeRole, "maxTime" },
-        { RepeatCountRole, "repeatCount" },
-        { StateRole, "state" },
-        { TimePassedInSecondsRole, "timePassedInSeconds" },
-        { CycleIdRole, "cycleId" },
-        { IsCycleRole, "isCycle" },
-        { ConditionTimeRole, "conditionTime" },
-        { RegimeExecutionTimeRole, "regimeExecutionTime" },
-        { CurrentRepeatRole, "currentRepeat" },
-        { ConditionCompletedRole, "conditionCompleted" },
-        { ConditionTimePassedRole, "conditionTimePassed" },
-        { RegimeTimePassedRole, "regimeTimePassed" },
-        { RepeatIndexRole, "repeatIndex" },
-        { RegimeIndexRole, "regimeIndex" },
-        { IsCycleEntryRole, "isCycleEntry" },
-        { CycleRepeatIndexRole, "cycleRepeatIndex" }
-    };
+    static const QHash<int, QByteArray> names = roleTable().roleNames();
+    return names;
 }
 
-void VisibleRegimeModel::setRegimes(const QList<Regime> &regimes)
+void VisibleRegimeModel::setRegimes(const QList<Regime> &regimes, const QList<int> &sourceRows)
 {
+    Q_ASSERT(sourceRows.isEmpty() || sourceRows.count() == regimes.count());
     beginResetModel();
-    expandRegimesToRepeats(regimes);
+    expandRegimesToRepeats(regimes, sourceRows);
     endResetModel();
 }
 
-void VisibleRegimeModel::expandRegimesToRepeats(const QList<Regime> &regimes)
+qint64 VisibleRegimeModel::bytesUsed() const
 {
-    m_repeatEntries.clear();
-    QSet<int> processedCycleIds;
-
-    for (int regimeIndex = 0; regimeIndex < regimes.count(); ++regimeIndex) {
-        const Regime &regime = regimes.at(regimeIndex);
+    return qint64(m_repeatEntries.capacity()) * qint64(sizeof(RepeatEntry));
+}
 
-        if (regime.m_cycleId != -1) {
-            if (!processedCycleIds.contains(regime.m_cycleId)) {
-                // This is the first regime of a new cycle
-                QList<int> cycleRegimeIndices;
-                for (int i = regimeIndex; i < regimes.count(); ++i) {
-                    if (regimes.at(i).m_cycleId == regime.m_cycleId) {
-                        cycleRegimeIndices.append(i);
-                    }
-                }
+void VisibleRegimeModel::expandRegimesToRepeats(const QList<Regime> &regimes, const QList<int> &sourceRows)
+{
+    m_repeatEntries.clear();
+    // Entries point into this copy; it shares the caller's buffer and is never written to
+    m_regimes = regimes;
+    const Regime *rows = m_regimes.constData();
 
-                for (int cycleRepeat = 0; cycleRepeat < regime.m_cycleRepeat; ++cycleRepeat) {
-                    for (int cycleRegimeIndex : cycleRegimeIndices) {
-                        const Regime &cycleRegime = regimes.at(cycleRegimeIndex);
-                        // a cycle regime is a sequence of regimes that repeats
-                        // so we need to add each repeat of the regime to the list
-                         for (int repeat = 0; repeat < cycleRegime.m_repeatCount; ++repeat) {
-                            RepeatEntry entry;
-                            entry.regime = cycleRegime;
-                            entry.repeatIndex = repeat;
-                            entry.regimeIndex = cycleRegimeIndex;
-                            entry.isCycleEntry = true;
-                            entry.cycleRepeatIndex = cycleRepeat;
-                            m_repeatEntries.append(entry);
-                        }
-                    }
-                }
-                processedCycleIds.insert(regime.m_cycleId);
-            }
-        } else {
-            // Individual regime - expand by repeat count
-            for (int repeat = 0; repeat < regime.m_repeatCount; ++repeat) {
-                RepeatEntry entry;
-                entry.regime = regime;
-                entry.repeatIndex = repeat;
-                entry.regimeIndex = regimeIndex;
-                entry.isCycleEntry = false;
-                entry.cycleRepeatIndex = 0;
-                m_repeatEntries.append(entry);
-            }
-        }
-    }
+    // Cycles, nested ones included, repeat their rows in order; each repeat is one entry
+    CycleTree tree;
+    tree.rebuild(m_regimes);
+    tree.forEachRepeat([&](int regimeIndex, int repeat, int cyclePass) {
+        const Regime &regime = rows[regimeIndex];
+        RepeatEntry entry;
+        entry.regime = &regime;
+        entry.conditionTime = regime.conditionTimeInSeconds();
+        entry.repeatIndex = repeat;
+        entry.regimeIndex = sourceRows.isEmpty() ? regimeIndex : sourceRows.at(regimeIndex);
+        entry.isCycleEntry = regime.m_cycleId != -1;
+        entry.cycleRepeatIndex = cyclePass;
+        m_repeatEntries.append(entry);
+    });
 }
 
 void VisibleRegimeModel::notifyTimelineUpdate()
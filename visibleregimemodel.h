@@ -2,6 +2,7 @@
 
 #include <QAbstractListModel>
 #include "regime.h"
+#include "roletable.h"
 
 class VisibleRegimeModel : public QAbstractListModel
 {
@@ -25,7 +26,7 @@ public:
         ConditionTimePassedRole, ///< Time passed in condition phase (seconds)
         RegimeTimePassedRole,   ///< Time passed in execution phase (seconds)
         RepeatIndexRole,        ///< Which repeat this entry represents (0-based)
-        RegimeIndexRole,        ///< Index in the original regime list
+        RegimeIndexRole,        ///< Row of the regime in the program (ProtoTableModel)
         IsCycleEntryRole,       ///< True if this is part of a cycle expansion
         CycleRepeatIndexRole    ///< Which cycle repeat this represents (0-based)
     };
@@ -34,27 +35,39 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
 
-    void setRegimes(const QList<Regime> &regimes);
+    /**
+     * @brief Expands rows into one entry per repeat
+     * @param sourceRows Program row of each of regimes, exposed as regimeIndex; empty if
+     *        regimes is the whole program
+     */
+    void setRegimes(const QList<Regime> &regimes, const QList<int> &sourceRows = {});
+    /// Memory held by the expanded entries; the rows they point to are shared with the caller
+    qint64 bytesUsed() const;
     
     // Function to be called by ProtoTableModel when total time changes
     Q_INVOKABLE void notifyTimelineUpdate();
     
 private:
     struct RepeatEntry {
-        Regime regime;          // The base regime
+        const Regime *regime = nullptr; // The base regime, a row of m_regimes
         int repeatIndex;        // Which repeat this represents (0-based)
-        int regimeIndex;        // Index in the original regime list
+        int regimeIndex;        // Row of the regime in the program
         bool isCycleEntry;      // True if this is part of a cycle expansion
         int cycleRepeatIndex;   // Which cycle repeat this represents (0-based)
+        int conditionTime = 0;  // Condition time in seconds, computed once on expansion
     };
+
+    /// Accessors of every role, indexed by role id
+    static const RoleTable<RepeatEntry> &roleTable();
     
     QList<RepeatEntry> m_repeatEntries;  // Expanded repeat entries
     
-    void expandRegimesToRepeats(const QList<Regime> &regimes);
+    void expandRegimesToRepeats(const QList<Regime> &regimes, const QList<int> &sourceRows);
 
 signals:
     void timelineUpdateRequired();
 
 private:
+    /// Rows the entries point into; replaced as a whole, never modified in place
     QList<Regime> m_regimes;
 };
\ No newline at end of file